@@ -0,0 +1,800 @@
+#include "asynclog.h"
+#include "spscring.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+// Version 2 records each argument's size after its type.
+constexpr char BinaryMagic[8] = {'W', 'S', 'L', 'B', 'L', 'O', 'G', '2'};
+constexpr char DefinitionRecord = 'D';
+constexpr char EventRecord = 'E';
+
+// Everything a line needs that is the same for every record from a site.
+struct LogDefinition {
+    LogLevel level = LogLevel::Info;
+    std::string_view file;
+    uint32_t line = 0;
+    std::string_view format;
+    const LogArgType* types = nullptr;
+    const uint8_t* sizes = nullptr;
+    uint8_t argumentCount = 0;
+};
+
+uint32_t CurrentThreadId() {
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return static_cast<uint32_t>(syscall(SYS_gettid));
+#endif
+}
+
+uint64_t WallClockNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+}
+
+template <typename T>
+void Append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(std::string& out, std::string_view text) {
+    Append(out, static_cast<uint16_t>(text.size()));
+    out.append(text);
+}
+
+void AppendFormatted(std::string& out, const char* format, ...) {
+    char buffer[MaxLogStringSize + 128];
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    va_end(arguments);
+    if (length > 0) {
+        out.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+    }
+}
+
+// 2026-01-31T23:59:59.123456Z
+void AppendTime(std::string& out, uint64_t wallNanoseconds) {
+    const time_t seconds = static_cast<time_t>(wallNanoseconds / 1000000000);
+    tm parts{};
+#ifdef _WIN32
+    gmtime_s(&parts, &seconds);
+#else
+    gmtime_r(&seconds, &parts);
+#endif
+    AppendFormatted(out,
+                    "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ",
+                    parts.tm_year + 1900,
+                    parts.tm_mon + 1,
+                    parts.tm_mday,
+                    parts.tm_hour,
+                    parts.tm_min,
+                    parts.tm_sec,
+                    static_cast<unsigned>(wallNanoseconds % 1000000000 / 1000));
+}
+
+std::string_view BaseName(std::string_view path) {
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+// Reads the next argument of a record, or throws if the record is cut short.
+class ArgumentReader {
+public:
+    ArgumentReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    T Read() {
+        T value;
+        Take(&value, sizeof(value));
+        return value;
+    }
+
+    std::string_view ReadString() {
+        const uint16_t length = Read<uint16_t>();
+        if (size_ - offset_ < length) {
+            throw std::runtime_error("Log record is truncated");
+        }
+        std::string_view text(data_ + offset_, length);
+        offset_ += length;
+        return text;
+    }
+
+private:
+    void Take(void* out, size_t size) {
+        if (size_ - offset_ < size) {
+            throw std::runtime_error("Log record is truncated");
+        }
+        std::memcpy(out, data_ + offset_, size);
+        offset_ += size;
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t offset_ = 0;
+};
+
+void AppendCodePoint(std::string& out, uint32_t c) {
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    }
+    else if (c < 0x800) {
+        out += static_cast<char>(0xC0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000) {
+        out += static_cast<char>(0xE0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+}
+
+// Formats the message part of a line. Each conversion is handed to
+// snprintf on its own, rewritten for the type the argument was stored as.
+void AppendMessage(std::string& out, const LogDefinition& definition, const char* arguments, size_t size) {
+    const std::string_view format = definition.format;
+    ArgumentReader reader(arguments, size);
+    size_t position = 0;
+    for (uint8_t index = 0;; ++index) {
+        const LogDetail::Conversion conversion = LogDetail::NextConversion(format, position);
+
+        // Literal text up to the conversion, with "%%" unescaped.
+        for (size_t i = position; i < conversion.begin; ++i) {
+            out += format[i];
+            if (format[i] == '%') {
+                ++i;
+            }
+        }
+        if (conversion.type == 0) {
+            return;
+        }
+        if (index >= definition.argumentCount) {
+            throw std::runtime_error("Log record has fewer arguments than its format");
+        }
+
+        // Flags, width and precision; the length modifier is ours to choose.
+        std::string spec(1, '%');
+        for (size_t i = conversion.begin + 1; i + 1 < conversion.end; ++i) {
+            if (std::string_view("hlLzjtq").find(format[i]) == std::string_view::npos) {
+                spec += format[i];
+            }
+        }
+
+        const LogArgType type = definition.types[index];
+        switch (type) {
+        case LogArgType::String: {
+            // The text is not terminated, so the precision always comes
+            // from here.
+            std::string_view text = reader.ReadString();
+            const size_t dot = spec.find('.');
+            if (dot != std::string::npos) {
+                text = text.substr(0, static_cast<size_t>(std::atoi(spec.c_str() + dot + 1)));
+                spec.resize(dot);
+            }
+            spec += ".*s";
+            AppendFormatted(out, spec.c_str(), static_cast<int>(text.size()), text.data());
+            break;
+        }
+        case LogArgType::Double:
+            spec += conversion.type;
+            AppendFormatted(out, spec.c_str(), reader.Read<double>());
+            break;
+        case LogArgType::Pointer:
+            AppendFormatted(out, "0x%016llx", static_cast<unsigned long long>(reader.Read<uint64_t>()));
+            break;
+        default: {
+            int64_t value = 0;
+            if (type == LogArgType::Char) {
+                value = reader.Read<uint32_t>();
+            }
+            else {
+                value = reader.Read<int64_t>();
+            }
+            if (conversion.type == 'c') {
+                std::string character;
+                AppendCodePoint(character, static_cast<uint32_t>(value));
+                spec += 's';
+                AppendFormatted(out, spec.c_str(), character.c_str());
+            }
+            else if (conversion.type == 'd' || conversion.type == 'i') {
+                spec += "ll";
+                spec += conversion.type;
+                AppendFormatted(out, spec.c_str(), static_cast<long long>(value));
+            }
+            else {
+                // Signed values are stored sign-extended; cut them back to
+                // the width they were passed at.
+                uint64_t bits = static_cast<uint64_t>(value);
+                const uint8_t width = definition.sizes[index];
+                if (width < sizeof(bits)) {
+                    bits &= (uint64_t{1} << (8 * width)) - 1;
+                }
+                spec += "ll";
+                spec += conversion.type;
+                AppendFormatted(out, spec.c_str(), static_cast<unsigned long long>(bits));
+            }
+            break;
+        }
+        }
+        position = conversion.end;
+    }
+}
+
+// <time> <LEVEL> <thread> <file>:<line> <message>
+void AppendLine(std::string& out,
+                const LogDefinition& definition,
+                uint64_t wallNanoseconds,
+                uint32_t threadId,
+                const char* arguments,
+                size_t size) {
+    AppendTime(out, wallNanoseconds);
+    const std::string_view level = LogLevelName(definition.level);
+    const std::string_view file = BaseName(definition.file);
+    AppendFormatted(out,
+                    " %-5.*s %5u %.*s:%u ",
+                    static_cast<int>(level.size()),
+                    level.data(),
+                    threadId,
+                    static_cast<int>(file.size()),
+                    file.data(),
+                    definition.line);
+    AppendMessage(out, definition, arguments, size);
+    out += '\n';
+}
+
+} // namespace
+
+std::string_view LogLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace:
+        return "TRACE";
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warning:
+        return "WARN";
+    case LogLevel::Error:
+        return "ERROR";
+    }
+    return "?";
+}
+
+namespace LogDetail {
+
+// One producer thread's records, on their way to the writer thread.
+class ThreadBuffer {
+public:
+    ThreadBuffer(size_t capacity, uint32_t threadId) : ring(capacity), threadId(threadId) {}
+
+    SpscRing<char> ring;
+    const uint32_t threadId;
+    std::atomic<uint64_t> dropped{0};
+
+    // The thread has exited; the buffer goes once it is drained.
+    std::atomic<bool> closed{false};
+};
+
+namespace {
+
+// Keeps the thread's buffer alive for the writer after the thread exits.
+struct ThreadOwner {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadOwner() {
+        if (buffer) {
+            buffer->closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
+} // namespace
+
+size_t EncodeWide(char* out, size_t capacity, const wchar_t* text, size_t length) {
+    size_t size = 0;
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t c = static_cast<uint32_t>(text[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0xD800 && c < 0xDC00 && i + 1 < length) {
+                const uint32_t low = static_cast<uint32_t>(text[i + 1]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+        }
+        if (c >= 0xD800 && c < 0xE000) {
+            c = 0xFFFD;
+        }
+
+        char encoded[4];
+        size_t count = 0;
+        if (c < 0x80) {
+            encoded[count++] = static_cast<char>(c);
+        }
+        else if (c < 0x800) {
+            encoded[count++] = static_cast<char>(0xC0 | (c >> 6));
+            encoded[count++] = static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            encoded[count++] = static_cast<char>(0xE0 | (c >> 12));
+            encoded[count++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded[count++] = static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else {
+            encoded[count++] = static_cast<char>(0xF0 | (c >> 18));
+            encoded[count++] = static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            encoded[count++] = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded[count++] = static_cast<char>(0x80 | (c & 0x3F));
+        }
+
+        // Stop at a whole character.
+        if (size + count > capacity) {
+            break;
+        }
+        std::memcpy(out + size, encoded, count);
+        size += count;
+    }
+    return size;
+}
+
+void Commit(ThreadBuffer* buffer, const char* record, size_t size) {
+    // Only the writer thread frees space, so a record that fits now still
+    // fits when Push() gets to it.
+    if (buffer->ring.Capacity() - buffer->ring.SizeApprox() < size) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->ring.Push(record, size);
+}
+
+} // namespace LogDetail
+
+class AsyncLogger::Impl {
+public:
+    Impl(ByteSink& output, LogOutput format, AsyncLoggerOptions options)
+        : level(options.level),
+          output_(output),
+          format_(format),
+          options_(options),
+          steadyBase_(LogDetail::Now()),
+          wallBase_(WallClockNow()) {
+        if (format_ == LogOutput::Binary) {
+            std::string header(BinaryMagic, sizeof(BinaryMagic));
+            Append(header, wallBase_);
+            Append(header, steadyBase_);
+            output_.Write(header.data(), header.size());
+        }
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    ~Impl() {
+        {
+            std::lock_guard lock(lock_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    void Flush();
+    LogDetail::ThreadBuffer* Attach();
+
+    uint64_t Written() const { return written_.load(std::memory_order_relaxed); }
+
+    uint64_t Dropped() const {
+        std::lock_guard lock(buffersLock_);
+        uint64_t dropped = retiredDropped_;
+        for (const auto& buffer : buffers_) {
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    // Set under installLock.
+    LogLevel level;
+    uint64_t generation = 0;
+
+private:
+    // A record taken out of a buffer, waiting to be put in order.
+    struct Pending {
+        uint64_t timestamp;
+        uint32_t threadId;
+        size_t offset; // of the record in batch_
+    };
+
+    void Run();
+    void Drain();
+    size_t Take(LogDetail::ThreadBuffer& buffer);
+    void Write(const Pending& pending);
+    uint32_t DefinitionId(const LogRecordHeader& header);
+
+    ByteSink& output_;
+    const LogOutput format_;
+    const AsyncLoggerOptions options_;
+    const uint64_t steadyBase_;
+    const uint64_t wallBase_;
+
+    mutable std::mutex buffersLock_;
+    std::vector<std::shared_ptr<LogDetail::ThreadBuffer>> buffers_;
+    uint64_t retiredDropped_ = 0;
+
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    uint64_t flushRequested_ = 0;
+    uint64_t flushCompleted_ = 0;
+    bool stopping_ = false;
+
+    // Writer thread only.
+    std::vector<char> batch_;
+    std::vector<Pending> pending_;
+    std::string text_;
+    std::unordered_map<const LogSite*, uint32_t> definitions_;
+
+    std::atomic<uint64_t> written_{0};
+    std::thread thread_;
+};
+
+namespace {
+
+// The installed logger.
+std::mutex installLock;
+AsyncLogger* installed = nullptr;
+uint64_t lastGeneration = 0;
+
+thread_local LogDetail::ThreadOwner threadOwner;
+
+} // namespace
+
+LogDetail::ThreadBuffer* AsyncLogger::Impl::Attach() {
+    auto buffer = std::make_shared<LogDetail::ThreadBuffer>(options_.threadBufferSize, CurrentThreadId());
+    {
+        std::lock_guard lock(buffersLock_);
+        buffers_.push_back(buffer);
+    }
+
+    // A buffer left over from an earlier logger is that logger's to drain.
+    if (threadOwner.buffer) {
+        threadOwner.buffer->closed.store(true, std::memory_order_release);
+    }
+    threadOwner.buffer = std::move(buffer);
+    return threadOwner.buffer.get();
+}
+
+void AsyncLogger::Impl::Flush() {
+    std::unique_lock lock(lock_);
+    const uint64_t ticket = ++flushRequested_;
+    wake_.notify_one();
+    flushed_.wait(lock, [&] { return flushCompleted_ >= ticket; });
+}
+
+void AsyncLogger::Impl::Run() {
+    std::unique_lock lock(lock_);
+    for (;;) {
+        wake_.wait_for(lock, options_.flushInterval, [&] { return stopping_ || flushRequested_ > flushCompleted_; });
+        const uint64_t target = flushRequested_;
+        const bool stopping = stopping_;
+
+        lock.unlock();
+        Drain();
+        lock.lock();
+
+        flushCompleted_ = target;
+        flushed_.notify_all();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+void AsyncLogger::Impl::Drain() {
+    std::vector<std::shared_ptr<LogDetail::ThreadBuffer>> buffers;
+    {
+        std::lock_guard lock(buffersLock_);
+        buffers = buffers_;
+    }
+
+    batch_.clear();
+    pending_.clear();
+    for (const auto& buffer : buffers) {
+        Take(*buffer);
+    }
+
+    // Each buffer is in order already; this interleaves the threads.
+    std::stable_sort(pending_.begin(), pending_.end(), [](const Pending& left, const Pending& right) {
+        return left.timestamp < right.timestamp;
+    });
+
+    text_.clear();
+    for (const auto& pending : pending_) {
+        Write(pending);
+    }
+    if (!text_.empty()) {
+        output_.Write(text_.data(), text_.size());
+    }
+    written_.fetch_add(pending_.size(), std::memory_order_relaxed);
+
+    // Forget threads that have gone, once nothing of theirs is left.
+    std::lock_guard lock(buffersLock_);
+    std::erase_if(buffers_, [&](const std::shared_ptr<LogDetail::ThreadBuffer>& buffer) {
+        if (!buffer->closed.load(std::memory_order_acquire) || !buffer->ring.EmptyApprox()) {
+            return false;
+        }
+        retiredDropped_ += buffer->dropped.load(std::memory_order_relaxed);
+        return true;
+    });
+}
+
+// Moves the records committed so far into batch_.
+size_t AsyncLogger::Impl::Take(LogDetail::ThreadBuffer& buffer) {
+    size_t available = buffer.ring.SizeApprox();
+    size_t taken = 0;
+    while (available >= sizeof(LogRecordHeader)) {
+        const size_t offset = batch_.size();
+        batch_.resize(offset + sizeof(LogRecordHeader));
+        buffer.ring.Pop(batch_.data() + offset, sizeof(LogRecordHeader));
+
+        LogRecordHeader header;
+        std::memcpy(&header, batch_.data() + offset, sizeof(header));
+        const size_t rest = header.size - sizeof(LogRecordHeader);
+        batch_.resize(offset + header.size);
+
+        // A record that wrapped around the end of the ring is committed in
+        // two steps; the second is at most a few instructions away.
+        size_t popped = 0;
+        while (popped < rest) {
+            popped += buffer.ring.Pop(batch_.data() + offset + sizeof(LogRecordHeader) + popped, rest - popped);
+            if (popped < rest) {
+                std::this_thread::yield();
+            }
+        }
+
+        pending_.push_back({header.timestamp, buffer.threadId, offset});
+        available = available > header.size ? available - header.size : buffer.ring.SizeApprox();
+        ++taken;
+    }
+    return taken;
+}
+
+uint32_t AsyncLogger::Impl::DefinitionId(const LogRecordHeader& header) {
+    const auto found = definitions_.find(header.site);
+    if (found != definitions_.end()) {
+        return found->second;
+    }
+
+    const uint32_t id = static_cast<uint32_t>(definitions_.size());
+    definitions_.emplace(header.site, id);
+
+    text_ += DefinitionRecord;
+    Append(text_, id);
+    Append(text_, static_cast<uint8_t>(header.site->level));
+    Append(text_, header.site->line);
+    AppendString(text_, header.site->file);
+    AppendString(text_, header.format);
+    Append(text_, header.argumentCount);
+    text_.append(reinterpret_cast<const char*>(header.types), header.argumentCount);
+    text_.append(reinterpret_cast<const char*>(header.sizes), header.argumentCount);
+    return id;
+}
+
+void AsyncLogger::Impl::Write(const Pending& pending) {
+    LogRecordHeader header;
+    std::memcpy(&header, batch_.data() + pending.offset, sizeof(header));
+    const char* arguments = batch_.data() + pending.offset + sizeof(LogRecordHeader);
+    const size_t size = header.size - sizeof(LogRecordHeader);
+
+    if (format_ == LogOutput::Binary) {
+        const uint32_t id = DefinitionId(header);
+        text_ += EventRecord;
+        Append(text_, id);
+        Append(text_, header.timestamp);
+        Append(text_, pending.threadId);
+        Append(text_, static_cast<uint16_t>(size));
+        text_.append(arguments, size);
+        return;
+    }
+
+    LogDefinition definition;
+    definition.level = header.site->level;
+    definition.file = header.site->file;
+    definition.line = header.site->line;
+    definition.format = header.format;
+    definition.types = header.types;
+    definition.sizes = header.sizes;
+    definition.argumentCount = header.argumentCount;
+    AppendLine(text_, definition, wallBase_ + (header.timestamp - steadyBase_), pending.threadId, arguments, size);
+}
+
+namespace LogDetail {
+
+ThreadBuffer* AttachThread(uint64_t generation) {
+    std::lock_guard lock(installLock);
+    if (!installed || installed->pImpl_->generation != generation) {
+        return nullptr;
+    }
+    ThreadBuffer* buffer = installed->pImpl_->Attach();
+    threadState = {generation, buffer};
+    return buffer;
+}
+
+} // namespace LogDetail
+
+AsyncLogger::AsyncLogger(ByteSink& output, LogOutput format, AsyncLoggerOptions options)
+    : pImpl_(std::make_unique<Impl>(output, format, options)) {}
+
+AsyncLogger::~AsyncLogger() {
+    Uninstall();
+}
+
+void AsyncLogger::Install() {
+    std::lock_guard lock(installLock);
+    if (installed && installed != this) {
+        throw std::logic_error("Another logger is already installed");
+    }
+    installed = this;
+    pImpl_->generation = ++lastGeneration;
+    LogDetail::installedLevel.store(static_cast<uint8_t>(pImpl_->level), std::memory_order_relaxed);
+    LogDetail::installedGeneration.store(pImpl_->generation, std::memory_order_release);
+}
+
+void AsyncLogger::Uninstall() {
+    std::lock_guard lock(installLock);
+    if (installed == this) {
+        installed = nullptr;
+        LogDetail::installedGeneration.store(0, std::memory_order_release);
+    }
+}
+
+void AsyncLogger::SetLevel(LogLevel level) {
+    std::lock_guard lock(installLock);
+    pImpl_->level = level;
+    if (installed == this) {
+        LogDetail::installedLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogger::Flush() {
+    pImpl_->Flush();
+}
+
+uint64_t AsyncLogger::Written() const {
+    return pImpl_->Written();
+}
+
+uint64_t AsyncLogger::Dropped() const {
+    return pImpl_->Dropped();
+}
+
+void DecodeBinaryLog(ByteSource& input, ByteSink& output) {
+    auto readExactly = [&](void* buffer, size_t size) {
+        if (input.ReadFully(static_cast<char*>(buffer), size) != size) {
+            throw std::runtime_error("Binary log is truncated");
+        }
+    };
+    auto readString = [&](std::deque<std::string>& storage) -> std::string_view {
+        uint16_t length = 0;
+        readExactly(&length, sizeof(length));
+        std::string& text = storage.emplace_back(length, '\0');
+        readExactly(text.data(), length);
+        return text;
+    };
+
+    std::deque<std::string> strings;
+    std::deque<std::vector<LogArgType>> types;
+    std::deque<std::vector<uint8_t>> sizes;
+    std::vector<LogDefinition> definitions;
+    std::vector<char> arguments;
+    std::string text;
+    uint64_t wallBase = 0;
+    uint64_t steadyBase = 0;
+
+    // A log file that was appended to holds one session after another,
+    // each starting with the magic.
+    char kind = 0;
+    bool started = false;
+    while (input.ReadFully(&kind, 1) == 1) {
+        if (kind == BinaryMagic[0] || !started) {
+            char magic[sizeof(BinaryMagic)] = {kind};
+            if (input.ReadFully(magic + 1, sizeof(magic) - 1) != sizeof(magic) - 1 ||
+                std::memcmp(magic, BinaryMagic, sizeof(magic)) != 0) {
+                throw std::runtime_error("Not a binary log");
+            }
+            readExactly(&wallBase, sizeof(wallBase));
+            readExactly(&steadyBase, sizeof(steadyBase));
+            strings.clear();
+            types.clear();
+            sizes.clear();
+            definitions.clear();
+            started = true;
+            continue;
+        }
+
+        uint32_t id = 0;
+        readExactly(&id, sizeof(id));
+        if (kind == DefinitionRecord) {
+            if (id != definitions.size()) {
+                throw std::runtime_error("Binary log definitions are out of order");
+            }
+            LogDefinition definition;
+            uint8_t level = 0;
+            readExactly(&level, sizeof(level));
+            if (level > static_cast<uint8_t>(LogLevel::Error)) {
+                throw std::runtime_error("Binary log has an unknown level");
+            }
+            definition.level = static_cast<LogLevel>(level);
+            readExactly(&definition.line, sizeof(definition.line));
+            definition.file = readString(strings);
+            definition.format = readString(strings);
+            readExactly(&definition.argumentCount, sizeof(definition.argumentCount));
+            auto& argumentTypes = types.emplace_back(definition.argumentCount);
+            readExactly(argumentTypes.data(), argumentTypes.size());
+            for (LogArgType type : argumentTypes) {
+                if (type > LogArgType::Pointer) {
+                    throw std::runtime_error("Binary log has an unknown argument type");
+                }
+            }
+            auto& argumentSizes = sizes.emplace_back(definition.argumentCount);
+            readExactly(argumentSizes.data(), argumentSizes.size());
+            for (uint8_t size : argumentSizes) {
+                if (size != 1 && size != 2 && size != 4 && size != 8) {
+                    throw std::runtime_error("Binary log has an unknown argument size");
+                }
+            }
+            definition.types = argumentTypes.data();
+            definition.sizes = argumentSizes.data();
+            definitions.push_back(definition);
+        }
+        else if (kind == EventRecord) {
+            if (id >= definitions.size()) {
+                throw std::runtime_error("Binary log refers to an undefined site");
+            }
+            uint64_t timestamp = 0;
+            uint32_t threadId = 0;
+            uint16_t size = 0;
+            readExactly(&timestamp, sizeof(timestamp));
+            readExactly(&threadId, sizeof(threadId));
+            readExactly(&size, sizeof(size));
+            arguments.resize(size);
+            readExactly(arguments.data(), size);
+
+            text.clear();
+            AppendLine(text, definitions[id], wallBase + (timestamp - steadyBase), threadId, arguments.data(), size);
+            output.Write(text.data(), text.size());
+        }
+        else {
+            throw std::runtime_error("Binary log has an unknown record");
+        }
+    }
+}
+
+} // namespace WSL
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "bytestream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Logging that costs the calling thread a few tens of nanoseconds: a call
+// copies the raw arguments into a lock-free buffer owned by the thread, and
+// a background thread formats them later, or writes them out unformatted
+// for wsllogdecode to format offline.
+//
+//     WSL_LOG_ERROR("Launch of %ls failed: 0x%08x", name.c_str(), status);
+//
+// The format is printf's, checked against the arguments at compile time.
+// Levels below WSL_LOG_COMPILED_LEVEL are compiled out, arguments and all;
+// the default keeps Trace and Debug only in debug builds.
+
+#ifndef WSL_LOG_COMPILED_LEVEL
+#ifdef NDEBUG
+#define WSL_LOG_COMPILED_LEVEL 2 // Info
+#else
+#define WSL_LOG_COMPILED_LEVEL 0 // Trace
+#endif
+#endif
+
+#define WSL_LOG_AT(level, ...)                                                                          \
+    do {                                                                                                \
+        if constexpr (::WSL::LogDetail::CompiledIn(::WSL::LogLevel::level)) {                           \
+            static constexpr ::WSL::LogSite wslLogSite_{::WSL::LogLevel::level, __FILE__, __LINE__};    \
+            ::WSL::WriteLog(wslLogSite_, __VA_ARGS__);                                                  \
+        }                                                                                               \
+    } while (0)
+
+#define WSL_LOG_TRACE(...) WSL_LOG_AT(Trace, __VA_ARGS__)
+#define WSL_LOG_DEBUG(...) WSL_LOG_AT(Debug, __VA_ARGS__)
+#define WSL_LOG_INFO(...) WSL_LOG_AT(Info, __VA_ARGS__)
+#define WSL_LOG_WARNING(...) WSL_LOG_AT(Warning, __VA_ARGS__)
+#define WSL_LOG_ERROR(...) WSL_LOG_AT(Error, __VA_ARGS__)
+
+namespace WSL {
+
+enum class LogLevel : uint8_t {
+    Trace,
+    Debug,
+    Info,
+    Warning,
+    Error
+};
+
+std::string_view LogLevelName(LogLevel level);
+
+// Where a log call is; one per call site, in static storage.
+struct LogSite {
+    LogLevel level;
+    const char* file;
+    uint32_t line;
+};
+
+// How an argument is stored in a record.
+enum class LogArgType : uint8_t {
+    Signed,   // int64_t
+    Unsigned, // uint64_t
+    Double,
+    Char,    // uint32_t code point
+    String,  // uint16_t length, then UTF-8 (wide strings are converted)
+    Pointer, // uint64_t
+};
+
+namespace LogDetail {
+
+constexpr bool CompiledIn(LogLevel level) {
+    return level >= static_cast<LogLevel>(WSL_LOG_COMPILED_LEVEL);
+}
+
+// One conversion in a printf format. Only what a log message needs:
+// flags, width and precision as digits, the h/l/ll/z/j/t length
+// modifiers, and d i u x X o c s p f F e E g G a A.
+struct Conversion {
+    size_t begin = 0; // the '%'
+    size_t end = 0;   // one past the conversion character
+    char length = 0;  // 'h', 'l', or 0 for the others, which do not matter
+    char type = 0;    // 0 at the end of the format
+};
+
+// Finds the next conversion at or after position, skipping "%%". Throws
+// std::invalid_argument on anything it does not understand, which inside
+// a constant expression is a compile error.
+constexpr Conversion NextConversion(std::string_view format, size_t position) {
+    for (;;) {
+        const size_t percent = format.find('%', position);
+        if (percent == std::string_view::npos) {
+            return {format.size(), format.size(), 0, 0};
+        }
+        if (percent + 1 < format.size() && format[percent + 1] == '%') {
+            position = percent + 2;
+            continue;
+        }
+
+        Conversion conversion;
+        conversion.begin = percent;
+        size_t i = percent + 1;
+        while (i < format.size() && std::string_view("-+ #0").find(format[i]) != std::string_view::npos) {
+            ++i;
+        }
+        while (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+            ++i;
+        }
+        if (i < format.size() && format[i] == '.') {
+            ++i;
+            while (i < format.size() && format[i] >= '0' && format[i] <= '9') {
+                ++i;
+            }
+        }
+        while (i < format.size() && std::string_view("hlLzjtq").find(format[i]) != std::string_view::npos) {
+            if (format[i] == 'h' || format[i] == 'l') {
+                conversion.length = format[i];
+            }
+            ++i;
+        }
+        if (i == format.size() || std::string_view("diuxXocspfFeEgGaA").find(format[i]) == std::string_view::npos) {
+            throw std::invalid_argument("Unsupported conversion in log format");
+        }
+        conversion.type = format[i];
+        conversion.end = i + 1;
+        return conversion;
+    }
+}
+
+constexpr bool Accepts(const Conversion& conversion, LogArgType argument) {
+    switch (conversion.type) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        return argument == LogArgType::Signed || argument == LogArgType::Unsigned || argument == LogArgType::Char;
+    case 'c':
+        return argument == LogArgType::Char || argument == LogArgType::Signed || argument == LogArgType::Unsigned;
+    case 's':
+        return argument == LogArgType::String;
+    case 'p':
+        return argument == LogArgType::Pointer;
+    default:
+        return argument == LogArgType::Double;
+    }
+}
+
+template <typename T>
+struct IsWideString
+    : std::bool_constant<std::is_same_v<T, const wchar_t*> || std::is_same_v<T, wchar_t*> ||
+                         std::is_same_v<T, std::wstring> || std::is_same_v<T, std::wstring_view>> {};
+
+template <typename T>
+struct IsNarrowString
+    : std::bool_constant<std::is_same_v<T, const char*> || std::is_same_v<T, char*> || std::is_same_v<T, std::string> ||
+                         std::is_same_v<T, std::string_view>> {};
+
+template <typename Raw>
+constexpr LogArgType ArgTypeOf() {
+    using T = std::decay_t<Raw>;
+    if constexpr (IsWideString<T>::value || IsNarrowString<T>::value) {
+        return LogArgType::String;
+    }
+    else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, wchar_t> || std::is_same_v<T, char16_t> ||
+                       std::is_same_v<T, char32_t>) {
+        return LogArgType::Char;
+    }
+    else if constexpr (std::is_enum_v<T>) {
+        return ArgTypeOf<std::underlying_type_t<T>>();
+    }
+    else if constexpr (std::is_same_v<T, bool> || std::is_unsigned_v<T>) {
+        return LogArgType::Unsigned;
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        return LogArgType::Signed;
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        return LogArgType::Double;
+    }
+    else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+        return LogArgType::Pointer;
+    }
+    else {
+        static_assert(std::is_pointer_v<T>, "Type cannot be logged");
+        return LogArgType::Pointer;
+    }
+}
+
+// %ls and %s are kept apart so a format reads the same as it would with
+// printf.
+template <typename Raw>
+constexpr bool WideMatches(const Conversion& conversion) {
+    using T = std::decay_t<Raw>;
+    if (conversion.type != 's') {
+        return true;
+    }
+    return IsWideString<T>::value == (conversion.length == 'l');
+}
+
+// The width an integer had before it was widened for storage, so that
+// %u, %x and %o print a negative one as printf would, at that width.
+template <typename Raw>
+constexpr uint8_t ArgSizeOf() {
+    using T = std::decay_t<Raw>;
+    if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+        return static_cast<uint8_t>(sizeof(T));
+    }
+    else {
+        return 8;
+    }
+}
+
+template <typename... Args>
+struct ArgTypeList {
+    static constexpr LogArgType Types[sizeof...(Args) == 0 ? 1 : sizeof...(Args)] = {ArgTypeOf<Args>()...};
+    static constexpr uint8_t Sizes[sizeof...(Args) == 0 ? 1 : sizeof...(Args)] = {ArgSizeOf<Args>()...};
+};
+
+template <typename... Args>
+consteval void CheckFormat(std::string_view format) {
+    size_t position = 0;
+    bool matched = true;
+    (
+        [&] {
+            const Conversion conversion = NextConversion(format, position);
+            if (conversion.type == 0) {
+                throw std::invalid_argument("Log format has fewer conversions than arguments");
+            }
+            if (!Accepts(conversion, ArgTypeOf<Args>()) || !WideMatches<Args>(conversion)) {
+                matched = false;
+            }
+            position = conversion.end;
+        }(),
+        ...);
+    if (!matched) {
+        throw std::invalid_argument("Log argument does not match its conversion");
+    }
+    if (NextConversion(format, position).type != 0) {
+        throw std::invalid_argument("Log format has more conversions than arguments");
+    }
+}
+
+} // namespace LogDetail
+
+// A format string checked against Args when it is constructed, which can
+// only happen at compile time.
+template <typename... Args>
+class LogFormat {
+public:
+    template <size_t N>
+    consteval LogFormat(const char (&format)[N]) : format_(format, N - 1) {
+        LogDetail::CheckFormat<Args...>(format_);
+    }
+
+    constexpr const char* Data() const { return format_.data(); }
+
+private:
+    std::string_view format_;
+};
+
+// Fixed part of each record in a thread's buffer; the arguments follow.
+struct LogRecordHeader {
+    const LogSite* site;
+    const char* format;
+    const LogArgType* types;
+    const uint8_t* sizes; // of each argument as passed, in bytes
+    uint64_t timestamp;   // steady clock, nanoseconds
+    uint16_t size;      // header and arguments
+    uint8_t argumentCount;
+};
+
+// Strings are cut short to keep a record within MaxLogRecordSize; the
+// fixed-size arguments may take it MaxLogArguments * 8 bytes further.
+inline constexpr size_t MaxLogRecordSize = 2048;
+inline constexpr size_t MaxLogStringSize = 512;
+inline constexpr size_t MaxLogArguments = 16;
+
+namespace LogDetail {
+
+class ThreadBuffer;
+
+// Which logger the thread last wrote to, and its buffer there. Trivial so
+// the hot path reaches it without a TLS initialisation check.
+struct ThreadState {
+    uint64_t generation = 0;
+    ThreadBuffer* buffer = nullptr;
+};
+
+inline thread_local ThreadState threadState;
+
+// 0 while no logger is installed.
+inline std::atomic<uint64_t> installedGeneration{0};
+inline std::atomic<uint8_t> installedLevel{0};
+
+// Slow path: registers the thread with the installed logger. Null if there
+// is none.
+ThreadBuffer* AttachThread(uint64_t generation);
+
+// Copies the record into the thread's buffer, or counts it as dropped if
+// the buffer is full.
+void Commit(ThreadBuffer* buffer, const char* record, size_t size);
+
+inline uint64_t Now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+size_t EncodeWide(char* out, size_t capacity, const wchar_t* text, size_t length);
+
+inline size_t StringRoom(size_t size) {
+    return size + 2 < MaxLogRecordSize ? std::min(MaxLogStringSize, MaxLogRecordSize - size - 2) : 0;
+}
+
+inline void Encode(char* record, size_t& size, std::string_view text) {
+    const size_t length = std::min(text.size(), StringRoom(size));
+    const uint16_t stored = static_cast<uint16_t>(length);
+    std::memcpy(record + size, &stored, 2);
+    std::memcpy(record + size + 2, text.data(), length);
+    size += 2 + length;
+}
+
+inline void EncodeWideString(char* record, size_t& size, std::wstring_view text) {
+    const uint16_t stored =
+        static_cast<uint16_t>(EncodeWide(record + size + 2, StringRoom(size), text.data(), text.size()));
+    std::memcpy(record + size, &stored, 2);
+    size += 2 + stored;
+}
+
+template <typename Raw>
+inline void Encode(char* record, size_t& size, const Raw& value) {
+    using T = std::decay_t<Raw>;
+    constexpr LogArgType type = ArgTypeOf<T>();
+    if constexpr (IsNarrowString<T>::value) {
+        if constexpr (std::is_pointer_v<Raw>) {
+            Encode(record, size, value ? std::string_view(value) : std::string_view("(null)"));
+        }
+        else {
+            Encode(record, size, std::string_view(value));
+        }
+    }
+    else if constexpr (IsWideString<T>::value) {
+        if constexpr (std::is_pointer_v<Raw>) {
+            EncodeWideString(record, size, value ? std::wstring_view(value) : std::wstring_view(L"(null)"));
+        }
+        else {
+            EncodeWideString(record, size, std::wstring_view(value));
+        }
+    }
+    else if constexpr (type == LogArgType::Char) {
+        const uint32_t stored = static_cast<uint32_t>(static_cast<std::make_unsigned_t<T>>(value));
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+    else if constexpr (type == LogArgType::Signed) {
+        const int64_t stored = static_cast<int64_t>(value);
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+    else if constexpr (type == LogArgType::Unsigned) {
+        const uint64_t stored = static_cast<uint64_t>(value);
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+    else if constexpr (type == LogArgType::Double) {
+        const double stored = static_cast<double>(value);
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+    else if constexpr (std::is_null_pointer_v<T>) {
+        const uint64_t stored = 0;
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+    else {
+        const uint64_t stored = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+        std::memcpy(record + size, &stored, sizeof(stored));
+        size += sizeof(stored);
+    }
+}
+
+} // namespace LogDetail
+
+// What WSL_LOG_* expands to. Nothing is formatted here.
+template <typename... Args>
+inline void WriteLog(const LogSite& site, LogFormat<std::type_identity_t<Args>...> format, const Args&... args) {
+    static_assert(sizeof...(Args) <= MaxLogArguments, "Too many arguments for one log record");
+    const uint64_t generation = LogDetail::installedGeneration.load(std::memory_order_acquire);
+    if (generation == 0 ||
+        static_cast<uint8_t>(site.level) < LogDetail::installedLevel.load(std::memory_order_relaxed)) {
+        return;
+    }
+    LogDetail::ThreadBuffer* buffer = LogDetail::threadState.buffer;
+    if (LogDetail::threadState.generation != generation) {
+        buffer = LogDetail::AttachThread(generation);
+        if (!buffer) {
+            return;
+        }
+    }
+
+    alignas(8) char record[MaxLogRecordSize + MaxLogArguments * 8];
+    size_t size = sizeof(LogRecordHeader);
+    (LogDetail::Encode(record, size, args), ...);
+
+    LogRecordHeader header;
+    header.site = &site;
+    header.format = format.Data();
+    header.types = LogDetail::ArgTypeList<std::decay_t<Args>...>::Types;
+    header.sizes = LogDetail::ArgTypeList<std::decay_t<Args>...>::Sizes;
+    header.timestamp = LogDetail::Now();
+    header.size = static_cast<uint16_t>(size);
+    header.argumentCount = static_cast<uint8_t>(sizeof...(Args));
+    std::memcpy(record, &header, sizeof(header));
+    LogDetail::Commit(buffer, record, size);
+}
+
+enum class LogOutput {
+    Text,  // one formatted line per record
+    Binary // formats and arguments as recorded; see DecodeBinaryLog()
+};
+
+struct AsyncLoggerOptions {
+    // Per thread. A thread that outruns the writer by this much has its
+    // records dropped, and counted, rather than waiting.
+    size_t threadBufferSize = 64 * 1024;
+
+    // How long records may sit in a buffer before being written.
+    std::chrono::milliseconds flushInterval{20};
+
+    LogLevel level = LogLevel::Info;
+};
+
+// Owns the background thread that drains every thread's buffer, orders the
+// records by time and writes them to the output. Install() makes it the
+// process's logger; there is one at a time. Destroy it only once nothing
+// is logging any more, e.g. at the end of main().
+class AsyncLogger {
+public:
+    AsyncLogger(ByteSink& output, LogOutput format, AsyncLoggerOptions options = {});
+
+    // Uninstalls, writes what is left and stops the thread. Does not
+    // Finish() the output.
+    ~AsyncLogger();
+
+    // Non-copyable, non-movable
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+    AsyncLogger(AsyncLogger&&) = delete;
+    AsyncLogger& operator=(AsyncLogger&&) = delete;
+
+    void Install();
+    void Uninstall();
+
+    void SetLevel(LogLevel level);
+
+    // Returns once everything logged before the call has been written.
+    void Flush();
+
+    uint64_t Written() const;
+    uint64_t Dropped() const;
+
+private:
+    friend LogDetail::ThreadBuffer* LogDetail::AttachThread(uint64_t generation);
+
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+// Formats a binary log as AsyncLogger would have in text mode; logs
+// appended one after another are fine. Throws std::runtime_error if the
+// input is not one or is damaged.
+void DecodeBinaryLog(ByteSource& input, ByteSink& output);
+
+} // namespace WSL
@@ -0,0 +1,302 @@
+#include "batchlaunch.h"
+#include "relayengine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+std::wstring_view Trim(std::wstring_view text) {
+    const auto first = text.find_first_not_of(L" \t\r");
+    if (first == std::wstring_view::npos) {
+        return {};
+    }
+    const auto last = text.find_last_not_of(L" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool IsTagCharacter(wchar_t c) {
+    return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'.' ||
+           c == L'_' || c == L'-';
+}
+
+// Tags are restricted to ASCII, so this is exact.
+std::string Narrow(std::wstring_view text) {
+    return std::string(text.begin(), text.end());
+}
+
+[[noreturn]] void ThrowLastError(const std::string& what) {
+#ifdef _WIN32
+    throw std::runtime_error(what + ": " + std::to_string(GetLastError()));
+#else
+    throw std::system_error(errno, std::generic_category(), what);
+#endif
+}
+
+NativeHandle CreateOutputFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    if (file == InvalidNativeHandle) {
+        ThrowLastError("Failed to create " + path.string());
+    }
+    return file;
+}
+
+void CloseNative(NativeHandle& handle) {
+    if (handle == InvalidNativeHandle) {
+        return;
+    }
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+    close(handle);
+#endif
+    handle = InvalidNativeHandle;
+}
+
+void WriteAll(NativeHandle handle, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+#ifdef _WIN32
+        DWORD chunk = 0;
+        const DWORD request = static_cast<DWORD>(std::min<size_t>(data.size() - written, 1u << 30));
+        if (!WriteFile(handle, data.data() + written, request, &chunk, nullptr)) {
+            return;
+        }
+#else
+        const ssize_t chunk = write(handle, data.data() + written, data.size() - written);
+        if (chunk < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunk <= 0) {
+            return;
+        }
+#endif
+        written += static_cast<size_t>(chunk);
+    }
+}
+
+uint64_t ProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+std::filesystem::path SpoolPath(const char* stream) {
+    static std::atomic<uint64_t> next{0};
+    return std::filesystem::temp_directory_path() /
+           ("wsl-batch-" + std::to_string(ProcessId()) + "-" + std::to_string(next++) + "." + stream);
+}
+
+// Copies a spooled stream to the sink with every line prefixed by the tag.
+void WriteTagged(const std::filesystem::path& spool, const std::string& prefix, NativeHandle sink) {
+    constexpr size_t FlushSize = 64 * 1024;
+
+    std::ifstream file(spool, std::ios::binary);
+    std::string buffer;
+    std::string line;
+    while (std::getline(file, line)) {
+        buffer += prefix;
+        buffer += line;
+        buffer += '\n';
+        if (buffer.size() >= FlushSize) {
+            WriteAll(sink, buffer);
+            buffer.clear();
+        }
+    }
+    WriteAll(sink, buffer);
+}
+
+} // namespace
+
+std::vector<BatchJob> ParseBatchJobs(std::wstring_view text) {
+    std::vector<BatchJob> jobs;
+    std::unordered_set<std::wstring> tags;
+
+    size_t lineNumber = 0;
+    while (!text.empty()) {
+        ++lineNumber;
+        const auto end = text.find(L'\n');
+        std::wstring_view line = Trim(text.substr(0, end));
+        text = end == std::wstring_view::npos ? std::wstring_view{} : text.substr(end + 1);
+
+        if (line.empty() || line.front() == L'#') {
+            continue;
+        }
+
+        const std::string where = "Batch line " + std::to_string(lineNumber);
+        BatchJob job;
+        if (line.front() == L'[') {
+            const auto close = line.find(L']');
+            if (close == std::wstring_view::npos) {
+                throw std::invalid_argument(where + ": unterminated tag");
+            }
+            job.tag = line.substr(1, close - 1);
+            if (job.tag.empty() || !std::all_of(job.tag.begin(), job.tag.end(), IsTagCharacter)) {
+                throw std::invalid_argument(where + ": tags may only use letters, digits, '.', '_' and '-'");
+            }
+            line = Trim(line.substr(close + 1));
+        }
+        else {
+            job.tag = std::to_wstring(lineNumber);
+        }
+
+        if (line.empty()) {
+            throw std::invalid_argument(where + ": no command");
+        }
+        if (!tags.insert(job.tag).second) {
+            throw std::invalid_argument(where + ": duplicate tag " + Narrow(job.tag));
+        }
+
+        job.command = line;
+        jobs.push_back(std::move(job));
+    }
+
+    return jobs;
+}
+
+BatchLauncher::BatchLauncher(ServiceSession& session, LaunchRequest shared, BatchOptions options)
+    : session_(session), shared_(std::move(shared)), options_(std::move(options)) {
+    if (options_.parallelism == 0) {
+        options_.parallelism = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (options_.output == BatchOutputMode::Files && options_.outputDirectory.empty()) {
+        throw std::invalid_argument("Batch file output needs an output directory");
+    }
+}
+
+std::vector<BatchJobResult> BatchLauncher::Run(const std::vector<BatchJob>& jobs, NativeHandle output,
+                                               NativeHandle error) {
+    if (options_.output == BatchOutputMode::Files) {
+        std::filesystem::create_directories(options_.outputDirectory);
+    }
+
+    std::vector<BatchJobResult> results(jobs.size());
+    std::atomic<size_t> next{0};
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    // Each worker keeps one launch in flight; the session multiplexes them
+    // over its one connection.
+    auto work = [&] {
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            try {
+                results[i] = RunJob(jobs[i], output, error);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(failureLock);
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+                next = jobs.size();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    const size_t count = std::min(options_.parallelism, jobs.size());
+    for (size_t i = 0; i < count; ++i) {
+        workers.emplace_back(work);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+    return results;
+}
+
+BatchJobResult BatchLauncher::RunJob(const BatchJob& job, NativeHandle output, NativeHandle error) {
+    BatchJobResult result;
+    result.tag = job.tag;
+    const auto start = std::chrono::steady_clock::now();
+
+    const bool tagged = options_.output == BatchOutputMode::Tagged;
+    const std::filesystem::path outputPath =
+        tagged ? SpoolPath("out") : std::filesystem::path(options_.outputDirectory) / (Narrow(job.tag) + ".out");
+    const std::filesystem::path errorPath =
+        tagged ? SpoolPath("err") : std::filesystem::path(options_.outputDirectory) / (Narrow(job.tag) + ".err");
+
+    NativeHandle outputSink = CreateOutputFile(outputPath);
+    NativeHandle errorSink = InvalidNativeHandle;
+    try {
+        errorSink = CreateOutputFile(errorPath);
+    }
+    catch (...) {
+        CloseNative(outputSink);
+        throw;
+    }
+
+    LaunchRequest request = shared_;
+    request.command = options_.shell;
+    request.arguments = {options_.shell, L"-c", job.command};
+
+    LaunchResult launch = session_.Launch(std::move(request)).get();
+    result.status = launch.status;
+    if (launch.Succeeded()) {
+        // Nothing is fed to batch jobs; they see EOF on stdin straight away.
+        CloseNative(launch.input);
+
+        RelayEngine engine;
+        engine.AddStream(launch.output, outputSink);
+        engine.AddStream(launch.error, errorSink);
+        if (launch.process != InvalidNativeHandle) {
+            engine.WatchProcess(launch.process);
+        }
+        engine.Run();
+        result.exitCode = engine.GetExitCode();
+    }
+
+    CloseNative(outputSink);
+    CloseNative(errorSink);
+
+    if (tagged) {
+        const std::string prefix = "[" + Narrow(job.tag) + "] ";
+        {
+            std::lock_guard<std::mutex> guard(outputLock_);
+            WriteTagged(outputPath, prefix, output);
+            WriteTagged(errorPath, prefix, error);
+        }
+        std::error_code ignored;
+        std::filesystem::remove(outputPath, ignored);
+        std::filesystem::remove(errorPath, ignored);
+    }
+
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+int BatchExitCode(const std::vector<BatchJobResult>& results) {
+    for (const auto& result : results) {
+        if (!result.Succeeded()) {
+            return result.exitCode.value_or(0) != 0 ? *result.exitCode : 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace WSL
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "servicesession.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+struct BatchJob {
+    std::wstring tag; // [A-Za-z0-9._-]; doubles as the output file name
+    std::wstring command;
+};
+
+// One command per line. Blank lines and lines starting with '#' are skipped.
+// "[tag] command" names a job; otherwise it is tagged with its line number.
+// Throws std::invalid_argument for a malformed or duplicate tag.
+std::vector<BatchJob> ParseBatchJobs(std::wstring_view text);
+
+enum class BatchOutputMode {
+    // Each job's output is spooled and written when it exits, one
+    // "[tag] " prefixed line at a time, so jobs never interleave mid-line.
+    Tagged,
+
+    // <outputDirectory>/<tag>.out and <tag>.err, relayed as it arrives.
+    Files
+};
+
+struct BatchOptions {
+    // Jobs in flight at once; 0 means one per hardware thread.
+    size_t parallelism = 0;
+
+    BatchOutputMode output = BatchOutputMode::Tagged;
+    std::string outputDirectory;
+
+    // Each line runs as <shell> -c <command>.
+    std::wstring shell = L"/bin/sh";
+};
+
+struct BatchJobResult {
+    std::wstring tag;
+    int32_t status = 0;           // launch HRESULT
+    std::optional<int> exitCode;  // empty if it never ran or its instance went away
+    std::chrono::nanoseconds elapsed{0};
+
+    bool Succeeded() const { return status >= 0 && exitCode == 0; }
+};
+
+// Runs many commands over one ServiceSession. Everything the jobs share
+// (distribution id, environment, working directory) is taken from the
+// template request, resolved once by the caller, instead of per launch.
+class BatchLauncher {
+public:
+    BatchLauncher(ServiceSession& session, LaunchRequest shared, BatchOptions options = {});
+
+    // Runs every job and returns their results in input order. Tagged output
+    // goes to the output and error handles, which stay owned by the caller.
+    std::vector<BatchJobResult> Run(const std::vector<BatchJob>& jobs, NativeHandle output, NativeHandle error);
+
+private:
+    BatchJobResult RunJob(const BatchJob& job, NativeHandle output, NativeHandle error);
+
+    ServiceSession& session_;
+    LaunchRequest shared_;
+    BatchOptions options_;
+    std::mutex outputLock_;
+};
+
+// 0 if every job succeeded; otherwise the exit code of the first job, in
+// input order, that did not, or 1 if it never ran.
+int BatchExitCode(const std::vector<BatchJobResult>& results);
+
+} // namespace WSL
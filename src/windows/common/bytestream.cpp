@@ -0,0 +1,82 @@
+#include "bytestream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+size_t ByteSource::ReadFully(char* buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        const size_t chunk = Read(buffer + total, size - total);
+        if (chunk == 0) {
+            break;
+        }
+        total += chunk;
+    }
+    return total;
+}
+
+void HandleSink::Write(const char* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+#ifdef _WIN32
+        DWORD chunk = 0;
+        const DWORD request = static_cast<DWORD>(std::min<size_t>(size - written, 1u << 30));
+        if (!WriteFile(handle_, data + written, request, &chunk, nullptr)) {
+            throw std::runtime_error("Failed to write stream: " + std::to_string(GetLastError()));
+        }
+#else
+        const ssize_t chunk = write(handle_, data + written, size - written);
+        if (chunk < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunk < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to write stream");
+        }
+#endif
+        written += static_cast<size_t>(chunk);
+    }
+}
+
+size_t HandleSource::Read(char* buffer, size_t size) {
+#ifdef _WIN32
+    DWORD chunk = 0;
+    const DWORD request = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+    if (!ReadFile(handle_, buffer, request, &chunk, nullptr)) {
+        // The writer closing its end of a pipe is how the stream ends.
+        const DWORD error = GetLastError();
+        if (error == ERROR_BROKEN_PIPE) {
+            return 0;
+        }
+        throw std::runtime_error("Failed to read stream: " + std::to_string(error));
+    }
+    return chunk;
+#else
+    for (;;) {
+        const ssize_t chunk = read(handle_, buffer, size);
+        if (chunk >= 0) {
+            return static_cast<size_t>(chunk);
+        }
+        if (errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "Failed to read stream");
+        }
+    }
+#endif
+}
+
+size_t StringSource::Read(char* buffer, size_t size) {
+    const size_t chunk = std::min(size, data_.size());
+    std::memcpy(buffer, data_.data(), chunk);
+    data_.remove_prefix(chunk);
+    return chunk;
+}
+
+} // namespace WSL
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "relayengine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace WSL {
+
+// How far a chunked stage has got.
+struct StreamProgress {
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    uint64_t chunks = 0;
+};
+
+// Called on the thread driving the stream, after each chunk is written.
+using ProgressCallback = std::function<void(const StreamProgress& progress)>;
+
+// A pipeline stage that takes bytes pushed into it.
+class ByteSink {
+public:
+    virtual ~ByteSink() = default;
+
+    virtual void Write(const char* data, size_t size) = 0;
+
+    // No more data follows; flushes whatever the stage still holds.
+    virtual void Finish() {}
+};
+
+// A pipeline stage that bytes are pulled from.
+class ByteSource {
+public:
+    virtual ~ByteSource() = default;
+
+    // Fills up to size bytes; 0 only at the end of the stream.
+    virtual size_t Read(char* buffer, size_t size) = 0;
+
+    // Reads until size bytes or the end; returns how many were read.
+    size_t ReadFully(char* buffer, size_t size);
+};
+
+// Writes everything to a handle it does not own. Throws std::system_error
+// (std::runtime_error on Windows) if a write fails.
+class HandleSink : public ByteSink {
+public:
+    explicit HandleSink(NativeHandle handle) : handle_(handle) {}
+    void Write(const char* data, size_t size) override;
+
+private:
+    NativeHandle handle_;
+};
+
+class HandleSource : public ByteSource {
+public:
+    explicit HandleSource(NativeHandle handle) : handle_(handle) {}
+    size_t Read(char* buffer, size_t size) override;
+
+private:
+    NativeHandle handle_;
+};
+
+class StringSink : public ByteSink {
+public:
+    void Write(const char* data, size_t size) override { data_.append(data, size); }
+    const std::string& Data() const { return data_; }
+
+private:
+    std::string data_;
+};
+
+class StringSource : public ByteSource {
+public:
+    explicit StringSource(std::string_view data) : data_(data) {}
+    size_t Read(char* buffer, size_t size) override;
+
+private:
+    std::string_view data_;
+};
+
+} // namespace WSL
@@ -0,0 +1,348 @@
+#include "chunkstore.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <bcrypt.h>
+#else
+#include <openssl/evp.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+constexpr std::string_view ManifestHeader = "wsl-snapshot 1";
+
+// Chunk files start with a format byte and the uncompressed size.
+constexpr size_t ChunkHeaderSize = 5;
+constexpr char StoredRaw = 'R';
+constexpr char StoredZlib = 'Z';
+
+constexpr int CompressionLevel = 1;
+
+// Far above any chunker setting; a bigger size in a header is corruption.
+constexpr size_t MaxChunkSize = 64 * 1024 * 1024;
+
+void StoreLittleEndian32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint32_t LoadLittleEndian32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+// Written beside the target, then renamed over it, so readers never see a
+// partial file.
+void WriteFileAtomically(const std::filesystem::path& path, std::string_view header, std::string_view body) {
+    auto temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(header.data(), static_cast<std::streamsize>(header.size()));
+        file.write(body.data(), static_cast<std::streamsize>(body.size()));
+        file.close();
+        if (file.fail()) {
+            std::filesystem::remove(temporary);
+            throw std::runtime_error("Failed to write " + temporary.string());
+        }
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+std::string ReadWholeFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path.string());
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Deflating data that will not shrink (packed binaries, compressed files)
+// is the slowest thing a backup does, so a sample from the front of the
+// chunk decides whether to try.
+bool LooksCompressible(const char* data, size_t size) {
+    constexpr size_t SampleSize = 4096;
+    const size_t sample = std::min(size, SampleSize);
+    char compressed[SampleSize + SampleSize / 8 + 64];
+    uLongf compressedSize = sizeof(compressed);
+    return compress2(reinterpret_cast<Bytef*>(compressed), &compressedSize, reinterpret_cast<const Bytef*>(data),
+                     static_cast<uLong>(sample), 1) == Z_OK &&
+           compressedSize < sample - sample / 16;
+}
+
+bool IsTemporary(const std::filesystem::path& path) {
+    return path.extension() == ".tmp";
+}
+
+} // namespace
+
+ChunkId ChunkId::Of(const char* data, size_t size) {
+    ChunkId id;
+#ifdef _WIN32
+    const NTSTATUS status = BCryptHash(BCRYPT_SHA256_ALG_HANDLE, nullptr, 0,
+                                       reinterpret_cast<PUCHAR>(const_cast<char*>(data)), static_cast<ULONG>(size),
+                                       id.bytes.data(), static_cast<ULONG>(id.bytes.size()));
+    if (!BCRYPT_SUCCESS(status)) {
+        throw std::runtime_error("Failed to hash chunk: " + std::to_string(status));
+    }
+#else
+    unsigned int length = 0;
+    if (!EVP_Digest(data, size, id.bytes.data(), &length, EVP_sha256(), nullptr) || length != id.bytes.size()) {
+        throw std::runtime_error("Failed to hash chunk");
+    }
+#endif
+    return id;
+}
+
+std::optional<ChunkId> ChunkId::FromHex(std::string_view hex) {
+    ChunkId id;
+    if (hex.size() != 2 * id.bytes.size()) {
+        return std::nullopt;
+    }
+    const auto digit = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < id.bytes.size(); ++i) {
+        const int high = digit(hex[2 * i]);
+        const int low = digit(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return std::nullopt;
+        }
+        id.bytes[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return id;
+}
+
+std::string ChunkId::Hex() const {
+    static constexpr char Digits[] = "0123456789abcdef";
+    std::string hex(2 * bytes.size(), '\0');
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        hex[2 * i] = Digits[bytes[i] >> 4];
+        hex[2 * i + 1] = Digits[bytes[i] & 0xF];
+    }
+    return hex;
+}
+
+ChunkStore::ChunkStore(std::filesystem::path root) : root_(std::move(root)) {
+    std::filesystem::create_directories(root_ / "chunks");
+    std::filesystem::create_directories(root_ / "snapshots");
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root_ / "chunks")) {
+        if (!entry.is_regular_file() || IsTemporary(entry.path())) {
+            continue;
+        }
+        if (auto id = ChunkId::FromHex(entry.path().filename().string())) {
+            index_.insert(*id);
+        }
+    }
+}
+
+std::filesystem::path ChunkStore::ChunkPath(const ChunkId& id) const {
+    const std::string hex = id.Hex();
+    return root_ / "chunks" / hex.substr(0, 2) / hex;
+}
+
+std::filesystem::path ChunkStore::ManifestPath(std::string_view name) const {
+    // A plain file name that cannot be mistaken for a temporary file.
+    if (name.empty() || name.front() == '.' || name.find_first_of("/\\:") != std::string_view::npos ||
+        std::filesystem::path(name).extension() == ".tmp") {
+        throw std::invalid_argument("Invalid snapshot name: " + std::string(name));
+    }
+    return root_ / "snapshots" / std::string(name);
+}
+
+size_t ChunkStore::Put(const ChunkId& id, const char* data, size_t size) {
+    if (Contains(id)) {
+        return 0;
+    }
+    if (size > MaxChunkSize) {
+        throw std::invalid_argument("Chunk is too large to store");
+    }
+
+    char header[ChunkHeaderSize];
+    StoreLittleEndian32(header + 1, static_cast<uint32_t>(size));
+
+    std::string compressed(compressBound(static_cast<uLong>(size)), '\0');
+    uLongf compressedSize = static_cast<uLongf>(compressed.size());
+    const bool shrank = LooksCompressible(data, size) &&
+                        compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressedSize,
+                                  reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size),
+                                  CompressionLevel) == Z_OK &&
+                        compressedSize < size;
+
+    const auto path = ChunkPath(id);
+    std::filesystem::create_directories(path.parent_path());
+    std::string_view body;
+    if (shrank) {
+        header[0] = StoredZlib;
+        body = std::string_view(compressed.data(), compressedSize);
+    }
+    else {
+        header[0] = StoredRaw;
+        body = std::string_view(data, size);
+    }
+    WriteFileAtomically(path, std::string_view(header, sizeof(header)), body);
+    index_.insert(id);
+    return sizeof(header) + body.size();
+}
+
+std::string ChunkStore::Get(const ChunkId& id) const {
+    const auto path = ChunkPath(id);
+    if (!Contains(id) && !std::filesystem::exists(path)) {
+        throw std::runtime_error("Chunk " + id.Hex() + " is missing from the store");
+    }
+
+    const std::string stored = ReadWholeFile(path);
+    const uint32_t size = stored.size() >= ChunkHeaderSize ? LoadLittleEndian32(stored.data() + 1) : 0;
+    if (stored.size() < ChunkHeaderSize || size > MaxChunkSize) {
+        throw std::runtime_error("Chunk " + id.Hex() + " is corrupt");
+    }
+    const std::string_view body = std::string_view(stored).substr(ChunkHeaderSize);
+
+    std::string data;
+    if (stored[0] == StoredRaw && body.size() == size) {
+        data.assign(body);
+    }
+    else if (stored[0] == StoredZlib) {
+        data.resize(size);
+        uLongf inflated = size;
+        if (uncompress(reinterpret_cast<Bytef*>(data.data()), &inflated, reinterpret_cast<const Bytef*>(body.data()),
+                       static_cast<uLong>(body.size())) != Z_OK ||
+            inflated != size) {
+            throw std::runtime_error("Chunk " + id.Hex() + " is corrupt");
+        }
+    }
+    else {
+        throw std::runtime_error("Chunk " + id.Hex() + " is corrupt");
+    }
+
+    if (!(ChunkId::Of(data.data(), data.size()) == id)) {
+        throw std::runtime_error("Chunk " + id.Hex() + " does not match its hash");
+    }
+    return data;
+}
+
+void ChunkStore::SaveManifest(const SnapshotManifest& manifest) {
+    std::string text;
+    text.reserve(64 + manifest.chunks.size() * 76);
+    text += ManifestHeader;
+    text += "\ncreated " + std::to_string(manifest.created);
+    text += "\nsize " + std::to_string(manifest.size);
+    text += '\n';
+    for (const auto& chunk : manifest.chunks) {
+        text += chunk.id.Hex();
+        text += ' ';
+        text += std::to_string(chunk.size);
+        text += '\n';
+    }
+    WriteFileAtomically(ManifestPath(manifest.name), {}, text);
+}
+
+SnapshotManifest ChunkStore::LoadManifest(std::string_view name) const {
+    std::istringstream text(ReadWholeFile(ManifestPath(name)));
+    const auto corrupt = [&] {
+        return std::runtime_error("Snapshot manifest " + std::string(name) + " is corrupt");
+    };
+
+    SnapshotManifest manifest;
+    manifest.name = name;
+    std::string line;
+    std::string key;
+    if (!std::getline(text, line) || line != ManifestHeader) {
+        throw corrupt();
+    }
+    if (!(text >> key >> manifest.created) || key != "created" || !(text >> key >> manifest.size) || key != "size") {
+        throw corrupt();
+    }
+
+    uint64_t total = 0;
+    std::string hex;
+    uint32_t size = 0;
+    while (text >> hex >> size) {
+        auto id = ChunkId::FromHex(hex);
+        if (!id) {
+            throw corrupt();
+        }
+        manifest.chunks.push_back({*id, size});
+        total += size;
+    }
+    if (!text.eof() || total != manifest.size) {
+        throw corrupt();
+    }
+    return manifest;
+}
+
+std::vector<std::string> ChunkStore::Snapshots() const {
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(root_ / "snapshots")) {
+        if (entry.is_regular_file() && !IsTemporary(entry.path())) {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+void ChunkStore::Restore(const SnapshotManifest& manifest, ByteSink& output) const {
+    for (const auto& chunk : manifest.chunks) {
+        const std::string data = Get(chunk.id);
+        if (data.size() != chunk.size) {
+            throw std::runtime_error("Chunk " + chunk.id.Hex() + " has the wrong size");
+        }
+        output.Write(data.data(), data.size());
+    }
+    output.Finish();
+}
+
+SnapshotWriter::SnapshotWriter(ChunkStore& store, std::string name, ChunkerOptions options, ProgressCallback progress)
+    : store_(store),
+      progress_(std::move(progress)),
+      chunker_([this](const char* data, size_t size) { AddChunk(data, size); }, options) {
+    manifest_.name = std::move(name);
+    manifest_.created =
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void SnapshotWriter::AddChunk(const char* data, size_t size) {
+    const ChunkId id = ChunkId::Of(data, size);
+    const size_t stored = store_.Put(id, data, size);
+    manifest_.chunks.push_back({id, static_cast<uint32_t>(size)});
+    manifest_.size += size;
+
+    stats_.bytes += size;
+    ++stats_.chunks;
+    if (stored != 0) {
+        ++stats_.newChunks;
+        stats_.newBytes += size;
+        stats_.storedBytes += stored;
+    }
+
+    if (progress_) {
+        progress_({stats_.bytes, stats_.storedBytes, stats_.chunks});
+    }
+}
+
+void SnapshotWriter::Finish() {
+    chunker_.Finish();
+    store_.SaveManifest(manifest_);
+}
+
+} // namespace WSL
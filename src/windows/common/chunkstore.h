@@ -0,0 +1,128 @@
+#pragma once
+
+#include "bytestream.h"
+#include "contentchunker.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace WSL {
+
+// A chunk's SHA-256, which is also its name in the store.
+struct ChunkId {
+    std::array<uint8_t, 32> bytes{};
+
+    static ChunkId Of(const char* data, size_t size);
+    static std::optional<ChunkId> FromHex(std::string_view hex);
+    std::string Hex() const;
+
+    bool operator==(const ChunkId&) const = default;
+};
+
+struct ChunkIdHash {
+    size_t operator()(const ChunkId& id) const noexcept {
+        // Already uniformly distributed.
+        size_t value = 0;
+        for (size_t i = 0; i < sizeof(value); ++i) {
+            value = (value << 8) | id.bytes[i];
+        }
+        return value;
+    }
+};
+
+// One snapshot: the stream it was taken from, as a list of chunks.
+struct SnapshotManifest {
+    struct Chunk {
+        ChunkId id;
+        uint32_t size = 0;
+    };
+
+    std::string name;
+    int64_t created = 0; // seconds since the epoch
+    uint64_t size = 0;
+    std::vector<Chunk> chunks;
+};
+
+// A directory of chunks named by their hash, each stored once however many
+// snapshots use it, plus the snapshot manifests that list them:
+//
+//     <root>/chunks/<first two hex digits>/<hex>
+//     <root>/snapshots/<name>
+//
+// Chunks are zlib-compressed unless that does not make them smaller. Every
+// file is written under a temporary name and renamed into place, and a
+// manifest only after all its chunks, so an interrupted backup leaves at
+// worst unreferenced chunks. Not safe for concurrent writers.
+class ChunkStore {
+public:
+    // Creates the directories if needed, then indexes the chunks present.
+    explicit ChunkStore(std::filesystem::path root);
+
+    bool Contains(const ChunkId& id) const { return index_.count(id) != 0; }
+    size_t ChunkCount() const { return index_.size(); }
+
+    // Stores the chunk unless it is already present. Returns the bytes
+    // written to disk, 0 for a chunk the store already had.
+    size_t Put(const ChunkId& id, const char* data, size_t size);
+
+    // Throws std::runtime_error if the chunk is missing or its content no
+    // longer matches its id.
+    std::string Get(const ChunkId& id) const;
+
+    void SaveManifest(const SnapshotManifest& manifest);
+    SnapshotManifest LoadManifest(std::string_view name) const;
+
+    // Snapshot names, in name order.
+    std::vector<std::string> Snapshots() const;
+
+    // Writes the snapshot's stream to output, then output.Finish().
+    void Restore(const SnapshotManifest& manifest, ByteSink& output) const;
+
+private:
+    std::filesystem::path ChunkPath(const ChunkId& id) const;
+    std::filesystem::path ManifestPath(std::string_view name) const;
+
+    std::filesystem::path root_;
+    std::unordered_set<ChunkId, ChunkIdHash> index_;
+};
+
+struct SnapshotStats {
+    uint64_t bytes = 0;       // stream size
+    uint64_t chunks = 0;
+    uint64_t newChunks = 0;   // not already in the store
+    uint64_t newBytes = 0;    // their uncompressed size
+    uint64_t storedBytes = 0; // what they took on disk
+};
+
+// Takes a snapshot of everything written to it: the stream is chunked by
+// content, new chunks are stored, and Finish() saves the manifest. A
+// stream that mostly matches an earlier snapshot costs only the chunks
+// that differ.
+class SnapshotWriter : public ByteSink {
+public:
+    SnapshotWriter(ChunkStore& store, std::string name, ChunkerOptions options = {}, ProgressCallback progress = {});
+
+    void Write(const char* data, size_t size) override { chunker_.Write(data, size); }
+    void Finish() override;
+
+    const SnapshotStats& Stats() const { return stats_; }
+    const SnapshotManifest& Manifest() const { return manifest_; }
+
+private:
+    void AddChunk(const char* data, size_t size);
+
+    ChunkStore& store_;
+    SnapshotManifest manifest_;
+    SnapshotStats stats_;
+    ProgressCallback progress_;
+    ContentChunker chunker_;
+};
+
+} // namespace WSL
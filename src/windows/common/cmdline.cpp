@@ -0,0 +1,304 @@
+#include "cmdline.h"
+
+#include <stdexcept>
+
+namespace WSL {
+
+namespace {
+
+bool IsPosixBlank(wchar_t c) {
+    return c == L' ' || c == L'\t' || c == L'\n';
+}
+
+bool IsWindowsBlank(wchar_t c) {
+    return c == L' ' || c == L'\t';
+}
+
+// What a backslash inside double quotes escapes; before anything else it
+// stays a backslash.
+bool IsPosixQuotedEscape(wchar_t c) {
+    return c == L'$' || c == L'`' || c == L'"' || c == L'\\' || c == L'\n';
+}
+
+bool IsPosixSafe(wchar_t c) {
+    return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'_' ||
+           c == L'-' || c == L'.' || c == L'/' || c == L',' || c == L':' || c == L'=' || c == L'+' || c == L'@' ||
+           c == L'%';
+}
+
+// Appends one word starting at commandLine[i] to out and returns the index
+// just past it.
+size_t ReadPosixWord(std::wstring_view commandLine, size_t i, std::wstring& out) {
+    const size_t size = commandLine.size();
+    while (i < size && !IsPosixBlank(commandLine[i])) {
+        const wchar_t c = commandLine[i];
+        if (c == L'\'') {
+            const size_t close = commandLine.find(L'\'', i + 1);
+            if (close == std::wstring_view::npos) {
+                throw std::invalid_argument("Unterminated single quote");
+            }
+            out.append(commandLine.substr(i + 1, close - i - 1));
+            i = close + 1;
+        }
+        else if (c == L'"') {
+            for (++i;; ++i) {
+                if (i == size) {
+                    throw std::invalid_argument("Unterminated double quote");
+                }
+                const wchar_t quoted = commandLine[i];
+                if (quoted == L'"') {
+                    ++i;
+                    break;
+                }
+                if (quoted == L'\\' && i + 1 < size && IsPosixQuotedEscape(commandLine[i + 1])) {
+                    if (commandLine[++i] != L'\n') {
+                        out += commandLine[i];
+                    }
+                    continue;
+                }
+                out += quoted;
+            }
+        }
+        else if (c == L'\\') {
+            if (i + 1 == size) {
+                out += c;
+                ++i;
+            }
+            else {
+                // Backslash-newline is a line continuation and vanishes.
+                if (commandLine[i + 1] != L'\n') {
+                    out += commandLine[i + 1];
+                }
+                i += 2;
+            }
+        }
+        else {
+            out += c;
+            ++i;
+        }
+    }
+    return i;
+}
+
+void TokenizePosix(std::wstring_view commandLine, std::wstring& buffer, std::vector<uint32_t>& offsets) {
+    const size_t size = commandLine.size();
+    size_t i = 0;
+    for (;;) {
+        while (i < size && (IsPosixBlank(commandLine[i]) ||
+                            (commandLine[i] == L'\\' && i + 1 < size && commandLine[i + 1] == L'\n'))) {
+            i += commandLine[i] == L'\\' ? 2 : 1;
+        }
+        if (i == size) {
+            return;
+        }
+        offsets.push_back(static_cast<uint32_t>(buffer.size()));
+        i = ReadPosixWord(commandLine, i, buffer);
+        buffer += L'\0';
+    }
+}
+
+void TokenizeWindows(std::wstring_view commandLine, std::wstring& buffer, std::vector<uint32_t>& offsets) {
+    const size_t size = commandLine.size();
+    size_t i = 0;
+    bool program = true;
+    for (;;) {
+        while (i < size && IsWindowsBlank(commandLine[i])) {
+            ++i;
+        }
+        if (i == size) {
+            return;
+        }
+        offsets.push_back(static_cast<uint32_t>(buffer.size()));
+
+        if (program) {
+            bool quoted = false;
+            for (; i < size && (quoted || !IsWindowsBlank(commandLine[i])); ++i) {
+                if (commandLine[i] == L'"') {
+                    quoted = !quoted;
+                }
+                else {
+                    buffer += commandLine[i];
+                }
+            }
+            buffer += L'\0';
+            program = false;
+            continue;
+        }
+
+        // quotes counts like Wine's CommandLineToArgvW: 1 while inside a
+        // quoted run; a third consecutive quote emits a literal one.
+        int quotes = 0;
+        while (i < size && (quotes == 1 || !IsWindowsBlank(commandLine[i]))) {
+            const wchar_t c = commandLine[i];
+            if (c == L'\\') {
+                size_t run = 0;
+                while (i + run < size && commandLine[i + run] == L'\\') {
+                    ++run;
+                }
+                if (i + run < size && commandLine[i + run] == L'"') {
+                    buffer.append(run / 2, L'\\');
+                    if (run % 2 == 1) {
+                        buffer += L'"';
+                        ++run;
+                    }
+                }
+                else {
+                    buffer.append(run, L'\\');
+                }
+                i += run;
+            }
+            else if (c == L'"') {
+                for (; i < size && commandLine[i] == L'"'; ++i) {
+                    if (++quotes == 3) {
+                        buffer += L'"';
+                        quotes = 0;
+                    }
+                }
+                if (quotes == 2) {
+                    quotes = 0;
+                }
+            }
+            else {
+                buffer += c;
+                ++i;
+            }
+        }
+        buffer += L'\0';
+    }
+}
+
+} // namespace
+
+ArgumentVector::ArgumentVector(std::initializer_list<std::wstring_view> arguments) {
+    size_t characters = 0;
+    for (std::wstring_view argument : arguments) {
+        characters += argument.size() + 1;
+    }
+    Reserve(characters, arguments.size());
+    for (std::wstring_view argument : arguments) {
+        Append(argument);
+    }
+}
+
+void ArgumentVector::Append(std::wstring_view argument) {
+    if (buffer_.size() + argument.size() + 1 > UINT32_MAX) {
+        throw std::length_error("Argument vector is too large");
+    }
+    offsets_.push_back(static_cast<uint32_t>(buffer_.size()));
+    buffer_.append(argument);
+    buffer_ += L'\0';
+}
+
+void ArgumentVector::Clear() {
+    buffer_.clear();
+    offsets_.clear();
+}
+
+void ArgumentVector::Reserve(size_t characters, size_t arguments) {
+    buffer_.reserve(characters);
+    offsets_.reserve(arguments);
+}
+
+std::wstring ArgumentVector::Join(QuotingRules rules) const {
+    std::wstring commandLine;
+    commandLine.reserve(buffer_.size() + 2 * Size());
+    for (size_t i = 0; i < Size(); ++i) {
+        if (i > 0) {
+            commandLine += L' ';
+        }
+        const std::wstring_view argument = (*this)[i];
+        if (rules == QuotingRules::Windows && i == 0) {
+            if (argument.find(L'"') != std::wstring_view::npos) {
+                throw std::invalid_argument("A Windows program name cannot contain a quote");
+            }
+            if (argument.empty() || argument.find_first_of(L" \t") != std::wstring_view::npos) {
+                commandLine += L'"';
+                commandLine.append(argument);
+                commandLine += L'"';
+            }
+            else {
+                commandLine.append(argument);
+            }
+            continue;
+        }
+        commandLine += QuoteArgument(argument, rules);
+    }
+    return commandLine;
+}
+
+void TokenizeCommandLine(std::wstring_view commandLine, QuotingRules rules, ArgumentVector& arguments) {
+    if (commandLine.size() >= UINT32_MAX) {
+        throw std::length_error("Command line is too large");
+    }
+
+    // No argument is longer than its source and each adds one terminator,
+    // so this is the most either buffer can need.
+    arguments.Clear();
+    arguments.Reserve(commandLine.size() + 1, commandLine.size() / 2 + 1);
+    if (rules == QuotingRules::Posix) {
+        TokenizePosix(commandLine, arguments.buffer_, arguments.offsets_);
+    }
+    else {
+        TokenizeWindows(commandLine, arguments.buffer_, arguments.offsets_);
+    }
+}
+
+ArgumentVector TokenizeCommandLine(std::wstring_view commandLine, QuotingRules rules) {
+    ArgumentVector arguments;
+    TokenizeCommandLine(commandLine, rules, arguments);
+    return arguments;
+}
+
+std::wstring QuoteArgument(std::wstring_view argument, QuotingRules rules) {
+    std::wstring quoted;
+    if (rules == QuotingRules::Posix) {
+        bool safe = !argument.empty();
+        for (wchar_t c : argument) {
+            safe = safe && IsPosixSafe(c);
+        }
+        if (safe) {
+            return std::wstring(argument);
+        }
+
+        quoted.reserve(argument.size() + 2);
+        quoted += L'\'';
+        for (wchar_t c : argument) {
+            if (c == L'\'') {
+                quoted += L"'\\''";
+            }
+            else {
+                quoted += c;
+            }
+        }
+        quoted += L'\'';
+        return quoted;
+    }
+
+    if (!argument.empty() && argument.find_first_of(L" \t\"") == std::wstring_view::npos) {
+        return std::wstring(argument);
+    }
+
+    // Backslashes only need doubling where a quote follows them, including
+    // the closing one.
+    quoted.reserve(argument.size() + 2);
+    quoted += L'"';
+    size_t backslashes = 0;
+    for (wchar_t c : argument) {
+        if (c == L'\\') {
+            ++backslashes;
+        }
+        else if (c == L'"') {
+            quoted.append(backslashes + 1, L'\\');
+            backslashes = 0;
+        }
+        else {
+            backslashes = 0;
+        }
+        quoted += c;
+    }
+    quoted.append(backslashes, L'\\');
+    quoted += L'"';
+    return quoted;
+}
+
+} // namespace WSL
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+enum class QuotingRules {
+    // sh word splitting: blanks and newlines separate; '...' is literal;
+    // "..." honours \$ \` \" \\ and line continuations; a bare backslash
+    // escapes the next character. No expansion of any kind is done.
+    Posix,
+
+    // CommandLineToArgvW(): blanks separate; 2n backslashes before a quote
+    // give n and toggle quoting, 2n+1 give n and a literal quote; inside
+    // quotes "" is a literal quote and ends the quoted run. The program
+    // name is special: quotes only toggle, backslashes are literal.
+    Windows
+};
+
+// An argv held as one buffer of NUL-terminated arguments plus their offsets,
+// so it can be handed to CreateLxProcess as-is and reused without
+// reallocating once it has grown to fit.
+class ArgumentVector {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::wstring_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::wstring_view;
+
+        Iterator() = default;
+        std::wstring_view operator*() const { return (*arguments_)[index_]; }
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator previous = *this;
+            ++index_;
+            return previous;
+        }
+        bool operator==(const Iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const Iterator& other) const { return index_ != other.index_; }
+
+    private:
+        friend class ArgumentVector;
+        Iterator(const ArgumentVector* arguments, size_t index) : arguments_(arguments), index_(index) {}
+
+        const ArgumentVector* arguments_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    ArgumentVector() = default;
+    ArgumentVector(std::initializer_list<std::wstring_view> arguments);
+
+    size_t Size() const { return offsets_.size(); }
+    bool Empty() const { return offsets_.empty(); }
+
+    std::wstring_view operator[](size_t i) const { return {CStr(i), Length(i)}; }
+    std::wstring_view Back() const { return (*this)[Size() - 1]; }
+
+    // NUL-terminated, valid until the vector is next modified.
+    const wchar_t* CStr(size_t i) const { return buffer_.data() + offsets_[i]; }
+
+    Iterator begin() const { return {this, 0}; }
+    Iterator end() const { return {this, Size()}; }
+
+    void Append(std::wstring_view argument);
+    void Clear();
+
+    // Keeps the storage.
+    void Reserve(size_t characters, size_t arguments);
+
+    // Characters in the buffer, terminators included.
+    size_t Characters() const { return buffer_.size(); }
+
+    // A command line that tokenizes back to exactly these arguments. Throws
+    // std::invalid_argument for a Windows program name containing a quote,
+    // which those rules cannot express.
+    std::wstring Join(QuotingRules rules) const;
+
+    bool operator==(const ArgumentVector& other) const {
+        return offsets_ == other.offsets_ && buffer_ == other.buffer_;
+    }
+    bool operator!=(const ArgumentVector& other) const { return !(*this == other); }
+
+private:
+    friend void TokenizeCommandLine(std::wstring_view commandLine, QuotingRules rules, ArgumentVector& arguments);
+
+    size_t Length(size_t i) const {
+        const size_t next = i + 1 < offsets_.size() ? offsets_[i + 1] : buffer_.size();
+        return next - offsets_[i] - 1;
+    }
+
+    std::wstring buffer_;
+    std::vector<uint32_t> offsets_;
+};
+
+// Splits commandLine into arguments, replacing what they held. Nothing is
+// allocated once their capacity covers the command line. Throws
+// std::invalid_argument for an unterminated Posix quote; Windows rules
+// accept any input.
+void TokenizeCommandLine(std::wstring_view commandLine, QuotingRules rules, ArgumentVector& arguments);
+ArgumentVector TokenizeCommandLine(std::wstring_view commandLine, QuotingRules rules);
+
+// One argument quoted so the rules read it back unchanged; left bare when
+// it needs no quoting. The Windows form is for arguments after the program
+// name.
+std::wstring QuoteArgument(std::wstring_view argument, QuotingRules rules);
+
+} // namespace WSL
@@ -1,94 +1,113 @@
 #include "config.h"
-#include <fstream>
-#include <sstream>
-#include <regex>
+#include "configcache.h"
 
 class WSLConfigManager::Impl {
 private:
-    std::map<std::string, std::map<std::string, std::string>> wslConfig;
-    std::map<std::string, std::map<std::string, std::string>> wslGlobalConfig;
+    std::shared_ptr<const WSL::ConfigStore> wslConfig;
+    std::shared_ptr<const WSL::ConfigStore> wslGlobalConfig;
+    const std::vector<WSL::IniError>* parseErrors = &noErrors;
+    WSL::CompiledSettings settings;
+
+    static inline const std::vector<WSL::IniError> noErrors;
 
 public:
     bool LoadWslConfig(const std::string& distributionPath) {
         std::string configPath = distributionPath + "/etc/wsl.conf";
-        return ParseINIFile(configPath, wslConfig);
+        return Load(configPath, wslConfig);
     }
 
     bool LoadGlobalConfig(const std::string& userProfile) {
         std::string configPath = userProfile + "\\.wslconfig";
-        return ParseINIFile(configPath, wslGlobalConfig);
+        if (!Load(configPath, wslGlobalConfig)) return false;
+
+        settings = WSL::CompileSettings(*wslGlobalConfig);
+        return true;
     }
 
-private:
-    bool ParseINIFile(const std::string& filePath,
-                      std::map<std::string, std::map<std::string, std::string>>& config) {
-        std::ifstream file(filePath);
-        if (!file.is_open()) return false;
-
-        std::string line;
-        std::string currentSection;
-        std::regex sectionRegex(R"(\[([^\]]+)\])");
-        std::regex keyValueRegex(R"(([^=]+)=([^=]*))");
-        std::smatch matches;
-
-        while (std::getline(file, line)) {
-            // Remove comments and trim whitespace
-            size_t commentPos = line.find('#');
-            if (commentPos != std::string::npos) {
-                line = line.substr(0, commentPos);
+    std::string GetValue(const std::string& section, const std::string& key) const {
+        for (const auto* config : {&wslConfig, &wslGlobalConfig}) {
+            if (!*config) {
+                continue;
             }
 
-            line = Trim(line);
-            if (line.empty()) continue;
-
-            // Check for section header
-            if (std::regex_match(line, matches, sectionRegex)) {
-                currentSection = matches[1].str();
-                config[currentSection] = std::map<std::string, std::string>();
-            }
-            // Check for key-value pair
-            else if (std::regex_match(line, matches, keyValueRegex)) {
-                if (!currentSection.empty()) {
-                    std::string key = Trim(matches[1].str());
-                    std::string value = Trim(matches[2].str());
-                    config[currentSection][key] = value;
-                }
+            if (const std::string_view* value = (*config)->Find(section, key)) {
+                return std::string(*value);
             }
         }
+        return "";
+    }
 
-        return true;
+    const std::vector<WSL::IniError>& GetParseErrors() const {
+        return *parseErrors;
     }
 
-    std::string Trim(const std::string& str) {
-        size_t start = str.find_first_not_of(" \t\r\n");
-        if (start == std::string::npos) return "";
+    const WSL::WslSettings& GetSettings() const {
+        return settings.settings;
+    }
 
-        size_t end = str.find_last_not_of(" \t\r\n");
-        return str.substr(start, end - start + 1);
+    const std::vector<WSL::SettingIssue>& GetSettingIssues() const {
+        return settings.issues;
+    }
+
+private:
+    // Unchanged files come back from the process-wide cache without being
+    // reparsed; a failed load keeps whatever was loaded before.
+    bool Load(const std::string& filePath, std::shared_ptr<const WSL::ConfigStore>& config) {
+        auto store = WSL::ConfigCache::Default().Get(filePath);
+        if (!store) return false;
+
+        config = std::move(store);
+        parseErrors = &config->Errors();
+        return true;
     }
 };
 
-// Configuration validation and application
+WSLConfigManager::WSLConfigManager()
+    : pImpl(std::make_unique<Impl>()) {
+}
+
+WSLConfigManager::~WSLConfigManager() = default;
+
+bool WSLConfigManager::LoadWslConfig(const std::string& distributionPath) {
+    return pImpl->LoadWslConfig(distributionPath);
+}
+
+bool WSLConfigManager::LoadGlobalConfig(const std::string& userProfile) {
+    return pImpl->LoadGlobalConfig(userProfile);
+}
+
+std::string WSLConfigManager::GetValue(const std::string& section, const std::string& key) const {
+    return pImpl->GetValue(section, key);
+}
+
+const std::vector<WSL::IniError>& WSLConfigManager::GetParseErrors() const {
+    return pImpl->GetParseErrors();
+}
+
+const WSL::WslSettings& WSLConfigManager::GetSettings() const {
+    return pImpl->GetSettings();
+}
+
+const std::vector<WSL::SettingIssue>& WSLConfigManager::GetSettingIssues() const {
+    return pImpl->GetSettingIssues();
+}
+
+// Configuration validation and application. The checks are the constexpr
+// parsers behind WSL::CompileSettings, so nothing is compiled or allocated
+// per call.
 class ConfigValidator {
 public:
     static bool ValidateMemorySize(const std::string& memoryStr) {
-        std::regex memoryRegex(R"((\d+)(GB|MB|KB|B)?)");
-        return std::regex_match(memoryStr, memoryRegex);
+        return WSL::ParseMemorySize(memoryStr).has_value();
     }
 
     static bool ValidateProcessorCount(const std::string& procStr) {
-        try {
-            int count = std::stoi(procStr);
-            return count > 0 && count <= std::thread::hardware_concurrency();
-        } catch (...) {
-            return false;
-        }
+        const auto count = WSL::ParseCount(procStr);
+        const uint32_t host = WSL::SettingsLimits::Host().hostProcessors;
+        return count && *count > 0 && (host == 0 || *count <= host);
     }
 
     static bool ValidateNetworkingMode(const std::string& mode) {
-        const std::vector<std::string> validModes = {
-            "NAT", "bridged", "mirrored", "none", "virtioproxy"
-        };
-        return std::find(validModes.begin(), validModes.end(), mode) != validModes.end();
+        return WSL::ParseNetworkingMode(mode).has_value();
     }
 };
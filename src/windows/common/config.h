@@ -0,0 +1,44 @@
+#pragma once
+
+#include "configschema.h"
+#include "iniparser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class WSLConfigManager {
+public:
+    WSLConfigManager();
+    ~WSLConfigManager();
+
+    // Non-copyable, non-movable
+    WSLConfigManager(const WSLConfigManager&) = delete;
+    WSLConfigManager& operator=(const WSLConfigManager&) = delete;
+    WSLConfigManager(WSLConfigManager&&) = delete;
+    WSLConfigManager& operator=(WSLConfigManager&&) = delete;
+
+    // Reads <distributionPath>/etc/wsl.conf.
+    bool LoadWslConfig(const std::string& distributionPath);
+
+    // Reads <userProfile>\.wslconfig.
+    bool LoadGlobalConfig(const std::string& userProfile);
+
+    // wsl.conf first, then .wslconfig; empty when the key is not set. Hot
+    // paths can use WSL::ConfigStore directly and skip the copy.
+    std::string GetValue(const std::string& section, const std::string& key) const;
+
+    // Lines the last load skipped, with their line and column.
+    const std::vector<WSL::IniError>& GetParseErrors() const;
+
+    // .wslconfig settings, typed and validated when it was loaded; defaults
+    // until then.
+    const WSL::WslSettings& GetSettings() const;
+
+    // Values GetSettings() rejected and replaced with their defaults.
+    const std::vector<WSL::SettingIssue>& GetSettingIssues() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
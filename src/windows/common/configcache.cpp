@@ -0,0 +1,646 @@
+#include "configcache.h"
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <future>
+#else
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+// Copies the file into a store that owns its text; see ConfigCache.
+ConfigCache::Snapshot LoadSnapshot(const std::string& path) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        return nullptr;
+    }
+    return ConfigStore::FromText(std::string(file.View()));
+}
+
+bool SameSection(std::span<const ConfigEntry> left, std::span<const ConfigEntry> right) {
+    return std::equal(left.begin(), left.end(), right.begin(), right.end(),
+                      [](const ConfigEntry& a, const ConfigEntry& b) { return a.key == b.key && a.value == b.value; });
+}
+
+// Reports file names that changed in watched directories. An empty name
+// means events were dropped and anything in the directory may have changed.
+// lost means the directory itself was deleted or moved: it is no longer
+// watched, and nothing more is reported for it unless it is added again.
+class DirectoryWatcher {
+public:
+    using Callback = std::function<void(const std::string& directory, const std::string& name, bool lost)>;
+
+    explicit DirectoryWatcher(Callback callback);
+    ~DirectoryWatcher();
+
+    // Non-copyable, non-movable
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    DirectoryWatcher(DirectoryWatcher&&) = delete;
+    DirectoryWatcher& operator=(DirectoryWatcher&&) = delete;
+
+    // Once this returns true, every later change in the directory is reported.
+    bool Add(const std::string& directory);
+
+private:
+    void Run();
+
+    Callback callback_;
+    std::mutex lock_;
+    std::thread thread_;
+
+#ifdef _WIN32
+    struct Directory {
+        std::string path;
+        HANDLE handle = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped{};
+        alignas(DWORD) char buffer[16 * 1024];
+    };
+
+    struct PendingAdd {
+        std::string path;
+        std::promise<bool> armed;
+    };
+
+    bool Arm(Directory& directory);
+
+    HANDLE stopEvent_ = nullptr;
+    HANDLE wakeEvent_ = nullptr;
+    std::vector<std::unique_ptr<Directory>> directories_; // watcher thread only
+    std::vector<PendingAdd*> pending_;
+    std::vector<std::string> added_;
+#else
+    int inotify_ = -1;
+    int stopFd_ = -1;
+    std::unordered_map<int, std::string> directories_;
+#endif
+};
+
+#ifdef _WIN32
+
+DirectoryWatcher::DirectoryWatcher(Callback callback) : callback_(std::move(callback)) {
+    stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    wakeEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    if (!stopEvent_ || !wakeEvent_) {
+        DWORD error = GetLastError();
+        if (stopEvent_) CloseHandle(stopEvent_);
+        if (wakeEvent_) CloseHandle(wakeEvent_);
+        throw std::runtime_error("Failed to create config watcher events: " + std::to_string(error));
+    }
+    thread_ = std::thread(&DirectoryWatcher::Run, this);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    SetEvent(stopEvent_);
+    thread_.join();
+    for (auto& directory : directories_) {
+        CancelIoEx(directory->handle, &directory->overlapped);
+        DWORD bytes = 0;
+        GetOverlappedResult(directory->handle, &directory->overlapped, &bytes, TRUE);
+        CloseHandle(directory->overlapped.hEvent);
+        CloseHandle(directory->handle);
+    }
+    CloseHandle(wakeEvent_);
+    CloseHandle(stopEvent_);
+}
+
+// Overlapped directory reads are cancelled when the issuing thread exits,
+// so only the watcher thread opens and arms directories.
+bool DirectoryWatcher::Add(const std::string& directory) {
+    PendingAdd add{directory, {}};
+    std::future<bool> armed = add.armed.get_future();
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (std::find(added_.begin(), added_.end(), directory) != added_.end()) {
+            return true;
+        }
+        pending_.push_back(&add);
+    }
+
+    SetEvent(wakeEvent_);
+    return armed.get();
+}
+
+bool DirectoryWatcher::Arm(Directory& directory) {
+    ResetEvent(directory.overlapped.hEvent);
+    return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), FALSE,
+                                 FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                     FILE_NOTIFY_CHANGE_SIZE,
+                                 nullptr, &directory.overlapped, nullptr);
+}
+
+void DirectoryWatcher::Run() {
+    for (;;) {
+        // MAXIMUM_WAIT_OBJECTS is far more directories than config files
+        // live in.
+        std::vector<HANDLE> waits = {stopEvent_, wakeEvent_};
+        for (auto& directory : directories_) {
+            waits.push_back(directory->overlapped.hEvent);
+        }
+
+        const DWORD result = WaitForMultipleObjects(static_cast<DWORD>(waits.size()), waits.data(), FALSE, INFINITE);
+        if (result == WAIT_OBJECT_0) {
+            break;
+        }
+
+        if (result == WAIT_OBJECT_0 + 1) {
+            std::vector<PendingAdd*> pending;
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                pending.swap(pending_);
+            }
+
+            for (PendingAdd* add : pending) {
+                auto directory = std::make_unique<Directory>();
+                directory->path = add->path;
+                directory->handle = CreateFileA(add->path.c_str(), FILE_LIST_DIRECTORY,
+                                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                                OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                                nullptr);
+                directory->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+                bool armed = directory->handle != INVALID_HANDLE_VALUE && directory->overlapped.hEvent &&
+                             Arm(*directory);
+                if (armed) {
+                    std::lock_guard<std::mutex> guard(lock_);
+                    added_.push_back(add->path);
+                    directories_.push_back(std::move(directory));
+                } else {
+                    if (directory->overlapped.hEvent) CloseHandle(directory->overlapped.hEvent);
+                    if (directory->handle != INVALID_HANDLE_VALUE) CloseHandle(directory->handle);
+                }
+                add->armed.set_value(armed);
+            }
+            continue;
+        }
+
+        if (result < WAIT_OBJECT_0 + 2 || result >= WAIT_OBJECT_0 + waits.size()) {
+            break;
+        }
+
+        Directory& directory = *directories_[result - WAIT_OBJECT_0 - 2];
+        DWORD bytes = 0;
+        const BOOL completed = GetOverlappedResult(directory.handle, &directory.overlapped, &bytes, FALSE);
+
+        // Collect names before re-arming; the buffer is reused.
+        std::vector<std::string> names;
+        if (!completed || bytes == 0) {
+            names.emplace_back();
+        } else {
+            const char* cursor = directory.buffer;
+            for (;;) {
+                const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(cursor);
+                const int wideLength = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+                const int length =
+                    WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+                std::string name(static_cast<size_t>(length), '\0');
+                WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, name.data(), length, nullptr, nullptr);
+                if (std::find(names.begin(), names.end(), name) == names.end()) {
+                    names.push_back(std::move(name));
+                }
+
+                if (info->NextEntryOffset == 0) {
+                    break;
+                }
+                cursor += info->NextEntryOffset;
+            }
+        }
+
+        const bool lost = !Arm(directory);
+        if (lost) {
+            // The directory went away; report once and stop watching it.
+            names.assign(1, std::string());
+        }
+
+        for (const std::string& name : names) {
+            callback_(directory.path, name, lost);
+        }
+
+        if (lost) {
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                std::erase(added_, directory.path);
+            }
+            CloseHandle(directory.overlapped.hEvent);
+            CloseHandle(directory.handle);
+            directories_.erase(directories_.begin() + (result - WAIT_OBJECT_0 - 2));
+        }
+    }
+}
+
+#else
+
+DirectoryWatcher::DirectoryWatcher(Callback callback) : callback_(std::move(callback)) {
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create config watcher");
+    }
+
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd_ < 0) {
+        int error = errno;
+        close(inotify_);
+        throw std::system_error(error, std::generic_category(), "Failed to create config watcher stop event");
+    }
+
+    thread_ = std::thread(&DirectoryWatcher::Run, this);
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    const uint64_t one = 1;
+    (void)write(stopFd_, &one, sizeof(one));
+    thread_.join();
+    close(stopFd_);
+    close(inotify_);
+}
+
+bool DirectoryWatcher::Add(const std::string& directory) {
+    std::lock_guard<std::mutex> guard(lock_);
+
+    // Renames cover editors that save by replacing the file. Deleting the
+    // directory ends the watch with IN_IGNORED; moving it does not, so that
+    // is ended here once seen.
+    const int wd = inotify_add_watch(inotify_, directory.c_str(),
+                                     IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_MOVE_SELF |
+                                         IN_ONLYDIR);
+    if (wd < 0) {
+        return false;
+    }
+    directories_[wd] = directory;
+    return true;
+}
+
+void DirectoryWatcher::Run() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        pollfd fds[2] = {{inotify_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+
+        // Drain everything queued so a burst of writes reloads once.
+        std::vector<std::pair<std::string, std::string>> changes;
+        std::vector<std::string> lost;
+        for (;;) {
+            const ssize_t bytes = read(inotify_, buffer, sizeof(buffer));
+            if (bytes <= 0) {
+                break;
+            }
+
+            std::lock_guard<std::mutex> guard(lock_);
+            for (const char* cursor = buffer; cursor < buffer + bytes;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    for (const auto& [wd, directory] : directories_) {
+                        changes.emplace_back(directory, std::string());
+                    }
+                    continue;
+                }
+
+                auto directory = directories_.find(event->wd);
+                if (directory == directories_.end()) {
+                    continue;
+                }
+
+                std::pair<std::string, std::string> change(directory->second, event->len ? event->name : "");
+                if (std::find(changes.begin(), changes.end(), change) == changes.end()) {
+                    changes.push_back(std::move(change));
+                }
+
+                if (event->mask & IN_MOVE_SELF) {
+                    inotify_rm_watch(inotify_, event->wd);
+                }
+                if (event->mask & IN_IGNORED) {
+                    lost.push_back(directory->second);
+                    directories_.erase(directory);
+                }
+            }
+        }
+
+        for (const auto& [directory, name] : changes) {
+            callback_(directory, name,
+                      name.empty() && std::find(lost.begin(), lost.end(), directory) != lost.end());
+        }
+    }
+}
+
+#endif
+
+} // namespace
+
+std::optional<FileIdentity> FileIdentity::Query(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return std::nullopt;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    const BOOL queried = GetFileInformationByHandle(file, &info);
+    CloseHandle(file);
+    if (!queried) {
+        return std::nullopt;
+    }
+
+    FileIdentity identity;
+    identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    identity.modified = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                        info.ftLastWriteTime.dwLowDateTime;
+    identity.volume = info.dwVolumeSerialNumber;
+    identity.file = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    return identity;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return std::nullopt;
+    }
+
+    FileIdentity identity;
+    identity.size = static_cast<uint64_t>(info.st_size);
+    identity.modified = static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ull +
+                        static_cast<uint64_t>(info.st_mtim.tv_nsec);
+    identity.volume = static_cast<uint64_t>(info.st_dev);
+    identity.file = static_cast<uint64_t>(info.st_ino);
+    return identity;
+#endif
+}
+
+class ConfigCache::Impl {
+private:
+    struct Entry {
+        std::string path;
+        std::string directory;
+        std::string name;
+        std::atomic<Snapshot> snapshot;
+        std::atomic<bool> watched{false};
+
+        std::mutex reloadLock;
+        std::optional<FileIdentity> identity; // guarded by reloadLock
+        bool loaded = false;                  // guarded by reloadLock
+    };
+
+    struct Refresh {
+        Snapshot previous;
+        Snapshot current;
+        bool changed = false;
+    };
+
+    struct Subscriber {
+        uint64_t id;
+        std::string path;
+        std::string section;
+        SectionCallback callback;
+    };
+
+    std::shared_mutex entriesLock_;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries_;
+
+    // Held while callbacks run, so Unsubscribe() returning means the
+    // callback is done.
+    std::mutex subscribersLock_;
+    std::vector<Subscriber> subscribers_;
+    uint64_t nextId_ = 1;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> reloads_{0};
+    MetricsRegistry* metrics_;
+
+    std::mutex watcherLock_;
+    std::unique_ptr<DirectoryWatcher> watcher_;
+
+public:
+    explicit Impl(MetricsRegistry* metrics) : metrics_(metrics) {}
+
+    ~Impl() {
+        // Stop callbacks before the entries they touch go away.
+        watcher_.reset();
+    }
+
+    Snapshot Get(const std::string& path) {
+        Entry& entry = FindOrAdd(path);
+        if (entry.watched.load(std::memory_order_acquire)) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return entry.snapshot.load(std::memory_order_acquire);
+        }
+        return RefreshEntry(entry).current;
+    }
+
+    bool Watch(const std::string& path) {
+        Entry& entry = FindOrAdd(path);
+        if (entry.watched.load(std::memory_order_acquire)) {
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(watcherLock_);
+            if (!watcher_) {
+                try {
+                    watcher_ = std::make_unique<DirectoryWatcher>(
+                        [this](const std::string& directory, const std::string& name, bool lost) {
+                            OnChange(directory, name, lost);
+                        });
+                } catch (const std::exception&) {
+                    return false;
+                }
+            }
+        }
+
+        if (!watcher_->Add(entry.directory)) {
+            return false;
+        }
+
+        // Changes from here on reach OnChange; this catches anything before.
+        RefreshEntry(entry);
+        entry.watched.store(true, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t Subscribe(const std::string& path, std::string section, SectionCallback callback) {
+        std::lock_guard<std::mutex> guard(subscribersLock_);
+        const uint64_t id = nextId_++;
+        subscribers_.push_back({id, path, std::move(section), std::move(callback)});
+        return id;
+    }
+
+    void Unsubscribe(uint64_t id) {
+        std::lock_guard<std::mutex> guard(subscribersLock_);
+        std::erase_if(subscribers_, [id](const Subscriber& subscriber) { return subscriber.id == id; });
+    }
+
+    Stats GetStats() const {
+        return {hits_.load(std::memory_order_relaxed), reloads_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    Entry& FindOrAdd(const std::string& path) {
+        {
+            std::shared_lock<std::shared_mutex> guard(entriesLock_);
+            auto found = entries_.find(path);
+            if (found != entries_.end()) {
+                return *found->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> guard(entriesLock_);
+        auto& slot = entries_[path];
+        if (!slot) {
+            slot = std::make_unique<Entry>();
+            const std::filesystem::path split(path);
+            slot->path = path;
+            slot->directory = split.has_parent_path() ? split.parent_path().string() : ".";
+            slot->name = split.filename().string();
+        }
+        return *slot;
+    }
+
+    Refresh RefreshEntry(Entry& entry) {
+        std::lock_guard<std::mutex> guard(entry.reloadLock);
+        Snapshot current = entry.snapshot.load(std::memory_order_acquire);
+
+        std::optional<FileIdentity> identity = FileIdentity::Query(entry.path);
+        if (entry.loaded && identity == entry.identity) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return {current, current, false};
+        }
+
+        Snapshot next = identity ? LoadSnapshot(entry.path) : nullptr;
+        entry.snapshot.store(next, std::memory_order_release);
+        entry.identity = identity;
+        entry.loaded = true;
+        reloads_.fetch_add(1, std::memory_order_relaxed);
+        if (metrics_) {
+            metrics_->Add(Metric::ConfigReloads);
+        }
+        return {std::move(current), std::move(next), true};
+    }
+
+    void OnChange(const std::string& directory, const std::string& name, bool lost) {
+        std::vector<Entry*> affected;
+        {
+            std::shared_lock<std::shared_mutex> guard(entriesLock_);
+            for (auto& [path, entry] : entries_) {
+                if (entry->directory == directory && (name.empty() || entry->name == name)) {
+                    affected.push_back(entry.get());
+                }
+            }
+        }
+
+        for (Entry* entry : affected) {
+            // Nothing will report this path's changes any more, so Get()
+            // goes back to checking its identity.
+            if (lost) {
+                entry->watched.store(false, std::memory_order_release);
+            }
+            Refresh refresh = RefreshEntry(*entry);
+            if (refresh.changed) {
+                Notify(entry->path, refresh);
+            }
+        }
+    }
+
+    void Notify(const std::string& path, const Refresh& refresh) {
+        const std::vector<std::string> changed = ChangedSections(refresh.previous.get(), refresh.current.get());
+        if (changed.empty()) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(subscribersLock_);
+        for (const Subscriber& subscriber : subscribers_) {
+            if (subscriber.path == path &&
+                std::binary_search(changed.begin(), changed.end(), subscriber.section)) {
+                subscriber.callback(refresh.current);
+            }
+        }
+    }
+};
+
+ConfigCache::ConfigCache(MetricsRegistry* metrics)
+    : pImpl_(std::make_unique<Impl>(metrics)) {
+}
+
+ConfigCache::~ConfigCache() = default;
+
+ConfigCache& ConfigCache::Default() {
+    static ConfigCache cache(&MetricsRegistry::Default());
+    return cache;
+}
+
+ConfigCache::Snapshot ConfigCache::Get(const std::string& path) {
+    return pImpl_->Get(path);
+}
+
+bool ConfigCache::Watch(const std::string& path) {
+    return pImpl_->Watch(path);
+}
+
+uint64_t ConfigCache::Subscribe(const std::string& path, std::string section, SectionCallback callback) {
+    return pImpl_->Subscribe(path, std::move(section), std::move(callback));
+}
+
+void ConfigCache::Unsubscribe(uint64_t id) {
+    pImpl_->Unsubscribe(id);
+}
+
+ConfigCache::Stats ConfigCache::GetStats() const {
+    return pImpl_->GetStats();
+}
+
+std::vector<std::string> ConfigCache::ChangedSections(const ConfigStore* before, const ConfigStore* after) {
+    // Entries are sorted by section, so the names of both sides merge in order.
+    std::vector<std::string> names;
+    for (const ConfigStore* store : {before, after}) {
+        if (!store) {
+            continue;
+        }
+        for (const ConfigEntry& entry : store->Entries()) {
+            if (names.empty() || names.back() != entry.section) {
+                names.emplace_back(entry.section);
+            }
+        }
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::vector<std::string> changed;
+    for (std::string& name : names) {
+        const std::span<const ConfigEntry> left = before ? before->Section(name) : std::span<const ConfigEntry>();
+        const std::span<const ConfigEntry> right = after ? after->Section(name) : std::span<const ConfigEntry>();
+        if (!SameSection(left, right)) {
+            changed.push_back(std::move(name));
+        }
+    }
+    return changed;
+}
+
+} // namespace WSL
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "configstore.h"
+#include "metrics.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+// What identifies one version of a file without reading it.
+struct FileIdentity {
+    uint64_t size = 0;
+    uint64_t modified = 0; // mtime in ns on Linux, FILETIME ticks on Windows
+    uint64_t volume = 0;   // st_dev / volume serial number
+    uint64_t file = 0;     // inode / file index
+
+    bool operator==(const FileIdentity&) const = default;
+
+    // std::nullopt if the file does not exist or cannot be queried.
+    static std::optional<FileIdentity> Query(const std::string& path);
+};
+
+// Process-wide cache of parsed config files, keyed by path and validated by
+// FileIdentity. Snapshots own a copy of the text rather than a mapping, so
+// holding one never pins the user's file.
+//
+// Unwatched paths cost one stat per Get() and reparse only when the identity
+// changes. Watched paths skip the stat: a directory watcher (inotify /
+// ReadDirectoryChangesW) reparses in the background and swaps the snapshot
+// atomically, so Get() is a single atomic load.
+class ConfigCache {
+public:
+    using Snapshot = std::shared_ptr<const ConfigStore>;
+
+    // Runs on the watcher thread with the new snapshot, which is nullptr if
+    // the file was deleted. Callbacks may call Get() but not Watch(),
+    // Subscribe() or Unsubscribe().
+    using SectionCallback = std::function<void(const Snapshot&)>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t reloads = 0;
+    };
+
+    // With metrics, every reparse is also published as a config reload.
+    explicit ConfigCache(MetricsRegistry* metrics = nullptr);
+    ~ConfigCache();
+
+    // Non-copyable, non-movable
+    ConfigCache(const ConfigCache&) = delete;
+    ConfigCache& operator=(const ConfigCache&) = delete;
+    ConfigCache(ConfigCache&&) = delete;
+    ConfigCache& operator=(ConfigCache&&) = delete;
+
+    // Shared by every WSLConfigManager in the process.
+    static ConfigCache& Default();
+
+    // Current snapshot, or nullptr if the file does not exist.
+    Snapshot Get(const std::string& path);
+
+    // Starts watching the file's directory. Returns false if the directory
+    // cannot be watched; Get() keeps validating by identity then, as it does
+    // once a watched directory is deleted or moved.
+    bool Watch(const std::string& path);
+
+    // Calls back whenever a background reload of a watched path changes any
+    // key of the section, including the section appearing or disappearing.
+    // Once Unsubscribe() returns the callback will not run again.
+    uint64_t Subscribe(const std::string& path, std::string section, SectionCallback callback);
+    void Unsubscribe(uint64_t id);
+
+    Stats GetStats() const;
+
+    // Sections whose entries differ between two snapshots, in name order.
+    static std::vector<std::string> ChangedSections(const ConfigStore* before, const ConfigStore* after);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
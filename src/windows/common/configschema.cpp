@@ -0,0 +1,127 @@
+#include "configschema.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace WSL {
+
+namespace {
+
+// Every lookup key is a literal in the table, so a typo fails the build.
+static_assert(FindSetting("wsl2", "memory") != nullptr);
+static_assert(FindSetting("wsl2", "networkingMode")->type == SettingType::Networking);
+static_assert(ParseNetworkingMode("mirrored") == NetworkingMode::Mirrored);
+static_assert(ParseMemorySize("4GB") == 4ull << 30);
+
+constexpr bool SchemaIsConsistent() {
+    for (size_t i = 0; i < SettingsSchema.size(); ++i) {
+        const SettingField& field = SettingsSchema[i];
+        const int targets = (field.size != nullptr) + (field.count != nullptr) + (field.networking != nullptr) +
+                            (field.flag != nullptr);
+        if (targets != 1) {
+            return false;
+        }
+
+        const bool typed = (field.type == SettingType::Size && field.size) ||
+                           (field.type == SettingType::Count && field.count) ||
+                           (field.type == SettingType::Networking && field.networking) ||
+                           (field.type == SettingType::Boolean && field.flag);
+        if (!typed) {
+            return false;
+        }
+
+        for (size_t j = 0; j < i; ++j) {
+            if (SettingsSchema[j].section == field.section && SettingsSchema[j].key == field.key) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(SchemaIsConsistent(), "each setting needs one unique (section, key) and one matching target");
+
+// 1-based line and column of a view into the store's text, or 0, 0.
+std::pair<size_t, size_t> Locate(std::string_view text, std::string_view value) {
+    if (value.data() < text.data() || value.data() > text.data() + text.size()) {
+        return {0, 0};
+    }
+
+    const std::string_view before = text.substr(0, static_cast<size_t>(value.data() - text.data()));
+    const size_t line = static_cast<size_t>(std::count(before.begin(), before.end(), '\n')) + 1;
+    const size_t lineStart = before.rfind('\n');
+    const size_t column = lineStart == std::string_view::npos ? before.size() + 1 : before.size() - lineStart;
+    return {line, column};
+}
+
+// Applies one value; an empty string on success, otherwise why it was rejected.
+std::string Apply(const SettingField& field, std::string_view value, const SettingsLimits& limits,
+                  WslSettings& settings) {
+    switch (field.type) {
+    case SettingType::Size:
+        if (auto bytes = ParseMemorySize(value)) {
+            settings.*field.size = *bytes;
+            return {};
+        }
+        return "expected a size such as 8GB, 512MB, 1024KB or 4096B";
+
+    case SettingType::Count:
+        if (auto count = ParseCount(value)) {
+            if (*count == 0) {
+                return "must be at least 1";
+            }
+            if (limits.hostProcessors != 0 && *count > limits.hostProcessors) {
+                return "exceeds the " + std::to_string(limits.hostProcessors) + " logical processors on this machine";
+            }
+            settings.*field.count = *count;
+            return {};
+        }
+        return "expected a whole number";
+
+    case SettingType::Networking:
+        if (auto mode = ParseNetworkingMode(value)) {
+            settings.*field.networking = *mode;
+            return {};
+        }
+        return "expected one of NAT, bridged, mirrored, none, virtioproxy";
+
+    case SettingType::Boolean:
+        if (auto flag = ParseBoolean(value)) {
+            settings.*field.flag = *flag;
+            return {};
+        }
+        return "expected true or false";
+    }
+
+    return "unsupported setting type";
+}
+
+} // namespace
+
+SettingsLimits SettingsLimits::Host() {
+    static const SettingsLimits host{std::thread::hardware_concurrency()};
+    return host;
+}
+
+CompiledSettings CompileSettings(const ConfigStore& store, const SettingsLimits& limits) {
+    CompiledSettings compiled;
+    for (const SettingField& field : SettingsSchema) {
+        const std::string_view* value = store.Find(field.section, field.key);
+        if (!value) {
+            continue;
+        }
+
+        std::string message = Apply(field, *value, limits, compiled.settings);
+        if (message.empty()) {
+            continue;
+        }
+
+        auto [line, column] = Locate(store.Text(), *value);
+        compiled.issues.push_back({std::string(field.section), std::string(field.key), std::string(*value), line,
+                                   column, std::move(message)});
+    }
+    return compiled;
+}
+
+} // namespace WSL
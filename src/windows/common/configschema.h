@@ -0,0 +1,197 @@
+#pragma once
+
+#include "configstore.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+enum class NetworkingMode : uint8_t {
+    Nat,
+    Bridged,
+    Mirrored,
+    None,
+    VirtioProxy
+};
+
+// .wslconfig [wsl2] settings, parsed and validated once. Zero sizes and
+// counts mean "let the service pick" (half the host memory, every core).
+struct WslSettings {
+    uint64_t memoryBytes = 0;
+    uint64_t swapBytes = 0;
+    uint32_t processors = 0;
+    NetworkingMode networkingMode = NetworkingMode::Nat;
+    bool localhostForwarding = true;
+    bool guiApplications = true;
+    bool nestedVirtualization = true;
+    bool dnsTunneling = false;
+    bool firewall = true;
+    bool autoProxy = true;
+};
+
+enum class SettingType : uint8_t {
+    Size,
+    Count,
+    Networking,
+    Boolean
+};
+
+// One schema row. Exactly one member pointer matching the type is set.
+struct SettingField {
+    std::string_view section;
+    std::string_view key;
+    SettingType type;
+    uint64_t WslSettings::*size = nullptr;
+    uint32_t WslSettings::*count = nullptr;
+    NetworkingMode WslSettings::*networking = nullptr;
+    bool WslSettings::*flag = nullptr;
+};
+
+inline constexpr std::array<SettingField, 10> SettingsSchema = {{
+    {"wsl2", "memory", SettingType::Size, &WslSettings::memoryBytes},
+    {"wsl2", "swap", SettingType::Size, &WslSettings::swapBytes},
+    {"wsl2", "processors", SettingType::Count, nullptr, &WslSettings::processors},
+    {"wsl2", "networkingMode", SettingType::Networking, nullptr, nullptr, &WslSettings::networkingMode},
+    {"wsl2", "localhostForwarding", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::localhostForwarding},
+    {"wsl2", "guiApplications", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::guiApplications},
+    {"wsl2", "nestedVirtualization", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::nestedVirtualization},
+    {"wsl2", "dnsTunneling", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::dnsTunneling},
+    {"wsl2", "firewall", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::firewall},
+    {"wsl2", "autoProxy", SettingType::Boolean, nullptr, nullptr, nullptr, &WslSettings::autoProxy},
+}};
+
+struct NetworkingModeName {
+    std::string_view name;
+    NetworkingMode mode;
+};
+
+inline constexpr std::array<NetworkingModeName, 5> NetworkingModeNames = {{
+    {"NAT", NetworkingMode::Nat},
+    {"bridged", NetworkingMode::Bridged},
+    {"mirrored", NetworkingMode::Mirrored},
+    {"none", NetworkingMode::None},
+    {"virtioproxy", NetworkingMode::VirtioProxy},
+}};
+
+constexpr const SettingField* FindSetting(std::string_view section, std::string_view key) {
+    for (const SettingField& field : SettingsSchema) {
+        if (field.section == section && field.key == key) {
+            return &field;
+        }
+    }
+    return nullptr;
+}
+
+constexpr std::optional<NetworkingMode> ParseNetworkingMode(std::string_view text) {
+    for (const NetworkingModeName& entry : NetworkingModeNames) {
+        if (entry.name == text) {
+            return entry.mode;
+        }
+    }
+    return std::nullopt;
+}
+
+constexpr std::string_view NetworkingModeToString(NetworkingMode mode) {
+    for (const NetworkingModeName& entry : NetworkingModeNames) {
+        if (entry.mode == mode) {
+            return entry.name;
+        }
+    }
+    return {};
+}
+
+// "<digits>[B|KB|MB|GB]", binary multiples; empty on a bad unit or overflow.
+constexpr std::optional<uint64_t> ParseMemorySize(std::string_view text) {
+    size_t digits = 0;
+    uint64_t value = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') {
+        const uint64_t digit = static_cast<uint64_t>(text[digits] - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return std::nullopt;
+        }
+        value = value * 10 + digit;
+        ++digits;
+    }
+    if (digits == 0) {
+        return std::nullopt;
+    }
+
+    const std::string_view unit = text.substr(digits);
+    uint64_t multiplier = 0;
+    if (unit.empty() || unit == "B") {
+        multiplier = 1;
+    } else if (unit == "KB") {
+        multiplier = 1ull << 10;
+    } else if (unit == "MB") {
+        multiplier = 1ull << 20;
+    } else if (unit == "GB") {
+        multiplier = 1ull << 30;
+    } else {
+        return std::nullopt;
+    }
+
+    if (value > UINT64_MAX / multiplier) {
+        return std::nullopt;
+    }
+    return value * multiplier;
+}
+
+constexpr std::optional<uint32_t> ParseCount(std::string_view text) {
+    if (text.empty() || text.size() > 9) {
+        return std::nullopt;
+    }
+
+    uint32_t value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return std::nullopt;
+        }
+        value = value * 10 + static_cast<uint32_t>(c - '0');
+    }
+    return value;
+}
+
+constexpr std::optional<bool> ParseBoolean(std::string_view text) {
+    if (text == "true" || text == "1") {
+        return true;
+    }
+    if (text == "false" || text == "0") {
+        return false;
+    }
+    return std::nullopt;
+}
+
+// A value the snapshot rejected; the field keeps its default. Line and
+// column locate the value in the file.
+struct SettingIssue {
+    std::string section;
+    std::string key;
+    std::string value;
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+};
+
+struct SettingsLimits {
+    // Upper bound for processors; 0 disables the check.
+    uint32_t hostProcessors = 0;
+
+    // hardware_concurrency(), queried once per process.
+    static SettingsLimits Host();
+};
+
+struct CompiledSettings {
+    WslSettings settings;
+    std::vector<SettingIssue> issues;
+};
+
+// Walks the schema once against the store. Nothing here runs on lookups:
+// consumers read CompiledSettings::settings fields directly.
+CompiledSettings CompileSettings(const ConfigStore& store, const SettingsLimits& limits = SettingsLimits::Host());
+
+} // namespace WSL
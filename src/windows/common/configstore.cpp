@@ -0,0 +1,172 @@
+#include "configstore.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace WSL {
+
+namespace {
+
+// FNV-1a over section, a separator no header can contain, and key.
+uint32_t HashKey(std::string_view section, std::string_view key) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](std::string_view text) {
+        for (char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+    };
+    mix(section);
+    hash = (hash ^ ']') * 16777619u;
+    mix(key);
+    return hash;
+}
+
+bool EntryLess(const ConfigEntry& left, const ConfigEntry& right) {
+    if (left.section != right.section) {
+        return left.section < right.section;
+    }
+    return left.key < right.key;
+}
+
+// Collects entries in file order and remembers, per section, where its last
+// header was so everything before a redeclaration can be dropped afterwards.
+class IndexBuilder : public IniHandler {
+public:
+    IndexBuilder(std::vector<ConfigEntry>& entries, std::vector<IniError>& errors)
+        : entries_(entries), errors_(errors) {}
+
+    void OnSection(std::string_view name) override {
+        for (auto& [section, start] : starts_) {
+            if (section == name) {
+                start = entries_.size();
+                return;
+            }
+        }
+        starts_.emplace_back(name, entries_.size());
+    }
+
+    void OnValue(std::string_view section, std::string_view key, std::string_view value) override {
+        entries_.push_back({section, key, value});
+    }
+
+    void OnError(const IniError& error) override {
+        errors_.push_back(error);
+    }
+
+    size_t SectionStart(std::string_view name) const {
+        for (const auto& [section, start] : starts_) {
+            if (section == name) {
+                return start;
+            }
+        }
+        return 0;
+    }
+
+private:
+    std::vector<ConfigEntry>& entries_;
+    std::vector<IniError>& errors_;
+    std::vector<std::pair<std::string_view, size_t>> starts_;
+};
+
+} // namespace
+
+std::shared_ptr<const ConfigStore> ConfigStore::Open(const std::string& path) {
+    std::shared_ptr<ConfigStore> store(new ConfigStore());
+    if (!store->mapping_.Open(path)) {
+        return nullptr;
+    }
+
+    store->text_ = store->mapping_.View();
+    store->BuildIndex();
+    return store;
+}
+
+std::shared_ptr<const ConfigStore> ConfigStore::FromText(std::string text) {
+    std::shared_ptr<ConfigStore> store(new ConfigStore());
+    store->owned_ = std::move(text);
+    store->text_ = store->owned_;
+    store->BuildIndex();
+    return store;
+}
+
+void ConfigStore::BuildIndex() {
+    // Every value line has an '=', so this is the only allocation the index
+    // needs.
+    entries_.reserve(static_cast<size_t>(std::count(text_.begin(), text_.end(), '=')));
+
+    IndexBuilder builder(entries_, errors_);
+    ParseIni(text_, builder);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (i >= builder.SectionStart(entries_[i].section)) {
+            entries_[kept++] = entries_[i];
+        }
+    }
+    entries_.resize(kept);
+
+    // Stable, so the last of several equal keys is the last of its run.
+    std::stable_sort(entries_.begin(), entries_.end(), EntryLess);
+
+    kept = 0;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const bool overridden = i + 1 < entries_.size() && !EntryLess(entries_[i], entries_[i + 1]);
+        if (!overridden) {
+            entries_[kept++] = entries_[i];
+        }
+    }
+    entries_.resize(kept);
+
+    BuildHash();
+}
+
+void ConfigStore::BuildHash() {
+    if (entries_.empty()) {
+        return;
+    }
+
+    // At most half full so probe sequences stay short.
+    size_t capacity = 1;
+    while (capacity < entries_.size() * 2) {
+        capacity <<= 1;
+    }
+
+    slots_.assign(capacity, 0);
+    const size_t mask = capacity - 1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        size_t slot = HashKey(entries_[i].section, entries_[i].key) & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+const std::string_view* ConfigStore::Find(std::string_view section, std::string_view key) const {
+    if (slots_.empty()) {
+        return nullptr;
+    }
+
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = HashKey(section, key) & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+        const ConfigEntry& entry = entries_[slots_[slot] - 1];
+        if (entry.key == key && entry.section == section) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+std::string_view ConfigStore::GetValue(std::string_view section, std::string_view key) const {
+    const std::string_view* value = Find(section, key);
+    return value ? *value : std::string_view{};
+}
+
+std::span<const ConfigEntry> ConfigStore::Section(std::string_view section) const {
+    auto bySection = [](const ConfigEntry& left, const ConfigEntry& right) { return left.section < right.section; };
+    const ConfigEntry probe{section, {}, {}};
+    auto [first, last] = std::equal_range(entries_.begin(), entries_.end(), probe, bySection);
+    return {first, last};
+}
+
+} // namespace WSL
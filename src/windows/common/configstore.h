@@ -0,0 +1,67 @@
+#pragma once
+
+#include "iniparser.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+struct ConfigEntry {
+    std::string_view section;
+    std::string_view key;
+    std::string_view value;
+};
+
+// Read-only wsl.conf / .wslconfig contents: the file is mapped and every
+// entry is a set of views into the mapping, kept in one contiguous array
+// sorted by (section, key). Point lookups go through an open-addressed hash
+// of that array; neither allocates. Redeclared sections and repeated keys
+// resolve the way WSLConfigManager always has: the last declaration wins.
+class ConfigStore {
+public:
+    // nullptr if the file cannot be opened.
+    static std::shared_ptr<const ConfigStore> Open(const std::string& path);
+
+    // Same index over text the store takes ownership of.
+    static std::shared_ptr<const ConfigStore> FromText(std::string text);
+
+    // Non-copyable, non-movable
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+    ConfigStore(ConfigStore&&) = delete;
+    ConfigStore& operator=(ConfigStore&&) = delete;
+
+    // nullptr when the key is not set. The value lives as long as the store.
+    const std::string_view* Find(std::string_view section, std::string_view key) const;
+
+    // Empty when the key is not set.
+    std::string_view GetValue(std::string_view section, std::string_view key) const;
+
+    // All entries of one section, in key order.
+    std::span<const ConfigEntry> Section(std::string_view section) const;
+
+    std::span<const ConfigEntry> Entries() const { return entries_; }
+    const std::vector<IniError>& Errors() const { return errors_; }
+    std::string_view Text() const { return text_; }
+
+private:
+    ConfigStore() = default;
+
+    void BuildIndex();
+    void BuildHash();
+
+    MappedFile mapping_;
+    std::string owned_;
+    std::string_view text_;
+    std::vector<ConfigEntry> entries_;
+    std::vector<uint32_t> slots_; // entry index + 1, 0 = empty
+    std::vector<IniError> errors_;
+};
+
+} // namespace WSL
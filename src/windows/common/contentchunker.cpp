@@ -0,0 +1,112 @@
+#include "contentchunker.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+
+namespace WSL {
+
+namespace {
+
+// One random value per byte, fixed so that boundaries are the same in every
+// build: a store written by one version must dedupe against the next.
+constexpr std::array<uint64_t, 256> MakeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x5753'4C43'4443'0001; // splitmix64
+    for (auto& value : table) {
+        state += 0x9E37'79B9'7F4A'7C15;
+        uint64_t mixed = state;
+        mixed = (mixed ^ (mixed >> 30)) * 0xBF58'476D'1CE4'E5B9;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94D0'49BB'1331'11EB;
+        value = mixed ^ (mixed >> 31);
+    }
+    return table;
+}
+
+constexpr std::array<uint64_t, 256> Gear = MakeGearTable();
+
+// The hash shifts left a bit per byte, so its high bits cover the most
+// bytes; masks are taken from the top.
+constexpr uint64_t HighBits(int count) {
+    return ~uint64_t{0} << (64 - count);
+}
+
+} // namespace
+
+ContentChunker::ContentChunker(Callback callback, ChunkerOptions options)
+    : callback_(std::move(callback)), options_(options) {
+    if (options_.minSize == 0 || options_.minSize > options_.averageSize ||
+        options_.averageSize > options_.maxSize || !std::has_single_bit(options_.averageSize)) {
+        throw std::invalid_argument("Chunk sizes must satisfy min <= average <= max, with a power-of-two average");
+    }
+
+    // Two bits either side of the average, as FastCDC recommends.
+    const int bits = std::countr_zero(options_.averageSize);
+    smallMask_ = HighBits(std::min(bits + 2, 63));
+    largeMask_ = HighBits(std::max(bits - 2, 1));
+}
+
+void ContentChunker::Write(const char* data, size_t size) {
+    buffer_.append(data, size);
+    Cut(false);
+}
+
+void ContentChunker::Finish() {
+    Cut(true);
+}
+
+size_t ContentChunker::NextBoundary(const char* data, size_t size) {
+    // Nothing below the minimum is hashed; the hash only covers 64 bytes,
+    // so where it starts does not change where it finds boundaries.
+    size_t i = std::max(scanned_, options_.minSize);
+    const size_t normalEnd = std::min(options_.averageSize, size);
+    const size_t end = std::min(options_.maxSize, size);
+    uint64_t hash = hash_;
+
+    for (; i < normalEnd; ++i) {
+        hash = (hash << 1) + Gear[static_cast<unsigned char>(data[i])];
+        if ((hash & smallMask_) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < end; ++i) {
+        hash = (hash << 1) + Gear[static_cast<unsigned char>(data[i])];
+        if ((hash & largeMask_) == 0) {
+            return i + 1;
+        }
+    }
+
+    if (end == options_.maxSize) {
+        return end;
+    }
+    scanned_ = std::max(i, scanned_);
+    hash_ = hash;
+    return 0;
+}
+
+void ContentChunker::Cut(bool final) {
+    for (;;) {
+        const size_t available = buffer_.size() - start_;
+        size_t length = NextBoundary(buffer_.data() + start_, available);
+        if (length == 0) {
+            if (!final || available == 0) {
+                break;
+            }
+            length = available;
+        }
+        callback_(buffer_.data() + start_, length);
+        start_ += length;
+        scanned_ = 0;
+        hash_ = 0;
+    }
+
+    // Reclaim consumed bytes once they are the bulk of the buffer, so the
+    // copy is amortised over at least as many bytes as it moves.
+    if (start_ > 0 && start_ * 2 >= buffer_.size()) {
+        buffer_.erase(0, start_);
+        start_ = 0;
+    }
+}
+
+} // namespace WSL
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "bytestream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace WSL {
+
+struct ChunkerOptions {
+    // No boundary is looked for before minSize, and one is forced at
+    // maxSize; chunks average roughly averageSize, which must be a power of
+    // two.
+    size_t minSize = 16 * 1024;
+    size_t averageSize = 64 * 1024;
+    size_t maxSize = 256 * 1024;
+};
+
+// Splits a stream where its content says to rather than at fixed offsets,
+// so an insertion or deletion only changes the chunks around it and the
+// rest of the stream chunks as it did before. Boundaries come from a gear
+// rolling hash over the last 64 bytes, with a stricter mask below the
+// average size and a looser one above it to keep sizes close to the
+// average (FastCDC's normalized chunking).
+class ContentChunker : public ByteSink {
+public:
+    // Receives each chunk in order; the data is only valid for the call.
+    using Callback = std::function<void(const char* data, size_t size)>;
+
+    // Throws std::invalid_argument for sizes that are out of order or an
+    // average that is not a power of two.
+    explicit ContentChunker(Callback callback, ChunkerOptions options = {});
+
+    void Write(const char* data, size_t size) override;
+
+    // Emits what is left as the last chunk.
+    void Finish() override;
+
+private:
+    // Length of the next chunk at the front of the buffer, or 0 until more
+    // data arrives.
+    size_t NextBoundary(const char* data, size_t size);
+    void Cut(bool final);
+
+    Callback callback_;
+    ChunkerOptions options_;
+    uint64_t smallMask_;
+    uint64_t largeMask_;
+
+    std::string buffer_;
+    size_t start_ = 0;   // first byte of the current chunk in buffer_
+    size_t scanned_ = 0; // bytes of the current chunk already hashed
+    uint64_t hash_ = 0;
+};
+
+} // namespace WSL
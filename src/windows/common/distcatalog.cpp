@@ -0,0 +1,280 @@
+#include "distcatalog.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+#ifdef _WIN32
+
+const wchar_t* const LxssKey = L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss";
+
+std::wstring ReadString(HKEY key, const wchar_t* value) {
+    DWORD size = 0;
+    if (RegGetValueW(key, nullptr, value, RRF_RT_REG_SZ, nullptr, nullptr, &size) != ERROR_SUCCESS || size == 0) {
+        return {};
+    }
+
+    std::wstring text(size / sizeof(wchar_t), L'\0');
+    if (RegGetValueW(key, nullptr, value, RRF_RT_REG_SZ, nullptr, text.data(), &size) != ERROR_SUCCESS) {
+        return {};
+    }
+    text.resize(wcsnlen(text.c_str(), text.size()));
+    return text;
+}
+
+class RegistryDistributionBackend : public DistributionBackend {
+public:
+    RegistryDistributionBackend() {
+        event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!event_) {
+            throw std::runtime_error("Failed to create distribution change event: " + std::to_string(GetLastError()));
+        }
+    }
+
+    ~RegistryDistributionBackend() override {
+        if (key_) {
+            RegCloseKey(key_);
+        }
+        CloseHandle(event_);
+    }
+
+    bool Enumerate(DistributionList& list) override {
+        WSL_TRACE_SPAN("RegistryScan");
+        if (!key_ && RegOpenKeyExW(HKEY_CURRENT_USER, LxssKey, 0, KEY_READ | KEY_NOTIFY, &key_) != ERROR_SUCCESS) {
+            key_ = nullptr;
+            return false;
+        }
+
+        // Arm before reading so a change made mid-enumeration is not lost.
+        // Thread-agnostic, so the registration outlives the calling thread.
+        ResetEvent(event_);
+        armed_ = RegNotifyChangeKeyValue(key_, TRUE,
+                                         REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET |
+                                             REG_NOTIFY_THREAD_AGNOSTIC,
+                                         event_, TRUE) == ERROR_SUCCESS;
+
+        list.defaultId = ReadString(key_, L"DefaultDistribution");
+
+        DWORD subKeys = 0;
+        RegQueryInfoKeyW(key_, nullptr, nullptr, nullptr, &subKeys, nullptr, nullptr, nullptr, nullptr, nullptr,
+                         nullptr, nullptr);
+        list.distributions.reserve(subKeys);
+
+        wchar_t subKeyName[256];
+        for (DWORD index = 0;; ++index) {
+            DWORD subKeyNameSize = ARRAYSIZE(subKeyName);
+            if (RegEnumKeyExW(key_, index, subKeyName, &subKeyNameSize, nullptr, nullptr, nullptr, nullptr) !=
+                ERROR_SUCCESS) {
+                break;
+            }
+
+            HKEY subKey = nullptr;
+            if (RegOpenKeyExW(key_, subKeyName, 0, KEY_READ, &subKey) != ERROR_SUCCESS) {
+                continue;
+            }
+
+            Distribution distribution;
+            distribution.id = subKeyName;
+            distribution.name = ReadString(subKey, L"DistributionName");
+            distribution.basePath = ReadString(subKey, L"BasePath");
+
+            DWORD version = 0;
+            DWORD size = sizeof(version);
+            if (RegGetValueW(subKey, nullptr, L"Version", RRF_RT_REG_DWORD, nullptr, &version, &size) ==
+                ERROR_SUCCESS) {
+                distribution.version = version;
+            }
+            RegCloseKey(subKey);
+
+            if (!distribution.name.empty()) {
+                list.distributions.push_back(std::move(distribution));
+            }
+        }
+
+        return true;
+    }
+
+    bool Changed() override {
+        return !key_ || !armed_ || WaitForSingleObject(event_, 0) == WAIT_OBJECT_0;
+    }
+
+    // The latest last write time of the Lxss key and its subkeys. The key's
+    // own moves when distributions are registered or removed or the default
+    // changes; a subkey's when a distribution is renamed or moved. The
+    // times come with the subkey names, so no subkey is opened.
+    std::optional<uint64_t> Stamp() override {
+        if (!key_ && RegOpenKeyExW(HKEY_CURRENT_USER, LxssKey, 0, KEY_READ | KEY_NOTIFY, &key_) != ERROR_SUCCESS) {
+            key_ = nullptr;
+            return std::nullopt;
+        }
+
+        FILETIME written{};
+        if (RegQueryInfoKeyW(key_, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+                             nullptr, &written) != ERROR_SUCCESS) {
+            return std::nullopt;
+        }
+        uint64_t stamp = ToStamp(written);
+
+        wchar_t subKeyName[256];
+        for (DWORD index = 0;; ++index) {
+            DWORD subKeyNameSize = ARRAYSIZE(subKeyName);
+            const LSTATUS status =
+                RegEnumKeyExW(key_, index, subKeyName, &subKeyNameSize, nullptr, nullptr, nullptr, &written);
+            if (status == ERROR_NO_MORE_ITEMS) {
+                break;
+            }
+            if (status != ERROR_SUCCESS) {
+                return std::nullopt;
+            }
+            stamp = std::max(stamp, ToStamp(written));
+        }
+        return stamp;
+    }
+
+private:
+    static uint64_t ToStamp(const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    }
+
+    HKEY key_ = nullptr;
+    HANDLE event_ = nullptr;
+    bool armed_ = false;
+};
+
+#endif
+
+} // namespace
+
+CatalogSnapshot::CatalogSnapshot(DistributionList list)
+    : list_(std::move(list)) {
+    byName_.reserve(list_.distributions.size());
+    byId_.reserve(list_.distributions.size());
+
+    // emplace keeps the first of any duplicates, as the old linear scans did.
+    for (uint32_t i = 0; i < list_.distributions.size(); ++i) {
+        const Distribution& distribution = list_.distributions[i];
+        byName_.emplace(distribution.name, i);
+        byId_.emplace(NormalizeId(distribution.id), i);
+    }
+}
+
+std::wstring CatalogSnapshot::NormalizeId(std::wstring_view id) {
+    if (id.size() >= 2 && id.front() == L'{' && id.back() == L'}') {
+        id = id.substr(1, id.size() - 2);
+    }
+
+    std::wstring normalized(id);
+    for (wchar_t& c : normalized) {
+        if (c >= L'A' && c <= L'Z') {
+            c = static_cast<wchar_t>(c - L'A' + L'a');
+        }
+    }
+    return normalized;
+}
+
+const Distribution* CatalogSnapshot::FindByName(std::wstring_view name) const {
+    auto found = byName_.find(name);
+    return found == byName_.end() ? nullptr : &list_.distributions[found->second];
+}
+
+const Distribution* CatalogSnapshot::FindById(std::wstring_view id) const {
+    auto found = byId_.find(NormalizeId(id));
+    return found == byId_.end() ? nullptr : &list_.distributions[found->second];
+}
+
+const Distribution* CatalogSnapshot::Default() const {
+    return list_.defaultId.empty() ? nullptr : FindById(list_.defaultId);
+}
+
+class DistributionCatalog::Impl {
+private:
+    std::unique_ptr<DistributionBackend> backend_;
+    std::mutex lock_;
+    std::shared_ptr<const CatalogSnapshot> current_;
+    bool invalidated_ = true;
+    uint64_t enumerations_ = 0;
+
+public:
+    explicit Impl(std::unique_ptr<DistributionBackend> backend)
+        : backend_(std::move(backend)) {
+        if (!backend_) {
+            throw std::invalid_argument("Distribution catalog needs a backend");
+        }
+    }
+
+    std::shared_ptr<const CatalogSnapshot> Snapshot() {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (invalidated_ || backend_->Changed()) {
+            DistributionList list;
+            if (!backend_->Enumerate(list)) {
+                list = {};
+            }
+            current_ = std::make_shared<const CatalogSnapshot>(std::move(list));
+            invalidated_ = false;
+            ++enumerations_;
+        }
+        return current_;
+    }
+
+    void Invalidate() {
+        std::lock_guard<std::mutex> guard(lock_);
+        invalidated_ = true;
+    }
+
+    std::optional<uint64_t> Stamp() {
+        std::lock_guard<std::mutex> guard(lock_);
+        return backend_->Stamp();
+    }
+
+    uint64_t GetEnumerationCount() {
+        std::lock_guard<std::mutex> guard(lock_);
+        return enumerations_;
+    }
+};
+
+DistributionCatalog::DistributionCatalog(std::unique_ptr<DistributionBackend> backend)
+    : pImpl_(std::make_unique<Impl>(std::move(backend))) {
+}
+
+DistributionCatalog::~DistributionCatalog() = default;
+
+#ifdef _WIN32
+
+DistributionCatalog& DistributionCatalog::Default() {
+    static DistributionCatalog catalog(CreateRegistryDistributionBackend());
+    return catalog;
+}
+
+std::unique_ptr<DistributionBackend> CreateRegistryDistributionBackend() {
+    return std::make_unique<RegistryDistributionBackend>();
+}
+
+#endif
+
+std::shared_ptr<const CatalogSnapshot> DistributionCatalog::Snapshot() {
+    return pImpl_->Snapshot();
+}
+
+void DistributionCatalog::Invalidate() {
+    pImpl_->Invalidate();
+}
+
+std::optional<uint64_t> DistributionCatalog::Stamp() {
+    return pImpl_->Stamp();
+}
+
+uint64_t DistributionCatalog::GetEnumerationCount() const {
+    return pImpl_->GetEnumerationCount();
+}
+
+} // namespace WSL
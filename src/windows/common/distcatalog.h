@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace WSL {
+
+struct Distribution {
+    std::wstring id; // "{GUID}", the Lxss subkey name
+    std::wstring name;
+    std::wstring basePath;
+    uint32_t version = 0;
+};
+
+struct DistributionList {
+    std::vector<Distribution> distributions; // enumeration order
+    std::wstring defaultId;
+};
+
+// Where distributions are registered. The registry on Windows; tests use an
+// in-memory stand-in.
+class DistributionBackend {
+public:
+    virtual ~DistributionBackend() = default;
+
+    // Reads every distribution and the default in one pass. Returns false if
+    // the store cannot be opened; the list is then left empty.
+    virtual bool Enumerate(DistributionList& list) = 0;
+
+    // True if the store may have changed since the last Enumerate(). Called
+    // on every catalog access, so it must not enumerate.
+    virtual bool Changed() = 0;
+
+    // A value that changes whenever the store does, readable without
+    // enumerating; persistent caches compare it to decide they are stale.
+    // std::nullopt if the store has no such value.
+    virtual std::optional<uint64_t> Stamp() { return std::nullopt; }
+};
+
+// One enumeration, indexed by name and by id. Immutable once built.
+class CatalogSnapshot {
+public:
+    explicit CatalogSnapshot(DistributionList list);
+
+    // Non-copyable, non-movable; the indexes point into the list.
+    CatalogSnapshot(const CatalogSnapshot&) = delete;
+    CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+    CatalogSnapshot(CatalogSnapshot&&) = delete;
+    CatalogSnapshot& operator=(CatalogSnapshot&&) = delete;
+
+    std::span<const Distribution> All() const { return list_.distributions; }
+
+    // Exact match, as distribution names are registered.
+    const Distribution* FindByName(std::wstring_view name) const;
+
+    // Case-insensitive; the braces are optional.
+    const Distribution* FindById(std::wstring_view id) const;
+
+    // nullptr if no default is set or it names a missing distribution.
+    const Distribution* Default() const;
+
+private:
+    static std::wstring NormalizeId(std::wstring_view id);
+
+    DistributionList list_;
+    std::unordered_map<std::wstring_view, uint32_t> byName_;
+    std::unordered_map<std::wstring, uint32_t> byId_;
+};
+
+// Enumerates the backend once and serves lookups from the snapshot until
+// the backend reports a change.
+class DistributionCatalog {
+public:
+    explicit DistributionCatalog(std::unique_ptr<DistributionBackend> backend);
+    ~DistributionCatalog();
+
+    // Non-copyable, non-movable
+    DistributionCatalog(const DistributionCatalog&) = delete;
+    DistributionCatalog& operator=(const DistributionCatalog&) = delete;
+    DistributionCatalog(DistributionCatalog&&) = delete;
+    DistributionCatalog& operator=(DistributionCatalog&&) = delete;
+
+#ifdef _WIN32
+    // The current user's Lxss registry key, shared by the whole process.
+    static DistributionCatalog& Default();
+#endif
+
+    // Current snapshot; re-enumerates first if the backend changed.
+    std::shared_ptr<const CatalogSnapshot> Snapshot();
+
+    // Forces the next Snapshot() to re-enumerate, e.g. after this process
+    // registered or removed a distribution.
+    void Invalidate();
+
+    // The backend's Stamp(); never enumerates.
+    std::optional<uint64_t> Stamp();
+
+    uint64_t GetEnumerationCount() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+#ifdef _WIN32
+// HKCU\SOFTWARE\Microsoft\Windows\CurrentVersion\Lxss, invalidated through
+// RegNotifyChangeKeyValue rather than by re-reading it.
+std::unique_ptr<DistributionBackend> CreateRegistryDistributionBackend();
+#endif
+
+} // namespace WSL
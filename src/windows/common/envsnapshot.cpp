@@ -0,0 +1,474 @@
+#include "envsnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+constexpr uint64_t FnvOffset = 14695981039346656037ull;
+constexpr uint64_t FnvPrime = 1099511628211ull;
+
+// FNV-1a over 64-bit words in four independent lanes, which keeps the
+// multiplies from serialising; a block with a long PATH is tens of KB.
+uint64_t Fnv(uint64_t hash, const char* data, size_t size) {
+    uint64_t lanes[4] = {hash, hash ^ 1, hash ^ 2, hash ^ 3};
+    size_t i = 0;
+    for (; i + 4 * sizeof(uint64_t) <= size; i += 4 * sizeof(uint64_t)) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, data + i + lane * sizeof(uint64_t), sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * FnvPrime;
+        }
+    }
+    for (int lane = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t), ++lane) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        lanes[lane] = (lanes[lane] ^ word) * FnvPrime;
+    }
+
+    // Folded in one after another: lanes that changed alike must not cancel.
+    for (int lane = 0; lane < 4; ++lane) {
+        hash = (hash ^ lanes[lane]) * FnvPrime;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * FnvPrime;
+    }
+    return hash;
+}
+
+wchar_t Lower(wchar_t c) {
+    return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c - L'A' + L'a') : c;
+}
+
+bool EqualsIgnoreCase(std::wstring_view left, std::wstring_view right) {
+    return left.size() == right.size() &&
+           std::equal(left.begin(), left.end(), right.begin(), [](wchar_t a, wchar_t b) { return Lower(a) == Lower(b); });
+}
+
+std::pair<std::wstring_view, std::wstring_view> Split(std::wstring_view entry) {
+    // Search from 1 so a leading '=' stays part of the (hidden) name.
+    const auto equals = entry.find(L'=', 1);
+    if (equals == std::wstring_view::npos) {
+        return {entry, {}};
+    }
+    return {entry.substr(0, equals), entry.substr(equals + 1)};
+}
+
+} // namespace
+
+EnvironmentSnapshot::Builder::Builder(size_t characters, size_t entries) {
+    arena_.reserve(characters);
+    index_.reserve(entries);
+}
+
+void EnvironmentSnapshot::Builder::Add(std::wstring_view name, std::wstring_view value) {
+    if (name.empty() || name.front() == L'=') {
+        return;
+    }
+    if (arena_.size() + name.size() + value.size() + 2 > UINT32_MAX) {
+        throw std::length_error("Environment block is too large");
+    }
+
+    index_.push_back({static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(name.size()),
+                      static_cast<uint32_t>(value.size())});
+    arena_.append(name);
+    arena_ += L'=';
+    arena_.append(value);
+    arena_ += L'\0';
+}
+
+void EnvironmentSnapshot::Builder::Add(std::wstring_view entry) {
+    auto [name, value] = Split(entry);
+    Add(name, value);
+}
+
+EnvironmentSnapshot EnvironmentSnapshot::Builder::Finish() {
+    EnvironmentSnapshot snapshot;
+    snapshot.arena_ = std::move(arena_);
+    snapshot.index_ = std::move(index_);
+
+    // GetEnvironmentStringsW() already returns the block sorted, so the
+    // common case is one comparison per entry.
+    const EnvironmentSnapshot& view = snapshot;
+    auto byName = [&view](const Slot& left, const Slot& right) { return view.Name(left) < view.Name(right); };
+    if (!std::is_sorted(snapshot.index_.begin(), snapshot.index_.end(), byName)) {
+        std::stable_sort(snapshot.index_.begin(), snapshot.index_.end(), byName);
+    }
+    snapshot.index_.erase(std::unique(snapshot.index_.begin(), snapshot.index_.end(),
+                                      [&view](const Slot& left, const Slot& right) {
+                                          return view.Name(left) == view.Name(right);
+                                      }),
+                          snapshot.index_.end());
+
+    uint64_t hash = FnvOffset;
+    for (const Slot& slot : snapshot.index_) {
+        const char* entry = reinterpret_cast<const char*>(snapshot.arena_.data() + slot.offset);
+        hash = Fnv(hash, entry, (slot.nameLength + slot.valueLength + 2) * sizeof(wchar_t));
+    }
+    snapshot.hash_ = hash;
+    return snapshot;
+}
+
+EnvironmentSnapshot EnvironmentSnapshot::FromBlock(const wchar_t* block) {
+    if (!block) {
+        return {};
+    }
+
+    // The block already has the arena's layout, so it is copied whole and
+    // only indexed here.
+    size_t characters = 0;
+    size_t entries = 0;
+    while (block[characters]) {
+        characters += wcslen(block + characters) + 1;
+        ++entries;
+    }
+    if (characters > UINT32_MAX) {
+        throw std::length_error("Environment block is too large");
+    }
+
+    Builder builder;
+    builder.arena_.assign(block, characters);
+    builder.index_.reserve(entries);
+    for (size_t offset = 0; offset < characters;) {
+        const std::wstring_view entry(builder.arena_.data() + offset);
+        auto [name, value] = Split(entry);
+        if (name.size() < entry.size() && name.front() != L'=') {
+            builder.index_.push_back({static_cast<uint32_t>(offset), static_cast<uint32_t>(name.size()),
+                                      static_cast<uint32_t>(value.size())});
+        }
+        offset += entry.size() + 1;
+    }
+    return builder.Finish();
+}
+
+EnvironmentSnapshot EnvironmentSnapshot::FromStrings(std::initializer_list<std::wstring_view> entries) {
+    size_t characters = 0;
+    for (std::wstring_view entry : entries) {
+        characters += entry.size() + 1;
+    }
+
+    Builder builder(characters, entries.size());
+    for (std::wstring_view entry : entries) {
+        builder.Add(entry);
+    }
+    return builder.Finish();
+}
+
+EnvironmentSnapshot EnvironmentSnapshot::FromStrings(const std::vector<std::wstring>& entries) {
+    size_t characters = 0;
+    for (const std::wstring& entry : entries) {
+        characters += entry.size() + 1;
+    }
+
+    Builder builder(characters, entries.size());
+    for (const std::wstring& entry : entries) {
+        builder.Add(entry);
+    }
+    return builder.Finish();
+}
+
+#ifdef _WIN32
+
+EnvironmentSnapshot EnvironmentSnapshot::Capture() {
+    wchar_t* block = GetEnvironmentStringsW();
+    if (!block) {
+        return {};
+    }
+    EnvironmentSnapshot snapshot = FromBlock(block);
+    FreeEnvironmentStringsW(block);
+    return snapshot;
+}
+
+std::shared_ptr<const EnvironmentSnapshot> CaptureLinuxEnvironment() {
+    static std::mutex lock;
+    static uint64_t capturedHash = 0;
+    static std::shared_ptr<const EnvironmentSnapshot> translated;
+
+    const EnvironmentSnapshot windows = EnvironmentSnapshot::Capture();
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (!translated || windows.Hash() != capturedHash) {
+        const auto wslenv = windows.Find(L"WSLENV");
+        translated = std::make_shared<const EnvironmentSnapshot>(
+            EnvironmentFilter::FromWslEnv(wslenv.value_or(std::wstring_view{})).Apply(windows));
+        capturedHash = windows.Hash();
+    }
+    return translated;
+}
+
+#endif
+
+EnvironmentVariable EnvironmentSnapshot::operator[](size_t i) const {
+    const Slot& slot = index_[i];
+    const wchar_t* entry = arena_.data() + slot.offset;
+    return {{entry, slot.nameLength}, {entry + slot.nameLength + 1, slot.valueLength}};
+}
+
+std::optional<std::wstring_view> EnvironmentSnapshot::Find(std::wstring_view name) const {
+    auto found = std::lower_bound(index_.begin(), index_.end(), name,
+                                  [this](const Slot& slot, std::wstring_view key) { return Name(slot) < key; });
+    if (found == index_.end() || Name(*found) != name) {
+        return std::nullopt;
+    }
+    return (*this)[static_cast<size_t>(found - index_.begin())].value;
+}
+
+std::wstring TranslateWindowsPath(std::wstring_view path) {
+    std::wstring translated;
+    const bool driveAbsolute = path.size() >= 3 && ((path[0] >= L'A' && path[0] <= L'Z') ||
+                                                    (path[0] >= L'a' && path[0] <= L'z')) &&
+                               path[1] == L':' && (path[2] == L'\\' || path[2] == L'/');
+    if (driveAbsolute) {
+        translated = L"/mnt/";
+        translated += Lower(path[0]);
+        path.remove_prefix(2);
+    }
+
+    translated.reserve(translated.size() + path.size());
+    for (wchar_t c : path) {
+        translated += c == L'\\' ? L'/' : c;
+    }
+    // "C:\" -> "/mnt/c", not "/mnt/c/".
+    if (driveAbsolute && translated.size() > 6 && translated.back() == L'/') {
+        translated.pop_back();
+    }
+    return translated;
+}
+
+EnvironmentFilter EnvironmentFilter::FromWslEnv(std::wstring_view wslenv) {
+    EnvironmentFilter filter;
+    while (!wslenv.empty()) {
+        const auto colon = wslenv.find(L':');
+        std::wstring_view item = wslenv.substr(0, colon);
+        wslenv = colon == std::wstring_view::npos ? std::wstring_view{} : wslenv.substr(colon + 1);
+
+        const auto slash = item.find(L'/');
+        Rule rule{std::wstring(item.substr(0, slash)), 0};
+        if (rule.name.empty()) {
+            continue;
+        }
+        if (slash != std::wstring_view::npos) {
+            for (wchar_t flag : item.substr(slash + 1)) {
+                switch (flag) {
+                case L'p': rule.flags |= WslEnvPath; break;
+                case L'l': rule.flags |= WslEnvPathList; break;
+                case L'u': rule.flags |= WslEnvToLinuxOnly; break;
+                case L'w': rule.flags |= WslEnvToWindowsOnly; break;
+                default: break;
+                }
+            }
+        }
+        filter.rules_.push_back(std::move(rule));
+    }
+    return filter;
+}
+
+void EnvironmentFilter::Allow(std::wstring pattern) {
+    allow_.push_back(std::move(pattern));
+}
+
+void EnvironmentFilter::Deny(std::wstring pattern) {
+    deny_.push_back(std::move(pattern));
+}
+
+bool EnvironmentFilter::Matches(const std::wstring& pattern, std::wstring_view name) {
+    if (!pattern.empty() && pattern.back() == L'*') {
+        const std::wstring_view prefix(pattern.data(), pattern.size() - 1);
+        return name.size() >= prefix.size() && EqualsIgnoreCase(name.substr(0, prefix.size()), prefix);
+    }
+    return EqualsIgnoreCase(pattern, name);
+}
+
+const EnvironmentFilter::Rule* EnvironmentFilter::FindRule(std::wstring_view name) const {
+    for (const Rule& rule : rules_) {
+        if (EqualsIgnoreCase(rule.name, name)) {
+            return &rule;
+        }
+    }
+    return nullptr;
+}
+
+EnvironmentSnapshot EnvironmentFilter::Apply(const EnvironmentSnapshot& windows) const {
+    auto matchesAny = [](const std::vector<std::wstring>& patterns, std::wstring_view name) {
+        return std::any_of(patterns.begin(), patterns.end(),
+                           [name](const std::wstring& pattern) { return Matches(pattern, name); });
+    };
+
+    EnvironmentSnapshot::Builder builder(windows.Characters(), windows.Size());
+    std::wstring translated;
+    for (size_t i = 0; i < windows.Size(); ++i) {
+        const EnvironmentVariable variable = windows[i];
+        if (matchesAny(deny_, variable.name)) {
+            continue;
+        }
+
+        const Rule* rule = FindRule(variable.name);
+        if (rule && (rule->flags & WslEnvToWindowsOnly)) {
+            continue;
+        }
+        if (strict_ && !rule && !EqualsIgnoreCase(variable.name, L"WSLENV") && !matchesAny(allow_, variable.name)) {
+            continue;
+        }
+
+        if (rule && (rule->flags & WslEnvPathList)) {
+            translated.clear();
+            std::wstring_view list = variable.value;
+            while (true) {
+                const auto separator = list.find(L';');
+                if (!translated.empty()) {
+                    translated += L':';
+                }
+                translated += TranslateWindowsPath(list.substr(0, separator));
+                if (separator == std::wstring_view::npos) {
+                    break;
+                }
+                list.remove_prefix(separator + 1);
+            }
+            builder.Add(variable.name, translated);
+        }
+        else if (rule && (rule->flags & WslEnvPath)) {
+            builder.Add(variable.name, TranslateWindowsPath(variable.value));
+        }
+        else {
+            builder.Add(variable.name, variable.value);
+        }
+    }
+    return builder.Finish();
+}
+
+size_t EnvironmentDelta::Characters() const {
+    size_t characters = 0;
+    for (const auto& entry : set) {
+        characters += entry.size() + 1;
+    }
+    for (const auto& name : removed) {
+        characters += name.size() + 1;
+    }
+    return characters;
+}
+
+EnvironmentDelta DiffEnvironment(const EnvironmentSnapshot& base, const EnvironmentSnapshot& target) {
+    EnvironmentDelta delta;
+    delta.baseHash = base.Hash();
+    delta.targetHash = target.Hash();
+    if (delta.baseHash == delta.targetHash) {
+        return delta;
+    }
+
+    // Both are sorted by name, so one merge pass finds every difference.
+    size_t i = 0;
+    size_t j = 0;
+    while (i < base.Size() || j < target.Size()) {
+        if (j == target.Size() || (i < base.Size() && base[i].name < target[j].name)) {
+            delta.removed.emplace_back(base[i].name);
+            ++i;
+        }
+        else if (i == base.Size() || target[j].name < base[i].name) {
+            delta.set.emplace_back(target.Entry(j));
+            ++j;
+        }
+        else {
+            if (base[i].value != target[j].value) {
+                delta.set.emplace_back(target.Entry(j));
+            }
+            ++i;
+            ++j;
+        }
+    }
+    return delta;
+}
+
+std::optional<EnvironmentSnapshot> ApplyEnvironmentDelta(const EnvironmentSnapshot& base,
+                                                         const EnvironmentDelta& delta) {
+    if (base.Hash() != delta.baseHash) {
+        return std::nullopt;
+    }
+
+    // The delta's lists are in name order, as DiffEnvironment produced them.
+    EnvironmentSnapshot::Builder builder(base.Characters() + delta.Characters(), base.Size() + delta.set.size());
+    size_t removed = 0;
+    size_t set = 0;
+    for (size_t i = 0; i < base.Size(); ++i) {
+        const EnvironmentVariable variable = base[i];
+        while (set < delta.set.size() && Split(delta.set[set]).first < variable.name) {
+            builder.Add(delta.set[set++]);
+        }
+        if (set < delta.set.size() && Split(delta.set[set]).first == variable.name) {
+            builder.Add(delta.set[set++]);
+            continue;
+        }
+        if (removed < delta.removed.size() && delta.removed[removed] == variable.name) {
+            ++removed;
+            continue;
+        }
+        builder.Add(variable.name, variable.value);
+    }
+    while (set < delta.set.size()) {
+        builder.Add(delta.set[set++]);
+    }
+
+    EnvironmentSnapshot result = builder.Finish();
+    if (result.Hash() != delta.targetHash) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+size_t EnvironmentMessage::Characters() const {
+    if (full) {
+        return full->Characters();
+    }
+    return delta ? delta->Characters() : 0;
+}
+
+EnvironmentMessage EnvironmentEncoder::Encode(const std::shared_ptr<const EnvironmentSnapshot>& environment) const {
+    EnvironmentMessage message;
+    if (baseline_) {
+        EnvironmentDelta delta = DiffEnvironment(*baseline_, *environment);
+        // Past half the block, resending it in full is cheaper for both
+        // sides and gives the service a closer baseline.
+        if (delta.Characters() * 2 < environment->Characters()) {
+            message.delta = std::move(delta);
+            return message;
+        }
+    }
+    message.full = environment;
+    return message;
+}
+
+void EnvironmentEncoder::Acknowledge(const std::shared_ptr<const EnvironmentSnapshot>& environment) {
+    baseline_ = environment;
+}
+
+void EnvironmentEncoder::Reset() {
+    baseline_.reset();
+}
+
+std::shared_ptr<const EnvironmentSnapshot> EnvironmentBaseline::Receive(const EnvironmentMessage& message) {
+    if (message.full) {
+        baseline_ = message.full;
+        return baseline_;
+    }
+    if (!message.delta || !baseline_ || baseline_->Hash() != message.delta->baseHash) {
+        return nullptr;
+    }
+    if (message.delta->targetHash == message.delta->baseHash) {
+        return baseline_;
+    }
+
+    auto applied = ApplyEnvironmentDelta(*baseline_, *message.delta);
+    if (!applied) {
+        return nullptr;
+    }
+    return std::make_shared<const EnvironmentSnapshot>(std::move(*applied));
+}
+
+} // namespace WSL
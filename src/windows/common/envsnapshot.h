@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+struct EnvironmentVariable {
+    std::wstring_view name;
+    std::wstring_view value;
+};
+
+// An environment block held as one buffer of NUL-terminated "NAME=value"
+// entries plus an index sorted by name, so building one costs two
+// allocations however many variables there are. Entries with an empty name,
+// such as cmd's hidden "=C:" drive directories, are dropped; of duplicate
+// names the first is kept. Immutable once built; share it by pointer.
+class EnvironmentSnapshot {
+public:
+    EnvironmentSnapshot() = default;
+
+    // A GetEnvironmentStringsW()-style block: entries back to back, each
+    // NUL-terminated, ending with an empty entry.
+    static EnvironmentSnapshot FromBlock(const wchar_t* block);
+    static EnvironmentSnapshot FromStrings(std::initializer_list<std::wstring_view> entries);
+    static EnvironmentSnapshot FromStrings(const std::vector<std::wstring>& entries);
+
+#ifdef _WIN32
+    // The calling process' environment.
+    static EnvironmentSnapshot Capture();
+#endif
+
+    size_t Size() const { return index_.size(); }
+    bool Empty() const { return index_.empty(); }
+
+    // Sorted by name, ordinal.
+    EnvironmentVariable operator[](size_t i) const;
+
+    // "NAME=value", NUL-terminated, valid as long as the snapshot is.
+    const wchar_t* Entry(size_t i) const { return arena_.data() + index_[i].offset; }
+
+    std::optional<std::wstring_view> Find(std::wstring_view name) const;
+
+    // Of the sorted contents; equal snapshots hash equal.
+    uint64_t Hash() const { return hash_; }
+
+    // Characters in the arena, terminators included: what marshalling the
+    // whole block costs.
+    size_t Characters() const { return arena_.size(); }
+
+private:
+    struct Slot {
+        uint32_t offset;
+        uint32_t nameLength;
+        uint32_t valueLength;
+    };
+
+public:
+    // Collects entries, then sorts and hashes once.
+    class Builder {
+    public:
+        explicit Builder(size_t characters = 0, size_t entries = 0);
+        void Add(std::wstring_view name, std::wstring_view value);
+        void Add(std::wstring_view entry); // "NAME=value"
+        EnvironmentSnapshot Finish();
+
+    private:
+        friend class EnvironmentSnapshot;
+
+        std::wstring arena_;
+        std::vector<Slot> index_;
+    };
+
+private:
+    std::wstring_view Name(const Slot& slot) const { return {arena_.data() + slot.offset, slot.nameLength}; }
+
+    std::wstring arena_;
+    std::vector<Slot> index_;
+    uint64_t hash_ = 0;
+};
+
+enum WslEnvFlags : uint8_t {
+    WslEnvPath = 1,          // /p: translate a Windows path
+    WslEnvPathList = 2,      // /l: translate a ';' separated list of paths
+    WslEnvToLinuxOnly = 4,   // /u: only when going Windows -> Linux
+    WslEnvToWindowsOnly = 8  // /w: only when going Linux -> Windows
+};
+
+// "C:\Users\me" -> "/mnt/c/Users/me". Anything that is not a drive-absolute
+// path only has its separators flipped.
+std::wstring TranslateWindowsPath(std::wstring_view path);
+
+// Decides which Windows variables reach a Linux process and how. Variables
+// named in WSLENV are translated per their flags; the rest pass unchanged
+// unless denied, or, in strict mode, not explicitly allowed. Names compare
+// case-insensitively, as Windows does; a trailing '*' matches a prefix.
+class EnvironmentFilter {
+public:
+    // "NAME/flags:NAME/flags", as WSLENV is written.
+    static EnvironmentFilter FromWslEnv(std::wstring_view wslenv);
+
+    void Allow(std::wstring pattern);
+    void Deny(std::wstring pattern);
+
+    // Only WSLENV and allowed variables pass.
+    void SetStrict(bool strict) { strict_ = strict; }
+
+    EnvironmentSnapshot Apply(const EnvironmentSnapshot& windows) const;
+
+private:
+    struct Rule {
+        std::wstring name;
+        uint8_t flags;
+    };
+
+    static bool Matches(const std::wstring& pattern, std::wstring_view name);
+    const Rule* FindRule(std::wstring_view name) const;
+
+    std::vector<Rule> rules_;
+    std::vector<std::wstring> allow_;
+    std::vector<std::wstring> deny_;
+    bool strict_ = false;
+};
+
+#ifdef _WIN32
+// This process' environment as a Linux process should see it, translated per
+// its WSLENV. Launches share the result until the environment changes.
+std::shared_ptr<const EnvironmentSnapshot> CaptureLinuxEnvironment();
+#endif
+
+// What changed between two snapshots, by name.
+struct EnvironmentDelta {
+    uint64_t baseHash = 0;
+    uint64_t targetHash = 0;
+    std::vector<std::wstring> set;     // "NAME=value", added or changed
+    std::vector<std::wstring> removed; // names
+
+    size_t Characters() const;
+};
+
+EnvironmentDelta DiffEnvironment(const EnvironmentSnapshot& base, const EnvironmentSnapshot& target);
+
+// Empty if the delta was not taken against base, or the result does not
+// hash to its target.
+std::optional<EnvironmentSnapshot> ApplyEnvironmentDelta(const EnvironmentSnapshot& base,
+                                                         const EnvironmentDelta& delta);
+
+// One launch's environment on the wire: the whole block, or a delta against
+// the baseline the service already holds.
+struct EnvironmentMessage {
+    std::shared_ptr<const EnvironmentSnapshot> full;
+    std::optional<EnvironmentDelta> delta;
+
+    size_t Characters() const;
+};
+
+// Client half of a session's environment baseline. The first launch sends
+// the whole block, which becomes the baseline once the service acknowledges
+// it; later launches send a delta against that.
+class EnvironmentEncoder {
+public:
+    EnvironmentMessage Encode(const std::shared_ptr<const EnvironmentSnapshot>& environment) const;
+
+    // The service now holds this snapshot as its baseline.
+    void Acknowledge(const std::shared_ptr<const EnvironmentSnapshot>& environment);
+
+    // The service lost its baseline (for example it restarted); the next
+    // launch sends the whole block again.
+    void Reset();
+
+private:
+    std::shared_ptr<const EnvironmentSnapshot> baseline_;
+};
+
+// Service half: holds the last full block a session sent and rebuilds each
+// launch's environment from it.
+class EnvironmentBaseline {
+public:
+    // Empty if a delta does not apply to the held baseline; the client must
+    // then Reset() and resend in full.
+    std::shared_ptr<const EnvironmentSnapshot> Receive(const EnvironmentMessage& message);
+
+private:
+    std::shared_ptr<const EnvironmentSnapshot> baseline_;
+};
+
+} // namespace WSL
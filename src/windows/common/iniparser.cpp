@@ -0,0 +1,99 @@
+#include "iniparser.h"
+
+#include <utility>
+
+namespace WSL {
+
+namespace {
+
+bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+std::string_view Trim(std::string_view text) {
+    size_t start = 0;
+    while (start < text.size() && IsBlank(text[start])) {
+        ++start;
+    }
+
+    size_t end = text.size();
+    while (end > start && IsBlank(text[end - 1])) {
+        --end;
+    }
+    return text.substr(start, end - start);
+}
+
+class ErrorCollector : public IniHandler {
+public:
+    void OnSection(std::string_view) override {}
+    void OnValue(std::string_view, std::string_view, std::string_view) override {}
+    void OnError(const IniError& error) override { errors.push_back(error); }
+
+    std::vector<IniError> errors;
+};
+
+} // namespace
+
+void ParseIni(std::string_view text, IniHandler& handler) {
+    std::string_view section;
+    size_t lineNumber = 0;
+    size_t position = 0;
+
+    // Same line splitting as std::getline: a trailing '\n' does not start
+    // another line.
+    while (position < text.size()) {
+        size_t end = text.find('\n', position);
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+
+        const std::string_view raw = text.substr(position, end - position);
+        position = end + 1;
+        ++lineNumber;
+
+        std::string_view line = raw;
+        const size_t comment = line.find('#');
+        if (comment != std::string_view::npos) {
+            line = line.substr(0, comment);
+        }
+
+        line = Trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        auto report = [&](const char* at, const char* message) {
+            handler.OnError({lineNumber, static_cast<size_t>(at - raw.data()) + 1, message});
+        };
+
+        if (line.front() == '[' && line.back() == ']' && line.size() > 2) {
+            const std::string_view name = line.substr(1, line.size() - 2);
+            if (name.find(']') == std::string_view::npos) {
+                section = name;
+                handler.OnSection(section);
+                continue;
+            }
+        }
+
+        const size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            report(line.data(), line.front() == '[' ? "malformed section header" : "expected key=value");
+        } else if (equals == 0) {
+            report(line.data(), "missing key before '='");
+        } else if (const size_t second = line.find('=', equals + 1); second != std::string_view::npos) {
+            report(line.data() + second, "unexpected second '='");
+        } else if (section.empty()) {
+            report(line.data(), "key outside of any section");
+        } else {
+            handler.OnValue(section, Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)));
+        }
+    }
+}
+
+std::vector<IniError> ValidateIni(std::string_view text) {
+    ErrorCollector collector;
+    ParseIni(text, collector);
+    return std::move(collector.errors);
+}
+
+} // namespace WSL
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+// Position of a line the parser skipped. Lines and columns are 1-based;
+// the column points at the offending character.
+struct IniError {
+    size_t line = 0;
+    size_t column = 0;
+    std::string message;
+};
+
+// Receives what ParseIni finds. The views point into the text passed to
+// ParseIni and are only valid as long as it is.
+class IniHandler {
+public:
+    virtual ~IniHandler() = default;
+
+    // A [section] header. Redeclaring a section starts it over.
+    virtual void OnSection(std::string_view name) = 0;
+
+    // key=value inside a section, both trimmed.
+    virtual void OnValue(std::string_view section, std::string_view key, std::string_view value) = 0;
+
+    // Lines that are not blank, a header or a key=value pair are skipped and
+    // reported here; parsing always continues.
+    virtual void OnError(const IniError& error) { (void)error; }
+};
+
+// Single pass over wsl.conf / .wslconfig text with no allocation of its own:
+// '#' starts a comment anywhere on a line, blanks are " \t\r", a header is
+// "[name]" with no ']' inside, and a value line holds exactly one '='. Keys
+// before the first section are ignored.
+void ParseIni(std::string_view text, IniHandler& handler);
+
+// Convenience handler that only collects errors.
+std::vector<IniError> ValidateIni(std::string_view text);
+
+} // namespace WSL
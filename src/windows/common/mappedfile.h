@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace WSL {
+
+// Read-only private mapping of a whole file. Empty files open successfully
+// with an empty view.
+//
+// The mapping pins the file: on Windows an in-place rewrite of a mapped file
+// fails with ERROR_USER_MAPPED_FILE, and on Linux truncating it underneath
+// raises SIGBUS on access. Editors that save by writing a new file and
+// renaming it over the old one are unaffected; hold mappings of user-edited
+// files only as long as the data is needed.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Non-copyable
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file cannot be opened or mapped; errno /
+    // GetLastError() describe why.
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return open_; }
+    std::string_view View() const { return {data_, size_}; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+};
+
+} // namespace WSL
@@ -0,0 +1,492 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <iterator>
+
+#ifdef _WIN32
+#include <filesystem>
+#include <system_error>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+struct Definition {
+    Metric metric;
+    std::string_view name;
+    MetricKind kind;
+};
+
+constexpr Definition Definitions[] = {
+    {Metric::Launches, "launches", MetricKind::Counter},
+    {Metric::LaunchFailures, "launch_failures", MetricKind::Counter},
+    {Metric::LaunchLatency, "launch_latency", MetricKind::Histogram},
+    {Metric::RelayInputBytes, "relay_stdin_bytes", MetricKind::Counter},
+    {Metric::RelayOutputBytes, "relay_stdout_bytes", MetricKind::Counter},
+    {Metric::RelayErrorBytes, "relay_stderr_bytes", MetricKind::Counter},
+    {Metric::RelayStalls, "relay_stalls", MetricKind::Counter},
+    {Metric::ConfigReloads, "config_reloads", MetricKind::Counter},
+};
+
+constexpr size_t MetricCount = std::size(Definitions);
+
+constexpr bool DefinitionsInOrder() {
+    for (size_t i = 0; i < MetricCount; ++i) {
+        if (static_cast<size_t>(Definitions[i].metric) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(DefinitionsInOrder(), "Definitions must list every Metric in declaration order");
+
+// Histogram buckets: values below 8 exactly, then each power of two split
+// into 8, up to 2^48 ns (about three days); larger values land in the last.
+constexpr unsigned SubBucketBits = 3;
+constexpr size_t SubBuckets = size_t{1} << SubBucketBits;
+constexpr unsigned MaxExponent = 47;
+constexpr size_t BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+// A histogram's slots: the sum and max of its values, then the buckets.
+constexpr size_t HistogramSum = 0;
+constexpr size_t HistogramMax = 1;
+constexpr size_t HistogramBuckets = 2;
+
+// Enough that the cores of a typical machine each get their own; larger
+// machines share shards, which costs contention, never correctness.
+constexpr size_t ShardCount = 16;
+static_assert(std::has_single_bit(ShardCount));
+
+constexpr size_t SlotsPerLine = 64 / sizeof(uint64_t);
+
+struct Layout {
+    size_t offsets[MetricCount] = {};
+    size_t shardSlots = 0; // whole cache lines, so shards never share one
+};
+
+constexpr Layout ComputeLayout() {
+    Layout layout;
+    size_t next = 0;
+    for (size_t i = 0; i < MetricCount; ++i) {
+        layout.offsets[i] = next;
+        next += Definitions[i].kind == MetricKind::Histogram ? HistogramBuckets + BucketCount : 1;
+    }
+    layout.shardSlots = (next + SlotsPerLine - 1) / SlotsPerLine * SlotsPerLine;
+    return layout;
+}
+
+constexpr Layout MetricLayout = ComputeLayout();
+
+// The header takes the first cache line: the magic, then the layout hash.
+constexpr size_t HeaderSlots = SlotsPerLine;
+constexpr size_t SegmentSlots = HeaderSlots + ShardCount * MetricLayout.shardSlots;
+constexpr size_t SegmentSize = SegmentSlots * sizeof(uint64_t);
+
+constexpr uint64_t SegmentMagic = 0x3152544D4C535721; // "!WSLMTR1"
+
+// Changes whenever anything that moves a slot does.
+constexpr uint64_t ComputeLayoutHash() {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for (const auto& definition : Definitions) {
+        for (char c : definition.name) {
+            mix(static_cast<unsigned char>(c));
+        }
+        mix(static_cast<uint64_t>(definition.kind));
+    }
+    mix(BucketCount);
+    mix(ShardCount);
+    return hash;
+}
+
+constexpr uint64_t LayoutHash = ComputeLayoutHash();
+
+// The slots live in shared memory that other processes update too, hence
+// atomic_ref rather than std::atomic members. A plain aligned 64-bit load,
+// which is all this is on x64 and ARM64, is also fine on a read-only view.
+uint64_t Load(const uint64_t& slot) {
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(slot)).load(std::memory_order_relaxed);
+}
+
+void FetchAdd(uint64_t& slot, uint64_t value) {
+    std::atomic_ref<uint64_t>(slot).fetch_add(value, std::memory_order_relaxed);
+}
+
+size_t CurrentShard() {
+#ifdef _WIN32
+    return GetCurrentProcessorNumber() & (ShardCount - 1);
+#else
+    const int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : static_cast<size_t>(cpu) & (ShardCount - 1);
+#endif
+}
+
+size_t BucketIndex(uint64_t value) {
+    if (value < SubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    const unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    if (exponent > MaxExponent) {
+        return BucketCount - 1;
+    }
+    const unsigned shift = exponent - SubBucketBits;
+    return (exponent - SubBucketBits + 1) * SubBuckets + static_cast<size_t>((value >> shift) & (SubBuckets - 1));
+}
+
+// The largest value that lands in the bucket.
+uint64_t BucketUpperBound(size_t index) {
+    if (index < SubBuckets) {
+        return index;
+    }
+    const unsigned shift = static_cast<unsigned>(index / SubBuckets) - 1;
+    const uint64_t lower = static_cast<uint64_t>(SubBuckets + index % SubBuckets) << shift;
+    return lower + (uint64_t{1} << shift) - 1;
+}
+
+// Claims a zeroed segment, or checks that one already claimed matches.
+// Publishers racing on a fresh segment store the same values.
+bool ClaimSegment(uint64_t* segment) {
+    std::atomic_ref<uint64_t> magic(segment[0]);
+    std::atomic_ref<uint64_t> layout(segment[1]);
+    if (magic.load(std::memory_order_acquire) == 0) {
+        layout.store(LayoutHash, std::memory_order_relaxed);
+        magic.store(SegmentMagic, std::memory_order_release);
+    }
+    return magic.load(std::memory_order_acquire) == SegmentMagic && layout.load(std::memory_order_relaxed) == LayoutHash;
+}
+
+bool SegmentMatches(const uint64_t* segment) {
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(segment[0])).load(std::memory_order_acquire) ==
+               SegmentMagic &&
+           Load(segment[1]) == LayoutHash;
+}
+
+#ifdef _WIN32
+
+// A section over a file rather than the paging file: a paging-file section
+// goes away with the last process to map it, and wsl.exe is the only
+// publisher and rarely outlives a command. Like the POSIX segment, the file
+// is per user and keeps counting until it is removed.
+std::wstring SegmentPath(std::string_view segment) {
+    wchar_t localAppData[MAX_PATH];
+    const DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return {};
+    }
+    return std::wstring(localAppData, length) + L"\\wsl\\" + std::wstring(segment.begin(), segment.end()) +
+           L".metrics";
+}
+
+uint64_t* MapSegment(std::string_view segment, bool writable) {
+    const std::wstring path = SegmentPath(segment);
+    if (path.empty()) {
+        return nullptr;
+    }
+    if (writable) {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    }
+
+    HANDLE file = CreateFileW(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                              writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    // A new file is empty and the section grows it zero-filled; one of any
+    // other size belongs to another layout and is left alone.
+    LARGE_INTEGER size = {};
+    const bool usable = GetFileSizeEx(file, &size) &&
+                        (size.QuadPart == static_cast<LONGLONG>(SegmentSize) || (writable && size.QuadPart == 0));
+    HANDLE mapping = usable ? CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0,
+                                                 static_cast<DWORD>(SegmentSize), nullptr)
+                            : nullptr;
+    CloseHandle(file);
+    if (!mapping) {
+        return nullptr;
+    }
+
+    // The view keeps the section, and with it the file, open.
+    void* view = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, SegmentSize);
+    CloseHandle(mapping);
+    return static_cast<uint64_t*>(view);
+}
+
+void UnmapSegment(const uint64_t* segment) {
+    UnmapViewOfFile(segment);
+}
+
+#else
+
+// /dev/shm is shared by every user, so the name carries the uid.
+std::string SegmentName(std::string_view segment) {
+    return "/" + std::string(segment) + "-" + std::to_string(getuid());
+}
+
+uint64_t* MapSegment(std::string_view segment, bool writable) {
+    const std::string name = SegmentName(segment);
+    const int fd = shm_open(name.c_str(), writable ? O_RDWR | O_CREAT | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // A new segment is empty and grows zero-filled; one of any other size
+    // belongs to another layout and is left alone.
+    struct stat status = {};
+    bool usable = fstat(fd, &status) == 0;
+    if (usable && writable && status.st_size == 0) {
+        usable = ftruncate(fd, static_cast<off_t>(SegmentSize)) == 0 ||
+                 (fstat(fd, &status) == 0 && status.st_size == static_cast<off_t>(SegmentSize));
+    } else if (usable) {
+        usable = status.st_size == static_cast<off_t>(SegmentSize);
+    }
+
+    void* view = usable ? mmap(nullptr, SegmentSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)
+                        : MAP_FAILED;
+    close(fd);
+    return view == MAP_FAILED ? nullptr : static_cast<uint64_t*>(view);
+}
+
+void UnmapSegment(const uint64_t* segment) {
+    munmap(const_cast<uint64_t*>(segment), SegmentSize);
+}
+
+#endif
+
+// Nearest-rank percentile from summed buckets.
+uint64_t Percentile(const std::vector<uint64_t>& buckets, uint64_t count, uint64_t max, double fraction) {
+    if (count == 0) {
+        return 0;
+    }
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(count) + 0.999999));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // The last bucket has no upper bound of its own.
+            return i == BucketCount - 1 ? max : std::min(BucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+MetricsSnapshot Summarize(const uint64_t* shards) {
+    MetricsSnapshot snapshot;
+    snapshot.values.reserve(MetricCount);
+    std::vector<uint64_t> buckets(BucketCount);
+
+    for (size_t i = 0; i < MetricCount; ++i) {
+        const Definition& definition = Definitions[i];
+        MetricValue value;
+        value.metric = definition.metric;
+        value.name = definition.name;
+        value.kind = definition.kind;
+
+        const size_t offset = MetricLayout.offsets[i];
+        if (definition.kind != MetricKind::Histogram) {
+            uint64_t total = 0;
+            for (size_t shard = 0; shard < ShardCount; ++shard) {
+                total += Load(shards[shard * MetricLayout.shardSlots + offset]);
+            }
+            value.value = static_cast<int64_t>(total);
+        } else {
+            // The count comes from the buckets, so percentiles agree with it
+            // even while other threads are recording.
+            HistogramSummary& histogram = value.histogram;
+            std::fill(buckets.begin(), buckets.end(), 0);
+            for (size_t shard = 0; shard < ShardCount; ++shard) {
+                const uint64_t* slots = shards + shard * MetricLayout.shardSlots + offset;
+                histogram.sum += Load(slots[HistogramSum]);
+                histogram.max = std::max(histogram.max, Load(slots[HistogramMax]));
+                for (size_t bucket = 0; bucket < BucketCount; ++bucket) {
+                    const uint64_t hits = Load(slots[HistogramBuckets + bucket]);
+                    buckets[bucket] += hits;
+                    histogram.count += hits;
+                }
+            }
+            histogram.p50 = Percentile(buckets, histogram.count, histogram.max, 0.50);
+            histogram.p90 = Percentile(buckets, histogram.count, histogram.max, 0.90);
+            histogram.p99 = Percentile(buckets, histogram.count, histogram.max, 0.99);
+        }
+        snapshot.values.push_back(value);
+    }
+    return snapshot;
+}
+
+// Keeps the shards a cache line apart in process memory too.
+struct alignas(64) CacheLine {
+    uint64_t slots[SlotsPerLine];
+};
+
+} // namespace
+
+class MetricsRegistry::Impl {
+public:
+    Impl() : local_(SegmentSlots / SlotsPerLine), segment_(local_.front().slots) {}
+
+    explicit Impl(std::string_view segment) : Impl() {
+        uint64_t* mapped = MapSegment(segment, true);
+        if (mapped && ClaimSegment(mapped)) {
+            mapped_ = mapped;
+            segment_ = mapped;
+            local_.clear();
+            local_.shrink_to_fit();
+        } else if (mapped) {
+            UnmapSegment(mapped);
+        }
+    }
+
+    ~Impl() {
+        if (mapped_) {
+            UnmapSegment(mapped_);
+        }
+    }
+
+    void Add(Metric metric, int64_t delta) {
+        FetchAdd(Slots(metric)[0], static_cast<uint64_t>(delta));
+    }
+
+    void Record(Metric metric, uint64_t value) {
+        uint64_t* slots = Slots(metric);
+        FetchAdd(slots[HistogramSum], value);
+
+        std::atomic_ref<uint64_t> max(slots[HistogramMax]);
+        uint64_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+
+        FetchAdd(slots[HistogramBuckets + BucketIndex(value)], 1);
+    }
+
+    bool IsShared() const { return mapped_ != nullptr; }
+
+    MetricsSnapshot Snapshot() const { return Summarize(segment_ + HeaderSlots); }
+
+private:
+    uint64_t* Slots(Metric metric) {
+        const size_t shard = CurrentShard();
+        return segment_ + HeaderSlots + shard * MetricLayout.shardSlots +
+               MetricLayout.offsets[static_cast<size_t>(metric)];
+    }
+
+    std::vector<CacheLine> local_;
+    uint64_t* segment_;
+    uint64_t* mapped_ = nullptr;
+};
+
+MetricsRegistry::MetricsRegistry(std::string_view segment)
+    : pImpl_(std::make_unique<Impl>(segment)) {}
+
+MetricsRegistry::MetricsRegistry()
+    : pImpl_(std::make_unique<Impl>()) {}
+
+MetricsRegistry::~MetricsRegistry() = default;
+
+MetricsRegistry& MetricsRegistry::Default() {
+    static MetricsRegistry registry(DefaultMetricsSegment);
+    return registry;
+}
+
+void MetricsRegistry::Add(Metric metric, int64_t delta) {
+    pImpl_->Add(metric, delta);
+}
+
+void MetricsRegistry::Record(Metric metric, uint64_t value) {
+    pImpl_->Record(metric, value);
+}
+
+bool MetricsRegistry::IsShared() const {
+    return pImpl_->IsShared();
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() const {
+    return pImpl_->Snapshot();
+}
+
+std::optional<MetricsSnapshot> MetricsRegistry::Read(std::string_view segment) {
+    const uint64_t* mapped = MapSegment(segment, false);
+    if (!mapped) {
+        return std::nullopt;
+    }
+    std::optional<MetricsSnapshot> snapshot;
+    if (SegmentMatches(mapped)) {
+        snapshot = Summarize(mapped + HeaderSlots);
+    }
+    UnmapSegment(mapped);
+    return snapshot;
+}
+
+void MetricsRegistry::Unlink(std::string_view segment) {
+#ifdef _WIN32
+    // Shared for delete, so this succeeds while mapped; the file goes once
+    // the last view is unmapped.
+    DeleteFileW(SegmentPath(segment).c_str());
+#else
+    shm_unlink(SegmentName(segment).c_str());
+#endif
+}
+
+std::string MetricsSnapshot::Format() const {
+    size_t width = 0;
+    for (const auto& value : values) {
+        width = std::max(width, value.name.size());
+    }
+
+    char line[256];
+    std::string text;
+    for (const auto& value : values) {
+        if (value.kind != MetricKind::Histogram) {
+            snprintf(line, sizeof(line), "%-*.*s %lld\n", static_cast<int>(width), static_cast<int>(value.name.size()),
+                     value.name.data(), static_cast<long long>(value.value));
+        } else {
+            const HistogramSummary& histogram = value.histogram;
+            snprintf(line, sizeof(line), "%-*.*s %llu, p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                     static_cast<int>(width), static_cast<int>(value.name.size()), value.name.data(),
+                     static_cast<unsigned long long>(histogram.count), static_cast<double>(histogram.p50) / 1e6,
+                     static_cast<double>(histogram.p90) / 1e6, static_cast<double>(histogram.p99) / 1e6,
+                     static_cast<double>(histogram.max) / 1e6);
+        }
+        text += line;
+    }
+    return text;
+}
+
+std::string MetricsSnapshot::FormatJson() const {
+    std::string json = "{";
+    for (const auto& value : values) {
+        if (json.size() > 1) {
+            json += ',';
+        }
+        json += '"';
+        json += value.name;
+        json += "\":";
+        if (value.kind != MetricKind::Histogram) {
+            json += std::to_string(value.value);
+        } else {
+            const HistogramSummary& histogram = value.histogram;
+            json += "{\"count\":" + std::to_string(histogram.count) + ",\"sum_ns\":" + std::to_string(histogram.sum) +
+                    ",\"p50_ns\":" + std::to_string(histogram.p50) + ",\"p90_ns\":" + std::to_string(histogram.p90) +
+                    ",\"p99_ns\":" + std::to_string(histogram.p99) + ",\"max_ns\":" + std::to_string(histogram.max) +
+                    "}";
+        }
+    }
+    json += "}";
+    return json;
+}
+
+} // namespace WSL
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+enum class MetricKind {
+    Counter,
+    Histogram
+};
+
+// Everything the client and service publish. The set is fixed at compile
+// time so every process agrees on the segment layout without negotiating
+// it; changing it bumps the layout version, and a reader built against a
+// different one reports the segment as unavailable. There are no gauges: the
+// segment outlives its publishers, so a level one of them raised and was
+// killed before lowering would stay raised.
+enum class Metric : uint32_t {
+    Launches,
+    LaunchFailures,
+    LaunchLatency, // ns from queueing a launch to its completion
+    RelayInputBytes,
+    RelayOutputBytes,
+    RelayErrorBytes,
+    RelayStalls,
+    ConfigReloads,
+};
+
+// The segment wsl.exe and the service publish to and wsl --status --metrics
+// reads.
+inline constexpr std::string_view DefaultMetricsSegment = "WSLMetrics";
+
+struct HistogramSummary {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    // Upper bound of the bucket holding the percentile; within 1/8 of the
+    // recorded value.
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+};
+
+struct MetricValue {
+    Metric metric{};
+    std::string_view name; // snake_case, stable for scripts
+    MetricKind kind = MetricKind::Counter;
+    int64_t value = 0;          // counters
+    HistogramSummary histogram; // histograms
+};
+
+struct MetricsSnapshot {
+    std::vector<MetricValue> values; // in Metric order
+
+    const MetricValue& Get(Metric metric) const { return values.at(static_cast<size_t>(metric)); }
+
+    // Aligned name/value lines; latencies in milliseconds.
+    std::string Format() const;
+
+    // One object keyed by metric name; histograms are objects of raw values.
+    std::string FormatJson() const;
+};
+
+// Counters and log-linear (HDR-style, 8 sub-buckets per power of
+// two) histograms in a named shared-memory segment, so any process can read
+// them without asking the publisher. Each metric has one slot per shard and
+// updates go to the shard of the CPU the caller is running on, so threads
+// on different cores never write the same cache line; a read sums the
+// shards. Updates are relaxed atomics on the mapped memory, which makes
+// them safe across processes as well as threads.
+//
+// A zeroed segment is a valid empty one, so publishers create or open it
+// without coordinating. If it cannot be mapped, or holds another layout,
+// the registry keeps its metrics in process memory instead: publishing is
+// never allowed to fail a launch. Either way the segment outlives the
+// processes that publish to it, each a short-lived wsl, so a read sees the
+// totals of every run: on Windows it is a mapped file,
+// %LOCALAPPDATA%\wsl\<segment>.metrics, and a POSIX segment persists until
+// it is unlinked or the system restarts.
+class MetricsRegistry {
+public:
+    // Publishes to the named segment.
+    explicit MetricsRegistry(std::string_view segment);
+
+    // Process memory only.
+    MetricsRegistry();
+
+    ~MetricsRegistry();
+
+    // Non-copyable, non-movable
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+    MetricsRegistry(MetricsRegistry&&) = delete;
+    MetricsRegistry& operator=(MetricsRegistry&&) = delete;
+
+    // Publishes to DefaultMetricsSegment.
+    static MetricsRegistry& Default();
+
+    // Counters.
+    void Add(Metric metric, int64_t delta = 1);
+
+    // Histograms.
+    void Record(Metric metric, uint64_t value);
+
+    // False when the segment could not be used and metrics stay local.
+    bool IsShared() const;
+
+    MetricsSnapshot Snapshot() const;
+
+    // Maps the segment read-only and sums it. std::nullopt if nothing has
+    // published to it yet, or it holds another layout.
+    static std::optional<MetricsSnapshot> Read(std::string_view segment = DefaultMetricsSegment);
+
+    // Removes the segment; publishers still mapping it keep their copy.
+    static void Unlink(std::string_view segment);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace WSL {
+
+// One command-line option. The handler receives the arity arguments that
+// follow it; the parser has already checked they are there.
+template <typename Target>
+struct Option {
+    std::wstring_view name;  // "--distribution"
+    std::wstring_view alias; // "-d", or empty
+    uint8_t arity;
+    std::string_view values; // what the following arguments are, for errors
+    void (*handler)(Target& target, const wchar_t* const* values);
+};
+
+namespace OptionHash {
+
+constexpr wchar_t FoldCase(wchar_t c) {
+    return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c - L'A' + L'a') : c;
+}
+
+constexpr uint32_t Hash(std::wstring_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (wchar_t c : name) {
+        hash = (hash ^ static_cast<uint32_t>(FoldCase(c))) * 16777619u;
+    }
+    // FNV's multiply only carries upwards, so without this the slot bits
+    // would see just the low bits of the seed and the search would run
+    // out of distinct seeds as the table grows.
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+constexpr bool EqualsFolded(std::wstring_view left, std::wstring_view right) {
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (FoldCase(left[i]) != FoldCase(right[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace OptionHash
+
+// Options looked up by name or alias, ignoring ASCII case. The hash seed is
+// searched for at compile time until every name and alias lands in its own
+// slot, so a lookup is one hash and one comparison and never allocates. A
+// duplicate name leaves no such seed and fails the build.
+template <typename Target, size_t Count>
+class OptionTable {
+    static_assert(Count > 0 && Count < 255, "Slots index options with a byte");
+
+public:
+    static constexpr size_t Slots = std::bit_ceil(Count * 4);
+
+    constexpr explicit OptionTable(const Option<Target> (&options)[Count]) {
+        for (size_t i = 0; i < Count; ++i) {
+            options_[i] = options[i];
+        }
+        for (seed_ = 0; seed_ < 0x10000; ++seed_) {
+            if (TryPlace()) {
+                return;
+            }
+        }
+        throw std::logic_error("No perfect hash exists for these options");
+    }
+
+    constexpr const Option<Target>* Find(std::wstring_view argument) const {
+        const uint8_t slot = slots_[OptionHash::Hash(argument, seed_) & (Slots - 1)];
+        if (slot == EmptySlot) {
+            return nullptr;
+        }
+        const Option<Target>& option = options_[slot];
+        if (OptionHash::EqualsFolded(argument, option.name) ||
+            (!option.alias.empty() && OptionHash::EqualsFolded(argument, option.alias))) {
+            return &option;
+        }
+        return nullptr;
+    }
+
+    constexpr uint32_t Seed() const { return seed_; }
+
+private:
+    static constexpr uint8_t EmptySlot = 0xFF;
+
+    constexpr bool TryPlace() {
+        slots_.fill(EmptySlot);
+        for (size_t i = 0; i < Count; ++i) {
+            for (std::wstring_view key : {options_[i].name, options_[i].alias}) {
+                if (key.empty()) {
+                    continue;
+                }
+                uint8_t& slot = slots_[OptionHash::Hash(key, seed_) & (Slots - 1)];
+                if (slot != EmptySlot) {
+                    return false;
+                }
+                slot = static_cast<uint8_t>(i);
+            }
+        }
+        return true;
+    }
+
+    std::array<Option<Target>, Count> options_{};
+    std::array<uint8_t, Slots> slots_{};
+    uint32_t seed_ = 0;
+};
+
+} // namespace WSL
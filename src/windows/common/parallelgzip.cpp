@@ -0,0 +1,544 @@
+#include "parallelgzip.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+namespace WSL {
+
+namespace {
+
+// Member layout: the 10-byte gzip header with FEXTRA set, an extra field
+// holding one "WC" subfield with the member's total length, the raw deflate
+// data, then CRC-32 and ISIZE.
+constexpr size_t MemberHeaderSize = 20;
+constexpr size_t MemberTrailerSize = 8;
+constexpr size_t MinChunkSize = 64 * 1024;
+constexpr size_t MaxChunkSize = 64 * 1024 * 1024;
+
+// Stored and incompressible data grows by a few bytes per 16 KiB block; a
+// member bigger than this did not come from a valid chunk.
+constexpr size_t MaxMemberSize = MaxChunkSize + MaxChunkSize / 16 + MemberHeaderSize + MemberTrailerSize;
+
+void StoreLittleEndian32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+uint32_t LoadLittleEndian32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | static_cast<unsigned char>(in[i]);
+    }
+    return value;
+}
+
+bool IsIndexedMember(const char* header, size_t size) {
+    static constexpr unsigned char Prefix[] = {0x1F, 0x8B, 0x08, 0x04};
+    return size == MemberHeaderSize && std::memcmp(header, Prefix, sizeof(Prefix)) == 0 && header[10] == 8 &&
+           header[11] == 0 && header[12] == 'W' && header[13] == 'C' && header[14] == 4 && header[15] == 0;
+}
+
+size_t WorkerCount(size_t requested) {
+    if (requested != 0) {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// One chunk in flight: its input, and what a worker made of it.
+struct Chunk {
+    uint64_t sequence = 0;
+    std::vector<char> input;
+    std::vector<char> output; // sized for the worst case; outputSize is used
+    size_t outputSize = 0;
+    bool done = false;
+    std::exception_ptr error;
+};
+
+// Runs work() over chunks on a pool of threads and hands them to emit() on
+// the caller's thread in submission order. Chunks are recycled, and no more
+// than two per worker exist at once, which is what bounds memory.
+class ChunkWorkers {
+public:
+    using Callback = std::function<void(Chunk& chunk)>;
+
+    ChunkWorkers(size_t workers, Callback work, Callback emit)
+        : work_(std::move(work)), emit_(std::move(emit)), maxInFlight_(2 * workers) {
+        threads_.reserve(workers);
+        for (size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this] { Run(); });
+        }
+    }
+
+    ~ChunkWorkers() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stopping_ = true;
+        }
+        workReady_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Non-copyable, non-movable
+    ChunkWorkers(const ChunkWorkers&) = delete;
+    ChunkWorkers& operator=(const ChunkWorkers&) = delete;
+    ChunkWorkers(ChunkWorkers&&) = delete;
+    ChunkWorkers& operator=(ChunkWorkers&&) = delete;
+
+    // An empty chunk, once one is free; emits finished chunks meanwhile.
+    std::unique_ptr<Chunk> Acquire() {
+        std::unique_lock<std::mutex> guard(lock_);
+        for (;;) {
+            EmitCompleted(guard);
+            if (inFlight_.size() < maxInFlight_) {
+                break;
+            }
+            chunkDone_.wait(guard);
+        }
+
+        std::unique_ptr<Chunk> chunk;
+        if (free_.empty()) {
+            chunk = std::make_unique<Chunk>();
+        }
+        else {
+            chunk = std::move(free_.back());
+            free_.pop_back();
+        }
+        chunk->sequence = nextSequence_++;
+        chunk->input.clear();
+        chunk->outputSize = 0;
+        chunk->done = false;
+        chunk->error = nullptr;
+        return chunk;
+    }
+
+    void Submit(std::unique_ptr<Chunk> chunk) {
+        std::unique_lock<std::mutex> guard(lock_);
+        pending_.push_back(chunk.get());
+        inFlight_.push_back(std::move(chunk));
+        workReady_.notify_one();
+        EmitCompleted(guard);
+    }
+
+    // Waits for every submitted chunk and emits it.
+    void Drain() {
+        std::unique_lock<std::mutex> guard(lock_);
+        for (;;) {
+            EmitCompleted(guard);
+            if (inFlight_.empty()) {
+                return;
+            }
+            chunkDone_.wait(guard);
+        }
+    }
+
+private:
+    void EmitCompleted(std::unique_lock<std::mutex>& guard) {
+        while (!inFlight_.empty() && inFlight_.front()->done) {
+            std::unique_ptr<Chunk> chunk = std::move(inFlight_.front());
+            inFlight_.pop_front();
+
+            guard.unlock();
+            if (chunk->error) {
+                std::rethrow_exception(chunk->error);
+            }
+            emit_(*chunk);
+            guard.lock();
+            free_.push_back(std::move(chunk));
+        }
+    }
+
+    void Run() {
+        for (;;) {
+            Chunk* chunk = nullptr;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                workReady_.wait(guard, [this] { return stopping_ || !pending_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                chunk = pending_.front();
+                pending_.pop_front();
+            }
+
+            try {
+                work_(*chunk);
+            }
+            catch (...) {
+                chunk->error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                chunk->done = true;
+            }
+            chunkDone_.notify_all();
+        }
+    }
+
+    Callback work_;
+    Callback emit_;
+    const size_t maxInFlight_;
+
+    std::mutex lock_;
+    std::condition_variable workReady_;
+    std::condition_variable chunkDone_;
+    std::deque<Chunk*> pending_;
+    std::deque<std::unique_ptr<Chunk>> inFlight_; // submission order
+    std::vector<std::unique_ptr<Chunk>> free_;
+    uint64_t nextSequence_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+// zlib state is kept per worker thread and reset between chunks; setting it
+// up costs more than compressing a small chunk.
+class Deflater {
+public:
+    explicit Deflater(int level) : level_(level) {
+        if (deflateInit2(&stream_, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Failed to initialise zlib");
+        }
+    }
+    ~Deflater() { deflateEnd(&stream_); }
+
+    // Non-copyable, non-movable
+    Deflater(const Deflater&) = delete;
+    Deflater& operator=(const Deflater&) = delete;
+
+    static Deflater& ForThread(int level) {
+        thread_local std::unique_ptr<Deflater> deflater;
+        if (!deflater || deflater->level_ != level) {
+            deflater = std::make_unique<Deflater>(level);
+        }
+        deflateReset(&deflater->stream_);
+        return *deflater;
+    }
+
+    z_stream& Stream() { return stream_; }
+
+private:
+    z_stream stream_{};
+    int level_;
+};
+
+class Inflater {
+public:
+    Inflater() {
+        if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Failed to initialise zlib");
+        }
+    }
+    ~Inflater() { inflateEnd(&stream_); }
+
+    // Non-copyable, non-movable
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+
+    static Inflater& ForThread() {
+        thread_local Inflater inflater;
+        inflateReset(&inflater.stream_);
+        return inflater;
+    }
+
+    z_stream& Stream() { return stream_; }
+
+private:
+    z_stream stream_{};
+};
+
+void CompressChunk(Chunk& chunk, int level) {
+    Deflater& deflater = Deflater::ForThread(level);
+    z_stream& stream = deflater.Stream();
+
+    const size_t bound = MemberHeaderSize + deflateBound(&stream, static_cast<uLong>(chunk.input.size())) +
+                         MemberTrailerSize;
+    if (chunk.output.size() < bound) {
+        chunk.output.resize(bound);
+    }
+
+    char* out = chunk.output.data();
+    static constexpr unsigned char Header[MemberHeaderSize - 4] = {
+        0x1F, 0x8B, 0x08, 0x04, 0, 0, 0, 0, 0, 0xFF, 8, 0, 'W', 'C', 4, 0};
+    std::memcpy(out, Header, sizeof(Header));
+
+    stream.next_in = reinterpret_cast<Bytef*>(chunk.input.data());
+    stream.avail_in = static_cast<uInt>(chunk.input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out + MemberHeaderSize);
+    stream.avail_out = static_cast<uInt>(bound - MemberHeaderSize - MemberTrailerSize);
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        throw std::runtime_error("Failed to compress chunk " + std::to_string(chunk.sequence));
+    }
+
+    size_t size = MemberHeaderSize + stream.total_out;
+    const uLong crc = crc32(0, reinterpret_cast<const Bytef*>(chunk.input.data()), static_cast<uInt>(chunk.input.size()));
+    StoreLittleEndian32(out + size, static_cast<uint32_t>(crc));
+    StoreLittleEndian32(out + size + 4, static_cast<uint32_t>(chunk.input.size()));
+    size += MemberTrailerSize;
+    StoreLittleEndian32(out + MemberHeaderSize - 4, static_cast<uint32_t>(size));
+    chunk.outputSize = size;
+}
+
+[[noreturn]] void ThrowCorrupt(uint64_t sequence, const char* reason) {
+    throw std::runtime_error("Archive chunk " + std::to_string(sequence) + " is corrupt: " + reason);
+}
+
+void DecompressChunk(Chunk& chunk) {
+    const char* member = chunk.input.data();
+    const size_t size = chunk.input.size();
+    const uint32_t expectedCrc = LoadLittleEndian32(member + size - MemberTrailerSize);
+    const uint32_t expectedSize = LoadLittleEndian32(member + size - 4);
+    if (expectedSize > MaxChunkSize) {
+        ThrowCorrupt(chunk.sequence, "chunk is too large");
+    }
+    // One byte spare: zlib makes no progress into an empty buffer, even for
+    // an empty member, and a member that inflates past its size shows up.
+    if (chunk.output.size() <= expectedSize) {
+        chunk.output.resize(expectedSize + 1);
+    }
+
+    z_stream& stream = Inflater::ForThread().Stream();
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(member + MemberHeaderSize));
+    stream.avail_in = static_cast<uInt>(size - MemberHeaderSize - MemberTrailerSize);
+    stream.next_out = reinterpret_cast<Bytef*>(chunk.output.data());
+    stream.avail_out = static_cast<uInt>(chunk.output.size());
+    const int result = inflate(&stream, Z_FINISH);
+    if (result != Z_STREAM_END || stream.avail_in != 0 || stream.total_out != expectedSize) {
+        ThrowCorrupt(chunk.sequence, "bad deflate data");
+    }
+    if (crc32(0, reinterpret_cast<const Bytef*>(chunk.output.data()), expectedSize) != expectedCrc) {
+        ThrowCorrupt(chunk.sequence, "checksum mismatch");
+    }
+    chunk.outputSize = expectedSize;
+}
+
+// Anything that is not an indexed member stream: plain gzip (possibly
+// several members) or uncompressed data. prefix holds bytes already
+// read from input.
+void DecompressSerially(const char* prefix, size_t prefixSize, ByteSource& input, ByteSink& output,
+                        StreamProgress& progress, const ProgressCallback& callback) {
+    constexpr size_t BufferSize = 256 * 1024;
+    std::vector<char> in(BufferSize);
+    std::vector<char> out(BufferSize);
+    std::memcpy(in.data(), prefix, prefixSize);
+    size_t available = prefixSize + input.ReadFully(in.data() + prefixSize, BufferSize - prefixSize);
+
+    // A zlib header is not checked for: two bytes are too weak a signature
+    // to tell one from the start of a tar stream.
+    const bool gzip = available > 1 && static_cast<unsigned char>(in[0]) == 0x1F &&
+                      static_cast<unsigned char>(in[1]) == 0x8B;
+    if (!gzip) {
+        while (available > 0) {
+            output.Write(in.data(), available);
+            progress.inputBytes += available;
+            progress.outputBytes += available;
+            if (callback) {
+                callback(progress);
+            }
+            available = input.Read(in.data(), BufferSize);
+        }
+        return;
+    }
+
+    z_stream stream{};
+    // 16 + MAX_WBITS expects a gzip wrapper and checks its CRC.
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("Failed to initialise zlib");
+    }
+    struct End {
+        z_stream& stream;
+        ~End() { inflateEnd(&stream); }
+    } end{stream};
+
+    stream.next_in = reinterpret_cast<Bytef*>(in.data());
+    stream.avail_in = static_cast<uInt>(available);
+    for (;;) {
+        if (stream.avail_in == 0) {
+            progress.inputBytes += available;
+            available = input.Read(in.data(), BufferSize);
+            if (available == 0) {
+                throw std::runtime_error("Archive is truncated");
+            }
+            stream.next_in = reinterpret_cast<Bytef*>(in.data());
+            stream.avail_in = static_cast<uInt>(available);
+        }
+
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = static_cast<uInt>(BufferSize);
+        const int result = inflate(&stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            throw std::runtime_error(std::string("Archive is corrupt: ") + (stream.msg ? stream.msg : "bad data"));
+        }
+        const size_t produced = BufferSize - stream.avail_out;
+        if (produced > 0) {
+            output.Write(out.data(), produced);
+            progress.outputBytes += produced;
+            if (callback) {
+                callback(progress);
+            }
+        }
+
+        if (result == Z_STREAM_END) {
+            // Concatenated members continue the same stream.
+            if (stream.avail_in == 0) {
+                progress.inputBytes += available;
+                available = input.Read(in.data(), BufferSize);
+                if (available == 0) {
+                    return;
+                }
+                stream.next_in = reinterpret_cast<Bytef*>(in.data());
+                stream.avail_in = static_cast<uInt>(available);
+            }
+            inflateReset(&stream);
+        }
+    }
+}
+
+} // namespace
+
+class GzipCompressor::Impl {
+public:
+    Impl(ByteSink& output, GzipOptions options)
+        : output_(output),
+          options_(std::move(options)),
+          workers_(WorkerCount(options_.workers),
+                   [level = options_.level](Chunk& chunk) { CompressChunk(chunk, level); },
+                   [this](Chunk& chunk) { Emit(chunk); }) {
+    }
+
+    void Write(const char* data, size_t size) {
+        if (finished_) {
+            throw std::logic_error("Write after Finish");
+        }
+        while (size > 0) {
+            if (!current_) {
+                current_ = workers_.Acquire();
+                current_->input.reserve(options_.chunkSize);
+            }
+            const size_t take = std::min(size, options_.chunkSize - current_->input.size());
+            current_->input.insert(current_->input.end(), data, data + take);
+            data += take;
+            size -= take;
+            if (current_->input.size() == options_.chunkSize) {
+                workers_.Submit(std::move(current_));
+                ++submitted_;
+            }
+        }
+    }
+
+    void Finish() {
+        if (finished_) {
+            return;
+        }
+        // An empty stream still gets one (empty) member, so it is valid gzip.
+        if (current_ || submitted_ == 0) {
+            workers_.Submit(current_ ? std::move(current_) : workers_.Acquire());
+        }
+        workers_.Drain();
+        finished_ = true;
+        output_.Finish();
+    }
+
+    StreamProgress Progress() const { return progress_; }
+
+private:
+    void Emit(Chunk& chunk) {
+        output_.Write(chunk.output.data(), chunk.outputSize);
+        progress_.inputBytes += chunk.input.size();
+        progress_.outputBytes += chunk.outputSize;
+        ++progress_.chunks;
+        if (options_.progress) {
+            options_.progress(progress_);
+        }
+    }
+
+    ByteSink& output_;
+    GzipOptions options_;
+    StreamProgress progress_;
+    std::unique_ptr<Chunk> current_;
+    uint64_t submitted_ = 0;
+    bool finished_ = false;
+
+    // Last, so its threads stop before the members they use go away.
+    ChunkWorkers workers_;
+};
+
+GzipCompressor::GzipCompressor(ByteSink& output, GzipOptions options) {
+    if (options.chunkSize < MinChunkSize || options.chunkSize > MaxChunkSize) {
+        throw std::invalid_argument("Chunk size must be between 64 KiB and 64 MiB");
+    }
+    if (options.level < 1 || options.level > 9) {
+        throw std::invalid_argument("Compression level must be between 1 and 9");
+    }
+    pImpl_ = std::make_unique<Impl>(output, std::move(options));
+}
+
+GzipCompressor::~GzipCompressor() = default;
+
+void GzipCompressor::Write(const char* data, size_t size) {
+    pImpl_->Write(data, size);
+}
+
+void GzipCompressor::Finish() {
+    pImpl_->Finish();
+}
+
+StreamProgress GzipCompressor::Progress() const {
+    return pImpl_->Progress();
+}
+
+void GzipDecompress(ByteSource& input, ByteSink& output, GzipOptions options) {
+    StreamProgress progress;
+    auto emit = [&](Chunk& chunk) {
+        output.Write(chunk.output.data(), chunk.outputSize);
+        progress.inputBytes += chunk.input.size();
+        progress.outputBytes += chunk.outputSize;
+        ++progress.chunks;
+        if (options.progress) {
+            options.progress(progress);
+        }
+    };
+    ChunkWorkers workers(WorkerCount(options.workers), DecompressChunk, emit);
+
+    char header[MemberHeaderSize];
+    size_t headerSize = input.ReadFully(header, sizeof(header));
+    while (IsIndexedMember(header, headerSize)) {
+        const uint32_t memberSize = LoadLittleEndian32(header + MemberHeaderSize - 4);
+        std::unique_ptr<Chunk> chunk = workers.Acquire();
+        if (memberSize < MemberHeaderSize + MemberTrailerSize || memberSize > MaxMemberSize) {
+            ThrowCorrupt(chunk->sequence, "bad member length");
+        }
+
+        chunk->input.resize(memberSize);
+        std::memcpy(chunk->input.data(), header, sizeof(header));
+        const size_t body = memberSize - MemberHeaderSize;
+        if (input.ReadFully(chunk->input.data() + MemberHeaderSize, body) != body) {
+            ThrowCorrupt(chunk->sequence, "archive is truncated");
+        }
+        workers.Submit(std::move(chunk));
+
+        headerSize = input.ReadFully(header, sizeof(header));
+    }
+    workers.Drain();
+
+    // Whatever follows the indexed members, if anything, is read serially.
+    if (headerSize > 0) {
+        DecompressSerially(header, headerSize, input, output, progress, options.progress);
+    }
+    output.Finish();
+}
+
+} // namespace WSL
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "bytestream.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace WSL {
+
+struct GzipOptions {
+    // Uncompressed bytes per gzip member. Each member is compressed on its
+    // own, so this is the unit of parallelism and of corruption.
+    size_t chunkSize = 4 * 1024 * 1024;
+
+    // Compression threads; 0 means one per hardware thread.
+    size_t workers = 0;
+
+    // zlib level, 1 (fastest) to 9.
+    int level = 3;
+
+    ProgressCallback progress;
+};
+
+// Compresses everything written to it into a gzip stream of independent
+// members, one per chunk, compressed in parallel and written in order. Any
+// gzip reader accepts the result; each member also records its own length
+// so GzipDecompressor can split the stream up again without inflating it.
+// At most two chunks per worker are held, whatever the stream's size.
+class GzipCompressor : public ByteSink {
+public:
+    GzipCompressor(ByteSink& output, GzipOptions options = {});
+
+    // Abandons anything not yet Finish()ed.
+    ~GzipCompressor() override;
+
+    // Non-copyable, non-movable
+    GzipCompressor(const GzipCompressor&) = delete;
+    GzipCompressor& operator=(const GzipCompressor&) = delete;
+    GzipCompressor(GzipCompressor&&) = delete;
+    GzipCompressor& operator=(GzipCompressor&&) = delete;
+
+    // Blocks while every worker's chunks are still in flight.
+    void Write(const char* data, size_t size) override;
+    void Finish() override;
+
+    StreamProgress Progress() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+// Reads a gzip stream and writes what it inflates to the output. Members
+// that carry their length (as GzipCompressor writes them) are inflated in
+// parallel and their CRC-32 and length checked one by one; any other gzip
+// stream is inflated serially, and input that is not gzip at all is copied
+// through. Throws std::runtime_error naming the chunk that failed to verify.
+void GzipDecompress(ByteSource& input, ByteSink& output, GzipOptions options = {});
+
+} // namespace WSL
@@ -0,0 +1,471 @@
+#include "portdiscovery.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <cerrno>
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+// The "st" column of /proc/net/tcp for TCP_LISTEN.
+constexpr std::string_view ListenStateHex = "0A";
+
+// Large enough for a dump of a few hundred listeners per recv().
+constexpr size_t ReceiveBufferSize = 64 * 1024;
+
+int HexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+bool ParseHex(std::string_view text, uint32_t& value) {
+    if (text.empty() || text.size() > 8) {
+        return false;
+    }
+    value = 0;
+    for (const char c : text) {
+        const int digit = HexDigit(c);
+        if (digit < 0) {
+            return false;
+        }
+        value = value << 4 | static_cast<uint32_t>(digit);
+    }
+    return true;
+}
+
+// Next space-separated field of line, advancing past it.
+std::string_view NextField(std::string_view& line) {
+    const size_t start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    const size_t end = line.find(' ', start);
+    const std::string_view field = line.substr(start, end - start);
+    line = end == std::string_view::npos ? std::string_view{} : line.substr(end);
+    return field;
+}
+
+// "0100007F:1F90": the address as 32-bit words in the kernel's byte order
+// (little-endian on every architecture WSL runs), then the port.
+bool ParseLocalAddress(std::string_view field, int family, ListeningPort& port) {
+    const size_t colon = field.find(':');
+    const size_t words = family == AF_INET6 ? 4 : 1;
+    if (colon != words * 8) {
+        return false;
+    }
+
+    uint32_t value = 0;
+    for (size_t i = 0; i < words; ++i) {
+        if (!ParseHex(field.substr(i * 8, 8), value)) {
+            return false;
+        }
+        for (size_t byte = 0; byte < 4; ++byte) {
+            port.address[i * 4 + byte] = static_cast<uint8_t>(value >> (8 * byte));
+        }
+    }
+    if (!ParseHex(field.substr(colon + 1), value) || value > UINT16_MAX) {
+        return false;
+    }
+    port.family = family;
+    port.port = static_cast<uint16_t>(value);
+    return true;
+}
+
+// Appends the listeners in a /proc/net/tcp or tcp6 listing. Other sockets
+// are dismissed on their state column before anything is converted.
+void ParseProcNet(std::string_view contents, int family, std::vector<ListeningPort>& ports) {
+    size_t next = contents.find('\n'); // header
+    while (next != std::string_view::npos) {
+        const size_t start = next + 1;
+        next = contents.find('\n', start);
+        std::string_view line = contents.substr(start, next == std::string_view::npos ? next : next - start);
+
+        NextField(line); // "sl:"
+        const std::string_view local = NextField(line);
+        NextField(line); // remote
+        if (NextField(line) != ListenStateHex) {
+            continue;
+        }
+
+        ListeningPort port;
+        if (ParseLocalAddress(local, family, port)) {
+            ports.push_back(port);
+        }
+    }
+}
+
+bool ReadFile(const std::string& path, std::string& contents) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    // procfs reports a size of zero, so read until EOF.
+    contents.clear();
+    char buffer[16384];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+    const bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+// Sorted and unique: SO_REUSEPORT groups list one socket per member.
+void Normalize(std::vector<ListeningPort>& ports) {
+    std::sort(ports.begin(), ports.end());
+    ports.erase(std::unique(ports.begin(), ports.end()), ports.end());
+}
+
+#ifndef _WIN32
+
+// A netlink socket kept open across scans.
+class SockDiagScanner {
+public:
+    SockDiagScanner() {
+        fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to open sock_diag");
+        }
+        buffer_.resize(ReceiveBufferSize);
+    }
+
+    ~SockDiagScanner() { close(fd_); }
+
+    // Non-copyable, non-movable
+    SockDiagScanner(const SockDiagScanner&) = delete;
+    SockDiagScanner& operator=(const SockDiagScanner&) = delete;
+    SockDiagScanner(SockDiagScanner&&) = delete;
+    SockDiagScanner& operator=(SockDiagScanner&&) = delete;
+
+    // False on a failure partway, when the result would be incomplete.
+    bool Scan(std::vector<ListeningPort>& ports) {
+        ports.clear();
+        return Dump(AF_INET, ports) && Dump(AF_INET6, ports);
+    }
+
+private:
+    bool Dump(int family, std::vector<ListeningPort>& ports) {
+        struct {
+            nlmsghdr header;
+            inet_diag_req_v2 request;
+        } message = {};
+        message.header.nlmsg_len = sizeof(message);
+        message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+        message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        message.header.nlmsg_seq = ++sequence_;
+        message.request.sdiag_family = static_cast<uint8_t>(family);
+        message.request.sdiag_protocol = IPPROTO_TCP;
+
+        // Listeners only: the kernel then answers from its listening hash
+        // and never walks the established one.
+        message.request.idiag_states = 1u << TCP_LISTEN;
+
+        sockaddr_nl kernel = {};
+        kernel.nl_family = AF_NETLINK;
+        if (sendto(fd_, &message, sizeof(message), 0, reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+            return false;
+        }
+
+        for (;;) {
+            const ssize_t received = recv(fd_, buffer_.data(), buffer_.size(), 0);
+            if (received < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+
+            int length = static_cast<int>(received);
+            for (auto* header = reinterpret_cast<const nlmsghdr*>(buffer_.data()); NLMSG_OK(header, length);
+                 header = NLMSG_NEXT(header, length)) {
+                if (header->nlmsg_seq != sequence_) {
+                    continue;
+                }
+                if (header->nlmsg_type == NLMSG_DONE) {
+                    return true;
+                }
+                if (header->nlmsg_type == NLMSG_ERROR) {
+                    return false;
+                }
+
+                const auto* socket = static_cast<const inet_diag_msg*>(NLMSG_DATA(header));
+                ListeningPort port;
+                port.family = socket->idiag_family;
+                port.port = ntohs(socket->id.idiag_sport);
+                std::memcpy(port.address.data(), socket->id.idiag_src, socket->idiag_family == AF_INET6 ? 16 : 4);
+                ports.push_back(port);
+            }
+        }
+    }
+
+    int fd_ = -1;
+    uint32_t sequence_ = 0;
+    std::vector<char> buffer_;
+};
+
+#endif
+
+} // namespace
+
+bool ListeningPort::IsWildcard() const {
+    const size_t size = family == AF_INET6 ? 16 : 4;
+    return std::all_of(address.begin(), address.begin() + size, [](uint8_t byte) { return byte == 0; });
+}
+
+bool ListeningPort::IsLoopback() const {
+    if (family == AF_INET) {
+        return address[0] == 127;
+    }
+    static constexpr std::array<uint8_t, 16> loopback = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+    static constexpr std::array<uint8_t, 12> mappedPrefix = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return address == loopback ||
+           (std::equal(mappedPrefix.begin(), mappedPrefix.end(), address.begin()) && address[12] == 127);
+}
+
+std::string ListeningPort::Address() const {
+    char text[64];
+    if (family != AF_INET6) {
+        std::snprintf(text, sizeof(text), "%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+        return text;
+    }
+
+    // RFC 5952: lowercase, the longest run of two or more zero groups as "::".
+    uint16_t groups[8];
+    for (size_t i = 0; i < 8; ++i) {
+        groups[i] = static_cast<uint16_t>(address[i * 2] << 8 | address[i * 2 + 1]);
+    }
+    size_t bestStart = 8, bestLength = 0;
+    for (size_t i = 0; i < 8;) {
+        size_t length = 0;
+        while (i + length < 8 && groups[i + length] == 0) {
+            ++length;
+        }
+        if (length > bestLength && length > 1) {
+            bestStart = i;
+            bestLength = length;
+        }
+        i += std::max<size_t>(length, 1);
+    }
+
+    std::string result;
+    for (size_t i = 0; i < 8; ++i) {
+        if (i == bestStart) {
+            result += "::";
+            i += bestLength - 1;
+            continue;
+        }
+        if (!result.empty() && result.back() != ':') {
+            result += ':';
+        }
+        std::snprintf(text, sizeof(text), "%x", groups[i]);
+        result += text;
+    }
+    return result;
+}
+
+class PortDiscovery::Impl {
+public:
+    Impl(PortCallback callback, const PortDiscoveryOptions& options)
+        : callback_(std::move(callback)), options_(options), source_(options.source) {
+#ifdef _WIN32
+        if (source_ == PortSource::SockDiag) {
+            throw std::system_error(std::make_error_code(std::errc::not_supported), "sock_diag is Linux only");
+        }
+        source_ = PortSource::ProcNet;
+#else
+        if (source_ != PortSource::ProcNet) {
+            // Some sandboxes refuse the dump rather than the socket, so Auto
+            // tries one before settling on it.
+            try {
+                scanner_ = std::make_unique<SockDiagScanner>();
+                std::vector<ListeningPort> probe;
+                if (!scanner_->Scan(probe)) {
+                    throw std::system_error(errno, std::generic_category(), "Failed to dump listening sockets");
+                }
+                source_ = PortSource::SockDiag;
+            } catch (const std::system_error&) {
+                if (source_ == PortSource::SockDiag) {
+                    throw;
+                }
+                scanner_.reset();
+                source_ = PortSource::ProcNet;
+            }
+        }
+#endif
+        if (options_.interval.count() == 0) {
+            options_.interval = source_ == PortSource::SockDiag ? SockDiagInterval : ProcNetInterval;
+        }
+    }
+
+    ~Impl() { Stop(); }
+
+    void Start() {
+        if (thread_.joinable()) {
+            return;
+        }
+        stop_ = false;
+        thread_ = std::thread([this] {
+            std::unique_lock<std::mutex> guard(stopLock_);
+            while (!stop_) {
+                guard.unlock();
+                Poll();
+                guard.lock();
+                stopSignal_.wait_for(guard, options_.interval, [this] { return stop_; });
+            }
+        });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> guard(stopLock_);
+            stop_ = true;
+        }
+        stopSignal_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    size_t Poll() {
+        if (!Scan(scanned_)) {
+            return 0; // keep the last good set rather than report everything gone
+        }
+        Normalize(scanned_);
+
+        // Both sorted: one merge pass finds what changed.
+        changes_.clear();
+        auto before = current_.begin();
+        auto after = scanned_.begin();
+        while (before != current_.end() || after != scanned_.end()) {
+            if (after == scanned_.end() || (before != current_.end() && *before < *after)) {
+                changes_.emplace_back(PortChange::Removed, *before++);
+            } else if (before == current_.end() || *after < *before) {
+                changes_.emplace_back(PortChange::Added, *after++);
+            } else {
+                ++before;
+                ++after;
+            }
+        }
+
+        if (!changes_.empty()) {
+            std::lock_guard<std::mutex> guard(portsLock_);
+            current_.swap(scanned_);
+        }
+        for (const auto& [change, port] : changes_) {
+            callback_(change, port);
+        }
+        return changes_.size();
+    }
+
+    PortSource Source() const { return source_; }
+
+    std::chrono::milliseconds Interval() const { return options_.interval; }
+
+    std::vector<ListeningPort> Ports() const {
+        std::lock_guard<std::mutex> guard(portsLock_);
+        return current_;
+    }
+
+private:
+    bool Scan(std::vector<ListeningPort>& ports) {
+#ifndef _WIN32
+        if (scanner_) {
+            return scanner_->Scan(ports);
+        }
+#endif
+        // tcp6 is missing when IPv6 is disabled; only both missing is a failure.
+        ports.clear();
+        const bool v4 = ReadFile(options_.procRoot + "/net/tcp", contents_);
+        if (v4) {
+            ParseProcNet(contents_, AF_INET, ports);
+        }
+        const bool v6 = ReadFile(options_.procRoot + "/net/tcp6", contents_);
+        if (v6) {
+            ParseProcNet(contents_, AF_INET6, ports);
+        }
+        return v4 || v6;
+    }
+
+    PortCallback callback_;
+    PortDiscoveryOptions options_;
+    PortSource source_;
+#ifndef _WIN32
+    std::unique_ptr<SockDiagScanner> scanner_;
+#endif
+
+    // Scan state, touched only by whichever thread polls; kept across scans
+    // so a steady state allocates nothing.
+    std::vector<ListeningPort> scanned_;
+    std::vector<std::pair<PortChange, ListeningPort>> changes_;
+    std::string contents_;
+
+    mutable std::mutex portsLock_;
+    std::vector<ListeningPort> current_;
+
+    std::mutex stopLock_;
+    std::condition_variable stopSignal_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+PortDiscovery::PortDiscovery(PortCallback callback, const PortDiscoveryOptions& options)
+    : pImpl_(std::make_unique<Impl>(std::move(callback), options)) {}
+
+PortDiscovery::~PortDiscovery() = default;
+
+void PortDiscovery::Start() {
+    pImpl_->Start();
+}
+
+void PortDiscovery::Stop() {
+    pImpl_->Stop();
+}
+
+size_t PortDiscovery::Poll() {
+    return pImpl_->Poll();
+}
+
+PortSource PortDiscovery::Source() const {
+    return pImpl_->Source();
+}
+
+std::chrono::milliseconds PortDiscovery::Interval() const {
+    return pImpl_->Interval();
+}
+
+std::vector<ListeningPort> PortDiscovery::Ports() const {
+    return pImpl_->Ports();
+}
+
+} // namespace WSL
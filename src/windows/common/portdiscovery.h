@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WSL {
+
+// A TCP socket in the LISTEN state.
+struct ListeningPort {
+    int family = 0;                   // AF_INET or AF_INET6
+    std::array<uint8_t, 16> address{}; // network order; IPv4 uses the first 4 bytes
+    uint16_t port = 0;
+
+    // 0.0.0.0 or ::, i.e. reachable on every address.
+    bool IsWildcard() const;
+    bool IsLoopback() const;
+
+    // 127.0.0.1, ::1 and so on.
+    std::string Address() const;
+
+    auto operator<=>(const ListeningPort&) const = default;
+};
+
+enum class PortChange {
+    Added,
+    Removed
+};
+
+using PortCallback = std::function<void(PortChange change, const ListeningPort& port)>;
+
+enum class PortSource {
+    Auto,     // SockDiag where the kernel allows it, otherwise ProcNet
+    SockDiag, // netlink inet_diag dump of listeners only (Linux)
+    ProcNet   // <procRoot>/net/tcp and tcp6
+};
+
+// Default intervals between scans. A sock_diag scan asks for listeners alone
+// and is cheap enough that 50 ms keeps new ports well under 100 ms from bind
+// to forward. A /proc/net/tcp scan reads every socket, and over a
+// \\wsl.localhost share that costs a large share of a core at 10k sockets
+// if done every 50 ms, so it polls once a second instead.
+inline constexpr std::chrono::milliseconds SockDiagInterval{50};
+inline constexpr std::chrono::milliseconds ProcNetInterval{1000};
+
+struct PortDiscoveryOptions {
+    // Between scans; zero picks SockDiagInterval or ProcNetInterval for the
+    // source in use.
+    std::chrono::milliseconds interval{0};
+
+    PortSource source = PortSource::Auto;
+
+    // For ProcNet. On Windows, a distribution's /proc over its share, e.g.
+    // \\wsl.localhost\Ubuntu\proc.
+    std::string procRoot = "/proc";
+};
+
+// Watches for TCP listeners and reports each one that appears or goes away,
+// for the relay to forward. The kernel offers no notification of new
+// listeners short of eBPF, so this polls, but only the listeners: the
+// sock_diag request asks the kernel for LISTEN sockets alone, which it
+// answers from its listener table without walking established connections,
+// so the cost does not grow with the thousands of connections a busy
+// distribution holds. Each scan is diffed against the previous one and
+// only the difference is reported.
+//
+// /proc/net/tcp lists every socket and is the fallback where netlink is
+// unavailable; a scan skips non-listeners without parsing them.
+class PortDiscovery {
+public:
+    // Throws std::system_error if SockDiag is asked for and unavailable.
+    explicit PortDiscovery(PortCallback callback, const PortDiscoveryOptions& options = {});
+
+    // Stops first.
+    ~PortDiscovery();
+
+    // Non-copyable, non-movable
+    PortDiscovery(const PortDiscovery&) = delete;
+    PortDiscovery& operator=(const PortDiscovery&) = delete;
+    PortDiscovery(PortDiscovery&&) = delete;
+    PortDiscovery& operator=(PortDiscovery&&) = delete;
+
+    // Scans on a background thread, every interval, reporting from it. The
+    // first scan reports every listener already there as Added.
+    void Start();
+
+    // Joins the thread; listeners still present are not reported as
+    // removed. Safe to call twice.
+    void Stop();
+
+    // One scan and diff on the calling thread, for callers with their own
+    // loop. Returns the number of changes reported. Not to be mixed with
+    // Start().
+    size_t Poll();
+
+    // The source in use, after Auto has been resolved.
+    PortSource Source() const;
+
+    // Between scans, after a zero interval has been resolved.
+    std::chrono::milliseconds Interval() const;
+
+    // As of the last scan, sorted.
+    std::vector<ListeningPort> Ports() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
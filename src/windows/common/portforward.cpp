@@ -0,0 +1,1374 @@
+#include "portforward.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+struct SocketAddress {
+    sockaddr_storage storage{};
+    socklen_t length = 0;
+
+    int Family() const { return storage.ss_family; }
+    const sockaddr* Get() const { return reinterpret_cast<const sockaddr*>(&storage); }
+
+    void SetPort(uint16_t port) {
+        if (storage.ss_family == AF_INET6) {
+            reinterpret_cast<sockaddr_in6*>(&storage)->sin6_port = htons(port);
+        } else {
+            reinterpret_cast<sockaddr_in*>(&storage)->sin_port = htons(port);
+        }
+    }
+};
+
+// The first address getaddrinfo offers. An empty host is the wildcard for
+// listening and loopback otherwise.
+SocketAddress Resolve(const std::string& host, uint16_t port, bool passive) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    addrinfo* result = nullptr;
+    const std::string service = std::to_string(port);
+    const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &result);
+    if (error != 0 || !result) {
+        throw std::runtime_error("Failed to resolve " + host + ": " + std::to_string(error));
+    }
+
+    SocketAddress address;
+    std::memcpy(&address.storage, result->ai_addr, result->ai_addrlen);
+    address.length = static_cast<socklen_t>(result->ai_addrlen);
+    freeaddrinfo(result);
+    return address;
+}
+
+uint16_t BoundPort(const SocketAddress& address) {
+    if (address.Family() == AF_INET6) {
+        return ntohs(reinterpret_cast<const sockaddr_in6*>(&address.storage)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<const sockaddr_in*>(&address.storage)->sin_port);
+}
+
+size_t ThreadCount(const PortForwardOptions& options) {
+    if (options.threads > 0) {
+        return options.threads;
+    }
+    return std::clamp<size_t>(std::thread::hardware_concurrency(), 1, 4);
+}
+
+// Fixed-size buffers, handed out while a direction has bytes in flight and
+// kept for reuse once drained. Not thread-safe; each owner serialises.
+class BufferPool {
+public:
+    BufferPool(size_t size, size_t keep) : size_(std::max<size_t>(size, 1)), keep_(keep) {}
+
+    size_t Size() const { return size_; }
+
+    char* Acquire() {
+        if (free_.empty()) {
+            allocated_.fetch_add(1, std::memory_order_relaxed);
+            return new char[size_];
+        }
+        char* buffer = free_.back().release();
+        free_.pop_back();
+        return buffer;
+    }
+
+    void Release(char* buffer) {
+        if (free_.size() < keep_) {
+            free_.emplace_back(buffer);
+        } else {
+            delete[] buffer;
+        }
+    }
+
+    uint64_t Allocated() const { return allocated_.load(std::memory_order_relaxed); }
+
+private:
+    size_t size_;
+    size_t keep_;
+    std::vector<std::unique_ptr<char[]>> free_;
+    std::atomic<uint64_t> allocated_{0};
+};
+
+// Per-loop counters, summed by GetStats().
+struct alignas(64) ForwardCounters {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> active{0};
+    std::atomic<uint64_t> connectFailures{0};
+    std::atomic<uint64_t> bytesToTarget{0};
+    std::atomic<uint64_t> bytesToClient{0};
+
+    void AddTo(PortForwardStats& stats) const {
+        stats.accepted += accepted.load(std::memory_order_relaxed);
+        stats.active += active.load(std::memory_order_relaxed);
+        stats.connectFailures += connectFailures.load(std::memory_order_relaxed);
+        stats.bytesToTarget += bytesToTarget.load(std::memory_order_relaxed);
+        stats.bytesToClient += bytesToClient.load(std::memory_order_relaxed);
+    }
+};
+
+#ifdef _WIN32
+
+constexpr ULONG_PTR ListenerKey = 1;
+constexpr ULONG_PTR ConnectionKey = 2;
+constexpr ULONG_PTR StopKey = 3;
+
+// AcceptEx calls kept posted per listener, so bursts of connections do not
+// wait on the accept completion being handled.
+constexpr size_t AcceptsPerListener = 16;
+constexpr DWORD AddressLength = sizeof(sockaddr_storage) + 16;
+
+[[noreturn]] void ThrowSocketError(const char* what) {
+    throw std::runtime_error(std::string(what) + ": " + std::to_string(WSAGetLastError()));
+}
+
+enum class OperationKind {
+    Connect,
+    Read,
+    Write
+};
+
+struct Connection;
+struct Direction;
+
+struct Operation {
+    OVERLAPPED overlapped{};
+    OperationKind kind = OperationKind::Read;
+    Connection* connection = nullptr;
+    Direction* direction = nullptr;
+};
+
+// One way of a connection. Only one operation is ever outstanding per
+// direction: a zero-byte read waits for data without holding a buffer,
+// then the data is read without blocking and sent, and so on.
+struct Direction {
+    Operation operation;
+    SOCKET source = INVALID_SOCKET;
+    SOCKET sink = INVALID_SOCKET;
+    char* buffer = nullptr;
+    size_t offset = 0;
+    size_t length = 0;
+    bool done = false; // EOF seen and the sink shut down
+    bool toTarget = false;
+};
+
+struct Connection {
+    std::mutex lock;
+    SOCKET client = INVALID_SOCKET;
+    SOCKET target = INVALID_SOCKET;
+    Operation connect;
+    Direction toTarget;
+    Direction toClient;
+    size_t outstanding = 0; // guarded by lock; the last completion frees it
+    bool closed = false;
+};
+
+struct Listener;
+
+struct PendingAccept {
+    OVERLAPPED overlapped{};
+    Listener* listener = nullptr;
+    SOCKET socket = INVALID_SOCKET;
+    char addresses[2 * AddressLength] = {};
+};
+
+struct Listener {
+    SOCKET socket = INVALID_SOCKET;
+    int family = AF_INET;
+    uint16_t port = 0;
+    SocketAddress target;
+    std::vector<std::unique_ptr<PendingAccept>> accepts;
+    std::atomic<size_t> posted{0}; // accepts in flight; the last one out frees a removed listener
+    std::atomic<bool> removed{false};
+};
+
+template <typename Function>
+Function LoadExtension(SOCKET socket, GUID guid) {
+    Function function = nullptr;
+    DWORD bytes = 0;
+    if (WSAIoctl(socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &function, sizeof(function), &bytes,
+                 nullptr, nullptr) == SOCKET_ERROR) {
+        ThrowSocketError("Failed to load a Winsock extension");
+    }
+    return function;
+}
+
+void SetNoDelay(SOCKET socket) {
+    BOOL enable = TRUE;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+}
+
+class WinsockScope {
+public:
+    WinsockScope() {
+        WSADATA data = {};
+        const int error = WSAStartup(MAKEWORD(2, 2), &data);
+        if (error != 0) {
+            throw std::runtime_error("Failed to start Winsock: " + std::to_string(error));
+        }
+    }
+
+    ~WinsockScope() { WSACleanup(); }
+
+    // Non-copyable, non-movable
+    WinsockScope(const WinsockScope&) = delete;
+    WinsockScope& operator=(const WinsockScope&) = delete;
+    WinsockScope(WinsockScope&&) = delete;
+    WinsockScope& operator=(WinsockScope&&) = delete;
+};
+
+#else
+
+constexpr size_t MaxEvents = 128;
+constexpr int MaxAcceptsPerWakeup = 64;
+
+// Reads serviced per direction per wakeup before it goes to the back of the
+// ready list, so one busy connection cannot starve the rest of its loop.
+constexpr int MaxReadsPerWakeup = 16;
+
+// Largest splice into a direction's pipe; the pipe's own capacity (64 KiB
+// by default) is the real limit.
+constexpr size_t PipeChunk = 1024 * 1024;
+
+[[noreturn]] void ThrowErrno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+enum class EndpointKind {
+    Wake,
+    Listener,
+    Client,
+    Target
+};
+
+struct Connection;
+
+struct Endpoint {
+    EndpointKind kind = EndpointKind::Wake;
+    int fd = -1;
+    Connection* connection = nullptr;            // Client and Target only
+    std::shared_ptr<const SocketAddress> target; // Listener only
+    uint16_t port = 0;                           // Listener only
+};
+
+struct Pipe {
+    int read = -1;
+    int write = -1;
+};
+
+struct Direction {
+    int source = -1;
+    int sink = -1;
+
+    // Buffered: bytes at buffer + offset still to send.
+    char* buffer = nullptr;
+    size_t offset = 0;
+    size_t length = 0;
+
+    // Zero-copy: bytes sitting in the pipe still to splice out.
+    bool zeroCopy = false;
+    Pipe pipe;
+    size_t piped = 0;
+
+    bool eof = false;
+    bool shutdown = false;
+
+    bool Pending() const { return length > 0 || piped > 0; }
+};
+
+struct Connection {
+    Endpoint client;
+    Endpoint target;
+    Direction toTarget;
+    Direction toClient;
+    bool connecting = true;
+    bool closed = false;
+    bool ready = false; // queued to carry on after MaxReadsPerWakeup
+};
+
+enum class PumpResult {
+    Blocked,   // source drained or sink full; epoll will call back
+    Yielded,   // hit the read budget with more to do
+    Failed     // reset or error; tear the connection down
+};
+
+// Drained pipes kept for reuse, like buffers.
+class PipePool {
+public:
+    explicit PipePool(size_t keep) : keep_(keep) {}
+
+    ~PipePool() {
+        for (const Pipe& pipe : free_) {
+            Close(pipe);
+        }
+    }
+
+    // Non-copyable, non-movable
+    PipePool(const PipePool&) = delete;
+    PipePool& operator=(const PipePool&) = delete;
+    PipePool(PipePool&&) = delete;
+    PipePool& operator=(PipePool&&) = delete;
+
+    // Read end -1 if no pipe could be made.
+    Pipe Acquire() {
+        if (!free_.empty()) {
+            const Pipe pipe = free_.back();
+            free_.pop_back();
+            return pipe;
+        }
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+            return {};
+        }
+        return {fds[0], fds[1]};
+    }
+
+    // Pipes still holding bytes cannot be reused.
+    void Release(const Pipe& pipe, bool empty) {
+        if (empty && free_.size() < keep_) {
+            free_.push_back(pipe);
+        } else {
+            Close(pipe);
+        }
+    }
+
+private:
+    static void Close(const Pipe& pipe) {
+        close(pipe.read);
+        close(pipe.write);
+    }
+
+    size_t keep_;
+    std::vector<Pipe> free_;
+};
+
+#endif
+
+} // namespace
+
+#ifdef _WIN32
+
+class PortForwarder::Impl {
+public:
+    explicit Impl(const PortForwardOptions& options)
+        : options_(options), buffers_(options.bufferSize, options.pooledBuffers * ThreadCount(options)) {
+        iocp_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+        if (!iocp_) {
+            throw std::runtime_error("Failed to create port forward completion port: " +
+                                     std::to_string(GetLastError()));
+        }
+
+        SOCKET probe = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (probe == INVALID_SOCKET) {
+            CloseHandle(iocp_);
+            ThrowSocketError("Failed to create a socket");
+        }
+        try {
+            acceptEx_ = LoadExtension<LPFN_ACCEPTEX>(probe, WSAID_ACCEPTEX);
+            connectEx_ = LoadExtension<LPFN_CONNECTEX>(probe, WSAID_CONNECTEX);
+        } catch (...) {
+            closesocket(probe);
+            CloseHandle(iocp_);
+            throw;
+        }
+        closesocket(probe);
+    }
+
+    ~Impl() {
+        Stop();
+        CloseHandle(iocp_);
+    }
+
+    uint16_t AddForward(const std::string& listenAddress, uint16_t listenPort, const std::string& targetHost,
+                        uint16_t targetPort) {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        auto listener = std::make_unique<Listener>();
+        const SocketAddress local = Resolve(listenAddress, listenPort, true);
+        listener->target = Resolve(targetHost, targetPort, false);
+        listener->family = local.Family();
+
+        listener->socket = WSASocketW(local.Family(), SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+        if (listener->socket == INVALID_SOCKET) {
+            ThrowSocketError("Failed to create a listening socket");
+        }
+
+        SocketAddress bound = local;
+        bound.length = static_cast<socklen_t>(sizeof(bound.storage));
+        if (bind(listener->socket, local.Get(), local.length) == SOCKET_ERROR ||
+            listen(listener->socket, options_.backlog) == SOCKET_ERROR ||
+            getsockname(listener->socket, reinterpret_cast<sockaddr*>(&bound.storage), &bound.length) == SOCKET_ERROR ||
+            !CreateIoCompletionPort(reinterpret_cast<HANDLE>(listener->socket), iocp_, ListenerKey, 0)) {
+            const int error = WSAGetLastError();
+            closesocket(listener->socket);
+            throw std::runtime_error("Failed to listen on port " + std::to_string(listenPort) + ": " +
+                                     std::to_string(error));
+        }
+
+        listener->port = BoundPort(bound);
+        for (size_t i = 0; i < AcceptsPerListener; ++i) {
+            auto accept = std::make_unique<PendingAccept>();
+            accept->listener = listener.get();
+            listener->accepts.push_back(std::move(accept));
+        }
+
+        Listener& added = *listener;
+        {
+            std::lock_guard<std::mutex> listeners(listenersLock_);
+            listeners_.push_back(std::move(listener));
+        }
+        if (!threads_.empty()) {
+            for (auto& accept : added.accepts) {
+                PostAccept(*accept);
+            }
+        }
+        return added.port;
+    }
+
+    bool RemoveForward(uint16_t listenPort) {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        std::lock_guard<std::mutex> listeners(listenersLock_);
+        bool found = false;
+        for (auto it = listeners_.begin(); it != listeners_.end();) {
+            Listener& listener = **it;
+            if (listener.port != listenPort || listener.removed.exchange(true)) {
+                ++it;
+                continue;
+            }
+
+            // Fails the posted accepts; the last to complete frees it.
+            found = true;
+            closesocket(listener.socket);
+            it = listener.posted.load() == 0 ? listeners_.erase(it) : it + 1;
+        }
+        return found;
+    }
+
+    void Start() {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        if (!threads_.empty()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> listeners(listenersLock_);
+            for (auto& listener : listeners_) {
+                for (auto& accept : listener->accepts) {
+                    PostAccept(*accept);
+                }
+            }
+        }
+        for (size_t i = 0; i < ThreadCount(options_); ++i) {
+            threads_.emplace_back(&Impl::Run, this);
+        }
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        if (stopping_.exchange(true)) {
+            return;
+        }
+
+        // Closing the sockets fails every posted operation; the threads see
+        // those completions out and post the stop packets once none are left.
+        {
+            std::lock_guard<std::mutex> listeners(listenersLock_);
+            for (auto& listener : listeners_) {
+                if (!listener->removed.exchange(true)) {
+                    closesocket(listener->socket);
+                }
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(connectionsLock_);
+            for (Connection* connection : connections_) {
+                std::lock_guard<std::mutex> connectionGuard(connection->lock);
+                Close(*connection);
+            }
+        }
+
+        if (threads_.empty()) {
+            return;
+        }
+        if (outstanding_.load() == 0) {
+            PostStop();
+        }
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+    }
+
+    PortForwardStats GetStats() const {
+        PortForwardStats stats;
+        counters_.AddTo(stats);
+        stats.buffersAllocated = buffers_.Allocated();
+        return stats;
+    }
+
+private:
+    void Run() {
+        for (;;) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            const BOOL ok = GetQueuedCompletionStatus(iocp_, &bytes, &key, &overlapped, INFINITE);
+            if (key == StopKey) {
+                return;
+            }
+            if (!overlapped) {
+                continue;
+            }
+
+            const DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+            if (key == ListenerKey) {
+                OnAccept(*CONTAINING_RECORD(overlapped, PendingAccept, overlapped), error);
+            } else {
+                Operation& operation = *CONTAINING_RECORD(overlapped, Operation, overlapped);
+                OnOperation(operation, bytes, error);
+            }
+
+            if (outstanding_.fetch_sub(1) == 1 && stopping_.load()) {
+                PostStop();
+            }
+        }
+    }
+
+    void PostStop() {
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            PostQueuedCompletionStatus(iocp_, 0, StopKey, nullptr);
+        }
+    }
+
+    void PostAccept(PendingAccept& accept) {
+        Listener& listener = *accept.listener;
+        accept.socket = WSASocketW(listener.family, SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+        if (accept.socket == INVALID_SOCKET) {
+            return;
+        }
+
+        accept.overlapped = {};
+        outstanding_.fetch_add(1);
+        listener.posted.fetch_add(1);
+        DWORD received = 0;
+        if (!acceptEx_(listener.socket, accept.socket, accept.addresses, 0, AddressLength, AddressLength, &received,
+                       &accept.overlapped) &&
+            WSAGetLastError() != ERROR_IO_PENDING) {
+            listener.posted.fetch_sub(1);
+            outstanding_.fetch_sub(1);
+            closesocket(accept.socket);
+            accept.socket = INVALID_SOCKET;
+        }
+    }
+
+    void OnAccept(PendingAccept& accept, DWORD error) {
+        Listener& listener = *accept.listener;
+        SOCKET client = std::exchange(accept.socket, INVALID_SOCKET);
+        if (error != ERROR_SUCCESS || listener.removed.load()) {
+            closesocket(client);
+        } else {
+            setsockopt(client, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, reinterpret_cast<const char*>(&listener.socket),
+                       sizeof(listener.socket));
+            counters_.accepted.fetch_add(1, std::memory_order_relaxed);
+            Connect(client, listener.target);
+        }
+
+        // The replacement is posted before this one is let go, so the count
+        // only reaches zero once the listener is closed.
+        if (!listener.removed.load()) {
+            PostAccept(accept);
+        }
+        if (listener.posted.fetch_sub(1) == 1 && listener.removed.load() && !stopping_.load()) {
+            std::lock_guard<std::mutex> listeners(listenersLock_);
+            std::erase_if(listeners_, [&listener](const auto& entry) { return entry.get() == &listener; });
+        }
+    }
+
+    void Connect(SOCKET client, const SocketAddress& target) {
+        SOCKET upstream = WSASocketW(target.Family(), SOCK_STREAM, IPPROTO_TCP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+
+        // ConnectEx needs a bound socket.
+        SocketAddress any;
+        any.storage.ss_family = static_cast<ADDRESS_FAMILY>(target.Family());
+        any.length = static_cast<socklen_t>(target.Family() == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in));
+        if (upstream == INVALID_SOCKET || bind(upstream, any.Get(), any.length) == SOCKET_ERROR ||
+            !CreateIoCompletionPort(reinterpret_cast<HANDLE>(client), iocp_, ConnectionKey, 0) ||
+            !CreateIoCompletionPort(reinterpret_cast<HANDLE>(upstream), iocp_, ConnectionKey, 0)) {
+            counters_.connectFailures.fetch_add(1, std::memory_order_relaxed);
+            closesocket(client);
+            if (upstream != INVALID_SOCKET) {
+                closesocket(upstream);
+            }
+            return;
+        }
+
+        auto* connection = new Connection();
+        connection->client = client;
+        connection->target = upstream;
+        connection->connect.kind = OperationKind::Connect;
+        connection->connect.connection = connection;
+        for (Direction* direction : {&connection->toTarget, &connection->toClient}) {
+            direction->operation.connection = connection;
+            direction->operation.direction = direction;
+        }
+        connection->toTarget.toTarget = true;
+        connection->toTarget.source = client;
+        connection->toTarget.sink = upstream;
+        connection->toClient.source = upstream;
+        connection->toClient.sink = client;
+
+        {
+            std::lock_guard<std::mutex> guard(connectionsLock_);
+            connections_.push_back(connection);
+        }
+        counters_.active.fetch_add(1, std::memory_order_relaxed);
+
+        std::unique_lock<std::mutex> guard(connection->lock);
+        ++connection->outstanding;
+        outstanding_.fetch_add(1);
+        if (!connectEx_(upstream, target.Get(), target.length, nullptr, 0, nullptr, &connection->connect.overlapped) &&
+            WSAGetLastError() != ERROR_IO_PENDING) {
+            --connection->outstanding;
+            outstanding_.fetch_sub(1);
+            counters_.connectFailures.fetch_add(1, std::memory_order_relaxed);
+            Close(*connection);
+        }
+        Release(*connection, guard);
+    }
+
+    void OnOperation(Operation& operation, DWORD bytes, DWORD error) {
+        Connection& connection = *operation.connection;
+        std::unique_lock<std::mutex> guard(connection.lock);
+        --connection.outstanding;
+
+        if (connection.closed) {
+            // An operation failed by Close() coming home.
+        } else if (error != ERROR_SUCCESS) {
+            if (operation.kind == OperationKind::Connect) {
+                counters_.connectFailures.fetch_add(1, std::memory_order_relaxed);
+            }
+            Close(connection);
+        } else if (operation.kind == OperationKind::Connect) {
+            setsockopt(connection.target, SOL_SOCKET, SO_UPDATE_CONNECT_CONTEXT, nullptr, 0);
+            u_long nonBlocking = 1;
+            ioctlsocket(connection.client, FIONBIO, &nonBlocking);
+            ioctlsocket(connection.target, FIONBIO, &nonBlocking);
+            SetNoDelay(connection.client);
+            SetNoDelay(connection.target);
+            if (!PostRead(connection.toTarget) || !PostRead(connection.toClient)) {
+                Close(connection);
+            }
+        } else if (operation.kind == OperationKind::Read) {
+            Transfer(*operation.direction);
+        } else {
+            Direction& direction = *operation.direction;
+            direction.offset += bytes;
+            direction.length -= std::min<size_t>(bytes, direction.length);
+            (direction.toTarget ? counters_.bytesToTarget : counters_.bytesToClient)
+                .fetch_add(bytes, std::memory_order_relaxed);
+            if (direction.length > 0 ? !PostWrite(direction) : !Transfer(direction)) {
+                Close(connection);
+            }
+        }
+
+        Release(connection, guard);
+    }
+
+    // Reads what is there without blocking and sends it, or waits for more
+    // with a zero-byte read once the source is drained. Called with the
+    // connection locked; false means close it.
+    bool Transfer(Direction& direction) {
+        Connection& connection = *direction.operation.connection;
+        if (!direction.buffer) {
+            std::lock_guard<std::mutex> guard(buffersLock_);
+            direction.buffer = buffers_.Acquire();
+        }
+
+        const int received = recv(direction.source, direction.buffer, static_cast<int>(buffers_.Size()), 0);
+        if (received > 0) {
+            direction.offset = 0;
+            direction.length = static_cast<size_t>(received);
+            return PostWrite(direction);
+        }
+
+        const int error = received == 0 ? 0 : WSAGetLastError();
+        ReleaseBuffer(direction);
+        if (received < 0 && error == WSAEWOULDBLOCK) {
+            return PostRead(direction);
+        }
+        if (received < 0) {
+            return false;
+        }
+
+        // EOF: pass the half-close on; the other direction carries on.
+        shutdown(direction.sink, SD_SEND);
+        direction.done = true;
+        if (connection.toTarget.done && connection.toClient.done) {
+            Close(connection);
+        }
+        return true;
+    }
+
+    bool PostRead(Direction& direction) {
+        Connection& connection = *direction.operation.connection;
+        direction.operation.overlapped = {};
+        direction.operation.kind = OperationKind::Read;
+        WSABUF buffer = {0, nullptr};
+        DWORD flags = 0;
+        ++connection.outstanding;
+        outstanding_.fetch_add(1);
+        if (WSARecv(direction.source, &buffer, 1, nullptr, &flags, &direction.operation.overlapped, nullptr) ==
+                SOCKET_ERROR &&
+            WSAGetLastError() != WSA_IO_PENDING) {
+            --connection.outstanding;
+            outstanding_.fetch_sub(1);
+            return false;
+        }
+        return true;
+    }
+
+    bool PostWrite(Direction& direction) {
+        Connection& connection = *direction.operation.connection;
+        direction.operation.overlapped = {};
+        direction.operation.kind = OperationKind::Write;
+        WSABUF buffer = {static_cast<ULONG>(direction.length), direction.buffer + direction.offset};
+        ++connection.outstanding;
+        outstanding_.fetch_add(1);
+        if (WSASend(direction.sink, &buffer, 1, nullptr, 0, &direction.operation.overlapped, nullptr) ==
+                SOCKET_ERROR &&
+            WSAGetLastError() != WSA_IO_PENDING) {
+            --connection.outstanding;
+            outstanding_.fetch_sub(1);
+            return false;
+        }
+        return true;
+    }
+
+    void ReleaseBuffer(Direction& direction) {
+        if (direction.buffer) {
+            std::lock_guard<std::mutex> guard(buffersLock_);
+            buffers_.Release(std::exchange(direction.buffer, nullptr));
+        }
+        direction.offset = 0;
+        direction.length = 0;
+    }
+
+    // Closing the sockets fails whatever is outstanding; the connection is
+    // freed when the last of those completions comes back.
+    void Close(Connection& connection) {
+        if (connection.closed) {
+            return;
+        }
+        connection.closed = true;
+        closesocket(connection.client);
+        closesocket(connection.target);
+        counters_.active.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Release(Connection& connection, std::unique_lock<std::mutex>& guard) {
+        if (!connection.closed || connection.outstanding > 0) {
+            return;
+        }
+        guard.unlock();
+        {
+            std::lock_guard<std::mutex> registry(connectionsLock_);
+            std::erase(connections_, &connection);
+        }
+        ReleaseBuffer(connection.toTarget);
+        ReleaseBuffer(connection.toClient);
+        delete &connection;
+    }
+
+    PortForwardOptions options_;
+    WinsockScope winsock_;
+    HANDLE iocp_ = nullptr;
+    LPFN_ACCEPTEX acceptEx_ = nullptr;
+    LPFN_CONNECTEX connectEx_ = nullptr;
+
+    std::mutex controlLock_; // AddForward, RemoveForward, Start and Stop
+
+    std::mutex listenersLock_;
+    std::vector<std::unique_ptr<Listener>> listeners_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> outstanding_{0};
+
+    std::mutex connectionsLock_;
+    std::vector<Connection*> connections_;
+
+    std::mutex buffersLock_;
+    BufferPool buffers_;
+    ForwardCounters counters_;
+};
+
+#else
+
+class PortForwarder::Impl {
+public:
+    explicit Impl(const PortForwardOptions& options) : options_(options) {
+        const size_t count = ThreadCount(options);
+        for (size_t i = 0; i < count; ++i) {
+            auto worker = std::make_unique<Worker>(options);
+            worker->epoll = epoll_create1(EPOLL_CLOEXEC);
+            worker->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (worker->epoll < 0 || worker->wake.fd < 0) {
+                ThrowErrno("Failed to create port forward event loop");
+            }
+            Watch(*worker, worker->wake, EPOLLIN);
+            workers_.push_back(std::move(worker));
+        }
+    }
+
+    ~Impl() {
+        Stop();
+        for (auto& worker : workers_) {
+            for (auto& listener : worker->listeners) {
+                close(listener->fd);
+            }
+            close(worker->wake.fd);
+            close(worker->epoll);
+        }
+    }
+
+    uint16_t AddForward(const std::string& listenAddress, uint16_t listenPort, const std::string& targetHost,
+                        uint16_t targetPort) {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        SocketAddress local = Resolve(listenAddress, listenPort, true);
+        auto target = std::make_shared<const SocketAddress>(Resolve(targetHost, targetPort, false));
+
+        // A listener per loop on the same port; SO_REUSEPORT has the kernel
+        // spread connections across them.
+        std::vector<int> sockets;
+        try {
+            for (size_t i = 0; i < workers_.size(); ++i) {
+                const int fd = socket(local.Family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                    ThrowErrno("Failed to create a listening socket");
+                }
+                sockets.push_back(fd);
+
+                const int enable = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+                if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0 ||
+                    bind(fd, local.Get(), local.length) != 0 || listen(fd, options_.backlog) != 0) {
+                    ThrowErrno("Failed to listen on the forwarded port");
+                }
+
+                // Port 0 is resolved by the first bind; the rest share it.
+                if (BoundPort(local) == 0) {
+                    SocketAddress bound;
+                    bound.length = sizeof(bound.storage);
+                    if (getsockname(fd, reinterpret_cast<sockaddr*>(&bound.storage), &bound.length) != 0) {
+                        ThrowErrno("Failed to query the forwarded port");
+                    }
+                    local.SetPort(BoundPort(bound));
+                }
+            }
+        } catch (...) {
+            for (int fd : sockets) {
+                close(fd);
+            }
+            throw;
+        }
+
+        // A running loop picks its listener up between batches.
+        const uint16_t port = BoundPort(local);
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            Worker& worker = *workers_[i];
+            auto listener = std::make_unique<Endpoint>();
+            listener->kind = EndpointKind::Listener;
+            listener->fd = sockets[i];
+            listener->target = target;
+            listener->port = port;
+            if (worker.thread.joinable()) {
+                std::lock_guard<std::mutex> commands(worker.commandsLock);
+                worker.added.push_back(std::move(listener));
+                Wake(worker);
+            } else {
+                AddListener(worker, std::move(listener));
+            }
+        }
+        ports_.push_back(port);
+        return port;
+    }
+
+    bool RemoveForward(uint16_t listenPort) {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        if (std::erase(ports_, listenPort) == 0) {
+            return false;
+        }
+        for (auto& worker : workers_) {
+            if (worker->thread.joinable()) {
+                std::lock_guard<std::mutex> commands(worker->commandsLock);
+                worker->removed.push_back(listenPort);
+                Wake(*worker);
+            } else {
+                RemoveListeners(*worker, listenPort);
+            }
+        }
+        return true;
+    }
+
+    void Start() {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        for (auto& worker : workers_) {
+            if (!worker->thread.joinable()) {
+                worker->thread = std::thread(&Impl::Run, this, std::ref(*worker));
+            }
+        }
+    }
+
+    void Stop() {
+        std::lock_guard<std::mutex> guard(controlLock_);
+        stopping_.store(true);
+        for (auto& worker : workers_) {
+            Wake(*worker);
+        }
+        for (auto& worker : workers_) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+            for (auto& [raw, connection] : worker->connections) {
+                Close(*worker, *connection);
+            }
+            worker->connections.clear();
+            worker->closed.clear();
+            worker->ready.clear();
+            for (auto& listener : worker->listeners) {
+                close(std::exchange(listener->fd, -1));
+            }
+            worker->listeners.clear();
+            for (auto& listener : worker->added) {
+                close(listener->fd);
+            }
+            worker->added.clear();
+            worker->removed.clear();
+        }
+        ports_.clear();
+    }
+
+    PortForwardStats GetStats() const {
+        PortForwardStats stats;
+        for (const auto& worker : workers_) {
+            worker->counters.AddTo(stats);
+            stats.buffersAllocated += worker->buffers.Allocated();
+        }
+        return stats;
+    }
+
+private:
+    struct Worker {
+        explicit Worker(const PortForwardOptions& options)
+            : buffers(options.bufferSize, options.pooledBuffers), pipes(options.pooledBuffers) {}
+
+        int epoll = -1;
+        Endpoint wake;
+        std::thread thread;
+        std::vector<std::unique_ptr<Endpoint>> listeners;
+        std::unordered_map<Connection*, std::unique_ptr<Connection>> connections;
+        std::vector<Connection*> closed; // freed once the current batch is done
+        std::vector<Connection*> ready;  // yielded with work left
+        BufferPool buffers;
+        PipePool pipes;
+        ForwardCounters counters;
+
+        // Listener changes made while the loop runs, applied by it.
+        std::mutex commandsLock;
+        std::vector<std::unique_ptr<Endpoint>> added;
+        std::vector<uint16_t> removed;
+    };
+
+    static void Watch(Worker& worker, Endpoint& endpoint, uint32_t events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.ptr = &endpoint;
+        if (epoll_ctl(worker.epoll, EPOLL_CTL_ADD, endpoint.fd, &event) != 0) {
+            ThrowErrno("Failed to watch a forwarded socket");
+        }
+    }
+
+    static void Wake(Worker& worker) {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(worker.wake.fd, &one, sizeof(one));
+    }
+
+    static void AddListener(Worker& worker, std::unique_ptr<Endpoint> listener) {
+        try {
+            Watch(worker, *listener, EPOLLIN);
+        } catch (const std::system_error&) {
+            close(listener->fd);
+            return;
+        }
+        worker.listeners.push_back(std::move(listener));
+    }
+
+    // Connections already accepted on the port carry on.
+    static void RemoveListeners(Worker& worker, uint16_t port) {
+        std::erase_if(worker.listeners, [&worker, port](const std::unique_ptr<Endpoint>& listener) {
+            if (listener->port != port) {
+                return false;
+            }
+            epoll_ctl(worker.epoll, EPOLL_CTL_DEL, listener->fd, nullptr);
+            close(listener->fd);
+            return true;
+        });
+    }
+
+    // Between batches, so no event still in hand points at a listener
+    // being removed.
+    static void ApplyCommands(Worker& worker) {
+        std::vector<std::unique_ptr<Endpoint>> added;
+        std::vector<uint16_t> removed;
+        {
+            std::lock_guard<std::mutex> guard(worker.commandsLock);
+            added.swap(worker.added);
+            removed.swap(worker.removed);
+        }
+        for (auto& listener : added) {
+            AddListener(worker, std::move(listener));
+        }
+        for (const uint16_t port : removed) {
+            RemoveListeners(worker, port);
+        }
+    }
+
+    void Run(Worker& worker) {
+        // splice() has no MSG_NOSIGNAL; a peer that has gone raises SIGPIPE
+        // on this thread, which is blocked here and seen as EPIPE instead.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        epoll_event events[MaxEvents];
+        while (!stopping_.load(std::memory_order_relaxed)) {
+            const int count = epoll_wait(worker.epoll, events, MaxEvents, worker.ready.empty() ? -1 : 0);
+            if (count < 0 && errno != EINTR) {
+                break;
+            }
+
+            bool woken = false;
+            for (int i = 0; i < count; ++i) {
+                auto& endpoint = *static_cast<Endpoint*>(events[i].data.ptr);
+                switch (endpoint.kind) {
+                case EndpointKind::Wake: {
+                    uint64_t value = 0;
+                    [[maybe_unused]] const ssize_t drained = read(endpoint.fd, &value, sizeof(value));
+                    woken = true;
+                    break;
+                }
+                case EndpointKind::Listener:
+                    Accept(worker, endpoint);
+                    break;
+                case EndpointKind::Client:
+                case EndpointKind::Target:
+                    OnEvent(worker, *endpoint.connection, endpoint.kind == EndpointKind::Target, events[i].events);
+                    break;
+                }
+            }
+
+            // Connections that used up their budget go again, after
+            // everything that just became ready had a turn.
+            std::vector<Connection*> ready;
+            ready.swap(worker.ready);
+            for (Connection* connection : ready) {
+                connection->ready = false;
+                if (!connection->closed) {
+                    Service(worker, *connection, true, true);
+                }
+            }
+
+            for (Connection* connection : worker.closed) {
+                worker.connections.erase(connection);
+            }
+            worker.closed.clear();
+
+            if (woken) {
+                ApplyCommands(worker);
+            }
+        }
+    }
+
+    void Accept(Worker& worker, Endpoint& listener) {
+        for (int i = 0; i < MaxAcceptsPerWakeup; ++i) {
+            const int client = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+            worker.counters.accepted.fetch_add(1, std::memory_order_relaxed);
+
+            const SocketAddress& target = *listener.target;
+            const int upstream = socket(target.Family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (upstream < 0 || (connect(upstream, target.Get(), target.length) != 0 && errno != EINPROGRESS)) {
+                worker.counters.connectFailures.fetch_add(1, std::memory_order_relaxed);
+                close(client);
+                if (upstream >= 0) {
+                    close(upstream);
+                }
+                continue;
+            }
+
+            const int enable = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            setsockopt(upstream, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+            auto connection = std::make_unique<Connection>();
+            Connection& raw = *connection;
+            raw.client.kind = EndpointKind::Client;
+            raw.client.fd = client;
+            raw.client.connection = &raw;
+            raw.target.kind = EndpointKind::Target;
+            raw.target.fd = upstream;
+            raw.target.connection = &raw;
+            raw.toTarget.source = client;
+            raw.toTarget.sink = upstream;
+            raw.toTarget.zeroCopy = options_.zeroCopy;
+            raw.toClient.source = upstream;
+            raw.toClient.sink = client;
+            raw.toClient.zeroCopy = options_.zeroCopy;
+            worker.connections.emplace(&raw, std::move(connection));
+            worker.counters.active.fetch_add(1, std::memory_order_relaxed);
+
+            // Edge-triggered: every wakeup pumps until the socket would block.
+            constexpr uint32_t events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            try {
+                Watch(worker, raw.client, events);
+                Watch(worker, raw.target, events);
+            } catch (const std::system_error&) {
+                Close(worker, raw);
+            }
+        }
+    }
+
+    void OnEvent(Worker& worker, Connection& connection, bool target, uint32_t events) {
+        if (connection.closed) {
+            return;
+        }
+
+        if (connection.connecting) {
+            if (!target) {
+                return;
+            }
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(connection.target.fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+                worker.counters.connectFailures.fetch_add(1, std::memory_order_relaxed);
+                Close(worker, connection);
+                return;
+            }
+            if (!(events & EPOLLOUT)) {
+                return;
+            }
+            connection.connecting = false;
+            Service(worker, connection, true, true);
+            return;
+        }
+
+        // This socket readable feeds one direction, writable drains the other.
+        const bool readable = events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+        const bool writable = events & (EPOLLOUT | EPOLLHUP | EPOLLERR);
+        Service(worker, connection, target ? writable : readable, target ? readable : writable);
+    }
+
+    void Service(Worker& worker, Connection& connection, bool toTarget, bool toClient) {
+        PumpResult up = PumpResult::Blocked;
+        PumpResult down = PumpResult::Blocked;
+        if (toTarget) {
+            up = Pump(worker, connection.toTarget, worker.counters.bytesToTarget);
+        }
+        if (toClient && up != PumpResult::Failed) {
+            down = Pump(worker, connection.toClient, worker.counters.bytesToClient);
+        }
+
+        if (up == PumpResult::Failed || down == PumpResult::Failed ||
+            (connection.toTarget.shutdown && connection.toClient.shutdown)) {
+            Close(worker, connection);
+        } else if ((up == PumpResult::Yielded || down == PumpResult::Yielded) && !connection.ready) {
+            connection.ready = true;
+            worker.ready.push_back(&connection);
+        }
+    }
+
+    // Moves bytes until the source is drained or the sink is full, then
+    // forwards EOF as a shutdown once everything before it has gone out.
+    PumpResult Pump(Worker& worker, Direction& direction, std::atomic<uint64_t>& relayed) {
+        for (int reads = 0;;) {
+            if (direction.Pending()) {
+                const ssize_t sent =
+                    direction.piped > 0
+                        ? splice(direction.pipe.read, nullptr, direction.sink, nullptr, direction.piped,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+                        : send(direction.sink, direction.buffer + direction.offset, direction.length, MSG_NOSIGNAL);
+                if (sent > 0) {
+                    if (direction.piped > 0) {
+                        direction.piped -= static_cast<size_t>(sent);
+                    } else {
+                        direction.offset += static_cast<size_t>(sent);
+                        direction.length -= static_cast<size_t>(sent);
+                    }
+                    relayed.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+                    continue;
+                }
+                if (sent < 0 && errno == EINTR) {
+                    continue;
+                }
+                return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? PumpResult::Blocked
+                                                                             : PumpResult::Failed;
+            }
+
+            ReleaseResources(worker, direction);
+            if (direction.eof) {
+                if (!direction.shutdown) {
+                    shutdown(direction.sink, SHUT_WR);
+                    direction.shutdown = true;
+                }
+                return PumpResult::Blocked;
+            }
+            if (reads++ == MaxReadsPerWakeup) {
+                return PumpResult::Yielded;
+            }
+
+            ssize_t received = 0;
+            if (direction.zeroCopy) {
+                if (direction.pipe.read < 0) {
+                    direction.pipe = worker.pipes.Acquire();
+                    if (direction.pipe.read < 0) {
+                        direction.zeroCopy = false;
+                        continue;
+                    }
+                }
+                received = splice(direction.source, nullptr, direction.pipe.write, nullptr, PipeChunk,
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (received < 0 && errno == EINVAL) {
+                    // Not a pair the kernel can splice; copy from now on.
+                    direction.zeroCopy = false;
+                    continue;
+                }
+                if (received > 0) {
+                    direction.piped = static_cast<size_t>(received);
+                }
+            } else {
+                if (!direction.buffer) {
+                    direction.buffer = worker.buffers.Acquire();
+                }
+                received = recv(direction.source, direction.buffer, worker.buffers.Size(), 0);
+                if (received > 0) {
+                    direction.offset = 0;
+                    direction.length = static_cast<size_t>(received);
+                }
+            }
+
+            if (received > 0) {
+                continue;
+            }
+            if (received == 0) {
+                direction.eof = true;
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ReleaseResources(worker, direction);
+                return PumpResult::Blocked;
+            }
+            return PumpResult::Failed;
+        }
+    }
+
+    // Hands back the buffer or pipe once nothing is waiting in it.
+    static void ReleaseResources(Worker& worker, Direction& direction) {
+        if (direction.buffer && direction.length == 0) {
+            worker.buffers.Release(std::exchange(direction.buffer, nullptr));
+        }
+        if (direction.pipe.read >= 0 && direction.piped == 0) {
+            worker.pipes.Release(std::exchange(direction.pipe, Pipe{}), true);
+        }
+    }
+
+    static void Close(Worker& worker, Connection& connection) {
+        if (connection.closed) {
+            return;
+        }
+        connection.closed = true;
+        close(connection.client.fd);
+        close(connection.target.fd);
+        for (Direction* direction : {&connection.toTarget, &connection.toClient}) {
+            if (direction->buffer) {
+                worker.buffers.Release(std::exchange(direction->buffer, nullptr));
+            }
+            if (direction->pipe.read >= 0) {
+                worker.pipes.Release(std::exchange(direction->pipe, Pipe{}), direction->piped == 0);
+            }
+        }
+        worker.counters.active.fetch_sub(1, std::memory_order_relaxed);
+        worker.closed.push_back(&connection);
+    }
+
+    PortForwardOptions options_;
+    std::mutex controlLock_; // AddForward, RemoveForward, Start and Stop
+    std::vector<uint16_t> ports_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> stopping_{false};
+};
+
+#endif
+
+PortForwarder::PortForwarder(const PortForwardOptions& options)
+    : pImpl_(std::make_unique<Impl>(options)) {}
+
+PortForwarder::~PortForwarder() = default;
+
+uint16_t PortForwarder::AddForward(const std::string& listenAddress, uint16_t listenPort, const std::string& targetHost,
+                                   uint16_t targetPort) {
+    return pImpl_->AddForward(listenAddress, listenPort, targetHost, targetPort);
+}
+
+bool PortForwarder::RemoveForward(uint16_t listenPort) {
+    return pImpl_->RemoveForward(listenPort);
+}
+
+void PortForwarder::Start() {
+    pImpl_->Start();
+}
+
+void PortForwarder::Stop() {
+    pImpl_->Stop();
+}
+
+PortForwardStats PortForwarder::GetStats() const {
+    return pImpl_->GetStats();
+}
+
+} // namespace WSL
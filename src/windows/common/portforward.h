@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace WSL {
+
+struct PortForwardOptions {
+    // Event loops. Each connection stays on the loop that accepted it (on
+    // Windows, completions go to whichever thread is free). Zero picks one
+    // per CPU, up to four.
+    size_t threads = 0;
+
+    // Size of each pooled buffer. A direction of a connection only holds one
+    // while it has bytes in flight, so idle connections cost none.
+    size_t bufferSize = 64 * 1024;
+
+    // Drained buffers kept for reuse per loop; more than this are freed.
+    size_t pooledBuffers = 256;
+
+    // Linux: move bytes socket -> pipe -> socket with splice instead of
+    // copying them through a buffer. Windows has no socket-to-socket
+    // equivalent and always copies.
+    bool zeroCopy = true;
+
+    int backlog = 1024;
+};
+
+struct PortForwardStats {
+    uint64_t accepted = 0;
+    uint64_t active = 0;
+    uint64_t connectFailures = 0;
+    uint64_t bytesToTarget = 0;
+    uint64_t bytesToClient = 0;
+    uint64_t buffersAllocated = 0; // pool misses
+};
+
+// Forwards TCP connections accepted on local ports to a target, e.g.
+// localhost ports into the distribution. Event driven, epoll on Linux and a
+// completion port on Windows, so a few threads carry thousands of
+// connections.
+//
+// Half-close is forwarded: once one side shuts down sending, the other side
+// gets a shutdown after the bytes before it have been delivered, and the
+// opposite direction keeps flowing until it ends as well. An error or reset
+// on either side closes both.
+class PortForwarder {
+public:
+    explicit PortForwarder(const PortForwardOptions& options = {});
+
+    // Stops first.
+    ~PortForwarder();
+
+    // Non-copyable, non-movable
+    PortForwarder(const PortForwarder&) = delete;
+    PortForwarder& operator=(const PortForwarder&) = delete;
+    PortForwarder(PortForwarder&&) = delete;
+    PortForwarder& operator=(PortForwarder&&) = delete;
+
+    // Listens on listenAddress:listenPort and forwards every connection to
+    // targetHost:targetPort, which is resolved once, here. Port 0 picks a
+    // free port; returns the bound one. May be called before or after
+    // Start(), from any thread. Throws std::system_error (Linux) or
+    // std::runtime_error (Windows).
+    uint16_t AddForward(const std::string& listenAddress, uint16_t listenPort, const std::string& targetHost,
+                        uint16_t targetPort);
+
+    // Stops listening on every forward bound to listenPort. Connections
+    // already accepted through it carry on. False if there was none.
+    bool RemoveForward(uint16_t listenPort);
+
+    void Start();
+
+    // Closes the listeners and every connection still open, then joins the
+    // threads. Safe to call twice.
+    void Stop();
+
+    PortForwardStats GetStats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
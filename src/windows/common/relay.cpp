@@ -1,93 +1,64 @@
 #include "relay.h"
-#include <thread>
-#include <atomic>
+#include "relaysession.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <optional>
 
 class IORelay {
 private:
-    HANDLE linux_stdin;
-    HANDLE linux_stdout;
-    HANDLE linux_stderr;
-    std::atomic<bool> shouldStop{false};
-    
+    WSL::RelaySession session;
+
 public:
-    IORelay(HANDLE stdin_h, HANDLE stdout_h, HANDLE stderr_h)
-        : linux_stdin(stdin_h), linux_stdout(stdout_h), linux_stderr(stderr_h) {}
-    
+    IORelay(const WSL::ProcessHandles& handles, WSL::RelayMode relayMode)
+        : session(ConsoleHandles(handles), relayMode, &WSL::MetricsRegistry::Default()) {}
+
     int Start() {
-        // Create relay threads
-        std::thread stdinThread(&IORelay::RelayStdin, this);
-        std::thread stdoutThread(&IORelay::RelayStdout, this);
-        std::thread stderrThread(&IORelay::RelayStderr, this);
-        
-        // Wait for process to complete
-        WaitForProcessCompletion();
-        
-        shouldStop = true;
-        
-        // Cleanup threads
-        if (stdinThread.joinable()) stdinThread.join();
-        if (stdoutThread.joinable()) stdoutThread.join();
-        if (stderrThread.joinable()) stderrThread.join();
-        
-        return GetProcessExitCode();
-    }
-    
-private:
-    void RelayStdin() {
-        char buffer[4096];
-        DWORD bytesRead, bytesWritten;
-        
-        while (!shouldStop) {
-            if (ReadFile(GetStdHandle(STD_INPUT_HANDLE), buffer, sizeof(buffer), &bytesRead, nullptr)) {
-                if (bytesRead > 0) {
-                    WriteFile(linux_stdin, buffer, bytesRead, &bytesWritten, nullptr);
-                }
-            }
+        WSL::RelayResult result = WSL::RelayResult::Failed;
+        {
+            WSL_TRACE_SPAN("Relay");
+            result = session.Run();
         }
-    }
-    
-    void RelayStdout() {
-        char buffer[4096];
-        DWORD bytesRead, bytesWritten;
-        
-        while (!shouldStop) {
-            if (ReadFile(linux_stdout, buffer, sizeof(buffer), &bytesRead, nullptr)) {
-                if (bytesRead > 0) {
-                    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), buffer, bytesRead, &bytesWritten, nullptr);
-                }
-            } else {
-                break; // Process likely terminated
-            }
+
+        // The drain after the process exited, the tail of the Relay span.
+        const auto teardown = static_cast<uint64_t>(session.GetTeardownLatency().count());
+        if (WSL::TracingEnabled() && teardown > 0) {
+            const uint64_t end = WSL::TraceNow();
+            WSL::RecordTraceSpan("RelayTeardown", end - std::min(end, teardown), end);
         }
-    }
-    
-    void RelayStderr() {
-        char buffer[4096];
-        DWORD bytesRead, bytesWritten;
-        
-        while (!shouldStop) {
-            if (ReadFile(linux_stderr, buffer, sizeof(buffer), &bytesRead, nullptr)) {
-                if (bytesRead > 0) {
-                    WriteFile(GetStdHandle(STD_ERROR_HANDLE), buffer, bytesRead, &bytesWritten, nullptr);
-                }
-            } else {
-                break; // Process likely terminated
-            }
+
+        if (result == WSL::RelayResult::Cancelled) {
+            return 1;
         }
+
+        // No status means the instance went away under the process.
+        return session.GetExitCode().value_or(1);
     }
-    
-    void WaitForProcessCompletion() {
-        // Implementation to wait for Linux process completion
-        // This would typically involve waiting on a control handle
+
+    void Stop() {
+        session.Cancel();
     }
-    
-    int GetProcessExitCode() {
-        // Return the exit code from the Linux process
-        return 0;
+
+private:
+    static WSL::RelaySessionHandles ConsoleHandles(const WSL::ProcessHandles& handles) {
+        WSL::RelaySessionHandles session;
+        session.consoleInput = GetStdHandle(STD_INPUT_HANDLE);
+        session.consoleOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        session.consoleError = GetStdHandle(STD_ERROR_HANDLE);
+        session.processInput = handles.stdin_handle;
+        session.processOutput = handles.stdout_handle;
+        session.processError = handles.stderr_handle;
+        session.process = handles.process_handle;
+        session.control = handles.control_handle;
+        return session;
     }
 };
 
-int RelayIO(HANDLE stdin_h, HANDLE stdout_h, HANDLE stderr_h) {
-    IORelay relay(stdin_h, stdout_h, stderr_h);
-    return relay.Start();
-}
\ No newline at end of file
+int RelayIO(const WSL::ProcessHandles& handles, WSL::RelayMode mode) {
+    std::optional<IORelay> relay;
+    {
+        WSL_TRACE_SPAN("RelaySetup");
+        relay.emplace(handles, mode);
+    }
+    return relay->Start();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <windows.h>
+#include "relayengine.h"
+#include "wslclient.h"
+
+// Relays the console to the Linux process' standard handles until the process
+// has exited and its output has drained, then returns its exit code. Latency
+// suits interactive shells; Throughput batches output for pipelines.
+int RelayIO(const WSL::ProcessHandles& handles, WSL::RelayMode mode = WSL::RelayMode::Latency);
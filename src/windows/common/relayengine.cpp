@@ -0,0 +1,1599 @@
+#include "relayengine.h"
+#include "spscring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winternl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <unistd.h>
+
+// Older glibc headers predate pidfd support in waitid().
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+#endif
+
+namespace WSL {
+
+namespace {
+
+// Upper bound on reads serviced for one stream per wakeup so a single busy
+// stream cannot starve the others sharing the loop.
+constexpr int MaxReadsPerWakeup = 16;
+
+#ifdef _WIN32
+
+constexpr ULONG_PTR IoKey = 1;
+constexpr ULONG_PTR WakeKey = 2;
+constexpr ULONG_PTR ProcessKey = 3;
+constexpr ULONG_PTR ControlKey = 4;
+
+struct IoRequest {
+    OVERLAPPED overlapped{};
+    size_t stream = 0;
+    bool write = false;
+};
+
+// Console handles and handles opened without FILE_FLAG_OVERLAPPED cannot
+// complete asynchronously; those get a dedicated blocking reader.
+bool IsOverlappedHandle(HANDLE handle) {
+    if (GetFileType(handle) == FILE_TYPE_CHAR) {
+        return false;
+    }
+
+    constexpr auto FileModeInformation = static_cast<FILE_INFORMATION_CLASS>(16);
+    constexpr ULONG SynchronousIoFlags = 0x00000010 | 0x00000020;
+
+    IO_STATUS_BLOCK ioStatus = {};
+    ULONG mode = 0;
+    NTSTATUS status = NtQueryInformationFile(handle, &ioStatus, &mode, sizeof(mode), FileModeInformation);
+    if (status < 0) {
+        return false;
+    }
+
+    return (mode & SynchronousIoFlags) == 0;
+}
+
+#else
+
+constexpr uint64_t WakeTag = UINT64_MAX;
+constexpr uint64_t ProcessTag = UINT64_MAX - 1;
+constexpr uint64_t ControlTag = UINT64_MAX - 2;
+
+// Largest single splice/sendfile request; the kernel clamps it to what the
+// pipe can take, so this only bounds the time spent in one call.
+constexpr size_t ZeroCopyChunk = 1024 * 1024;
+
+RelayTransfer SelectTransfer(int source, int sink) {
+    struct stat sourceStat = {};
+    struct stat sinkStat = {};
+    if (fstat(source, &sourceStat) != 0 || fstat(sink, &sinkStat) != 0) {
+        return RelayTransfer::Buffered;
+    }
+
+    // splice needs a pipe on at least one side; sendfile needs a source it
+    // can map. Terminals support neither and are caught by the EINVAL
+    // fallback in PumpZeroCopy.
+    if (S_ISFIFO(sourceStat.st_mode) || S_ISFIFO(sinkStat.st_mode)) {
+        return RelayTransfer::Splice;
+    }
+    if (S_ISREG(sourceStat.st_mode)) {
+        return RelayTransfer::SendFile;
+    }
+    return RelayTransfer::Buffered;
+}
+
+#endif
+
+} // namespace
+
+struct RelayStream {
+    NativeHandle source = InvalidNativeHandle;
+    NativeHandle sink = InvalidNativeHandle;
+    RelayStreamOptions options;
+    std::vector<char> buffer;
+    size_t pendingOffset = 0;
+    size_t pendingLength = 0;
+    size_t smallReads = 0;
+    std::atomic<uint64_t> bytesRelayed{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> zeroCopyCalls{0};
+    std::atomic<size_t> bufferSize{0};
+    std::atomic<RelayTransfer> transfer{RelayTransfer::Buffered};
+    bool sourceEof = false;
+    bool finished = false;
+    bool sinkBroken = false;
+    bool waitingForSink = false;
+
+    // Writer stage (writerRingSize != 0). The relay loop produces into the
+    // ring; the writer thread consumes and owns the sink.
+    std::unique_ptr<SpscRing<char>> ring;
+    std::thread writer;
+    std::atomic<uint64_t> ringSequence{0};
+    std::atomic<bool> producerClosed{false};
+    std::atomic<bool> readerStalled{false};
+    std::atomic<bool> writerDone{false};
+    std::atomic<uint64_t> readerStalls{0};
+
+#ifdef _WIN32
+    IoRequest readRequest;
+    IoRequest writeRequest;
+    bool overlappedSource = false;
+    bool overlappedSink = false;
+    bool zeroReadIsEof = false;
+    uint64_t readOffset = 0;
+    char* readTarget = nullptr;
+    size_t readLength = 0;
+    std::thread reader;
+    HANDLE readerResume = nullptr;
+    HANDLE writerEvent = nullptr;
+    DWORD readerError = ERROR_SUCCESS;
+#else
+    int sinkWatch = -1;
+    bool sourcePollable = false;
+    bool sinkPollable = false;
+    bool holding = false;
+    std::chrono::steady_clock::time_point flushDeadline;
+#endif
+};
+
+namespace {
+
+constexpr size_t LatencyModeBufferCap = 64 * 1024;
+
+// Consecutive reads using under an eighth of the buffer before it is halved.
+constexpr size_t ShrinkAfterSmallReads = 64;
+
+size_t InitialBufferSize(const RelayStreamOptions& options) {
+    return options.bufferSize > 0 ? options.bufferSize : 4096;
+}
+
+size_t BufferCap(const RelayStreamOptions& options) {
+    const size_t initial = InitialBufferSize(options);
+    size_t cap = std::max(options.maxBufferSize, initial);
+    if (options.mode == RelayMode::Latency) {
+        cap = std::min(cap, std::max(LatencyModeBufferCap, initial));
+    }
+    return cap;
+}
+
+void ResizeBuffer(RelayStream& stream, size_t size) {
+    stream.buffer.resize(size);
+    stream.bufferSize.store(size, std::memory_order_relaxed);
+}
+
+// Grows the buffer when a read filled every byte it was offered; a stream
+// that keeps doing that is bulk output and deserves fewer, larger syscalls.
+void AccountRead(RelayStream& stream, size_t bytes, size_t requested) {
+    stream.pendingLength += bytes;
+
+    if (bytes == requested) {
+        stream.smallReads = 0;
+        const size_t cap = BufferCap(stream.options);
+        if (stream.buffer.size() < cap) {
+            ResizeBuffer(stream, std::min(stream.buffer.size() * 2, cap));
+        }
+    } else if (bytes < stream.buffer.size() / 8) {
+        ++stream.smallReads;
+    } else {
+        stream.smallReads = 0;
+    }
+}
+
+// Only called with nothing pending, so no buffered data has to move.
+void MaybeShrink(RelayStream& stream) {
+    const size_t initial = InitialBufferSize(stream.options);
+    if (stream.smallReads < ShrinkAfterSmallReads || stream.buffer.size() <= initial) {
+        return;
+    }
+
+    const size_t size = std::max(stream.buffer.size() / 2, initial);
+    std::vector<char>(size).swap(stream.buffer);
+    stream.bufferSize.store(size, std::memory_order_relaxed);
+    stream.smallReads = 0;
+}
+
+bool CanCoalesce(const RelayStream& stream) {
+    return stream.options.mode == RelayMode::Throughput && stream.pendingLength < stream.buffer.size() / 2;
+}
+
+void CountBytes(RelayStream& stream, uint64_t bytes) {
+    stream.bytesRelayed.fetch_add(bytes, std::memory_order_relaxed);
+    if (stream.options.metrics) {
+        stream.options.metrics->Add(stream.options.bytesMetric, static_cast<int64_t>(bytes));
+    }
+}
+
+RelayStreamStats SnapshotStats(const RelayStream& stream) {
+    RelayStreamStats stats;
+    stats.bytes = stream.bytesRelayed.load(std::memory_order_relaxed);
+    stats.reads = stream.reads.load(std::memory_order_relaxed);
+    stats.writes = stream.writes.load(std::memory_order_relaxed);
+    stats.zeroCopyCalls = stream.zeroCopyCalls.load(std::memory_order_relaxed);
+    stats.readerStalls = stream.readerStalls.load(std::memory_order_relaxed);
+    stats.bufferSize = stream.bufferSize.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Reader stage: wakes the writer after new bytes were committed or the
+// source closed.
+void NotifyWriter(RelayStream& stream) {
+    stream.ringSequence.fetch_add(1, std::memory_order_release);
+    stream.ringSequence.notify_one();
+}
+
+void CloseStage(RelayStream& stream) {
+    stream.sourceEof = true;
+    stream.producerClosed.store(true, std::memory_order_release);
+    NotifyWriter(stream);
+}
+
+// Reader stage: free space in the ring, or an empty span after flagging the
+// stall so the writer resumes us once it has consumed something.
+std::span<char> ReserveStage(RelayStream& stream) {
+    std::span<char> span = stream.ring->WritableSpan();
+    if (!span.empty()) {
+        return span;
+    }
+
+    stream.readerStalled.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // The writer may have drained the ring between the two checks.
+    span = stream.ring->WritableSpan();
+    if (!span.empty()) {
+        stream.readerStalled.store(false, std::memory_order_relaxed);
+        return span;
+    }
+
+    stream.readerStalls.fetch_add(1, std::memory_order_relaxed);
+    if (stream.options.metrics) {
+        stream.options.metrics->Add(Metric::RelayStalls);
+    }
+    return span;
+}
+
+// Writer stage body. write(data, length) returns the bytes written, 0 when
+// the engine is stopping, or a negative value once the sink is unusable,
+// after which output is discarded so the reader never stalls on it.
+template <typename WriteFn, typename SignalFn>
+void RunWriterStage(RelayStream& stream, WriteFn write, SignalFn signalReader) {
+    for (;;) {
+        const uint64_t sequence = stream.ringSequence.load(std::memory_order_acquire);
+        std::span<const char> span = stream.ring->ReadableSpan();
+        if (span.empty()) {
+            if (stream.producerClosed.load(std::memory_order_acquire)) {
+                // Bytes committed before the close are visible now.
+                if (stream.ring->ReadableSpan().empty()) {
+                    break;
+                }
+                continue;
+            }
+            stream.ringSequence.wait(sequence, std::memory_order_acquire);
+            continue;
+        }
+
+        size_t consumed = span.size();
+        if (!stream.sinkBroken) {
+            auto written = write(span.data(), span.size());
+            stream.writes.fetch_add(1, std::memory_order_relaxed);
+            if (written == 0) {
+                break;
+            }
+            if (written < 0) {
+                stream.sinkBroken = true;
+            } else {
+                consumed = static_cast<size_t>(written);
+                CountBytes(stream, consumed);
+            }
+        }
+
+        stream.ring->Consume(consumed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (stream.readerStalled.exchange(false)) {
+            signalReader();
+        }
+    }
+
+    stream.writerDone.store(true, std::memory_order_release);
+    signalReader();
+}
+
+// The Linux process as a member of the wait set. Its exit counts as one more
+// required completion; the streams it wrote to still drain to EOF after it.
+struct ProcessWatch {
+    NativeHandle process = InvalidNativeHandle;
+    NativeHandle control = InvalidNativeHandle;
+    bool exited = false;
+    std::optional<int> exitCode;
+    std::chrono::steady_clock::time_point exitSeen;
+    std::chrono::nanoseconds teardown{0};
+
+    bool Active() const { return process != InvalidNativeHandle || control != InvalidNativeHandle; }
+
+    void RecordTeardown() {
+        if (exited) {
+            teardown = std::chrono::steady_clock::now() - exitSeen;
+        }
+    }
+};
+
+} // namespace
+
+#ifdef _WIN32
+
+class RelayEngine::Impl {
+private:
+    HANDLE iocp_ = nullptr;
+    HANDLE stopEvent_ = nullptr;
+    std::vector<std::unique_ptr<RelayStream>> streams_;
+    std::vector<HANDLE> associated_;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> stopping_{false};
+    size_t activeRequired_ = 0;
+    size_t outstanding_ = 0;
+    ProcessWatch process_;
+    HANDLE processWait_ = nullptr;
+    HANDLE controlWait_ = nullptr;
+
+public:
+    Impl() {
+        iocp_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!iocp_) {
+            throw std::runtime_error("Failed to create relay completion port: " + std::to_string(GetLastError()));
+        }
+
+        stopEvent_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!stopEvent_) {
+            DWORD error = GetLastError();
+            CloseHandle(iocp_);
+            throw std::runtime_error("Failed to create relay stop event: " + std::to_string(error));
+        }
+    }
+
+    ~Impl() {
+        StopThreads();
+        for (auto& stream : streams_) {
+            if (stream->readerResume) {
+                CloseHandle(stream->readerResume);
+            }
+            if (stream->writerEvent) {
+                CloseHandle(stream->writerEvent);
+            }
+        }
+        CloseHandle(stopEvent_);
+        CloseHandle(iocp_);
+    }
+
+    size_t AddStream(HANDLE source, HANDLE sink, const RelayStreamOptions& options) {
+        auto stream = std::make_unique<RelayStream>();
+        const size_t index = streams_.size();
+
+        stream->source = source;
+        stream->sink = sink;
+        stream->options = options;
+        ResizeBuffer(*stream, InitialBufferSize(options));
+        stream->readRequest.stream = index;
+        stream->writeRequest.stream = index;
+        stream->writeRequest.write = true;
+        stream->zeroReadIsEof = GetFileType(source) != FILE_TYPE_PIPE;
+
+        stream->overlappedSource = IsOverlappedHandle(source);
+        if (stream->overlappedSource) {
+            Associate(source);
+        } else {
+            stream->readerResume = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            if (!stream->readerResume) {
+                throw std::runtime_error("Failed to create relay reader event: " + std::to_string(GetLastError()));
+            }
+        }
+
+        stream->overlappedSink = IsOverlappedHandle(sink);
+        if (options.writerRingSize > 0) {
+            // The writer thread waits on its own event, so the sink does not
+            // need the completion port.
+            stream->ring = std::make_unique<SpscRing<char>>(options.writerRingSize);
+            stream->writerEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            if (!stream->writerEvent) {
+                throw std::runtime_error("Failed to create relay writer event: " + std::to_string(GetLastError()));
+            }
+        } else if (stream->overlappedSink) {
+            Associate(sink);
+        }
+
+        if (options.required) {
+            ++activeRequired_;
+        }
+
+        streams_.push_back(std::move(stream));
+        return index;
+    }
+
+    void WatchProcess(HANDLE process, HANDLE control) {
+        process_.process = process;
+        process_.control = control;
+        if (process_.Active()) {
+            ++activeRequired_;
+        }
+    }
+
+    RelayResult Run() {
+        // Thread-pool waits turn the process and control handles into packets
+        // on the completion port, so one GetQueuedCompletionStatus covers the
+        // whole wait set.
+        if (process_.process != INVALID_HANDLE_VALUE &&
+            !RegisterWaitForSingleObject(&processWait_, process_.process, &Impl::OnProcessSignalled, this, INFINITE,
+                                         WT_EXECUTEONLYONCE)) {
+            throw std::runtime_error("Failed to wait on relay process: " + std::to_string(GetLastError()));
+        }
+        if (process_.control != INVALID_HANDLE_VALUE &&
+            !RegisterWaitForSingleObject(&controlWait_, process_.control, &Impl::OnControlSignalled, this, INFINITE,
+                                         WT_EXECUTEONLYONCE)) {
+            UnregisterWaits();
+            throw std::runtime_error("Failed to wait on relay control handle: " + std::to_string(GetLastError()));
+        }
+
+        for (auto& stream : streams_) {
+            RelayStream* raw = stream.get();
+            if (raw->ring) {
+                raw->writer = std::thread(&Impl::WriterStage, this, raw);
+            }
+
+            if (raw->overlappedSource) {
+                IssueRead(*raw);
+            } else {
+                PrepareRead(*raw);
+                raw->reader = std::thread(&Impl::BlockingReader, this, raw);
+            }
+        }
+
+        RelayResult result = RelayResult::Completed;
+        while (activeRequired_ > 0) {
+            if (cancelled_) {
+                result = RelayResult::Cancelled;
+                break;
+            }
+
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            BOOL ok = GetQueuedCompletionStatus(iocp_, &bytes, &key, &overlapped, INFINITE);
+            if (!overlapped) {
+                if (!ok) {
+                    result = RelayResult::Failed;
+                    break;
+                }
+                if (key == ProcessKey || key == ControlKey) {
+                    OnProcessExit(key == ProcessKey);
+                    continue;
+                }
+                // Wake packet from Cancel() or a writer stage.
+                ServiceStages();
+                continue;
+            }
+
+            DWORD error = ok ? ERROR_SUCCESS : GetLastError();
+            auto* request = CONTAINING_RECORD(overlapped, IoRequest, overlapped);
+            OnCompletion(*request, bytes, error);
+        }
+
+        Shutdown();
+        process_.RecordTeardown();
+        return result;
+    }
+
+    std::optional<int> GetExitCode() const { return process_.exitCode; }
+
+    std::chrono::nanoseconds GetTeardownLatency() const { return process_.teardown; }
+
+    void Cancel() {
+        cancelled_ = true;
+        Wake();
+    }
+
+    uint64_t GetBytesRelayed(size_t stream) const {
+        return streams_.at(stream)->bytesRelayed.load(std::memory_order_relaxed);
+    }
+
+    RelayTransfer GetTransfer(size_t stream) const {
+        return streams_.at(stream)->transfer.load(std::memory_order_relaxed);
+    }
+
+    RelayStreamStats GetStats(size_t stream) const {
+        return SnapshotStats(*streams_.at(stream));
+    }
+
+private:
+    static VOID CALLBACK OnProcessSignalled(PVOID context, BOOLEAN) {
+        PostQueuedCompletionStatus(static_cast<Impl*>(context)->iocp_, 0, ProcessKey, nullptr);
+    }
+
+    static VOID CALLBACK OnControlSignalled(PVOID context, BOOLEAN) {
+        PostQueuedCompletionStatus(static_cast<Impl*>(context)->iocp_, 0, ControlKey, nullptr);
+    }
+
+    // The control handle signalling first means the instance is gone and no
+    // exit status is coming.
+    void OnProcessExit(bool reported) {
+        if (process_.exited) {
+            return;
+        }
+
+        process_.exited = true;
+        process_.exitSeen = std::chrono::steady_clock::now();
+
+        DWORD exitCode = 0;
+        if (reported && GetExitCodeProcess(process_.process, &exitCode)) {
+            process_.exitCode = static_cast<int>(exitCode);
+        }
+        --activeRequired_;
+    }
+
+    void UnregisterWaits() {
+        // INVALID_HANDLE_VALUE waits for a callback already in flight, which
+        // may still be posting to the port.
+        for (HANDLE* wait : {&processWait_, &controlWait_}) {
+            if (*wait) {
+                UnregisterWaitEx(*wait, INVALID_HANDLE_VALUE);
+                *wait = nullptr;
+            }
+        }
+    }
+
+    void Associate(HANDLE handle) {
+        for (HANDLE existing : associated_) {
+            if (existing == handle) {
+                return;
+            }
+        }
+
+        if (!CreateIoCompletionPort(handle, iocp_, IoKey, 0)) {
+            throw std::runtime_error("Failed to associate handle with relay completion port: " +
+                                     std::to_string(GetLastError()));
+        }
+        associated_.push_back(handle);
+    }
+
+    void BlockingReader(RelayStream* stream) {
+        for (;;) {
+            DWORD bytesRead = 0;
+            BOOL ok = ReadFile(stream->source, stream->readTarget,
+                               static_cast<DWORD>(stream->readLength), &bytesRead, nullptr);
+            if (stopping_) {
+                return;
+            }
+
+            stream->readerError = ok ? ERROR_SUCCESS : GetLastError();
+            PostQueuedCompletionStatus(iocp_, bytesRead, IoKey, &stream->readRequest.overlapped);
+
+            bool terminal = !ok || (bytesRead == 0 && stream->zeroReadIsEof);
+            if (terminal) {
+                return;
+            }
+
+            WaitForSingleObject(stream->readerResume, INFINITE);
+            if (stopping_) {
+                return;
+            }
+        }
+    }
+
+    void Wake() {
+        PostQueuedCompletionStatus(iocp_, 0, WakeKey, nullptr);
+    }
+
+    // Points the next read at free space: the ring for staged streams,
+    // otherwise after anything held back for coalescing. Returns false when
+    // a full ring has parked the stream.
+    bool PrepareRead(RelayStream& stream) {
+        if (stream.ring) {
+            std::span<char> span = ReserveStage(stream);
+            if (span.empty()) {
+                stream.waitingForSink = true;
+                return false;
+            }
+            stream.readTarget = span.data();
+            stream.readLength = std::min<size_t>(span.size(), MAXDWORD);
+            return true;
+        }
+
+        const size_t readAt = stream.pendingOffset + stream.pendingLength;
+        stream.readTarget = stream.buffer.data() + readAt;
+        stream.readLength = stream.buffer.size() - readAt;
+        return true;
+    }
+
+    void IssueRead(RelayStream& stream) {
+        if (stream.finished || !PrepareRead(stream)) {
+            return;
+        }
+
+        if (!stream.overlappedSource) {
+            SetEvent(stream.readerResume);
+            return;
+        }
+
+        stream.readRequest.overlapped = {};
+        stream.readRequest.overlapped.Offset = static_cast<DWORD>(stream.readOffset);
+        stream.readRequest.overlapped.OffsetHigh = static_cast<DWORD>(stream.readOffset >> 32);
+
+        if (!ReadFile(stream.source, stream.readTarget, static_cast<DWORD>(stream.readLength),
+                      nullptr, &stream.readRequest.overlapped) &&
+            GetLastError() != ERROR_IO_PENDING) {
+            if (stream.ring) {
+                CloseStage(stream);
+            } else {
+                Finish(stream);
+            }
+            return;
+        }
+
+        ++outstanding_;
+    }
+
+    void OnCompletion(IoRequest& request, DWORD bytes, DWORD error) {
+        RelayStream& stream = *streams_[request.stream];
+
+        if (request.write) {
+            --outstanding_;
+            if (error != ERROR_SUCCESS) {
+                stream.sinkBroken = true;
+                stream.pendingLength = 0;
+            } else {
+                stream.pendingOffset += bytes;
+                stream.pendingLength -= bytes;
+                CountBytes(stream, bytes);
+            }
+            Drain(stream);
+            return;
+        }
+
+        if (stream.overlappedSource) {
+            --outstanding_;
+        } else {
+            error = stream.readerError;
+        }
+
+        if (stream.finished) {
+            return;
+        }
+
+        stream.reads.fetch_add(1, std::memory_order_relaxed);
+
+        // ERROR_BROKEN_PIPE / ERROR_HANDLE_EOF are the normal end of stream.
+        if (error != ERROR_SUCCESS || (bytes == 0 && stream.zeroReadIsEof)) {
+            if (stream.ring) {
+                // The stream finishes once the writer has drained the ring.
+                CloseStage(stream);
+                return;
+            }
+            stream.sourceEof = true;
+            Drain(stream);
+            return;
+        }
+
+        if (bytes == 0) {
+            IssueRead(stream);
+            return;
+        }
+
+        stream.readOffset += bytes;
+        if (stream.ring) {
+            stream.ring->Commit(bytes);
+            NotifyWriter(stream);
+            IssueRead(stream);
+            return;
+        }
+
+        AccountRead(stream, bytes, stream.readLength);
+
+        // There is no timer here: small chunks are only merged with input
+        // that is already sitting in the pipe, so nothing is ever delayed.
+        if (CanCoalesce(stream) && MoreInputQueued(stream)) {
+            IssueRead(stream);
+            return;
+        }
+
+        Drain(stream);
+    }
+
+    bool MoreInputQueued(const RelayStream& stream) const {
+        if (stream.zeroReadIsEof) {
+            return false;
+        }
+
+        DWORD available = 0;
+        return PeekNamedPipe(stream.source, nullptr, 0, nullptr, &available, nullptr) && available > 0;
+    }
+
+    // Writes out the pending chunk and then asks for more input (or ends the
+    // stream after EOF). Overlapped sinks resume from OnCompletion;
+    // synchronous sinks are written inline.
+    void Drain(RelayStream& stream) {
+        while (stream.pendingLength > 0) {
+            if (stream.sinkBroken) {
+                // Keep reading so the producer never blocks on a dead consumer.
+                stream.pendingLength = 0;
+                break;
+            }
+
+            const char* data = stream.buffer.data() + stream.pendingOffset;
+            DWORD length = static_cast<DWORD>(stream.pendingLength);
+
+            stream.writes.fetch_add(1, std::memory_order_relaxed);
+            if (stream.overlappedSink) {
+                stream.writeRequest.overlapped = {};
+                stream.writeRequest.overlapped.Offset = 0xFFFFFFFF;
+                stream.writeRequest.overlapped.OffsetHigh = 0xFFFFFFFF;
+                if (!WriteFile(stream.sink, data, length, nullptr, &stream.writeRequest.overlapped) &&
+                    GetLastError() != ERROR_IO_PENDING) {
+                    stream.sinkBroken = true;
+                    continue;
+                }
+                ++outstanding_;
+                return;
+            }
+
+            DWORD written = 0;
+            if (!WriteFile(stream.sink, data, length, &written, nullptr)) {
+                stream.sinkBroken = true;
+                continue;
+            }
+            stream.pendingOffset += written;
+            stream.pendingLength -= written;
+            CountBytes(stream, written);
+        }
+
+        stream.pendingOffset = 0;
+        MaybeShrink(stream);
+
+        if (stream.sourceEof) {
+            Finish(stream);
+        } else {
+            IssueRead(stream);
+        }
+    }
+
+    void WriterStage(RelayStream* stream) {
+        RunWriterStage(*stream,
+            [this, stream](const char* data, size_t length) { return StageWrite(*stream, data, length); },
+            [this] { Wake(); });
+    }
+
+    long long StageWrite(RelayStream& stream, const char* data, size_t length) {
+        if (stopping_) {
+            return 0;
+        }
+
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, MAXDWORD));
+        DWORD written = 0;
+
+        if (!stream.overlappedSink) {
+            if (!WriteFile(stream.sink, data, chunk, &written, nullptr)) {
+                return stopping_ ? 0 : -1;
+            }
+            return written;
+        }
+
+        // Setting the low bit of hEvent keeps the completion off the relay
+        // port in case another stream associated this sink with it.
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = 0xFFFFFFFF;
+        overlapped.OffsetHigh = 0xFFFFFFFF;
+        overlapped.hEvent = reinterpret_cast<HANDLE>(reinterpret_cast<ULONG_PTR>(stream.writerEvent) | 1);
+
+        if (!WriteFile(stream.sink, data, chunk, nullptr, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+            return -1;
+        }
+
+        HANDLE waits[] = {stream.writerEvent, stopEvent_};
+        if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            CancelIoEx(stream.sink, &overlapped);
+            WaitForSingleObject(stream.writerEvent, INFINITE);
+            return 0;
+        }
+
+        if (!GetOverlappedResult(stream.sink, &overlapped, &written, FALSE)) {
+            return -1;
+        }
+        return written;
+    }
+
+    // Runs on the loop after a writer stage signalled: resume a parked reader
+    // or retire a stream whose writer has drained everything.
+    void ServiceStages() {
+        for (auto& stream : streams_) {
+            if (!stream->ring || stream->finished) {
+                continue;
+            }
+
+            if (stream->writerDone.load(std::memory_order_acquire)) {
+                Finish(*stream);
+            } else if (stream->waitingForSink && !stream->readerStalled.load()) {
+                stream->waitingForSink = false;
+                IssueRead(*stream);
+            }
+        }
+    }
+
+    void Finish(RelayStream& stream) {
+        if (stream.finished) {
+            return;
+        }
+
+        stream.finished = true;
+        if (stream.writer.joinable()) {
+            stream.writer.join();
+        }
+
+        if (stream.options.closeSinkOnEof && stream.sink != INVALID_HANDLE_VALUE) {
+            CloseHandle(stream.sink);
+            stream.sink = INVALID_HANDLE_VALUE;
+        }
+
+        if (stream.options.required) {
+            --activeRequired_;
+        }
+    }
+
+    // Cancels whatever is still in flight and waits for the kernel to hand the
+    // OVERLAPPED structures back before the buffers can go away.
+    void Shutdown() {
+        UnregisterWaits();
+
+        for (auto& stream : streams_) {
+            if (stream->overlappedSource && !stream->finished) {
+                CancelIoEx(stream->source, &stream->readRequest.overlapped);
+            }
+            if (stream->overlappedSink && stream->pendingLength > 0) {
+                CancelIoEx(stream->sink, &stream->writeRequest.overlapped);
+            }
+        }
+
+        while (outstanding_ > 0) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            BOOL ok = GetQueuedCompletionStatus(iocp_, &bytes, &key, &overlapped, INFINITE);
+            if (!overlapped) {
+                if (!ok) {
+                    break;
+                }
+                continue;
+            }
+
+            auto* request = CONTAINING_RECORD(overlapped, IoRequest, overlapped);
+            RelayStream& stream = *streams_[request->stream];
+            if (request->write || stream.overlappedSource) {
+                --outstanding_;
+            }
+        }
+
+        StopThreads();
+    }
+
+    void StopThreads() {
+        stopping_ = true;
+        SetEvent(stopEvent_);
+
+        for (auto& stream : streams_) {
+            if (stream->reader.joinable()) {
+                SetEvent(stream->readerResume);
+                JoinBlockedThread(stream->reader);
+            }
+
+            if (stream->writer.joinable()) {
+                stream->producerClosed.store(true, std::memory_order_release);
+                NotifyWriter(*stream);
+                JoinBlockedThread(stream->writer);
+            }
+        }
+    }
+
+    // CancelSynchronousIo is a no-op if the thread has not entered ReadFile
+    // or WriteFile yet, so keep poking until it is gone.
+    static void JoinBlockedThread(std::thread& thread) {
+        HANDLE handle = thread.native_handle();
+        while (WaitForSingleObject(handle, 10) == WAIT_TIMEOUT) {
+            CancelSynchronousIo(handle);
+        }
+        thread.join();
+    }
+};
+
+#else
+
+class RelayEngine::Impl {
+private:
+    int epollFd_ = -1;
+    int wakeFd_ = -1;
+    int stopFd_ = -1;
+    std::vector<std::unique_ptr<RelayStream>> streams_;
+    std::vector<std::pair<int, int>> savedFlags_;
+    std::atomic<bool> cancelled_{false};
+    size_t activeRequired_ = 0;
+    ProcessWatch process_;
+
+public:
+    Impl() {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        stopFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (epollFd_ < 0 || wakeFd_ < 0 || stopFd_ < 0) {
+            int error = errno;
+            Close();
+            throw std::system_error(error, std::generic_category(), "Failed to create relay event loop");
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = WakeTag;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event) != 0) {
+            int error = errno;
+            Close();
+            throw std::system_error(error, std::generic_category(), "Failed to register relay wake event");
+        }
+    }
+
+    ~Impl() {
+        StopWriters();
+        RestoreFlags();
+        for (auto& stream : streams_) {
+            if (stream->sinkWatch >= 0) {
+                close(stream->sinkWatch);
+            }
+        }
+        Close();
+    }
+
+    size_t AddStream(int source, int sink, const RelayStreamOptions& options) {
+        auto stream = std::make_unique<RelayStream>();
+        const size_t index = streams_.size();
+
+        stream->source = source;
+        stream->sink = sink;
+        stream->options = options;
+        ResizeBuffer(*stream, InitialBufferSize(options));
+
+        MakeNonBlocking(source);
+        MakeNonBlocking(sink);
+
+        // The same sink is commonly shared (stdout and stderr to one console),
+        // and epoll refuses a second registration of the same descriptor, so
+        // each stream watches its own duplicate.
+        stream->sinkWatch = fcntl(sink, F_DUPFD_CLOEXEC, 0);
+        if (stream->sinkWatch < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to duplicate relay sink");
+        }
+
+        if (options.writerRingSize > 0) {
+            stream->ring = std::make_unique<SpscRing<char>>(options.writerRingSize);
+        } else if (options.zeroCopy) {
+            stream->transfer = SelectTransfer(source, sink);
+        }
+
+        // A staged sink belongs to the writer thread, which polls it itself.
+        stream->sourcePollable = Watch(source, index << 1, EPOLLIN);
+        stream->sinkPollable = !stream->ring && Watch(stream->sinkWatch, (index << 1) | 1, 0);
+
+        if (options.required) {
+            ++activeRequired_;
+        }
+
+        streams_.push_back(std::move(stream));
+        return index;
+    }
+
+    void WatchProcess(int process, int control) {
+        process_.process = process;
+        process_.control = control;
+
+        if (process >= 0 && !Watch(process, ProcessTag, EPOLLIN)) {
+            throw std::system_error(EINVAL, std::generic_category(), "Relay process handle is not pollable");
+        }
+        if (control >= 0 && !Watch(control, ControlTag, EPOLLIN)) {
+            throw std::system_error(EINVAL, std::generic_category(), "Relay control handle is not pollable");
+        }
+        if (process_.Active()) {
+            ++activeRequired_;
+        }
+    }
+
+    RelayResult Run() {
+        constexpr int MaxEvents = 64;
+        epoll_event events[MaxEvents];
+
+        for (auto& stream : streams_) {
+            if (stream->ring) {
+                RelayStream* raw = stream.get();
+                raw->writer = std::thread([this, raw] {
+                    RunWriterStage(*raw,
+                        [this, raw](const char* data, size_t length) { return StageWrite(*raw, data, length); },
+                        [this] { Wake(); });
+                });
+            }
+        }
+
+        RelayResult result = RelayResult::Completed;
+        while (activeRequired_ > 0) {
+            if (cancelled_) {
+                result = RelayResult::Cancelled;
+                break;
+            }
+
+            int count = epoll_wait(epollFd_, events, MaxEvents, NextTimeout());
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                result = RelayResult::Failed;
+                break;
+            }
+
+            for (int i = 0; i < count; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == WakeTag) {
+                    uint64_t value = 0;
+                    (void)!read(wakeFd_, &value, sizeof(value));
+                    ServiceStages();
+                    continue;
+                }
+                if (tag == ProcessTag || tag == ControlTag) {
+                    OnProcessExit(tag == ProcessTag);
+                    continue;
+                }
+
+                const size_t index = static_cast<size_t>(tag >> 1);
+                RelayStream& stream = *streams_[index];
+                if (stream.finished) {
+                    continue;
+                }
+
+                if (tag & 1) {
+                    if (Flush(stream, index)) {
+                        if (stream.sourceEof) {
+                            Finish(stream);
+                        } else {
+                            Pump(stream, index);
+                        }
+                    }
+                } else {
+                    Pump(stream, index);
+                }
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            for (size_t index = 0; index < streams_.size(); ++index) {
+                RelayStream& stream = *streams_[index];
+                if (stream.finished) {
+                    continue;
+                }
+                if (stream.holding && now >= stream.flushDeadline) {
+                    Flush(stream, index);
+                }
+                if (!stream.sourcePollable && !stream.waitingForSink && !stream.sourceEof) {
+                    Pump(stream, index);
+                }
+            }
+        }
+
+        StopWriters();
+        RestoreFlags();
+        process_.RecordTeardown();
+        return result;
+    }
+
+    void Cancel() {
+        cancelled_ = true;
+        Wake();
+    }
+
+    std::optional<int> GetExitCode() const { return process_.exitCode; }
+
+    std::chrono::nanoseconds GetTeardownLatency() const { return process_.teardown; }
+
+    uint64_t GetBytesRelayed(size_t stream) const {
+        return streams_.at(stream)->bytesRelayed.load(std::memory_order_relaxed);
+    }
+
+    RelayTransfer GetTransfer(size_t stream) const {
+        return streams_.at(stream)->transfer.load(std::memory_order_relaxed);
+    }
+
+    RelayStreamStats GetStats(size_t stream) const {
+        return SnapshotStats(*streams_.at(stream));
+    }
+
+private:
+    // The control handle hanging up first means the instance is gone and no
+    // exit status is coming.
+    void OnProcessExit(bool reported) {
+        if (process_.exited) {
+            return;
+        }
+
+        process_.exited = true;
+        process_.exitSeen = std::chrono::steady_clock::now();
+        if (reported) {
+            process_.exitCode = ReapExitCode(process_.process);
+        }
+
+        for (int fd : {process_.process, process_.control}) {
+            if (fd >= 0) {
+                epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+            }
+        }
+        --activeRequired_;
+    }
+
+    // Only works for our own children; anything else has no status to give.
+    static std::optional<int> ReapExitCode(int pidfd) {
+        siginfo_t info = {};
+        if (waitid(static_cast<idtype_t>(P_PIDFD), static_cast<id_t>(pidfd), &info, WEXITED | WNOHANG) != 0 ||
+            info.si_pid == 0) {
+            return std::nullopt;
+        }
+        return info.si_code == CLD_EXITED ? info.si_status : 128 + info.si_status;
+    }
+
+    void Wake() {
+        uint64_t one = 1;
+        (void)!write(wakeFd_, &one, sizeof(one));
+    }
+
+    void StopWriters() {
+        uint64_t one = 1;
+        (void)!write(stopFd_, &one, sizeof(one));
+
+        for (auto& stream : streams_) {
+            if (stream->writer.joinable()) {
+                stream->producerClosed.store(true, std::memory_order_release);
+                NotifyWriter(*stream);
+                stream->writer.join();
+            }
+        }
+    }
+
+    // Writer stage: a blocking write that gives up as soon as the engine
+    // stops. The sink is non-blocking, so wait for it alongside the stop fd.
+    ssize_t StageWrite(RelayStream& stream, const char* data, size_t length) {
+        for (;;) {
+            ssize_t written = write(stream.sink, data, length);
+            if (written > 0) {
+                return written;
+            }
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd fds[2] = {{stream.sink, POLLOUT, 0}, {stopFd_, POLLIN, 0}};
+                if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+                    return -1;
+                }
+                if (fds[1].revents & POLLIN) {
+                    return 0;
+                }
+                continue;
+            }
+            return -1;
+        }
+    }
+
+    // Runs on the loop after a writer stage signalled: resume a parked reader
+    // or retire a stream whose writer has drained everything.
+    void ServiceStages() {
+        for (size_t index = 0; index < streams_.size(); ++index) {
+            RelayStream& stream = *streams_[index];
+            if (!stream.ring || stream.finished) {
+                continue;
+            }
+
+            if (stream.writerDone.load(std::memory_order_acquire)) {
+                Finish(stream);
+            } else if (stream.waitingForSink && !stream.readerStalled.load()) {
+                PauseSource(stream, index, false);
+                Pump(stream, index);
+            }
+        }
+    }
+
+    void Close() {
+        if (stopFd_ >= 0) {
+            close(stopFd_);
+            stopFd_ = -1;
+        }
+        if (wakeFd_ >= 0) {
+            close(wakeFd_);
+            wakeFd_ = -1;
+        }
+        if (epollFd_ >= 0) {
+            close(epollFd_);
+            epollFd_ = -1;
+        }
+    }
+
+    // Returns false for descriptors epoll cannot watch (regular files), which
+    // are always ready.
+    bool Watch(int fd, uint64_t tag, uint32_t events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = tag;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event) == 0) {
+            return true;
+        }
+        if (errno == EPERM) {
+            return false;
+        }
+        throw std::system_error(errno, std::generic_category(), "Failed to register relay handle");
+    }
+
+    void Modify(int fd, uint64_t tag, uint32_t events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    void MakeNonBlocking(int fd) {
+        for (const auto& saved : savedFlags_) {
+            if (saved.first == fd) {
+                return;
+            }
+        }
+
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to query relay handle flags");
+        }
+        if (!(flags & O_NONBLOCK)) {
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        savedFlags_.emplace_back(fd, flags);
+    }
+
+    // O_NONBLOCK lives on the open file description, which is shared with
+    // whoever else holds the terminal, so put it back when we are done.
+    void RestoreFlags(int fd = -1) {
+        for (auto it = savedFlags_.begin(); it != savedFlags_.end();) {
+            if (fd < 0 || it->first == fd) {
+                fcntl(it->first, F_SETFL, it->second);
+                it = savedFlags_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Regular files never report readiness, so they are polled without
+    // blocking; otherwise sleep until the earliest coalescing deadline.
+    int NextTimeout() const {
+        int timeout = -1;
+        const auto now = std::chrono::steady_clock::now();
+
+        for (const auto& stream : streams_) {
+            if (stream->finished) {
+                continue;
+            }
+            if (!stream->sourcePollable && !stream->waitingForSink && !stream->sourceEof) {
+                return 0;
+            }
+            if (stream->holding) {
+                auto remaining = std::chrono::ceil<std::chrono::milliseconds>(stream->flushDeadline - now).count();
+                int wait = remaining > 0 ? static_cast<int>(remaining) : 0;
+                timeout = timeout < 0 ? wait : std::min(timeout, wait);
+            }
+        }
+        return timeout;
+    }
+
+    void Pump(RelayStream& stream, size_t index) {
+        // A source event from the same epoll_wait batch can still arrive after
+        // the stream switched to waiting on its sink; the buffer is not free.
+        if (stream.waitingForSink) {
+            return;
+        }
+
+        if (stream.ring) {
+            PumpStage(stream, index);
+            return;
+        }
+
+        if (stream.transfer != RelayTransfer::Buffered && PumpZeroCopy(stream, index)) {
+            return;
+        }
+
+        for (int reads = 0; reads < MaxReadsPerWakeup && !stream.finished; ++reads) {
+            size_t tail = stream.pendingOffset + stream.pendingLength;
+            if (tail == stream.buffer.size()) {
+                if (!Flush(stream, index)) {
+                    return;
+                }
+                tail = 0;
+            }
+
+            const size_t room = stream.buffer.size() - tail;
+            ssize_t bytesRead = read(stream.source, stream.buffer.data() + tail, room);
+            stream.reads.fetch_add(1, std::memory_order_relaxed);
+
+            if (bytesRead > 0) {
+                AccountRead(stream, static_cast<size_t>(bytesRead), room);
+                if (!CanCoalesce(stream) && !Flush(stream, index)) {
+                    return;
+                }
+                continue;
+            }
+
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                HoldOrFlush(stream, index);
+                return;
+            }
+
+            // EOF, or a read error which ends the stream the same way. Anything
+            // held for coalescing still goes out first.
+            stream.sourceEof = true;
+            if (Flush(stream, index)) {
+                Finish(stream);
+            }
+            return;
+        }
+
+        // Read budget exhausted with a small chunk held back.
+        HoldOrFlush(stream, index);
+    }
+
+    // Reader stage: read straight into the ring. The sink is the writer
+    // thread's business; a full ring parks the source instead.
+    void PumpStage(RelayStream& stream, size_t index) {
+        for (int reads = 0; reads < MaxReadsPerWakeup && !stream.sourceEof; ++reads) {
+            std::span<char> span = ReserveStage(stream);
+            if (span.empty()) {
+                PauseSource(stream, index, true);
+                return;
+            }
+
+            ssize_t bytesRead = read(stream.source, span.data(), span.size());
+            stream.reads.fetch_add(1, std::memory_order_relaxed);
+
+            if (bytesRead > 0) {
+                stream.ring->Commit(static_cast<size_t>(bytesRead));
+                NotifyWriter(stream);
+                continue;
+            }
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            }
+
+            // The stream finishes once the writer has drained the ring.
+            if (stream.sourcePollable) {
+                epoll_ctl(epollFd_, EPOLL_CTL_DEL, stream.source, nullptr);
+                stream.sourcePollable = false;
+            }
+            CloseStage(stream);
+        }
+    }
+
+    void PauseSource(RelayStream& stream, size_t index, bool pause) {
+        stream.waitingForSink = pause;
+        if (stream.sourcePollable) {
+            Modify(stream.source, index << 1, pause ? 0u : static_cast<uint32_t>(EPOLLIN));
+        }
+    }
+
+    // The source is drained for now. Small output may wait up to the
+    // coalescing window for more to arrive; everything else goes out now.
+    void HoldOrFlush(RelayStream& stream, size_t index) {
+        if (stream.pendingLength == 0 || stream.waitingForSink || stream.finished) {
+            return;
+        }
+
+        const auto window = stream.options.coalesceWindow;
+        if (stream.options.mode == RelayMode::Throughput && window.count() > 0) {
+            const auto now = std::chrono::steady_clock::now();
+            if (!stream.holding) {
+                stream.holding = true;
+                stream.flushDeadline = now + window;
+                return;
+            }
+            if (now < stream.flushDeadline) {
+                return;
+            }
+        }
+
+        Flush(stream, index);
+    }
+
+    // Returns false when the stream has to drop to the buffered path.
+    bool PumpZeroCopy(RelayStream& stream, size_t index) {
+        const bool splicing = stream.transfer == RelayTransfer::Splice;
+
+        for (int moves = 0; moves < MaxReadsPerWakeup && !stream.finished; ++moves) {
+            ssize_t moved = splicing
+                ? splice(stream.source, nullptr, stream.sink, nullptr, ZeroCopyChunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+                : sendfile(stream.sink, stream.source, nullptr, ZeroCopyChunk);
+            stream.zeroCopyCalls.fetch_add(1, std::memory_order_relaxed);
+
+            if (moved > 0) {
+                CountBytes(stream, static_cast<uint64_t>(moved));
+                continue;
+            }
+            if (moved == 0) {
+                Finish(stream);
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Either side may be the one that is not ready; only wait on the
+                // sink when the source demonstrably still has bytes queued.
+                if (stream.sinkPollable && SourceHasData(stream)) {
+                    WaitForSink(stream, index, true);
+                }
+                return true;
+            }
+
+            // EINVAL/ENOSYS for pairs the kernel cannot splice, or a broken
+            // sink, which the buffered path already knows how to drain.
+            stream.transfer = RelayTransfer::Buffered;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SourceHasData(const RelayStream& stream) const {
+        if (stream.transfer == RelayTransfer::SendFile) {
+            return true;
+        }
+
+        int available = 0;
+        return ioctl(stream.source, FIONREAD, &available) == 0 && available > 0;
+    }
+
+    // Returns true once the pending chunk has been fully handed to the sink.
+    bool Flush(RelayStream& stream, size_t index) {
+        stream.holding = false;
+
+        while (stream.pendingLength > 0) {
+            if (stream.sinkBroken) {
+                // Keep reading so the producer never blocks on a dead consumer.
+                stream.pendingLength = 0;
+                break;
+            }
+
+            ssize_t written = write(stream.sink, stream.buffer.data() + stream.pendingOffset, stream.pendingLength);
+            stream.writes.fetch_add(1, std::memory_order_relaxed);
+            if (written > 0) {
+                stream.pendingOffset += static_cast<size_t>(written);
+                stream.pendingLength -= static_cast<size_t>(written);
+                CountBytes(stream, static_cast<uint64_t>(written));
+                continue;
+            }
+
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && stream.sinkPollable) {
+                WaitForSink(stream, index, true);
+                return false;
+            }
+
+            stream.sinkBroken = true;
+        }
+
+        stream.pendingOffset = 0;
+        MaybeShrink(stream);
+
+        if (stream.waitingForSink) {
+            WaitForSink(stream, index, false);
+        }
+        return true;
+    }
+
+    // Swaps interest between the source and the sink so a slow consumer
+    // applies backpressure instead of growing an unbounded queue.
+    void WaitForSink(RelayStream& stream, size_t index, bool wait) {
+        stream.waitingForSink = wait;
+        if (stream.sourcePollable) {
+            Modify(stream.source, index << 1, wait ? 0u : static_cast<uint32_t>(EPOLLIN));
+        }
+        Modify(stream.sinkWatch, (index << 1) | 1, wait ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    }
+
+    void Finish(RelayStream& stream) {
+        if (stream.finished) {
+            return;
+        }
+
+        stream.finished = true;
+        if (stream.writer.joinable()) {
+            stream.writer.join();
+        }
+
+        if (stream.sourcePollable) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, stream.source, nullptr);
+        }
+        if (stream.sinkWatch >= 0) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, stream.sinkWatch, nullptr);
+            close(stream.sinkWatch);
+            stream.sinkWatch = -1;
+        }
+
+        if (stream.options.closeSinkOnEof && stream.sink >= 0) {
+            RestoreFlags(stream.sink);
+            close(stream.sink);
+            stream.sink = -1;
+        }
+
+        if (stream.options.required) {
+            --activeRequired_;
+        }
+    }
+};
+
+#endif
+
+RelayEngine::RelayEngine() : pImpl_(std::make_unique<Impl>()) {}
+RelayEngine::~RelayEngine() = default;
+
+size_t RelayEngine::AddStream(NativeHandle source, NativeHandle sink, const RelayStreamOptions& options) {
+    return pImpl_->AddStream(source, sink, options);
+}
+
+void RelayEngine::WatchProcess(NativeHandle process, NativeHandle control) {
+    pImpl_->WatchProcess(process, control);
+}
+
+RelayResult RelayEngine::Run() {
+    return pImpl_->Run();
+}
+
+void RelayEngine::Cancel() {
+    pImpl_->Cancel();
+}
+
+std::optional<int> RelayEngine::GetExitCode() const {
+    return pImpl_->GetExitCode();
+}
+
+std::chrono::nanoseconds RelayEngine::GetTeardownLatency() const {
+    return pImpl_->GetTeardownLatency();
+}
+
+uint64_t RelayEngine::GetBytesRelayed(size_t stream) const {
+    return pImpl_->GetBytesRelayed(stream);
+}
+
+RelayStreamStats RelayEngine::GetStats(size_t stream) const {
+    return pImpl_->GetStats(stream);
+}
+
+RelayTransfer RelayEngine::GetTransfer(size_t stream) const {
+    return pImpl_->GetTransfer(stream);
+}
+
+} // namespace WSL
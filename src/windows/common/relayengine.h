@@ -0,0 +1,149 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "metrics.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace WSL {
+
+#ifdef _WIN32
+using NativeHandle = HANDLE;
+inline const NativeHandle InvalidNativeHandle = INVALID_HANDLE_VALUE;
+#else
+using NativeHandle = int;
+constexpr NativeHandle InvalidNativeHandle = -1;
+#endif
+
+enum class RelayMode {
+    // Forward every read as soon as it lands and keep buffers small; meant
+    // for interactive sessions where keystroke echo latency matters.
+    Latency,
+
+    // Grow buffers up to maxBufferSize and hold small chunks for up to
+    // coalesceWindow so back-to-back writes leave in a single syscall.
+    Throughput
+};
+
+struct RelayStreamOptions {
+    // Run() does not return until every required stream has reached EOF.
+    // Optional streams (stdin) are abandoned once the required ones finish.
+    bool required = true;
+
+    // Close the sink when the source reaches EOF so the peer sees EOF too.
+    bool closeSinkOnEof = false;
+
+    RelayMode mode = RelayMode::Latency;
+
+    // Starting size; buffers double while reads keep filling them and shrink
+    // back once the stream goes quiet. Latency mode caps growth at 64 KiB.
+    size_t bufferSize = 4096;
+    size_t maxBufferSize = 1024 * 1024;
+
+    // Throughput mode only. Windows merges input that is already queued on
+    // the pipe and never waits, so the window only applies to epoll.
+    std::chrono::microseconds coalesceWindow{2000};
+
+    // Non-zero splits the stream into a reader stage on the relay loop and a
+    // writer stage on its own thread, connected by an SPSC ring of this many
+    // bytes, so a slow sink (console scrollback, a network share) no longer
+    // stalls reads from the source. A full ring parks the source until the
+    // writer catches up. Staged streams always copy; zeroCopy is ignored.
+    size_t writerRingSize = 0;
+
+    // Move bytes kernel-side when the handle pair allows it (splice between
+    // pipes/sockets/files, sendfile from a file). Pairs that turn out not to
+    // support it fall back to the buffered copy on the first attempt. Windows
+    // has no pipe/console equivalent, so it always copies there.
+    bool zeroCopy = true;
+
+    // Also publishes bytes and reader stalls to this registry as they happen,
+    // not only through GetStats(). Null publishes nothing.
+    MetricsRegistry* metrics = nullptr;
+    Metric bytesMetric = Metric::RelayOutputBytes;
+};
+
+enum class RelayTransfer {
+    Buffered,
+    Splice,
+    SendFile
+};
+
+struct RelayStreamStats {
+    uint64_t bytes = 0;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t zeroCopyCalls = 0;
+    uint64_t readerStalls = 0;
+    size_t bufferSize = 0;
+
+    uint64_t Syscalls() const { return reads + writes + zeroCopyCalls; }
+
+    double SyscallsPerMegabyte() const {
+        return bytes == 0 ? 0.0 : static_cast<double>(Syscalls()) * (1024.0 * 1024.0) / static_cast<double>(bytes);
+    }
+};
+
+enum class RelayResult {
+    Completed,
+    Cancelled,
+    Failed
+};
+
+// Multiplexes any number of source -> sink byte streams on the calling thread.
+// Windows uses overlapped I/O on a completion port (console and synchronous
+// handles are serviced by a blocking reader that posts to the same port);
+// everything else uses epoll, which is what the Linux tests drive with pipes.
+class RelayEngine {
+public:
+    RelayEngine();
+    ~RelayEngine();
+
+    // Non-copyable, non-movable
+    RelayEngine(const RelayEngine&) = delete;
+    RelayEngine& operator=(const RelayEngine&) = delete;
+    RelayEngine(RelayEngine&&) = delete;
+    RelayEngine& operator=(RelayEngine&&) = delete;
+
+    // Handles stay owned by the caller unless closeSinkOnEof is set.
+    // Must be called before Run().
+    size_t AddStream(NativeHandle source, NativeHandle sink, const RelayStreamOptions& options = {});
+
+    // Adds the Linux process to the wait set. Run() then also waits for the
+    // process handle to signal (a pidfd on Linux, which the engine reaps) or
+    // the control handle to close, abandons optional streams at that point
+    // and keeps draining required ones to EOF. Must be called before Run().
+    void WatchProcess(NativeHandle process, NativeHandle control = InvalidNativeHandle);
+
+    RelayResult Run();
+
+    // Safe to call from any thread, before or during Run().
+    void Cancel();
+
+    // Exit status of the watched process; empty until it has exited, or if
+    // the instance went away without reporting one. Signals map to 128 + n.
+    std::optional<int> GetExitCode() const;
+
+    // Time from observing the exit to Run() returning, i.e. how long the
+    // remaining output took to drain.
+    std::chrono::nanoseconds GetTeardownLatency() const;
+
+    uint64_t GetBytesRelayed(size_t stream) const;
+    RelayStreamStats GetStats(size_t stream) const;
+
+    // Transfer path currently in use; may drop to Buffered while running.
+    RelayTransfer GetTransfer(size_t stream) const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
@@ -0,0 +1,102 @@
+#include "relaysession.h"
+
+namespace WSL {
+
+namespace {
+
+constexpr size_t OutputRingSize = 256 * 1024;
+
+} // namespace
+
+class RelaySession::Impl {
+public:
+    Impl(const RelaySessionHandles& handles, RelayMode mode, MetricsRegistry* metrics) {
+        // All three streams share one loop on the calling thread. Stdin is
+        // optional: once stdout and stderr hit EOF the process is gone and the
+        // pending console read is cancelled instead of joined.
+        RelayStreamOptions inputOptions;
+        inputOptions.required = false;
+        inputOptions.metrics = metrics;
+        inputOptions.bytesMetric = Metric::RelayInputBytes;
+
+        // Keystrokes are always forwarded immediately; the session mode only
+        // decides how output is batched. Output is written from its own thread
+        // so a console that is slow to scroll never backs up into the Linux
+        // process' pipe.
+        RelayStreamOptions outputOptions;
+        outputOptions.mode = mode;
+        outputOptions.writerRingSize = OutputRingSize;
+        outputOptions.metrics = metrics;
+        outputOptions.bytesMetric = Metric::RelayOutputBytes;
+
+        RelayStreamOptions errorOptions = outputOptions;
+        errorOptions.bytesMetric = Metric::RelayErrorBytes;
+
+        if (handles.consoleInput != InvalidNativeHandle && handles.processInput != InvalidNativeHandle) {
+            input_ = engine_.AddStream(handles.consoleInput, handles.processInput, inputOptions);
+        }
+        output_ = engine_.AddStream(handles.processOutput, handles.consoleOutput, outputOptions);
+        error_ = engine_.AddStream(handles.processError, handles.consoleError, errorOptions);
+
+        if (handles.process != InvalidNativeHandle || handles.control != InvalidNativeHandle) {
+            engine_.WatchProcess(handles.process, handles.control);
+        }
+    }
+
+    RelayResult Run() {
+        return engine_.Run();
+    }
+
+    void Cancel() { engine_.Cancel(); }
+
+    RelayStreamStats GetStats(RelaySessionStream stream) const {
+        switch (stream) {
+        case RelaySessionStream::Input:
+            return input_ == NoStream ? RelayStreamStats{} : engine_.GetStats(input_);
+        case RelaySessionStream::Output:
+            return engine_.GetStats(output_);
+        case RelaySessionStream::Error:
+            return engine_.GetStats(error_);
+        }
+        return {};
+    }
+
+    std::optional<int> GetExitCode() const { return engine_.GetExitCode(); }
+
+    std::chrono::nanoseconds GetTeardownLatency() const { return engine_.GetTeardownLatency(); }
+
+private:
+    static constexpr size_t NoStream = static_cast<size_t>(-1);
+
+    RelayEngine engine_;
+    size_t input_ = NoStream;
+    size_t output_ = NoStream;
+    size_t error_ = NoStream;
+};
+
+RelaySession::RelaySession(const RelaySessionHandles& handles, RelayMode mode, MetricsRegistry* metrics)
+    : pImpl_(std::make_unique<Impl>(handles, mode, metrics)) {}
+
+RelaySession::~RelaySession() = default;
+
+RelayResult RelaySession::Run() {
+    return pImpl_->Run();
+}
+
+void RelaySession::Cancel() {
+    pImpl_->Cancel();
+}
+
+RelayStreamStats RelaySession::GetStats(RelaySessionStream stream) const {
+    return pImpl_->GetStats(stream);
+}
+
+std::optional<int> RelaySession::GetExitCode() const {
+    return pImpl_->GetExitCode();
+}
+
+std::chrono::nanoseconds RelaySession::GetTeardownLatency() const {
+    return pImpl_->GetTeardownLatency();
+}
+
+} // namespace WSL
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "relayengine.h"
+
+#include <memory>
+
+namespace WSL {
+
+// The six handles of an interactive session: the console side the user sees
+// and the pipes the service hands back for the Linux process.
+struct RelaySessionHandles {
+    NativeHandle consoleInput = InvalidNativeHandle;
+    NativeHandle consoleOutput = InvalidNativeHandle;
+    NativeHandle consoleError = InvalidNativeHandle;
+
+    NativeHandle processInput = InvalidNativeHandle;
+    NativeHandle processOutput = InvalidNativeHandle;
+    NativeHandle processError = InvalidNativeHandle;
+
+    // Optional; when set, completion and the exit status come from these
+    // rather than from the output pipes closing.
+    NativeHandle process = InvalidNativeHandle;
+    NativeHandle control = InvalidNativeHandle;
+};
+
+enum class RelaySessionStream {
+    Input,
+    Output,
+    Error
+};
+
+// Wires a session's handles into one RelayEngine the way RelayIO does:
+// stdin is optional and always forwarded immediately, stdout and stderr follow
+// the session mode and are written from a staged writer. Kept free of console
+// APIs so the benchmarks and tests can drive it with pipes and socketpairs.
+class RelaySession {
+public:
+    // With metrics, each stream's bytes are published as they are relayed.
+    RelaySession(const RelaySessionHandles& handles, RelayMode mode, MetricsRegistry* metrics = nullptr);
+    ~RelaySession();
+
+    // Non-copyable, non-movable
+    RelaySession(const RelaySession&) = delete;
+    RelaySession& operator=(const RelaySession&) = delete;
+    RelaySession(RelaySession&&) = delete;
+    RelaySession& operator=(RelaySession&&) = delete;
+
+    // Returns once the process side has closed stdout and stderr and, when a
+    // process handle was given, the process has exited.
+    RelayResult Run();
+
+    // Safe to call from any thread.
+    void Cancel();
+
+    RelayStreamStats GetStats(RelaySessionStream stream) const;
+    std::optional<int> GetExitCode() const;
+    std::chrono::nanoseconds GetTeardownLatency() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
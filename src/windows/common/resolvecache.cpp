@@ -0,0 +1,300 @@
+#include "resolvecache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+// Fixed-size records follow the header, then the string pool. Everything is
+// in the writer's native layout; the cache never leaves the machine.
+struct ResolutionCache::Header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t charSize;
+    uint64_t stamp;
+    uint64_t checksum; // Checksum() of everything after the header
+    uint32_t entryCount;
+    uint32_t defaultIndex; // NoDefault if unset
+    uint32_t endpointOffset;
+    uint32_t endpointLength;
+    uint32_t stringChars;
+    uint32_t reserved;
+};
+
+// Sorted by name.
+struct ResolutionCache::Entry {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t idOffset;
+    uint32_t idLength;
+};
+
+namespace {
+
+constexpr uint32_t CacheMagic = 0x524C5357; // "WSLR"
+constexpr uint32_t NoDefault = UINT32_MAX;
+
+// FNV-1a over 64-bit words, then the tail bytes; a word at a time keeps
+// verification well under the cost of a registry enumeration even for
+// thousands of distributions.
+uint64_t Checksum(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t ProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint64_t>(getpid());
+#endif
+}
+
+} // namespace
+
+bool ResolutionCache::Open(const std::string& path) {
+    Close();
+    if (!file_.Open(path)) {
+        return false;
+    }
+
+    const std::string_view view = file_.View();
+    if (view.size() < sizeof(Header)) {
+        return false;
+    }
+
+    const Header* header = GetHeader();
+    if (header->magic != CacheMagic || header->version != FormatVersion || header->charSize != sizeof(wchar_t)) {
+        return false;
+    }
+
+    const uint64_t expected = sizeof(Header) + uint64_t{header->entryCount} * sizeof(Entry) +
+                              uint64_t{header->stringChars} * sizeof(wchar_t);
+    if (view.size() != expected) {
+        return false;
+    }
+
+    const char* payload = view.data() + sizeof(Header);
+    if (Checksum(payload, view.size() - sizeof(Header)) != header->checksum) {
+        return false;
+    }
+
+    // The checksum only proves the bytes are what some writer produced;
+    // bounds are still checked so a buggy writer cannot cause a bad read.
+    auto inPool = [header](uint32_t offset, uint32_t length) {
+        return uint64_t{offset} + length <= header->stringChars;
+    };
+    const Entry* entries = reinterpret_cast<const Entry*>(payload);
+    for (uint32_t i = 0; i < header->entryCount; ++i) {
+        if (!inPool(entries[i].nameOffset, entries[i].nameLength) || !inPool(entries[i].idOffset, entries[i].idLength)) {
+            return false;
+        }
+    }
+    if (!inPool(header->endpointOffset, header->endpointLength) ||
+        (header->defaultIndex != NoDefault && header->defaultIndex >= header->entryCount)) {
+        return false;
+    }
+
+    strings_ = reinterpret_cast<const wchar_t*>(payload + header->entryCount * sizeof(Entry));
+    valid_ = true;
+    return true;
+}
+
+void ResolutionCache::Close() {
+    file_.Close();
+    strings_ = nullptr;
+    valid_ = false;
+}
+
+const ResolutionCache::Header* ResolutionCache::GetHeader() const {
+    return reinterpret_cast<const Header*>(file_.View().data());
+}
+
+const ResolutionCache::Entry* ResolutionCache::Entries() const {
+    return reinterpret_cast<const Entry*>(file_.View().data() + sizeof(Header));
+}
+
+std::wstring_view ResolutionCache::String(uint32_t offset, uint32_t length) const {
+    return {strings_ + offset, length};
+}
+
+ResolvedDistribution ResolutionCache::Resolve(const Entry& entry) const {
+    return {std::wstring(String(entry.idOffset, entry.idLength)), std::wstring(String(entry.nameOffset, entry.nameLength)),
+            std::wstring(Endpoint()), true};
+}
+
+uint64_t ResolutionCache::Stamp() const {
+    return valid_ ? GetHeader()->stamp : 0;
+}
+
+std::wstring_view ResolutionCache::Endpoint() const {
+    if (!valid_) {
+        return {};
+    }
+    return String(GetHeader()->endpointOffset, GetHeader()->endpointLength);
+}
+
+std::optional<ResolvedDistribution> ResolutionCache::Find(std::wstring_view name) const {
+    if (!valid_) {
+        return std::nullopt;
+    }
+
+    const Entry* first = Entries();
+    const Entry* last = first + GetHeader()->entryCount;
+    const Entry* found = std::lower_bound(first, last, name, [this](const Entry& entry, std::wstring_view key) {
+        return String(entry.nameOffset, entry.nameLength) < key;
+    });
+    if (found == last || String(found->nameOffset, found->nameLength) != name) {
+        return std::nullopt;
+    }
+    return Resolve(*found);
+}
+
+std::optional<ResolvedDistribution> ResolutionCache::Default() const {
+    if (!valid_ || GetHeader()->defaultIndex == NoDefault) {
+        return std::nullopt;
+    }
+    return Resolve(Entries()[GetHeader()->defaultIndex]);
+}
+
+bool ResolutionCache::Write(const std::string& path, const CatalogSnapshot& catalog, uint64_t stamp,
+                            std::wstring_view endpoint) {
+    // First of any duplicate names, matching CatalogSnapshot::FindByName.
+    std::vector<const Distribution*> distributions;
+    for (const Distribution& distribution : catalog.All()) {
+        if (catalog.FindByName(distribution.name) == &distribution) {
+            distributions.push_back(&distribution);
+        }
+    }
+    std::sort(distributions.begin(), distributions.end(),
+              [](const Distribution* left, const Distribution* right) { return left->name < right->name; });
+
+    std::wstring pool;
+    auto intern = [&pool](std::wstring_view text, uint32_t& offset, uint32_t& length) {
+        offset = static_cast<uint32_t>(pool.size());
+        length = static_cast<uint32_t>(text.size());
+        pool.append(text);
+    };
+
+    Header header{};
+    header.magic = CacheMagic;
+    header.version = FormatVersion;
+    header.charSize = sizeof(wchar_t);
+    header.stamp = stamp;
+    header.entryCount = static_cast<uint32_t>(distributions.size());
+    header.defaultIndex = NoDefault;
+    intern(endpoint, header.endpointOffset, header.endpointLength);
+
+    std::vector<Entry> entries(distributions.size());
+    const Distribution* defaultDistribution = catalog.Default();
+    for (size_t i = 0; i < distributions.size(); ++i) {
+        intern(distributions[i]->name, entries[i].nameOffset, entries[i].nameLength);
+        intern(distributions[i]->id, entries[i].idOffset, entries[i].idLength);
+        if (distributions[i] == defaultDistribution) {
+            header.defaultIndex = static_cast<uint32_t>(i);
+        }
+    }
+    header.stringChars = static_cast<uint32_t>(pool.size());
+
+    std::string payload(entries.size() * sizeof(Entry) + pool.size() * sizeof(wchar_t), '\0');
+    if (!entries.empty()) {
+        std::memcpy(payload.data(), entries.data(), entries.size() * sizeof(Entry));
+    }
+    if (!pool.empty()) {
+        std::memcpy(payload.data() + entries.size() * sizeof(Entry), pool.data(), pool.size() * sizeof(wchar_t));
+    }
+    header.checksum = Checksum(payload.data(), payload.size());
+
+    std::error_code error;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::filesystem::create_directories(target.parent_path(), error);
+    }
+
+    const std::string temporary = path + "." + std::to_string(ProcessId()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        if (!file.flush()) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, target, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+std::optional<ResolvedDistribution> ResolveDistribution(const std::string& cachePath, std::wstring_view name,
+                                                        DistributionCatalog& catalog, std::wstring_view endpoint) {
+    const std::optional<uint64_t> stamp = cachePath.empty() ? std::nullopt : catalog.Stamp();
+
+    bool current = false;
+    if (stamp) {
+        ResolutionCache cache;
+        if (cache.Open(cachePath) && cache.Stamp() == *stamp) {
+            auto hit = name.empty() ? cache.Default() : cache.Find(name);
+            if (hit) {
+                return hit;
+            }
+            current = true;
+        }
+    }
+
+    // The stamp was read before enumerating, so a change in between leaves
+    // an older stamp in the cache and the next run refreshes it.
+    auto snapshot = catalog.Snapshot();
+    if (stamp && !current) {
+        ResolutionCache::Write(cachePath, *snapshot, *stamp, endpoint);
+    }
+
+    const Distribution* distribution = name.empty() ? snapshot->Default() : snapshot->FindByName(name);
+    if (!distribution) {
+        return std::nullopt;
+    }
+    return ResolvedDistribution{distribution->id, distribution->name, std::wstring(endpoint), false};
+}
+
+#ifdef _WIN32
+
+std::string DefaultResolutionCachePath() {
+    char localAppData[MAX_PATH];
+    const DWORD length = GetEnvironmentVariableA("LOCALAPPDATA", localAppData, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return {};
+    }
+    return std::string(localAppData, length) + "\\wsl\\resolve.cache";
+}
+
+std::optional<ResolvedDistribution> ResolveDistribution(std::wstring_view name) {
+    static const std::string path = DefaultResolutionCachePath();
+    return ResolveDistribution(path, name, DistributionCatalog::Default());
+}
+
+#endif
+
+} // namespace WSL
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "distcatalog.h"
+#include "mappedfile.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace WSL {
+
+// The COM class wsl.exe activates to reach the service.
+inline constexpr std::wstring_view DefaultServiceEndpoint = L"LxssUserSession";
+
+struct ResolvedDistribution {
+    std::wstring id;
+    std::wstring name;
+    std::wstring endpoint;
+    bool cached = false; // served without enumerating the store
+};
+
+// On-disk snapshot of what the client needs before it can launch anything:
+// distribution name -> id, the default, and the service endpoint. The file
+// is mapped, checked against its version, writer wchar_t size and checksum,
+// and searched in place. It is tagged with the distribution store's Stamp()
+// and ignored once that moves.
+//
+// Copy what you need and close it: on Windows a mapped file cannot be
+// replaced, so a long-lived reader would block every other client's update.
+class ResolutionCache {
+public:
+    static constexpr uint32_t FormatVersion = 1;
+
+    // False if the file is missing, from another version, or damaged.
+    bool Open(const std::string& path);
+    void Close();
+
+    uint64_t Stamp() const;
+    std::wstring_view Endpoint() const;
+
+    // Exact name match, as DistributionCatalog does.
+    std::optional<ResolvedDistribution> Find(std::wstring_view name) const;
+    std::optional<ResolvedDistribution> Default() const;
+
+    // Replaces the file atomically (write a sibling, then rename). Returns
+    // false if it could not be written; the cache is only an accelerator.
+    static bool Write(const std::string& path, const CatalogSnapshot& catalog, uint64_t stamp,
+                      std::wstring_view endpoint);
+
+private:
+    struct Header;
+    struct Entry;
+
+    const Header* GetHeader() const;
+    const Entry* Entries() const;
+    std::wstring_view String(uint32_t offset, uint32_t length) const;
+    ResolvedDistribution Resolve(const Entry& entry) const;
+
+    MappedFile file_;
+    const wchar_t* strings_ = nullptr;
+    bool valid_ = false;
+};
+
+// The client fast path: name (empty for the default) -> id through the cache
+// at cachePath, falling back to the catalog when the cache is missing,
+// stale or lacks the name, and rewriting the cache in that case.
+std::optional<ResolvedDistribution> ResolveDistribution(const std::string& cachePath, std::wstring_view name,
+                                                        DistributionCatalog& catalog,
+                                                        std::wstring_view endpoint = DefaultServiceEndpoint);
+
+#ifdef _WIN32
+// %LOCALAPPDATA%\wsl\resolve.cache
+std::string DefaultResolutionCachePath();
+
+// ResolveDistribution() against the default path and registry catalog.
+std::optional<ResolvedDistribution> ResolveDistribution(std::wstring_view name);
+#endif
+
+} // namespace WSL
@@ -0,0 +1,212 @@
+#include "servicesession.h"
+#include "trace.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+void CloseNative(NativeHandle& handle) {
+    if (handle == InvalidNativeHandle) {
+        return;
+    }
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+    close(handle);
+#endif
+    handle = InvalidNativeHandle;
+}
+
+} // namespace
+
+LaunchResult::~LaunchResult() {
+    Close();
+}
+
+LaunchResult::LaunchResult(LaunchResult&& other) noexcept
+    : status(other.status),
+      input(std::exchange(other.input, InvalidNativeHandle)),
+      output(std::exchange(other.output, InvalidNativeHandle)),
+      error(std::exchange(other.error, InvalidNativeHandle)),
+      process(std::exchange(other.process, InvalidNativeHandle)) {
+}
+
+LaunchResult& LaunchResult::operator=(LaunchResult&& other) noexcept {
+    if (this != &other) {
+        Close();
+        status = other.status;
+        input = std::exchange(other.input, InvalidNativeHandle);
+        output = std::exchange(other.output, InvalidNativeHandle);
+        error = std::exchange(other.error, InvalidNativeHandle);
+        process = std::exchange(other.process, InvalidNativeHandle);
+    }
+    return *this;
+}
+
+void LaunchResult::Close() {
+    CloseNative(input);
+    CloseNative(output);
+    CloseNative(error);
+    CloseNative(process);
+}
+
+bool SetLaunchCommand(LaunchRequest& request, std::wstring_view commandLine, const ArgumentVector& arguments) {
+    if (arguments.Empty()) {
+        TokenizeCommandLine(commandLine, QuotingRules::Posix, request.arguments);
+    } else {
+        request.arguments = arguments;
+    }
+    if (request.arguments.Empty()) {
+        return false;
+    }
+    request.command = request.arguments[0];
+    return true;
+}
+
+class ServiceSession::Impl {
+private:
+    struct Pending {
+        Callback callback;
+        uint64_t queued = 0; // TraceNow()
+    };
+
+    std::unique_ptr<ServiceTransport> transport_;
+    MetricsRegistry* metrics_;
+
+    mutable std::mutex lock_;
+    std::unordered_map<uint64_t, Pending> pending_;
+    bool closed_ = false;
+
+    std::atomic<uint64_t> nextId_{1};
+    std::atomic<uint64_t> launched_{0};
+    std::atomic<uint64_t> completed_{0};
+    std::atomic<uint64_t> failed_{0};
+
+public:
+    Impl(std::unique_ptr<ServiceTransport> transport, MetricsRegistry* metrics)
+        : transport_(std::move(transport)), metrics_(metrics) {
+        if (!transport_) {
+            throw std::invalid_argument("Service session needs a transport");
+        }
+        transport_->SetCompletion([this](uint64_t id, LaunchResult result) { Complete(id, std::move(result)); });
+    }
+
+    ~Impl() {
+        // No completion can arrive once Close() returns, so whatever is
+        // still pending will never hear back.
+        transport_->Close();
+
+        std::unordered_map<uint64_t, Pending> abandoned;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closed_ = true;
+            abandoned.swap(pending_);
+        }
+        for (auto& [id, pending] : abandoned) {
+            Finish(pending.callback, LaunchResult(LaunchAborted));
+        }
+    }
+
+    uint64_t Launch(LaunchRequest request, Callback callback) {
+        const uint64_t id = nextId_.fetch_add(1, std::memory_order_relaxed);
+        launched_.fetch_add(1, std::memory_order_relaxed);
+        if (metrics_) {
+            metrics_->Add(Metric::Launches);
+        }
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            if (closed_) {
+                guard.unlock();
+                Finish(callback, LaunchResult(LaunchAborted));
+                return id;
+            }
+            pending_.emplace(id, Pending{std::move(callback), TraceNow()});
+        }
+
+        // Registered first: a fast transport may complete before Send()
+        // returns.
+        if (!transport_->Send(id, std::move(request))) {
+            Complete(id, LaunchResult(LaunchServiceUnavailable));
+        }
+        return id;
+    }
+
+    Stats GetStats() const {
+        Stats stats;
+        stats.launched = launched_.load(std::memory_order_relaxed);
+        stats.completed = completed_.load(std::memory_order_relaxed);
+        stats.failed = failed_.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(lock_);
+        stats.pending = pending_.size();
+        return stats;
+    }
+
+private:
+    // Late or duplicate ids are dropped along with their handles.
+    void Complete(uint64_t id, LaunchResult result) {
+        Pending pending;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto found = pending_.find(id);
+            if (found == pending_.end()) {
+                return;
+            }
+            pending = std::move(found->second);
+            pending_.erase(found);
+        }
+
+        // From queueing to completion, on whichever thread completes it.
+        const uint64_t completed = TraceNow();
+        if (TracingEnabled()) {
+            RecordTraceSpan("ServiceRoundTrip", pending.queued, completed);
+        }
+        if (metrics_) {
+            metrics_->Record(Metric::LaunchLatency, completed - pending.queued);
+        }
+        Finish(pending.callback, std::move(result));
+    }
+
+    void Finish(Callback& callback, LaunchResult result) {
+        completed_.fetch_add(1, std::memory_order_relaxed);
+        if (!result.Succeeded()) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            if (metrics_) {
+                metrics_->Add(Metric::LaunchFailures);
+            }
+        }
+        callback(std::move(result));
+    }
+};
+
+ServiceSession::ServiceSession(std::unique_ptr<ServiceTransport> transport, MetricsRegistry* metrics)
+    : pImpl_(std::make_unique<Impl>(std::move(transport), metrics)) {
+}
+
+ServiceSession::~ServiceSession() = default;
+
+std::future<LaunchResult> ServiceSession::Launch(LaunchRequest request) {
+    auto promise = std::make_shared<std::promise<LaunchResult>>();
+    std::future<LaunchResult> future = promise->get_future();
+    pImpl_->Launch(std::move(request), [promise](LaunchResult result) { promise->set_value(std::move(result)); });
+    return future;
+}
+
+uint64_t ServiceSession::Launch(LaunchRequest request, Callback callback) {
+    return pImpl_->Launch(std::move(request), std::move(callback));
+}
+
+ServiceSession::Stats ServiceSession::GetStats() const {
+    return pImpl_->GetStats();
+}
+
+} // namespace WSL
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "cmdline.h"
+#include "envsnapshot.h"
+#include "metrics.h"
+#include "relayengine.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WSL {
+
+// HRESULT values the session reports on its own.
+inline constexpr int32_t LaunchAborted = static_cast<int32_t>(0x80004004);           // E_ABORT
+inline constexpr int32_t LaunchServiceUnavailable = static_cast<int32_t>(0x800706BA); // RPC_S_SERVER_UNAVAILABLE
+
+struct LaunchRequest {
+    std::wstring distributionId; // "{GUID}"
+    std::wstring command;
+    ArgumentVector arguments; // handed to the service as-is, never re-joined
+    std::shared_ptr<const EnvironmentSnapshot> environment; // shared, never copied per launch
+    std::wstring workingDirectory;
+    std::wstring userName; // empty for the default user; the COM transport ignores it
+};
+
+// Fills in what a request runs: a trailing argv as given when there is one,
+// otherwise commandLine split under POSIX rules. Returns false if that
+// leaves nothing to run. Throws std::invalid_argument for an unterminated
+// quote in commandLine.
+bool SetLaunchCommand(LaunchRequest& request, std::wstring_view commandLine, const ArgumentVector& arguments);
+
+// What CreateLxProcess hands back. Owns the handles and closes whatever is
+// still set when destroyed; move them out to keep them.
+struct LaunchResult {
+    int32_t status = 0; // HRESULT; negative on failure
+    NativeHandle input = InvalidNativeHandle;
+    NativeHandle output = InvalidNativeHandle;
+    NativeHandle error = InvalidNativeHandle;
+    NativeHandle process = InvalidNativeHandle;
+
+    LaunchResult() = default;
+    explicit LaunchResult(int32_t failure) : status(failure) {}
+    ~LaunchResult();
+
+    LaunchResult(LaunchResult&& other) noexcept;
+    LaunchResult& operator=(LaunchResult&& other) noexcept;
+
+    // Non-copyable
+    LaunchResult(const LaunchResult&) = delete;
+    LaunchResult& operator=(const LaunchResult&) = delete;
+
+    bool Succeeded() const { return status >= 0; }
+    void Close();
+};
+
+// One connection to the service. Requests carry an id the transport echoes
+// back with the result; completions may arrive on any thread, in any order.
+class ServiceTransport {
+public:
+    using Completion = std::function<void(uint64_t id, LaunchResult result)>;
+
+    virtual ~ServiceTransport() = default;
+
+    // Called once by the session, before the first Send().
+    virtual void SetCompletion(Completion completion) = 0;
+
+    // Queues one request. Returns false if the connection is gone; the id
+    // will then never complete.
+    virtual bool Send(uint64_t id, LaunchRequest request) = 0;
+
+    // Stops delivering completions and releases the connection. Requests
+    // still in flight are dropped. Must be safe to call twice.
+    virtual void Close() = 0;
+};
+
+// A long-lived connection that many launches share. Each Launch() gets a
+// request id and completes asynchronously; nothing waits for earlier
+// launches to finish.
+class ServiceSession {
+public:
+    using Callback = std::function<void(LaunchResult result)>;
+
+    struct Stats {
+        uint64_t launched = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;
+        size_t pending = 0;
+    };
+
+    // With metrics, publishes launches, failures and the latency from
+    // queueing a launch to its completion.
+    explicit ServiceSession(std::unique_ptr<ServiceTransport> transport, MetricsRegistry* metrics = nullptr);
+
+    // Closes the transport, then fails every pending launch with LaunchAborted.
+    ~ServiceSession();
+
+    // Non-copyable, non-movable
+    ServiceSession(const ServiceSession&) = delete;
+    ServiceSession& operator=(const ServiceSession&) = delete;
+    ServiceSession(ServiceSession&&) = delete;
+    ServiceSession& operator=(ServiceSession&&) = delete;
+
+#ifdef _WIN32
+    // The process-wide session over COM, connected on first use.
+    static ServiceSession& Default();
+#endif
+
+    std::future<LaunchResult> Launch(LaunchRequest request);
+
+    // The callback runs on a transport thread, or inline if the request
+    // could not be sent. Returns the request id.
+    uint64_t Launch(LaunchRequest request, Callback callback);
+
+    Stats GetStats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl_;
+};
+
+#ifdef _WIN32
+// ILxssUserSession, activated once; a pool of MTA threads issue
+// CreateLxProcess calls concurrently over the one proxy.
+std::unique_ptr<ServiceTransport> CreateComServiceTransport(size_t workers = 4);
+#endif
+
+} // namespace WSL
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace WSL {
+
+// Keeps the producer- and consumer-owned indices on separate cache lines.
+inline constexpr size_t CacheLineSize = 64;
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Indices grow monotonically and are masked on access, so the full
+// capacity is usable. A full ring is reported to the producer (TryPush fails,
+// Push/WritableSpan come back short) and it is up to the producer to stop
+// pulling input until the consumer catches up; nothing here blocks.
+template <typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing moves elements with memcpy");
+
+public:
+    // Capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity)
+        : mask_(RoundUpPowerOfTwo(capacity) - 1),
+          slots_(Allocate(mask_ + 1)) {}
+
+    ~SpscRing() {
+        ::operator delete[](slots_, std::align_val_t{CacheLineSize});
+    }
+
+    // Non-copyable, non-movable
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    SpscRing(SpscRing&&) = delete;
+    SpscRing& operator=(SpscRing&&) = delete;
+
+    size_t Capacity() const { return mask_ + 1; }
+
+    // Producer side.
+
+    // Largest contiguous free region; empty when the ring is full. Fill it
+    // in place (e.g. read() straight into it) and then Commit().
+    std::span<T> WritableSpan() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        cachedHead_ = head_.load(std::memory_order_acquire);
+
+        const size_t free = Capacity() - (tail - cachedHead_);
+        const size_t offset = tail & mask_;
+        return {slots_ + offset, std::min(free, Capacity() - offset)};
+    }
+
+    void Commit(size_t count) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    bool TryPush(const T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == Capacity()) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == Capacity()) {
+                return false;
+            }
+        }
+
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Copies as much as fits and returns how many elements were taken.
+    size_t Push(const T* data, size_t count) {
+        size_t pushed = 0;
+        while (pushed < count) {
+            std::span<T> span = WritableSpan();
+            if (span.empty()) {
+                break;
+            }
+
+            const size_t chunk = std::min(span.size(), count - pushed);
+            std::memcpy(span.data(), data + pushed, chunk * sizeof(T));
+            Commit(chunk);
+            pushed += chunk;
+        }
+        return pushed;
+    }
+
+    // Consumer side.
+
+    // Largest contiguous readable region; empty when the ring is empty.
+    std::span<const T> ReadableSpan() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        cachedTail_ = tail_.load(std::memory_order_acquire);
+
+        const size_t used = cachedTail_ - head;
+        const size_t offset = head & mask_;
+        return {slots_ + offset, std::min(used, Capacity() - offset)};
+    }
+
+    void Consume(size_t count) {
+        head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    bool TryPop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return false;
+            }
+        }
+
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t Pop(T* out, size_t count) {
+        size_t popped = 0;
+        while (popped < count) {
+            std::span<const T> span = ReadableSpan();
+            if (span.empty()) {
+                break;
+            }
+
+            const size_t chunk = std::min(span.size(), count - popped);
+            std::memcpy(out + popped, span.data(), chunk * sizeof(T));
+            Consume(chunk);
+            popped += chunk;
+        }
+        return popped;
+    }
+
+    // Either side; exact only when the other side is idle.
+    size_t SizeApprox() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool EmptyApprox() const { return SizeApprox() == 0; }
+
+private:
+    static size_t RoundUpPowerOfTwo(size_t value) {
+        if (value == 0) {
+            throw std::invalid_argument("SpscRing capacity must be non-zero");
+        }
+
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    static T* Allocate(size_t count) {
+        return static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t{CacheLineSize}));
+    }
+
+    // Written by the consumer, read by the producer.
+    alignas(CacheLineSize) std::atomic<size_t> head_{0};
+    size_t cachedTail_ = 0;
+
+    // Written by the producer, read by the consumer.
+    alignas(CacheLineSize) std::atomic<size_t> tail_{0};
+    size_t cachedHead_ = 0;
+
+    alignas(CacheLineSize) const size_t mask_;
+    T* const slots_;
+};
+
+} // namespace WSL
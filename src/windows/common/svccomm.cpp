@@ -1,74 +1,158 @@
 #include "svccomm.h"
+#include "resolvecache.h"
+#include "servicesession.h"
+#include "relay.h"
+#include "trace.h"
 #include <comdef.h>
 #include <atlbase.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <thread>
+#include <utility>
 
-class WSLServiceCommunicator::Impl {
-private:
-    CComPtr<ILxssUserSession> userSession;
-    bool initialized = false;
+namespace WSL {
+
+namespace {
 
+// Issues CreateLxProcess from a pool of MTA threads over one proxy, so a slow
+// launch does not hold up the ones queued behind it.
+class ComServiceTransport : public ServiceTransport {
 public:
-    HRESULT Initialize() {
-        if (initialized) {
-            return S_OK;
+    explicit ComServiceTransport(size_t workers) {
+        // Keeps the MTA, and with it the proxy, alive between worker threads.
+        HRESULT hr = CoIncrementMTAUsage(&mtaCookie_);
+        if (FAILED(hr)) {
+            throw std::runtime_error("Failed to enter the COM multithreaded apartment: " + std::to_string(hr));
         }
 
-        HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
-        if (FAILED(hr) && hr != RPC_E_CHANGED_MODE) {
-            return hr;
+        for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i) {
+            workers_.emplace_back(&ComServiceTransport::Work, this);
         }
+    }
 
-        hr = CoCreateInstance(
-            CLSID_LxssUserSession,
-            nullptr,
-            CLSCTX_LOCAL_SERVER,
-            IID_ILxssUserSession,
-            reinterpret_cast<void**>(&userSession)
-        );
+    ~ComServiceTransport() override {
+        Close();
+        CoDecrementMTAUsage(mtaCookie_);
+    }
 
-        if (SUCCEEDED(hr)) {
-            initialized = true;
+    void SetCompletion(Completion completion) override {
+        completion_ = std::move(completion);
+    }
+
+    bool Send(uint64_t id, LaunchRequest request) override {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_ || FAILED(connectResult_)) {
+                return false;
+            }
+            queue_.emplace_back(id, std::move(request));
         }
+        ready_.notify_one();
+        return true;
+    }
 
-        return hr;
+    void Close() override {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            queue_.clear();
+        }
+        ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+        userSession_.Release();
     }
 
-    ~Impl() {
-        if (initialized) {
-            userSession.Release();
+private:
+    void Work() {
+        HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        const bool uninitialize = SUCCEEDED(hr);
+
+        for (;;) {
+            std::pair<uint64_t, LaunchRequest> request;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                ready_.wait(guard, [this] { return closed_ || !queue_.empty(); });
+                if (closed_) {
+                    break;
+                }
+                request = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            completion_(request.first, CreateProcess(request.second));
+        }
+
+        if (uninitialize) {
             CoUninitialize();
         }
     }
 
-    HRESULT CreateInstance(
-        const std::wstring& distributionName,
-        const std::wstring& command,
-        ProcessHandles& handles
-    ) {
-        if (!initialized || !userSession) {
-            return E_NOT_VALID_STATE;
+    // Activates the server on first use; every worker then shares the proxy.
+    ILxssUserSession* Connect(HRESULT& hr) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (!userSession_ && SUCCEEDED(connectResult_)) {
+            WSL_TRACE_SPAN("CoCreateInstance");
+            connectResult_ = CoCreateInstance(
+                CLSID_LxssUserSession,
+                nullptr,
+                CLSCTX_LOCAL_SERVER,
+                IID_ILxssUserSession,
+                reinterpret_cast<void**>(&userSession_)
+            );
+        }
+        hr = connectResult_;
+        return userSession_;
+    }
+
+    LaunchResult CreateProcess(const LaunchRequest& request) {
+        HRESULT hr = S_OK;
+        ILxssUserSession* userSession = Connect(hr);
+        if (FAILED(hr)) {
+            return LaunchResult(hr);
         }
 
         GUID distributionId = {};
-        HRESULT hr = GetDistributionId(distributionName, &distributionId);
+        hr = CLSIDFromString(request.distributionId.c_str(), &distributionId);
         if (FAILED(hr)) {
-            return hr;
+            return LaunchResult(hr);
+        }
+
+        std::vector<LPCWSTR> arguments;
+        arguments.reserve(request.arguments.Size());
+        for (size_t i = 0; i < request.arguments.Size(); ++i) {
+            arguments.push_back(request.arguments.CStr(i));
         }
 
-        // Prepare command line and environment
-        std::vector<std::wstring> cmdArgs = ParseCommandLine(command);
-        std::vector<std::wstring> environment = GetEnvironmentVariables();
+        // Points into the shared snapshot rather than copying it.
+        std::vector<LPCWSTR> environment;
+        if (request.environment) {
+            environment.reserve(request.environment->Size());
+            for (size_t i = 0; i < request.environment->Size(); ++i) {
+                environment.push_back(request.environment->Entry(i));
+            }
+        }
 
+        // CreateLxProcess takes no user, so request.userName is not honoured
+        // here; processes run as the distribution's default user.
         LXSS_STD_HANDLES stdHandles = {};
+        WSL_TRACE_SPAN("CreateLxProcess");
         hr = userSession->CreateLxProcess(
             &distributionId,
-            command.c_str(),
-            static_cast<ULONG>(cmdArgs.size()),
-            cmdArgs.empty() ? nullptr : cmdArgs.data(),
+            request.command.c_str(),
+            static_cast<ULONG>(arguments.size()),
+            arguments.empty() ? nullptr : arguments.data(),
             environment.empty() ? nullptr : environment.data(),
-            nullptr, // current directory
+            request.workingDirectory.empty() ? nullptr : request.workingDirectory.c_str(),
             nullptr, // Linux path
             0,       // flags
             nullptr, // startup info
@@ -76,92 +160,77 @@ public:
             &stdHandles
         );
 
+        LaunchResult result(hr);
         if (SUCCEEDED(hr)) {
-            handles.stdin_handle = stdHandles.StdIn;
-            handles.stdout_handle = stdHandles.StdOut;
-            handles.stderr_handle = stdHandles.StdErr;
-            handles.process_handle = stdHandles.Process;
+            result.input = stdHandles.StdIn;
+            result.output = stdHandles.StdOut;
+            result.error = stdHandles.StdErr;
+            result.process = stdHandles.Process;
         }
-
-        return hr;
+        return result;
     }
 
-private:
-    HRESULT GetDistributionId(const std::wstring& name, GUID* id) {
-        if (!id) return E_INVALIDARG;
-
-        // Query Windows registry for distribution information
-        std::wstring registryPath = L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss";
+    DWORD mtaCookie_ = 0;
+    CComPtr<ILxssUserSession> userSession_;
+    HRESULT connectResult_ = S_OK;
 
-        HKEY hKey = nullptr;
-        LONG result = RegOpenKeyExW(HKEY_CURRENT_USER, registryPath.c_str(), 0, KEY_READ, &hKey);
-        if (result != ERROR_SUCCESS) {
-            return HRESULT_FROM_WIN32(result);
-        }
-
-        // Enumerate distributions to find matching name
-        DWORD index = 0;
-        wchar_t subKeyName[256];
-        DWORD subKeyNameSize = sizeof(subKeyName) / sizeof(subKeyName[0]);
+    Completion completion_;
+    std::mutex lock_;
+    std::condition_variable ready_;
+    std::deque<std::pair<uint64_t, LaunchRequest>> queue_;
+    std::vector<std::thread> workers_;
+    bool closed_ = false;
+};
 
-        while (RegEnumKeyExW(hKey, index++, subKeyName, &subKeyNameSize,
-                            nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
+} // namespace
 
-            HKEY hSubKey = nullptr;
-            if (RegOpenKeyExW(hKey, subKeyName, 0, KEY_READ, &hSubKey) == ERROR_SUCCESS) {
+std::unique_ptr<ServiceTransport> CreateComServiceTransport(size_t workers) {
+    return std::make_unique<ComServiceTransport>(workers);
+}
 
-                // Read distribution name
-                wchar_t distroName[256];
-                DWORD distroNameSize = sizeof(distroName);
-                DWORD valueType;
+// Defined here rather than in servicesession.cpp so the portable library does
+// not depend on the COM interface definitions.
+ServiceSession& ServiceSession::Default() {
+    static ServiceSession session(CreateComServiceTransport(), &MetricsRegistry::Default());
+    return session;
+}
 
-                if (RegQueryValueExW(hSubKey, L"DistributionName", nullptr, &valueType,
-                                   reinterpret_cast<LPBYTE>(distroName), &distroNameSize) == ERROR_SUCCESS) {
+} // namespace WSL
 
-                    if (name.empty() || name == distroName) {
-                        // Convert string GUID to GUID structure
-                        HRESULT hr = CLSIDFromString(subKeyName, id);
-                        RegCloseKey(hSubKey);
-                        RegCloseKey(hKey);
-                        return hr;
-                    }
-                }
-                RegCloseKey(hSubKey);
-            }
-            subKeyNameSize = sizeof(subKeyName) / sizeof(subKeyName[0]);
+class WSLServiceCommunicator::Impl {
+public:
+    // Launches go through the process-wide session; the connection to the
+    // service is made once and shared rather than per communicator.
+    HRESULT CreateInstance(
+        const std::wstring& distributionId,
+        const std::wstring& command,
+        const WSL::ArgumentVector& arguments,
+        ProcessHandles& handles
+    ) {
+        WSL::LaunchRequest request;
+        request.distributionId = distributionId;
+        // A trailing argv goes through as given; only a -e command line or
+        // the default shell is split, once, here. The service never sees a
+        // joined string.
+        if (!WSL::SetLaunchCommand(request, command, arguments)) {
+            return E_INVALIDARG;
         }
-
-        RegCloseKey(hKey);
-        return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
-    }
-
-    std::vector<std::wstring> ParseCommandLine(const std::wstring& command) {
-        std::vector<std::wstring> args;
-        if (command.empty()) return args;
-
-        // Simple command line parsing - could be enhanced
-        std::wistringstream iss(command);
-        std::wstring arg;
-        while (iss >> arg) {
-            args.push_back(arg);
+        {
+            WSL_TRACE_SPAN("CaptureEnvironment");
+            request.environment = WSL::CaptureLinuxEnvironment();
         }
-        return args;
-    }
-
-    std::vector<std::wstring> GetEnvironmentVariables() {
-        std::vector<std::wstring> env;
 
-        wchar_t* envStrings = GetEnvironmentStringsW();
-        if (!envStrings) return env;
-
-        wchar_t* current = envStrings;
-        while (*current) {
-            env.emplace_back(current);
-            current += wcslen(current) + 1;
+        WSL_TRACE_SPAN("ServiceLaunch");
+        WSL::LaunchResult result = WSL::ServiceSession::Default().Launch(std::move(request)).get();
+        if (!result.Succeeded()) {
+            return result.status;
         }
 
-        FreeEnvironmentStringsW(envStrings);
-        return env;
+        handles.stdin_handle = std::exchange(result.input, WSL::InvalidNativeHandle);
+        handles.stdout_handle = std::exchange(result.output, WSL::InvalidNativeHandle);
+        handles.stderr_handle = std::exchange(result.error, WSL::InvalidNativeHandle);
+        handles.process_handle = std::exchange(result.process, WSL::InvalidNativeHandle);
+        return S_OK;
     }
 };
 
@@ -176,14 +245,40 @@ int WSLServiceCommunicator::CreateInstanceAndExecute(
     const std::wstring& distribution,
     const std::wstring& command
 ) {
-    try {
-        HRESULT hr = pImpl->Initialize();
-        if (FAILED(hr)) {
-            throw std::runtime_error("Failed to initialize COM interface: " + std::to_string(hr));
-        }
+    return CreateInstanceAndExecute(distribution, command, WSL::ArgumentVector());
+}
 
+int WSLServiceCommunicator::CreateInstanceAndExecute(
+    const std::wstring& distribution,
+    const std::wstring& command,
+    const WSL::ArgumentVector& arguments
+) {
+    // An empty name selects the default distribution. Usually a hit in the
+    // on-disk resolution cache; the catalog is only enumerated when the cache
+    // is stale.
+    std::optional<WSL::ResolvedDistribution> resolved;
+    {
+        WSL_TRACE_SPAN("ResolveDistribution");
+        resolved = WSL::ResolveDistribution(distribution);
+    }
+    if (!resolved) {
+        std::cerr << "WSL Error: Distribution not found" << std::endl;
+        return 1;
+    }
+
+    return CreateInstanceAndExecute(*resolved, command, arguments);
+}
+
+// For a caller that has resolved the distribution already, so the launch
+// does not look it up a second time.
+int WSLServiceCommunicator::CreateInstanceAndExecute(
+    const WSL::ResolvedDistribution& distribution,
+    const std::wstring& command,
+    const WSL::ArgumentVector& arguments
+) {
+    try {
         ProcessHandles handles;
-        hr = pImpl->CreateInstance(distribution, command, handles);
+        HRESULT hr = pImpl->CreateInstance(distribution.id, command, arguments, handles);
         if (FAILED(hr)) {
             throw std::runtime_error("Failed to create WSL instance: " + std::to_string(hr));
         }
@@ -0,0 +1,632 @@
+#include "tarstream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+constexpr size_t BlockSize = 512;
+
+// Field offsets and widths in a ustar header.
+constexpr size_t NameOffset = 0, NameSize = 100;
+constexpr size_t ModeOffset = 100;
+constexpr size_t UidOffset = 108;
+constexpr size_t GidOffset = 116;
+constexpr size_t SizeOffset = 124, SizeSize = 12;
+constexpr size_t MtimeOffset = 136;
+constexpr size_t ChecksumOffset = 148, ChecksumSize = 8;
+constexpr size_t TypeOffset = 156;
+constexpr size_t LinkOffset = 157, LinkSize = 100;
+constexpr size_t MagicOffset = 257;
+constexpr size_t PrefixOffset = 345, PrefixSize = 155;
+
+// A pax record or GNU long name bigger than this is not a path.
+constexpr size_t MaxExtendedSize = 1024 * 1024;
+
+size_t Padding(uint64_t size) {
+    return static_cast<size_t>((BlockSize - size % BlockSize) % BlockSize);
+}
+
+// Octal when it fits in width - 1 digits, otherwise GNU base-256.
+void WriteNumber(char* field, size_t width, uint64_t value) {
+    if (value < (uint64_t{1} << (3 * (width - 1)))) {
+        for (size_t i = width - 1; i-- > 0;) {
+            field[i] = static_cast<char>('0' + (value & 7));
+            value >>= 3;
+        }
+        field[width - 1] = '\0';
+        return;
+    }
+    for (size_t i = width; i-- > 1;) {
+        field[i] = static_cast<char>(value & 0xFF);
+        value >>= 8;
+    }
+    field[0] = static_cast<char>(0x80);
+}
+
+uint64_t ParseNumber(const char* field, size_t width) {
+    uint64_t value = 0;
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        for (size_t i = 1; i < width; ++i) {
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        }
+        return value;
+    }
+    size_t i = 0;
+    while (i < width && field[i] == ' ') {
+        ++i;
+    }
+    for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i) {
+        value = (value << 3) | static_cast<uint64_t>(field[i] - '0');
+    }
+    return value;
+}
+
+std::string_view Field(const char* field, size_t width) {
+    return {field, static_cast<size_t>(std::find(field, field + width, '\0') - field)};
+}
+
+uint32_t Checksum(const char* header) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < BlockSize; ++i) {
+        const bool inField = i >= ChecksumOffset && i < ChecksumOffset + ChecksumSize;
+        sum += inField ? ' ' : static_cast<unsigned char>(header[i]);
+    }
+    return sum;
+}
+
+// Appends "<length> key=value\n", where length counts the whole record.
+void AppendPaxRecord(std::string& records, std::string_view key, std::string_view value) {
+    const size_t payload = key.size() + value.size() + 3; // ' ', '=', '\n'
+    size_t length = payload + 1;
+    while (std::to_string(length).size() + payload > length) {
+        ++length;
+    }
+    records += std::to_string(length);
+    records += ' ';
+    records.append(key);
+    records += '=';
+    records.append(value);
+    records += '\n';
+}
+
+// ustar fits a path of up to 256 bytes by splitting it at a '/' into
+// prefix and name. False if there is no such split.
+bool SplitName(std::string_view path, std::string_view& prefix, std::string_view& name) {
+    if (path.size() <= NameSize) {
+        prefix = {};
+        name = path;
+        return true;
+    }
+    // The prefix is as short as it can be while the name still fits, and
+    // the name keeps a directory's trailing '/'.
+    const size_t first = path.size() - NameSize - 1;
+    const size_t split = path.find('/', first);
+    if (split == std::string_view::npos || split == 0 || split > PrefixSize || split + 1 >= path.size()) {
+        return false;
+    }
+    prefix = path.substr(0, split);
+    name = path.substr(split + 1);
+    return true;
+}
+
+// "./a/b/" -> "a/b"; "." -> "".
+std::string NormalizePath(std::string path) {
+    while (path.size() >= 2 && path.compare(0, 2, "./") == 0) {
+        path.erase(0, 2);
+    }
+    if (path == ".") {
+        path.clear();
+    }
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+TarEntry::Type EntryType(char typeflag) {
+    switch (typeflag) {
+    case '0':
+    case '\0':
+    case '7':
+        return TarEntry::Type::File;
+    case '1':
+        return TarEntry::Type::Hardlink;
+    case '2':
+        return TarEntry::Type::Symlink;
+    case '5':
+        return TarEntry::Type::Directory;
+    default:
+        return TarEntry::Type::Other;
+    }
+}
+
+char Typeflag(TarEntry::Type type) {
+    switch (type) {
+    case TarEntry::Type::Directory:
+        return '5';
+    case TarEntry::Type::Symlink:
+        return '2';
+    case TarEntry::Type::Hardlink:
+        return '1';
+    default:
+        return '0';
+    }
+}
+
+// Links, directories and device nodes carry no data whatever their size
+// field says.
+bool HasData(char typeflag) {
+    return typeflag != '1' && typeflag != '2' && typeflag != '3' && typeflag != '4' && typeflag != '5' &&
+           typeflag != '6';
+}
+
+TarEntry Describe(const std::filesystem::path& path, std::string relative) {
+    TarEntry entry;
+    entry.path = std::move(relative);
+
+    const auto status = std::filesystem::symlink_status(path);
+    if (std::filesystem::is_symlink(status)) {
+        entry.type = TarEntry::Type::Symlink;
+        entry.linkTarget = std::filesystem::read_symlink(path).generic_string();
+    }
+    else if (std::filesystem::is_directory(status)) {
+        entry.type = TarEntry::Type::Directory;
+    }
+    else if (std::filesystem::is_regular_file(status)) {
+        entry.type = TarEntry::Type::File;
+        entry.size = std::filesystem::file_size(path);
+    }
+    else {
+        entry.type = TarEntry::Type::Other;
+    }
+
+#ifdef _WIN32
+    entry.mode = entry.type == TarEntry::Type::Directory ? 0755 : 0644;
+    if (entry.type != TarEntry::Type::Symlink) {
+        const auto modified = std::chrono::file_clock::to_sys(std::filesystem::last_write_time(path));
+        entry.mtime = std::chrono::duration_cast<std::chrono::seconds>(modified.time_since_epoch()).count();
+    }
+#else
+    struct stat info {};
+    if (lstat(path.c_str(), &info) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to stat " + path.string());
+    }
+    entry.mode = info.st_mode & 07777;
+    entry.uid = info.st_uid;
+    entry.gid = info.st_gid;
+    entry.mtime = info.st_mtime;
+#endif
+    return entry;
+}
+
+} // namespace
+
+void TarWriter::Add(const TarEntry& entry) {
+    if (remaining_ != 0) {
+        throw std::logic_error("Previous tar entry is missing data");
+    }
+
+    std::string name = entry.path;
+    if (entry.type == TarEntry::Type::Directory) {
+        name += '/';
+    }
+
+    std::string_view prefix;
+    std::string_view shortName;
+    const bool longName = !SplitName(name, prefix, shortName);
+    const bool longLink = entry.linkTarget.size() > LinkSize;
+    if (longName || longLink) {
+        std::string records;
+        if (longName) {
+            AppendPaxRecord(records, "path", name);
+        }
+        if (longLink) {
+            AppendPaxRecord(records, "linkpath", entry.linkTarget);
+        }
+        WriteHeader(TarEntry{}, 'x', "././@PaxHeader", {}, records.size());
+        output_.Write(records.data(), records.size());
+        written_ = records.size();
+        Pad();
+    }
+
+    const uint64_t size = entry.type == TarEntry::Type::File ? entry.size : 0;
+    WriteHeader(entry, Typeflag(entry.type), name, entry.linkTarget, size);
+    remaining_ = size;
+    written_ = 0;
+}
+
+// Anything that does not fit is cut short; the pax header has the rest.
+void TarWriter::WriteHeader(const TarEntry& entry, char typeflag, std::string_view name, std::string_view link,
+                            uint64_t size) {
+    std::string_view prefix;
+    std::string_view shortName;
+    if (!SplitName(name, prefix, shortName)) {
+        prefix = {};
+        shortName = name.substr(0, NameSize);
+    }
+
+    char header[BlockSize] = {};
+    std::memcpy(header + NameOffset, shortName.data(), shortName.size());
+    WriteNumber(header + ModeOffset, 8, entry.mode & 07777);
+    WriteNumber(header + UidOffset, 8, entry.uid);
+    WriteNumber(header + GidOffset, 8, entry.gid);
+    WriteNumber(header + SizeOffset, SizeSize, size);
+    WriteNumber(header + MtimeOffset, 12, entry.mtime > 0 ? static_cast<uint64_t>(entry.mtime) : 0);
+    header[TypeOffset] = typeflag;
+    std::memcpy(header + LinkOffset, link.data(), std::min(link.size(), LinkSize));
+    std::memcpy(header + MagicOffset, "ustar\0" "00", 8);
+    std::memcpy(header + PrefixOffset, prefix.data(), prefix.size());
+
+    WriteNumber(header + ChecksumOffset, 7, Checksum(header));
+    header[ChecksumOffset + 7] = ' ';
+    output_.Write(header, BlockSize);
+}
+
+void TarWriter::WriteData(const char* data, size_t size) {
+    if (size > remaining_) {
+        throw std::logic_error("Tar entry data exceeds its size");
+    }
+    output_.Write(data, size);
+    remaining_ -= size;
+    written_ += size;
+    if (remaining_ == 0) {
+        Pad();
+    }
+}
+
+void TarWriter::Pad() {
+    static const char zeros[BlockSize] = {};
+    output_.Write(zeros, Padding(written_));
+    written_ = 0;
+}
+
+void TarWriter::AddTree(const std::filesystem::path& root) {
+    std::vector<std::pair<std::filesystem::path, std::string>> stack{{root, std::string()}};
+    std::vector<char> buffer;
+    while (!stack.empty()) {
+        auto [directory, relative] = std::move(stack.back());
+        stack.pop_back();
+
+        std::vector<std::filesystem::path> children;
+        for (const auto& child : std::filesystem::directory_iterator(directory)) {
+            children.push_back(child.path());
+        }
+        // Reversed, so popping the stack visits them in name order.
+        std::sort(children.rbegin(), children.rend());
+
+        std::vector<std::pair<std::filesystem::path, std::string>> subdirectories;
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            const std::string name = relative.empty() ? it->filename().generic_string()
+                                                      : relative + "/" + it->filename().generic_string();
+            TarEntry entry = Describe(*it, name);
+            Add(entry);
+            if (entry.type == TarEntry::Type::File) {
+                std::ifstream file(*it, std::ios::binary);
+                buffer.resize(1024 * 1024);
+                uint64_t left = entry.size;
+                while (left > 0) {
+                    const size_t chunk = static_cast<size_t>(std::min<uint64_t>(left, buffer.size()));
+                    if (!file.read(buffer.data(), static_cast<std::streamsize>(chunk))) {
+                        throw std::runtime_error("File changed while archiving: " + it->string());
+                    }
+                    WriteData(buffer.data(), chunk);
+                    left -= chunk;
+                }
+            }
+            else if (entry.type == TarEntry::Type::Directory) {
+                subdirectories.emplace_back(*it, name);
+            }
+        }
+        for (auto it = subdirectories.rbegin(); it != subdirectories.rend(); ++it) {
+            stack.push_back(std::move(*it));
+        }
+    }
+}
+
+void TarWriter::Finish() {
+    if (remaining_ != 0) {
+        throw std::logic_error("Last tar entry is missing data");
+    }
+    static const char zeros[2 * BlockSize] = {};
+    output_.Write(zeros, sizeof(zeros));
+    output_.Finish();
+}
+
+void TarReader::Write(const char* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case State::Data: {
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, remaining_));
+            visitor_.EntryData(data, chunk);
+            data += chunk;
+            size -= chunk;
+            remaining_ -= chunk;
+            if (remaining_ == 0) {
+                visitor_.EndEntry();
+                state_ = padding_ == 0 ? State::Header : State::Padding;
+            }
+            break;
+        }
+
+        case State::Padding: {
+            const size_t chunk = std::min(size, padding_);
+            data += chunk;
+            size -= chunk;
+            padding_ -= chunk;
+            if (padding_ == 0) {
+                state_ = State::Header;
+            }
+            break;
+        }
+
+        case State::Extended: {
+            const size_t chunk = static_cast<size_t>(std::min<uint64_t>(size, remaining_));
+            extended_.append(data, chunk);
+            data += chunk;
+            size -= chunk;
+            remaining_ -= chunk;
+            if (remaining_ == 0) {
+                ParseExtended();
+                state_ = padding_ == 0 ? State::Header : State::Padding;
+            }
+            break;
+        }
+
+        case State::Header: {
+            const size_t chunk = std::min(size, BlockSize - blockFill_);
+            std::memcpy(block_ + blockFill_, data, chunk);
+            data += chunk;
+            size -= chunk;
+            blockFill_ += chunk;
+            if (blockFill_ == BlockSize) {
+                blockFill_ = 0;
+                ParseHeader();
+            }
+            break;
+        }
+
+        case State::Done:
+            // Whatever follows the end marker (tar pads to its record size).
+            return;
+        }
+    }
+}
+
+void TarReader::ParseHeader() {
+    if (std::all_of(block_, block_ + BlockSize, [](char c) { return c == '\0'; })) {
+        if (++zeroBlocks_ == 2) {
+            state_ = State::Done;
+        }
+        return;
+    }
+    zeroBlocks_ = 0;
+
+    if (ParseNumber(block_ + ChecksumOffset, ChecksumSize) != Checksum(block_)) {
+        throw std::runtime_error("Corrupt tar header after " + std::to_string(entries_) + " entries");
+    }
+
+    const char typeflag = block_[TypeOffset];
+    const uint64_t size = ParseNumber(block_ + SizeOffset, SizeSize);
+    if (typeflag == 'x' || typeflag == 'g' || typeflag == 'L' || typeflag == 'K') {
+        if (size > MaxExtendedSize) {
+            throw std::runtime_error("Tar extended header is too large");
+        }
+        extendedType_ = typeflag;
+        extended_.clear();
+        remaining_ = size;
+        padding_ = Padding(size);
+        if (size == 0) {
+            ParseExtended();
+            state_ = padding_ == 0 ? State::Header : State::Padding;
+        }
+        else {
+            state_ = State::Extended;
+        }
+        return;
+    }
+
+    TarEntry entry;
+    entry.type = EntryType(typeflag);
+    if (longPath_) {
+        entry.path = std::move(*longPath_);
+    }
+    else {
+        const auto prefix = Field(block_ + PrefixOffset, PrefixSize);
+        const auto name = Field(block_ + NameOffset, NameSize);
+        entry.path = prefix.empty() ? std::string(name) : std::string(prefix) + "/" + std::string(name);
+    }
+    entry.path = NormalizePath(std::move(entry.path));
+    entry.linkTarget = longLink_ ? std::move(*longLink_) : std::string(Field(block_ + LinkOffset, LinkSize));
+    entry.mode = static_cast<uint32_t>(ParseNumber(block_ + ModeOffset, 8));
+    entry.uid = static_cast<uint32_t>(ParseNumber(block_ + UidOffset, 8));
+    entry.gid = static_cast<uint32_t>(ParseNumber(block_ + GidOffset, 8));
+    entry.mtime = paxMtime_.value_or(static_cast<int64_t>(ParseNumber(block_ + MtimeOffset, 12)));
+    entry.size = HasData(typeflag) ? paxSize_.value_or(size) : 0;
+
+    longPath_.reset();
+    longLink_.reset();
+    paxSize_.reset();
+    paxMtime_.reset();
+    ++entries_;
+
+    visitor_.BeginEntry(entry);
+    remaining_ = entry.size;
+    padding_ = Padding(entry.size);
+    if (remaining_ == 0) {
+        visitor_.EndEntry();
+        state_ = padding_ == 0 ? State::Header : State::Padding;
+    }
+    else {
+        state_ = State::Data;
+    }
+}
+
+void TarReader::ParseExtended() {
+    if (extendedType_ == 'L' || extendedType_ == 'K') {
+        // GNU long names are NUL terminated.
+        std::string value(Field(extended_.data(), extended_.size()));
+        (extendedType_ == 'L' ? longPath_ : longLink_) = std::move(value);
+        return;
+    }
+    if (extendedType_ == 'g') {
+        return;
+    }
+
+    std::string_view records = extended_;
+    while (!records.empty()) {
+        const size_t space = records.find(' ');
+        size_t length = 0;
+        if (space != std::string_view::npos) {
+            for (size_t i = 0; i < space && records[i] >= '0' && records[i] <= '9'; ++i) {
+                length = length * 10 + static_cast<size_t>(records[i] - '0');
+            }
+        }
+        if (space == std::string_view::npos || length <= space + 1 || length > records.size() ||
+            records[length - 1] != '\n') {
+            throw std::runtime_error("Corrupt pax header");
+        }
+
+        const auto record = records.substr(space + 1, length - space - 2);
+        records.remove_prefix(length);
+        const size_t equals = record.find('=');
+        if (equals == std::string_view::npos) {
+            continue;
+        }
+        const auto key = record.substr(0, equals);
+        const auto value = record.substr(equals + 1);
+        if (key == "path") {
+            longPath_ = std::string(value);
+        }
+        else if (key == "linkpath") {
+            longLink_ = std::string(value);
+        }
+        else if (key == "size") {
+            paxSize_ = std::stoull(std::string(value));
+        }
+        else if (key == "mtime") {
+            // Fractional seconds are dropped.
+            paxMtime_ = std::stoll(std::string(value.substr(0, value.find('.'))));
+        }
+    }
+}
+
+void TarReader::Finish() {
+    if (state_ == State::Data || state_ == State::Extended || blockFill_ != 0) {
+        throw std::runtime_error("Tar stream ended inside an entry");
+    }
+}
+
+TarExtractor::TarExtractor(std::filesystem::path root) : root_(std::filesystem::absolute(std::move(root))) {
+    std::filesystem::create_directories(root_);
+    root_ = std::filesystem::canonical(root_);
+}
+
+std::filesystem::path TarExtractor::Resolve(std::string_view path) const {
+    const std::filesystem::path relative(path);
+    if (path.empty() || relative.has_root_path()) {
+        throw std::runtime_error("Refusing tar entry with absolute path: " + std::string(path));
+    }
+    for (const auto& component : relative) {
+        if (component == "..") {
+            throw std::runtime_error("Refusing tar entry outside the target: " + std::string(path));
+        }
+    }
+
+    // An earlier entry may have made a parent directory a symlink that
+    // points elsewhere.
+    auto target = root_ / relative;
+    const auto parent = std::filesystem::weakly_canonical(target.parent_path());
+    const auto [end, unused] = std::mismatch(root_.begin(), root_.end(), parent.begin(), parent.end());
+    (void)unused;
+    if (end != root_.end()) {
+        throw std::runtime_error("Refusing tar entry outside the target: " + std::string(path));
+    }
+    return parent / target.filename();
+}
+
+void TarExtractor::BeginEntry(const TarEntry& entry) {
+    entry_ = entry;
+    if (entry.type == TarEntry::Type::Other || entry.path.empty()) {
+        current_.clear();
+        return;
+    }
+
+    current_ = Resolve(entry.path);
+    std::filesystem::create_directories(current_.parent_path());
+    switch (entry.type) {
+    case TarEntry::Type::Directory:
+        // A symlink left by an earlier entry is replaced, not followed, or
+        // the directory's mode and times would land on its target.
+        if (std::filesystem::is_symlink(std::filesystem::symlink_status(current_))) {
+            std::filesystem::remove(current_);
+        }
+        std::filesystem::create_directories(current_);
+        break;
+
+    case TarEntry::Type::Symlink:
+        std::filesystem::remove(current_);
+        std::filesystem::create_symlink(entry.linkTarget, current_);
+        break;
+
+    case TarEntry::Type::Hardlink:
+        std::filesystem::remove(current_);
+        std::filesystem::create_hard_link(Resolve(entry.linkTarget), current_);
+        break;
+
+    default:
+        // Never write through a symlink left by an earlier entry.
+        if (std::filesystem::is_symlink(std::filesystem::symlink_status(current_))) {
+            std::filesystem::remove(current_);
+        }
+        file_.open(current_, std::ios::binary | std::ios::trunc);
+        if (!file_) {
+            throw std::runtime_error("Failed to create " + current_.string());
+        }
+        break;
+    }
+}
+
+void TarExtractor::EntryData(const char* data, size_t size) {
+    if (file_.is_open() && !file_.write(data, static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Failed to write " + current_.string());
+    }
+}
+
+void TarExtractor::EndEntry() {
+    if (file_.is_open()) {
+        file_.close();
+        if (file_.fail()) {
+            throw std::runtime_error("Failed to write " + current_.string());
+        }
+    }
+    if (current_.empty() || entry_.type == TarEntry::Type::Symlink || entry_.type == TarEntry::Type::Hardlink) {
+        return;
+    }
+
+#ifndef _WIN32
+    // A directory stays writable by its owner so the entries after it can
+    // still be extracted into it.
+    auto mode = entry_.mode & 07777;
+    if (entry_.type == TarEntry::Type::Directory) {
+        mode |= 0700;
+    }
+    std::filesystem::permissions(current_, static_cast<std::filesystem::perms>(mode),
+                                 std::filesystem::perm_options::replace | std::filesystem::perm_options::nofollow);
+#endif
+    const auto modified = std::chrono::sys_seconds(std::chrono::seconds(entry_.mtime));
+    std::error_code error;
+    std::filesystem::last_write_time(current_, std::chrono::file_clock::from_sys(modified), error);
+}
+
+} // namespace WSL
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "bytestream.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace WSL {
+
+struct TarEntry {
+    enum class Type {
+        File,
+        Directory,
+        Symlink,
+        Hardlink,
+        Other // devices, fifos: listed but not extracted
+    };
+
+    Type type = Type::File;
+    std::string path;       // relative, '/' separated, no trailing '/'
+    std::string linkTarget; // symlinks and hard links
+    uint64_t size = 0;      // file data that follows
+    uint32_t mode = 0644;
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+    int64_t mtime = 0; // seconds since the epoch
+};
+
+// Writes a POSIX (ustar) archive. Paths and link targets that do not fit
+// the ustar fields get a pax header; sizes past 8 GiB use base-256.
+class TarWriter {
+public:
+    explicit TarWriter(ByteSink& output) : output_(output) {}
+
+    // Writes the header; a file's size bytes must follow through WriteData.
+    void Add(const TarEntry& entry);
+    void WriteData(const char* data, size_t size);
+
+    // Everything below root, with paths relative to it, in a stable order.
+    void AddTree(const std::filesystem::path& root);
+
+    // The end-of-archive marker, then output.Finish().
+    void Finish();
+
+private:
+    void WriteHeader(const TarEntry& entry, char typeflag, std::string_view name, std::string_view link, uint64_t size);
+    void Pad();
+
+    ByteSink& output_;
+    uint64_t remaining_ = 0; // data still owed for the current entry
+    uint64_t written_ = 0;   // for padding to the 512-byte block
+};
+
+// Receives what TarReader parses.
+class TarVisitor {
+public:
+    virtual ~TarVisitor() = default;
+    virtual void BeginEntry(const TarEntry& entry) = 0;
+    virtual void EntryData(const char* data, size_t size) = 0;
+    virtual void EndEntry() = 0;
+};
+
+// Parses a tar stream as it is written, so it can sit at the end of a
+// pipeline. Understands ustar, pax (path, linkpath, size, mtime) and GNU
+// long names. Throws std::runtime_error on a bad header checksum or if
+// Finish() comes mid-entry.
+class TarReader : public ByteSink {
+public:
+    explicit TarReader(TarVisitor& visitor) : visitor_(visitor) {}
+
+    void Write(const char* data, size_t size) override;
+    void Finish() override;
+
+    uint64_t Entries() const { return entries_; }
+
+private:
+    enum class State {
+        Header,
+        Data,
+        Padding,
+        Extended, // pax or GNU long name payload
+        Done
+    };
+
+    void ParseHeader();
+    void ParseExtended();
+
+    TarVisitor& visitor_;
+    State state_ = State::Header;
+    char block_[512];
+    size_t blockFill_ = 0;
+    uint64_t remaining_ = 0;
+    size_t padding_ = 0;
+    char extendedType_ = 0;
+    std::string extended_;
+
+    // From a pax or GNU header, for the entry that follows it.
+    std::optional<std::string> longPath_;
+    std::optional<std::string> longLink_;
+    std::optional<uint64_t> paxSize_;
+    std::optional<int64_t> paxMtime_;
+
+    int zeroBlocks_ = 0;
+    uint64_t entries_ = 0;
+};
+
+// Recreates entries under a directory. Paths that are absolute, contain
+// "..", or would land outside the root through an extracted symlink are
+// refused with std::runtime_error.
+class TarExtractor : public TarVisitor {
+public:
+    explicit TarExtractor(std::filesystem::path root);
+
+    void BeginEntry(const TarEntry& entry) override;
+    void EntryData(const char* data, size_t size) override;
+    void EndEntry() override;
+
+private:
+    std::filesystem::path Resolve(std::string_view path) const;
+
+    std::filesystem::path root_;
+    std::filesystem::path current_;
+    TarEntry entry_;
+    std::ofstream file_;
+};
+
+} // namespace WSL
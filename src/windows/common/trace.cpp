@@ -0,0 +1,344 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+// A thread writes its own events out once it has this many.
+constexpr size_t FlushThreshold = 1024;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+struct ThreadEvents {
+    explicit ThreadEvents(uint32_t threadId) : threadId(threadId) {}
+
+    const uint32_t threadId;
+    std::mutex lock;
+    std::vector<TraceEvent> events;
+    std::atomic<bool> exited{false};
+};
+
+uint32_t CurrentProcessId() {
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+uint32_t CurrentThreadId() {
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return static_cast<uint32_t>(syscall(SYS_gettid));
+#endif
+}
+
+// The output file; guarded by outputLock.
+std::mutex outputLock;
+std::FILE* output = nullptr;
+uint32_t processId = 0;
+
+// Every thread that has recorded a span; guarded by registryLock.
+std::mutex registryLock;
+std::vector<std::shared_ptr<ThreadEvents>> registry;
+
+// Marks the thread's events for removal once they have been written.
+struct ThreadOwner {
+    std::shared_ptr<ThreadEvents> events;
+
+    ~ThreadOwner() {
+        if (events) {
+            events->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadOwner threadOwner;
+
+ThreadEvents& CurrentThreadEvents() {
+    if (!threadOwner.events) {
+        threadOwner.events = std::make_shared<ThreadEvents>(CurrentThreadId());
+        std::lock_guard lock(registryLock);
+        registry.push_back(threadOwner.events);
+    }
+    return *threadOwner.events;
+}
+
+void AppendEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+}
+
+void AppendNumber(std::string& out, uint64_t value) {
+    char buffer[24];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// Microseconds with nanosecond precision, as the format expects.
+void AppendMicroseconds(std::string& out, uint64_t nanoseconds) {
+    AppendNumber(out, nanoseconds / 1000);
+    const unsigned fraction = static_cast<unsigned>(nanoseconds % 1000);
+    out += '.';
+    out += static_cast<char>('0' + fraction / 100);
+    out += static_cast<char>('0' + fraction / 10 % 10);
+    out += static_cast<char>('0' + fraction % 10);
+}
+
+// Each event goes on a line of its own after a comma, so nothing ever has
+// to be taken back and TraceSummary can read the file a line at a time.
+void AppendEvent(std::string& out, const TraceEvent& event, uint32_t threadId) {
+    out += ",\n{\"name\":\"";
+    AppendEscaped(out, event.name);
+    out += "\",\"cat\":\"wsl\",\"ph\":\"X\",\"ts\":";
+    AppendMicroseconds(out, event.start);
+    out += ",\"dur\":";
+    AppendMicroseconds(out, event.end - std::min(event.start, event.end));
+    out += ",\"pid\":";
+    AppendNumber(out, processId);
+    out += ",\"tid\":";
+    AppendNumber(out, threadId);
+    out += '}';
+}
+
+void WriteOutput(const std::string& text) {
+    std::lock_guard lock(outputLock);
+    if (output && !text.empty()) {
+        fwrite(text.data(), 1, text.size(), output);
+        fflush(output);
+    }
+}
+
+void WriteEvents(ThreadEvents& thread) {
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard lock(thread.lock);
+        events.swap(thread.events);
+    }
+    std::string text;
+    text.reserve(events.size() * 128);
+    for (const auto& event : events) {
+        AppendEvent(text, event, thread.threadId);
+    }
+    WriteOutput(text);
+}
+
+std::FILE* OpenAppend(const std::filesystem::path& path) {
+#ifdef _WIN32
+    return _wfopen(path.c_str(), L"ab");
+#else
+    return fopen(path.c_str(), "ab");
+#endif
+}
+
+// Nearest-rank percentile of sorted values.
+double Percentile(const std::vector<double>& sorted, double fraction) {
+    const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+} // namespace
+
+namespace TraceDetail {
+
+void Record(const char* name, uint64_t start, uint64_t end) {
+    ThreadEvents& thread = CurrentThreadEvents();
+    size_t pending = 0;
+    {
+        std::lock_guard lock(thread.lock);
+        thread.events.push_back({name, start, end});
+        pending = thread.events.size();
+    }
+    if (pending >= FlushThreshold) {
+        WriteEvents(thread);
+    }
+}
+
+} // namespace TraceDetail
+
+uint64_t TraceNow() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+bool StartTracing(const std::filesystem::path& path, std::string_view processName) {
+    std::error_code error;
+    const uint32_t pid = CurrentProcessId();
+    std::filesystem::path file = path;
+    if (std::filesystem::is_directory(path, error)) {
+        file /= std::string(processName) + "-" + std::to_string(pid) + ".json";
+    }
+
+    std::lock_guard lock(outputLock);
+    if (output) {
+        return true;
+    }
+    output = OpenAppend(file);
+    if (!output) {
+        return false;
+    }
+    processId = pid;
+
+    // A file that already holds another run's events carries on after
+    // them; an empty one gets the opening bracket.
+    fseek(output, 0, SEEK_END);
+    std::string header = ftell(output) > 0 ? ",\n" : "[\n";
+    header += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) + ",\"args\":{\"name\":\"";
+    AppendEscaped(header, processName);
+    header += "\"}}";
+    fwrite(header.data(), 1, header.size(), output);
+    fflush(output);
+
+    TraceDetail::enabled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool StartTracingFromEnvironment(std::string_view processName) {
+#ifdef _WIN32
+    wchar_t path[MAX_PATH];
+    const DWORD length = GetEnvironmentVariableW(L"WSL_TRACE", path, MAX_PATH);
+    if (length == 0 || length >= MAX_PATH) {
+        return false;
+    }
+    return StartTracing(std::filesystem::path(std::wstring(path, length)), processName);
+#else
+    const char* path = getenv("WSL_TRACE");
+    if (!path || !*path) {
+        return false;
+    }
+    return StartTracing(path, processName);
+#endif
+}
+
+void FlushTrace() {
+    std::vector<std::shared_ptr<ThreadEvents>> threads;
+    {
+        std::lock_guard lock(registryLock);
+        threads = registry;
+
+        // Threads that have gone have nothing more to add after this.
+        std::erase_if(registry, [](const std::shared_ptr<ThreadEvents>& thread) {
+            return thread->exited.load(std::memory_order_acquire);
+        });
+    }
+    for (const auto& thread : threads) {
+        WriteEvents(*thread);
+    }
+}
+
+void StopTracing() {
+    TraceDetail::enabled.store(false, std::memory_order_relaxed);
+    FlushTrace();
+
+    std::lock_guard lock(outputLock);
+    if (output) {
+        fclose(output);
+        output = nullptr;
+    }
+}
+
+void TraceSummary::Add(std::string_view trace) {
+    while (!trace.empty()) {
+        const size_t newline = trace.find('\n');
+        const std::string_view line = trace.substr(0, newline);
+        trace.remove_prefix(newline == std::string_view::npos ? trace.size() : newline + 1);
+
+        static constexpr std::string_view NameField = "{\"name\":\"";
+        static constexpr std::string_view DurationField = ",\"dur\":";
+        const size_t name = line.find(NameField);
+        const size_t duration = line.find(DurationField);
+        if (name == std::string_view::npos || duration == std::string_view::npos ||
+            line.find("\"ph\":\"X\"") == std::string_view::npos) {
+            continue;
+        }
+
+        std::string phase;
+        size_t at = name + NameField.size();
+        for (; at < line.size() && line[at] != '"'; ++at) {
+            if (line[at] == '\\' && at + 1 < line.size()) {
+                ++at;
+            }
+            phase += line[at];
+        }
+        if (at == line.size()) {
+            continue;
+        }
+        const double microseconds = std::strtod(std::string(line.substr(duration + DurationField.size())).c_str(), nullptr);
+
+        const auto found = std::find(names_.begin(), names_.end(), phase);
+        const size_t index = static_cast<size_t>(found - names_.begin());
+        if (found == names_.end()) {
+            names_.push_back(std::move(phase));
+            durations_.emplace_back();
+        }
+        durations_[index].push_back(microseconds);
+    }
+}
+
+std::vector<TraceSummary::Phase> TraceSummary::Phases() const {
+    std::vector<Phase> phases;
+    for (size_t i = 0; i < names_.size(); ++i) {
+        std::vector<double> sorted = durations_[i];
+        std::sort(sorted.begin(), sorted.end());
+
+        Phase phase;
+        phase.name = names_[i];
+        phase.count = sorted.size();
+        phase.p50 = Percentile(sorted, 0.50);
+        phase.p99 = Percentile(sorted, 0.99);
+        phase.max = sorted.back();
+        for (double duration : sorted) {
+            phase.total += duration;
+        }
+        phases.push_back(std::move(phase));
+    }
+    return phases;
+}
+
+std::string TraceSummary::Format() const {
+    const auto phases = Phases();
+    size_t width = 5;
+    for (const auto& phase : phases) {
+        width = std::max(width, phase.name.size());
+    }
+
+    char line[256];
+    std::string text;
+    snprintf(line, sizeof(line), "%-*s %8s %12s %12s %12s\n", static_cast<int>(width), "Phase", "Count", "p50 (ms)",
+             "p99 (ms)", "Max (ms)");
+    text += line;
+    for (const auto& phase : phases) {
+        snprintf(line, sizeof(line), "%-*s %8zu %12.3f %12.3f %12.3f\n", static_cast<int>(width),
+                 phase.name.c_str(), phase.count, phase.p50 / 1000, phase.p99 / 1000, phase.max / 1000);
+        text += line;
+    }
+    return text;
+}
+
+} // namespace WSL
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Scoped spans across a launch, written as Chrome trace-event JSON for
+// Perfetto or chrome://tracing:
+//
+//     WSL_TRACE_SPAN("CreateLxProcess");
+//
+// Tracing is off unless a process starts it, normally from WSL_TRACE (see
+// StartTracingFromEnvironment()); until then a span costs one relaxed load.
+
+#define WSL_TRACE_CONCAT_(a, b) a##b
+#define WSL_TRACE_CONCAT(a, b) WSL_TRACE_CONCAT_(a, b)
+#define WSL_TRACE_SPAN(name) ::WSL::TraceSpan WSL_TRACE_CONCAT(wslTraceSpan_, __LINE__)(name)
+
+namespace WSL {
+
+namespace TraceDetail {
+
+inline std::atomic<bool> enabled{false};
+
+void Record(const char* name, uint64_t start, uint64_t end);
+
+} // namespace TraceDetail
+
+inline bool TracingEnabled() {
+    return TraceDetail::enabled.load(std::memory_order_relaxed);
+}
+
+// Steady clock in nanoseconds. The same clock in every process on the
+// machine, so client and service spans line up in one view.
+uint64_t TraceNow();
+
+// Records a span that has already ended, e.g. one that began before
+// tracing could be started. name must outlive the tracing session; a
+// string literal does.
+inline void RecordTraceSpan(const char* name, uint64_t start, uint64_t end) {
+    if (TracingEnabled()) {
+        TraceDetail::Record(name, start, end);
+    }
+}
+
+// From construction to destruction, on the constructing thread.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name) : name_(name), start_(TracingEnabled() ? TraceNow() : 0) {}
+
+    ~TraceSpan() {
+        if (start_ != 0) {
+            RecordTraceSpan(name_, start_, TraceNow());
+        }
+    }
+
+    // Non-copyable, non-movable
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    TraceSpan(TraceSpan&&) = delete;
+    TraceSpan& operator=(TraceSpan&&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_;
+};
+
+// Starts writing spans to path, labelled with processName. A directory
+// gets a file of its own per process, <processName>-<pid>.json, which
+// suits a batch of runs; a file is appended to, so several runs can share
+// it. Each span is a complete ("X") event on a line of its own. The
+// closing ']' is never written, which the trace-event format allows, so a
+// file stays readable even if the process dies. Returns false, leaving
+// tracing off, if the file cannot be opened.
+bool StartTracing(const std::filesystem::path& path, std::string_view processName);
+
+// StartTracing() from the WSL_TRACE environment variable, if it is set.
+bool StartTracingFromEnvironment(std::string_view processName);
+
+// Writes out what every thread has recorded so far.
+void FlushTrace();
+
+// Flushes and turns tracing off.
+void StopTracing();
+
+// Per-span-name durations across traces written by StartTracing(), for
+// comparing launches; one run's spans are best read in Perfetto.
+class TraceSummary {
+public:
+    struct Phase {
+        std::string name;
+        size_t count = 0;
+        double p50 = 0; // microseconds
+        double p99 = 0;
+        double max = 0;
+        double total = 0;
+    };
+
+    // Adds the complete events of one trace file's contents. Lines that
+    // are not such an event are ignored.
+    void Add(std::string_view trace);
+
+    // In order of first appearance.
+    std::vector<Phase> Phases() const;
+
+    // A fixed-width table of Phases().
+    std::string Format() const;
+
+private:
+    std::vector<std::string> names_;
+    std::vector<std::vector<double>> durations_;
+};
+
+} // namespace WSL
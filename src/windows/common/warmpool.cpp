@@ -0,0 +1,418 @@
+#include "warmpool.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace WSL {
+
+namespace {
+
+void AppendUtf8(std::string& out, std::wstring_view text) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        uint32_t code = static_cast<uint32_t>(text[i]);
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (code >= 0xD800 && code <= 0xDBFF && i + 1 < text.size()) {
+                const uint32_t low = static_cast<uint32_t>(text[i + 1]);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    ++i;
+                }
+            }
+        }
+
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+}
+
+// Single-quoted, with quotes and newlines spliced in from outside the quotes
+// so the job stays on one line.
+void AppendQuoted(std::string& out, std::wstring_view text) {
+    std::string bytes;
+    AppendUtf8(bytes, text);
+
+    out += '\'';
+    for (char c : bytes) {
+        if (c == '\'') {
+            out += "'\\''";
+        } else if (c == '\n') {
+            out += "'\"$__wsl_warm_nl\"'";
+        } else {
+            out += c;
+        }
+    }
+    out += '\'';
+}
+
+bool IsShellName(std::wstring_view name) {
+    if (name.empty() || (name[0] >= L'0' && name[0] <= L'9')) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](wchar_t c) {
+        return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') || c == L'_';
+    });
+}
+
+bool WriteAll(NativeHandle handle, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+#ifdef _WIN32
+        DWORD chunk = 0;
+        if (!WriteFile(handle, data.data() + written, static_cast<DWORD>(data.size() - written), &chunk, nullptr)) {
+            return false;
+        }
+#else
+        const ssize_t chunk = write(handle, data.data() + written, data.size() - written);
+        if (chunk < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunk <= 0) {
+            return false;
+        }
+#endif
+        written += static_cast<size_t>(chunk);
+    }
+    return true;
+}
+
+// A worker without a process handle is assumed alive; a dead one then shows
+// up as a failed write.
+bool IsRunning(NativeHandle process) {
+    if (process == InvalidNativeHandle) {
+        return true;
+    }
+#ifdef _WIN32
+    return WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+#else
+    pollfd descriptor{process, POLLIN, 0};
+    return poll(&descriptor, 1, 0) == 0;
+#endif
+}
+
+bool HasOutput(NativeHandle output) {
+#ifdef _WIN32
+    DWORD available = 0;
+    return PeekNamedPipe(output, nullptr, 0, nullptr, &available, nullptr) && available > 0;
+#else
+    pollfd descriptor{output, POLLIN, 0};
+    return poll(&descriptor, 1, 0) == 1;
+#endif
+}
+
+// Consumes the ready marker, waiting for the shell to finish initialising
+// if it has not yet. Whatever the login printed first, a banner or a
+// profile's echo, is read and dropped; the marker is always the last byte,
+// as the bootstrap then waits for its job. False if the worker died first.
+bool AwaitReady(NativeHandle output) {
+    char buffer[512];
+    for (;;) {
+#ifdef _WIN32
+        DWORD bytes = 0;
+        if (!ReadFile(output, buffer, sizeof(buffer), &bytes, nullptr) || bytes == 0) {
+            return false;
+        }
+#else
+        const ssize_t bytes = read(output, buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return false;
+        }
+#endif
+        if (buffer[bytes - 1] == WarmWorkerReady) {
+            return true;
+        }
+    }
+}
+
+std::wstring PoolKey(const LaunchRequest& request) {
+    return request.distributionId + L'\n' + request.userName;
+}
+
+} // namespace
+
+std::string EncodeWarmJob(const LaunchRequest& request) {
+    std::string job;
+    if (!request.workingDirectory.empty()) {
+        job += "cd -- ";
+        AppendQuoted(job, request.workingDirectory);
+        job += " || exit 1; ";
+    }
+
+    bool exported = false;
+    const size_t count = request.environment ? request.environment->Size() : 0;
+    for (size_t i = 0; i < count; ++i) {
+        const std::wstring_view name = (*request.environment)[i].name;
+        if (!IsShellName(name) || name == WarmWorkerNewline) {
+            continue;
+        }
+        job += exported ? " " : "export ";
+        AppendQuoted(job, request.environment->Entry(i));
+        exported = true;
+    }
+    if (exported) {
+        job += "; ";
+    }
+
+    // A bare command line is evaluated by the initialised shell, so its
+    // aliases and functions apply; an argv is exec'd as given.
+    if (request.arguments.Empty()) {
+        job += "eval ";
+        AppendQuoted(job, request.command);
+    } else {
+        job += "exec";
+        for (std::wstring_view argument : request.arguments) {
+            job += ' ';
+            AppendQuoted(job, argument);
+        }
+    }
+    job += '\n';
+    return job;
+}
+
+class WarmPool::Impl : public std::enable_shared_from_this<Impl> {
+private:
+    struct Worker {
+        LaunchResult process;
+        std::chrono::steady_clock::time_point ready;
+    };
+
+    struct Slot {
+        std::deque<Worker> idle;
+        size_t starting = 0;
+    };
+
+    ServiceSession& session_;
+    const WarmPoolOptions options_;
+
+    mutable std::mutex lock_;
+    std::condition_variable stop_;
+    std::unordered_map<std::wstring, Slot> slots_;
+    bool closed_ = false;
+    Stats stats_;
+    std::thread evictor_;
+
+public:
+    Impl(ServiceSession& session, WarmPoolOptions options)
+        : session_(session), options_(std::move(options)) {
+    }
+
+    void Start() {
+        if (options_.size > 0) {
+            evictor_ = std::thread(&Impl::EvictLoop, this);
+        }
+    }
+
+    void Shutdown() {
+        std::unordered_map<std::wstring, Slot> slots;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closed_ = true;
+            slots.swap(slots_);
+        }
+        stop_.notify_all();
+        if (evictor_.joinable()) {
+            evictor_.join();
+        }
+        // Dropping the workers closes their stdin, which ends the bootstrap.
+    }
+
+    void Prewarm(const LaunchRequest& request) {
+        if (options_.size == 0) {
+            return;
+        }
+
+        const std::wstring key = PoolKey(request);
+        size_t needed = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_) {
+                return;
+            }
+            Slot& slot = slots_[key];
+            const size_t have = slot.idle.size() + slot.starting;
+            needed = have < options_.size ? options_.size - have : 0;
+            slot.starting += needed;
+            stats_.started += needed;
+        }
+
+        // Outside the lock: a launch that cannot be sent completes inline.
+        for (size_t i = 0; i < needed; ++i) {
+            session_.Launch(WorkerRequest(request),
+                            [self = shared_from_this(), key](LaunchResult result) { self->Arrive(key, std::move(result)); });
+        }
+    }
+
+    LaunchResult Launch(const LaunchRequest& request) {
+        WSL_TRACE_SPAN("WarmPoolLaunch");
+        const std::wstring key = PoolKey(request);
+        const std::string job = EncodeWarmJob(request);
+
+        for (;;) {
+            std::optional<Worker> worker = Claim(key);
+            if (!worker) {
+                break;
+            }
+            if (IsRunning(worker->process.process) && AwaitReady(worker->process.output) &&
+                WriteAll(worker->process.input, job)) {
+                {
+                    std::lock_guard<std::mutex> guard(lock_);
+                    ++stats_.hits;
+                }
+                Prewarm(request);
+                return std::move(worker->process);
+            }
+            std::lock_guard<std::mutex> guard(lock_);
+            ++stats_.evicted;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            ++stats_.misses;
+        }
+        Prewarm(request);
+        return session_.Launch(request).get();
+    }
+
+    void EvictIdle() {
+        std::vector<Worker> evicted;
+        const auto now = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            for (auto& [key, slot] : slots_) {
+                auto& idle = slot.idle;
+                for (auto it = idle.begin(); it != idle.end();) {
+                    if (now - it->ready >= options_.idleTimeout || !IsRunning(it->process.process)) {
+                        evicted.push_back(std::move(*it));
+                        it = idle.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            stats_.evicted += evicted.size();
+        }
+        // Closed here, outside the lock.
+    }
+
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        Stats stats = stats_;
+        for (const auto& [key, slot] : slots_) {
+            stats.idle += slot.idle.size();
+        }
+        return stats;
+    }
+
+private:
+    LaunchRequest WorkerRequest(const LaunchRequest& request) const {
+        LaunchRequest worker;
+        worker.distributionId = request.distributionId;
+        worker.userName = request.userName;
+        worker.command = options_.shell;
+        worker.arguments.Append(options_.shell);
+        for (const std::wstring& argument : options_.shellArguments) {
+            worker.arguments.Append(argument);
+        }
+        worker.arguments.Append(L"-c");
+        worker.arguments.Append(WarmWorkerBootstrap);
+        return worker;
+    }
+
+    void Arrive(const std::wstring& key, LaunchResult result) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (closed_) {
+            return;
+        }
+        Slot& slot = slots_[key];
+        --slot.starting;
+        if (result.Succeeded()) {
+            slot.idle.push_back({std::move(result), std::chrono::steady_clock::now()});
+        }
+    }
+
+    std::optional<Worker> Claim(const std::wstring& key) {
+        std::lock_guard<std::mutex> guard(lock_);
+        auto found = slots_.find(key);
+        if (found == slots_.end() || found->second.idle.empty()) {
+            return std::nullopt;
+        }
+        // The oldest that has finished initialising, so none sits long enough
+        // to be evicted while others are used; failing that, the oldest.
+        auto& idle = found->second.idle;
+        auto chosen = std::find_if(idle.begin(), idle.end(),
+                                   [](const Worker& worker) { return HasOutput(worker.process.output); });
+        if (chosen == idle.end()) {
+            chosen = idle.begin();
+        }
+        Worker worker = std::move(*chosen);
+        idle.erase(chosen);
+        return worker;
+    }
+
+    void EvictLoop() {
+        const auto period =
+            std::max<std::chrono::milliseconds>(options_.idleTimeout / 4, std::chrono::milliseconds(10));
+        std::unique_lock<std::mutex> guard(lock_);
+        while (!stop_.wait_for(guard, period, [this] { return closed_; })) {
+            guard.unlock();
+            EvictIdle();
+            guard.lock();
+        }
+    }
+};
+
+WarmPool::WarmPool(ServiceSession& session, WarmPoolOptions options)
+    : pImpl_(std::make_shared<Impl>(session, std::move(options))) {
+    pImpl_->Start();
+}
+
+WarmPool::~WarmPool() {
+    pImpl_->Shutdown();
+}
+
+void WarmPool::Prewarm(const LaunchRequest& request) {
+    pImpl_->Prewarm(request);
+}
+
+LaunchResult WarmPool::Launch(const LaunchRequest& request) {
+    return pImpl_->Launch(request);
+}
+
+void WarmPool::EvictIdle() {
+    pImpl_->EvictIdle();
+}
+
+WarmPool::Stats WarmPool::GetStats() const {
+    return pImpl_->GetStats();
+}
+
+} // namespace WSL
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "servicesession.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace WSL {
+
+// What a warm worker runs once its shell has initialised: announce itself with
+// WarmWorkerReady on stdout, read one job line from stdin, run it, exit. The
+// job comes from EncodeWarmJob(), which splices newlines in from
+// WarmWorkerNewline and never exports a variable of that name.
+inline constexpr char WarmWorkerReady = '\x06';
+inline constexpr std::wstring_view WarmWorkerNewline = L"__wsl_warm_nl";
+inline constexpr std::wstring_view WarmWorkerBootstrap =
+    L"__wsl_warm_nl='\n'; printf '\\006'; IFS= read -r job || exit 1; eval \"$job\"";
+
+// The request's working directory, environment and command as a single line
+// of POSIX shell for WarmWorkerBootstrap. A bare command line is evaluated by
+// the initialised shell; with arguments, they are exec'd as the argv.
+// Variables whose names the shell cannot export, and WarmWorkerNewline, are
+// left out.
+std::string EncodeWarmJob(const LaunchRequest& request);
+
+struct WarmPoolOptions {
+    // Workers kept ready per distribution and user; 0 disables the pool.
+    size_t size = 2;
+
+    // Idle workers older than this are shut down.
+    std::chrono::milliseconds idleTimeout = std::chrono::minutes(5);
+
+    // Workers run <shell> <shellArguments...> -c <WarmWorkerBootstrap>.
+    std::wstring shell = L"/bin/bash";
+    std::vector<std::wstring> shellArguments = {L"-l"};
+};
+
+// Keeps shells started and initialised ahead of time so a launch only has to
+// hand over its command. Each worker runs exactly one command and then exits;
+// a claimed worker is never returned to the pool. A launch that finds no
+// ready worker starts cold through the session, as it would without a pool,
+// and the pool refills in the background.
+class WarmPool {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t started = 0;
+        uint64_t evicted = 0;
+        size_t idle = 0;
+    };
+
+    WarmPool(ServiceSession& session, WarmPoolOptions options = {});
+
+    // Shuts down every idle worker. Workers still starting are dropped as
+    // they arrive.
+    ~WarmPool();
+
+    // Non-copyable, non-movable
+    WarmPool(const WarmPool&) = delete;
+    WarmPool& operator=(const WarmPool&) = delete;
+    WarmPool(WarmPool&&) = delete;
+    WarmPool& operator=(WarmPool&&) = delete;
+
+    // Starts workers for the request's distribution and user up to size.
+    void Prewarm(const LaunchRequest& request);
+
+    // Runs the request on a warm worker if one is ready, otherwise cold.
+    // The result's handles belong to the process running the command either
+    // way.
+    LaunchResult Launch(const LaunchRequest& request);
+
+    // Shuts down workers idle past idleTimeout, or that have died. Also runs
+    // periodically on the pool's own thread.
+    void EvictIdle();
+
+    Stats GetStats() const;
+
+private:
+    class Impl;
+
+    // Shared with in-flight worker launches, which complete on transport
+    // threads and may outlive the pool.
+    std::shared_ptr<Impl> pImpl_;
+};
+
+} // namespace WSL
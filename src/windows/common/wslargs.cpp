@@ -0,0 +1,145 @@
+#include "wslargs.h"
+#include "optiontable.h"
+
+#include <cwchar>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace WSL {
+
+namespace {
+
+using WSLOption = Option<WSLArguments>;
+
+template <WSLCommand Command>
+void SetCommand(WSLArguments& arguments, const wchar_t* const*) {
+    arguments.command = Command;
+}
+
+void ParseParallel(WSLArguments& arguments, const wchar_t* const* values) {
+    const wchar_t* value = values[0];
+    wchar_t* end = nullptr;
+    const unsigned long count = (*value >= L'0' && *value <= L'9') ? std::wcstoul(value, &end, 10) : 0;
+    if (count == 0 || *end != L'\0') {
+        throw std::invalid_argument("--parallel requires a positive job count");
+    }
+    arguments.batchParallelism = count;
+}
+
+constexpr WSLOption Options[] = {
+    {L"--help", L"-h", 0, "", SetCommand<WSLCommand::Help>},
+    {L"--version", L"-v", 0, "", SetCommand<WSLCommand::Version>},
+    {L"--list", L"-l", 0, "", SetCommand<WSLCommand::List>},
+    {L"--status", L"", 0, "", SetCommand<WSLCommand::Status>},
+    {L"--metrics", L"", 0, "",
+     [](WSLArguments& arguments, const wchar_t* const*) { arguments.showMetrics = true; }},
+    {L"--json", L"", 0, "", [](WSLArguments& arguments, const wchar_t* const*) { arguments.json = true; }},
+    {L"--shutdown", L"", 0, "", SetCommand<WSLCommand::Shutdown>},
+    {L"--update", L"", 0, "", SetCommand<WSLCommand::Update>},
+    {L"--terminate", L"-t", 1, "a distribution name",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Terminate;
+         arguments.distributionName = values[0];
+     }},
+    {L"--set-default", L"-s", 1, "a distribution name",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::SetDefault;
+         arguments.distributionName = values[0];
+     }},
+    {L"--unregister", L"", 1, "a distribution name",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Unregister;
+         arguments.distributionName = values[0];
+     }},
+    {L"--import", L"", 3, "a distribution name, install location and archive",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Import;
+         arguments.distributionName = values[0];
+         arguments.installLocation = values[1];
+         arguments.archivePath = values[2];
+     }},
+    {L"--export", L"", 2, "a distribution name and archive",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Export;
+         arguments.distributionName = values[0];
+         arguments.archivePath = values[1];
+     }},
+    {L"--incremental", L"", 0, "",
+     [](WSLArguments& arguments, const wchar_t* const*) { arguments.incremental = true; }},
+    {L"--restore", L"", 3, "a chunk store, snapshot name and archive",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Restore;
+         arguments.snapshotStore = values[0];
+         arguments.snapshotName = values[1];
+         arguments.archivePath = values[2];
+     }},
+    {L"--distribution", L"-d", 1, "a distribution name",
+     [](WSLArguments& arguments, const wchar_t* const* values) { arguments.distributionName = values[0]; }},
+    {L"--exec", L"-e", 1, "a command",
+     [](WSLArguments& arguments, const wchar_t* const* values) { arguments.executeCommand = values[0]; }},
+    {L"--user", L"-u", 1, "a username",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.userName = values[0];
+         arguments.asUser = true;
+     }},
+    {L"--cd", L"", 1, "a directory path",
+     [](WSLArguments& arguments, const wchar_t* const* values) { arguments.workingDirectory = values[0]; }},
+    {L"--shell-type", L"", 0, "",
+     [](WSLArguments& arguments, const wchar_t* const*) { arguments.shellExecute = true; }},
+    {L"--batch", L"", 1, "a file, or - for stdin",
+     [](WSLArguments& arguments, const wchar_t* const* values) {
+         arguments.command = WSLCommand::Batch;
+         arguments.batchFile = values[0];
+     }},
+    {L"--parallel", L"", 1, "a job count", ParseParallel},
+    {L"--output-dir", L"", 1, "a directory path",
+     [](WSLArguments& arguments, const wchar_t* const* values) { arguments.batchOutputDirectory = values[0]; }},
+    {L"--trace", L"", 1, "a file or directory path",
+     [](WSLArguments& arguments, const wchar_t* const* values) { arguments.tracePath = values[0]; }},
+};
+
+constexpr OptionTable<WSLArguments, std::size(Options)> OptionLookup(Options);
+
+// Error messages only; option names are ASCII.
+std::string Narrow(std::wstring_view text) {
+    return std::string(text.begin(), text.end());
+}
+
+} // namespace
+
+WSLArguments ParseWSLArguments(int argc, const wchar_t* const argv[]) {
+    if (argc < 1) {
+        throw std::invalid_argument("No arguments provided");
+    }
+
+    WSLArguments arguments;
+    for (int i = 1; i < argc; ++i) {
+        const std::wstring_view argument = argv[i];
+        if (argument.empty() || argument.front() != L'-' || argument == L"--") {
+            for (int j = argument == L"--" ? i + 1 : i; j < argc; ++j) {
+                arguments.commandArguments.Append(argv[j]);
+            }
+            break;
+        }
+
+        const WSLOption* option = OptionLookup.Find(argument);
+        if (!option) {
+            throw std::invalid_argument("Unknown argument: " + Narrow(argument));
+        }
+        if (argc - 1 - i < option->arity) {
+            throw std::invalid_argument(Narrow(option->name) + " requires " + std::string(option->values));
+        }
+        option->handler(arguments, argv + i + 1);
+        i += option->arity;
+
+        // Help overrides everything else.
+        if (arguments.command == WSLCommand::Help) {
+            break;
+        }
+    }
+    return arguments;
+}
+
+} // namespace WSL
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cmdline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace WSL {
+
+enum class WSLCommand {
+    Execute,
+    Help,
+    Version,
+    List,
+    Status,
+    Shutdown,
+    Terminate,
+    SetDefault,
+    Unregister,
+    Import,
+    Export,
+    Restore,
+    Update,
+    Batch
+};
+
+struct WSLArguments {
+    WSLCommand command = WSLCommand::Execute;
+    std::wstring distributionName;
+    std::wstring executeCommand;
+    ArgumentVector commandArguments; // trailing argv, kept as given
+    std::wstring workingDirectory;
+    std::vector<std::wstring> additionalArgs;
+    bool asUser = false;
+    bool shellExecute = false;
+    std::wstring userName;
+    std::optional<uint32_t> exitCode;
+
+    // --batch; "-" reads the job list from stdin.
+    std::wstring batchFile;
+    size_t batchParallelism = 0;
+    std::wstring batchOutputDirectory;
+
+    // --import <distribution> <installLocation> <archive>,
+    // --export <distribution> <archive>
+    std::wstring installLocation;
+    std::wstring archivePath;
+
+    // --export --incremental: archivePath is a chunk store that gets a new
+    // snapshot. --restore <store> <snapshot> <archive> rebuilds an archive.
+    bool incremental = false;
+    std::wstring snapshotStore;
+    std::wstring snapshotName;
+
+    // --status --metrics [--json]: the counters and latency histograms that
+    // wsl and the service publish, read from shared memory.
+    bool showMetrics = false;
+    bool json = false;
+
+    // --trace <file|directory>: Chrome trace-event spans of this run, as
+    // WSL_TRACE=<path> would.
+    std::wstring tracePath;
+};
+
+// The one parser behind every wsl entry point. Options are matched without
+// regard to ASCII case through a compile-time table; the first argument that
+// is not an option, or everything after "--", is the command to run, passed
+// on without being joined. Throws std::invalid_argument for an unknown
+// option or one missing its values.
+WSLArguments ParseWSLArguments(int argc, const wchar_t* const argv[]);
+
+} // namespace WSL
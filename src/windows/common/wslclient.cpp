@@ -1,9 +1,23 @@
 #include "wslclient.h"
 #include "svccomm.h"
-#include "logging.h"
+#include "distcatalog.h"
+#include "resolvecache.h"
+#include "batchlaunch.h"
+#include "servicesession.h"
+#include "bytestream.h"
+#include "chunkstore.h"
+#include "parallelgzip.h"
+#include "asynclog.h"
+#include "trace.h"
+#include "metrics.h"
+#include <cstdio>
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <filesystem>
 #include <algorithm>
+#include <thread>
+#include <utility>
 #include <comdef.h>
 
 namespace WSL {
@@ -33,7 +47,7 @@ bool ProcessHandles::AreValid() const {
 
 WSLCommandLineParser::WSLCommandLineParser(int argc, wchar_t* argv[]) {
     try {
-        ParseArguments(argc, argv);
+        arguments_ = ParseWSLArguments(argc, argv);
     }
     catch (const std::exception& e) {
         isValid_ = false;
@@ -42,102 +56,6 @@ WSLCommandLineParser::WSLCommandLineParser(int argc, wchar_t* argv[]) {
     }
 }
 
-void WSLCommandLineParser::ParseArguments(int argc, wchar_t* argv[]) {
-    if (argc < 1) {
-        throw std::invalid_argument("No arguments provided");
-    }
-    
-    // Default to execute command if no specific command given
-    arguments_.command = WSLCommand::Execute;
-    
-    for (int i = 1; i < argc; ++i) {
-        std::wstring arg = argv[i];
-        std::transform(arg.begin(), arg.end(), arg.begin(), ::towlower);
-        
-        if (arg == L"--help" || arg == L"-h") {
-            arguments_.command = WSLCommand::Help;
-            return; // Help overrides everything else
-        }
-        else if (arg == L"--version" || arg == L"-v") {
-            arguments_.command = WSLCommand::Version;
-        }
-        else if (arg == L"--list" || arg == L"-l") {
-            arguments_.command = WSLCommand::List;
-        }
-        else if (arg == L"--status") {
-            arguments_.command = WSLCommand::Status;
-        }
-        else if (arg == L"--shutdown") {
-            arguments_.command = WSLCommand::Shutdown;
-        }
-        else if (arg == L"--terminate" || arg == L"-t") {
-            arguments_.command = WSLCommand::Terminate;
-            // Next argument should be distribution name
-            if (i + 1 < argc) {
-                arguments_.distributionName = argv[++i];
-            }
-        }
-        else if (arg == L"--distribution" || arg == L"-d") {
-            ParseDistributionOption(i, argc, argv);
-        }
-        else if (arg == L"--exec" || arg == L"-e") {
-            ParseExecuteOption(i, argc, argv);
-        }
-        else if (arg == L"--user" || arg == L"-u") {
-            ParseUserOption(i, argc, argv);
-        }
-        else if (arg == L"--cd") {
-            ParseWorkingDirectoryOption(i, argc, argv);
-        }
-        else if (arg == L"--shell-type") {
-            arguments_.shellExecute = true;
-        }
-        else if (arg.front() != L'-') {
-            // This is likely a command to execute
-            std::wostringstream oss;
-            for (int j = i; j < argc; ++j) {
-                if (j > i) oss << L" ";
-                oss << argv[j];
-            }
-            arguments_.executeCommand = oss.str();
-            break;
-        }
-        else {
-            throw std::invalid_argument("Unknown argument: " + 
-                std::string(arg.begin(), arg.end()));
-        }
-    }
-}                                                           
-
-void WSLCommandLineParser::ParseDistributionOption(int& index, int argc, wchar_t* argv[]) {
-    if (index + 1 >= argc) {
-        throw std::invalid_argument("--distribution requires a distribution name");
-    }
-    arguments_.distributionName = argv[++index];
-}
-
-void WSLCommandLineParser::ParseExecuteOption(int& index, int argc, wchar_t* argv[]) {
-    if (index + 1 >= argc) {
-        throw std::invalid_argument("--exec requires a command");
-    }
-    arguments_.executeCommand = argv[++index];
-}
-
-void WSLCommandLineParser::ParseUserOption(int& index, int argc, wchar_t* argv[]) {
-    if (index + 1 >= argc) {
-        throw std::invalid_argument("--user requires a username");
-    }
-    arguments_.userName = argv[++index];
-    arguments_.asUser = true;
-}
-
-void WSLCommandLineParser::ParseWorkingDirectoryOption(int& index, int argc, wchar_t* argv[]) {
-    if (index + 1 >= argc) {
-        throw std::invalid_argument("--cd requires a directory path");
-    }
-    arguments_.workingDirectory = argv[++index];
-}
-
 void WSLCommandLineParser::ShowHelp() const {
     std::wcout << L"Windows Subsystem for Linux\n"
                << L"Usage: wsl [options] [command]\n\n"
@@ -146,12 +64,35 @@ void WSLCommandLineParser::ShowHelp() const {
                << L"  -u, --user <username>        Run as the specified user\n"
                << L"  -e, --exec <command>         Execute the specified command\n"
                << L"      --cd <directory>         Change to the specified directory\n"
-               << L"      --shell-type             Request a shell\n\n"
+               << L"      --shell-type             Request a shell\n"
+               << L"      --trace <path>           Write a Chrome trace of the launch phases to a\n"
+               << L"                               file, or a file per process in a directory\n"
+               << L"      --                       Pass everything after it as the command\n\n"
+               << L"Batch:\n"
+               << L"      --batch <file|->         Run each line of the file as a command\n"
+               << L"      --parallel <count>       Jobs to run at once (default: one per CPU)\n"
+               << L"      --output-dir <directory> Write <tag>.out and <tag>.err per job instead\n"
+               << L"                               of tagged lines on the console\n\n"
                << L"Management Commands:\n"
                << L"  -l, --list                   List installed distributions\n"
-               << L"      --status                 Show WSL status\n"
+               << L"      --status [--metrics [--json]]\n"
+               << L"                               Show WSL status, or with --metrics the launch,\n"
+               << L"                               relay and config metrics summed over the wsl\n"
+               << L"                               runs so far\n"
                << L"  -t, --terminate <name>       Terminate the specified distribution\n"
-               << L"      --shutdown               Shutdown all distributions\n\n"
+               << L"      --shutdown               Shutdown all distributions\n"
+               << L"  -s, --set-default <name>     Set the default distribution\n"
+               << L"      --unregister <name>      Unregister the distribution and delete its disk\n"
+               << L"      --import <name> <location> <archive>\n"
+               << L"                               Import a tar archive as a new distribution\n"
+               << L"      --export <name> <archive>\n"
+               << L"                               Export the distribution to a gzip-compressed tar\n"
+               << L"                               archive, or to stdout if <archive> is -\n"
+               << L"      --export <name> <store> --incremental\n"
+               << L"                               Add a deduplicated snapshot to a backup store\n"
+               << L"      --restore <store> <snapshot> <archive>\n"
+               << L"                               Rebuild a snapshot as a gzip-compressed tar archive\n"
+               << L"      --update                 Update the WSL package\n\n"
                << L"Information:\n"
                << L"  -h, --help                   Display this help\n"
                << L"  -v, --version                Display version information\n\n";
@@ -184,7 +125,7 @@ public:
                     return HandleListCommand();
                     
                 case WSLCommand::Status:
-                    return HandleStatusCommand();
+                    return HandleStatusCommand(args);
                     
                 case WSLCommand::Shutdown:
                     return HandleShutdownCommand();
@@ -192,13 +133,33 @@ public:
                 case WSLCommand::Terminate:
                     return HandleTerminateCommand(args.distributionName);
                     
+                case WSLCommand::Batch:
+                    return HandleBatchCommand(args);
+                    
+                case WSLCommand::SetDefault:
+                    return HandleSetDefaultCommand(args.distributionName);
+                    
+                case WSLCommand::Export:
+                    return HandleExportCommand(args);
+                    
+                case WSLCommand::Restore:
+                    return HandleRestoreCommand(args);
+                    
+                case WSLCommand::Unregister:
+                case WSLCommand::Import:
+                case WSLCommand::Update:
+                    // Parsed so the options are recognised, but this client
+                    // has no service call for them yet.
+                    std::wcerr << L"Error: This command is not supported by this client\n";
+                    return 1;
+                    
                 case WSLCommand::Execute:
                 default:
                     return HandleExecuteCommand(args);
             }
         }
         catch (const std::exception& e) {
-            LogError(L"WSLClient::Execute failed: %hs", e.what());
+            WSL_LOG_ERROR("WSLClient::Execute failed: %s", e.what());
             std::wcerr << L"Error: " << e.what() << std::endl;
             return 1;
         }
@@ -206,17 +167,18 @@ public:
     
 private:
     int HandleListCommand() {
-        auto distributions = GetAvailableDistributions();
-        if (distributions.empty()) {
+        // One snapshot, so the list and its default marker agree.
+        auto catalog = DistributionCatalog::Default().Snapshot();
+        if (catalog->All().empty()) {
             std::wcout << L"No distributions installed.\n";
             return 0;
         }
         
-        std::wstring defaultDistro = GetDefaultDistribution();
+        const Distribution* defaultDistro = catalog->Default();
         
-        for (const auto& distro : distributions) {
-            std::wcout << distro;
-            if (distro == defaultDistro) {
+        for (const auto& distro : catalog->All()) {
+            std::wcout << distro.name;
+            if (&distro == defaultDistro) {
                 std::wcout << L" (Default)";
             }
             std::wcout << L"\n";
@@ -225,14 +187,26 @@ private:
         return 0;                    
     }
     
-    int HandleStatusCommand() {
-        // Implementation to show WSL status
+    int HandleStatusCommand(const WSLArguments& args) {
+        // Read straight from the shared segment; the service is never asked.
+        if (args.showMetrics) {
+            auto metrics = MetricsRegistry::Read();
+            if (!metrics) {
+                std::wcerr << L"Error: No metrics have been published\n";
+                return 1;
+            }
+            const std::string text = args.json ? metrics->FormatJson() + "\n" : metrics->Format();
+            std::wcout << std::wstring(text.begin(), text.end());
+            return 0;
+        }
+
         std::wcout << L"WSL Status:\n";
         std::wcout << L"Version: " << GetWSLVersion() << L"\n";
         
-        auto distributions = GetAvailableDistributions();
-        std::wcout << L"Installed distributions: " << distributions.size() << L"\n";
-        std::wcout << L"Default distribution: " << GetDefaultDistribution() << L"\n";
+        auto catalog = DistributionCatalog::Default().Snapshot();
+        const Distribution* defaultDistro = catalog->Default();
+        std::wcout << L"Installed distributions: " << catalog->All().size() << L"\n";
+        std::wcout << L"Default distribution: " << (defaultDistro ? defaultDistro->name : L"") << L"\n";
         
         return 0;
     }
@@ -250,22 +224,314 @@ private:
         return service_->TerminateDistribution(distributionName);
     }
     
+    int HandleSetDefaultCommand(const std::wstring& distributionName) {
+        if (!SetDefaultDistribution(distributionName)) {
+            std::wcerr << L"Error: Failed to set the default distribution: " << distributionName << L"\n";
+            return 1;
+        }
+        return 0;
+    }
+    
+    int HandleBatchCommand(const WSLArguments& args) {
+        std::vector<BatchJob> jobs = ParseBatchJobs(ReadBatchFile(args.batchFile));
+        if (jobs.empty()) {
+            return 0;
+        }
+        
+        // Resolved once for every job rather than per launch.
+        auto resolved = ResolveDistribution(args.distributionName);
+        if (!resolved) {
+            std::wcerr << L"Error: Distribution not found: " << args.distributionName << L"\n";
+            return 1;
+        }
+        
+        LaunchRequest shared;
+        shared.distributionId = std::move(resolved->id);
+        shared.environment = CaptureLinuxEnvironment();
+        shared.workingDirectory = args.workingDirectory;
+        shared.userName = args.userName;
+        
+        BatchOptions options;
+        options.parallelism = args.batchParallelism;
+        if (!args.batchOutputDirectory.empty()) {
+            options.output = BatchOutputMode::Files;
+            options.outputDirectory = std::filesystem::path(args.batchOutputDirectory).string();
+        }
+        
+        BatchLauncher launcher(ServiceSession::Default(), std::move(shared), options);
+        auto results = launcher.Run(jobs, GetStdHandle(STD_OUTPUT_HANDLE), GetStdHandle(STD_ERROR_HANDLE));
+        
+        for (const auto& result : results) {
+            if (result.status < 0) {
+                std::wcerr << L"[" << result.tag << L"] failed to launch: 0x" << std::hex << result.status
+                           << std::dec << L"\n";
+            }
+            else if (!result.exitCode) {
+                std::wcerr << L"[" << result.tag << L"] exited without a status\n";
+            }
+            else if (*result.exitCode != 0) {
+                std::wcerr << L"[" << result.tag << L"] exited with " << *result.exitCode << L"\n";
+            }
+        }
+        
+        return BatchExitCode(results);
+    }
+    
+    // tar runs inside the distribution and streams the root filesystem out;
+    // it is compressed (or chunked into a snapshot) here on its way to disk,
+    // so nothing the size of the distribution is ever held or staged.
+    int HandleExportCommand(const WSLArguments& args) {
+        auto resolved = ResolveDistribution(args.distributionName);
+        if (!resolved) {
+            std::wcerr << L"Error: Distribution not found: " << args.distributionName << L"\n";
+            return 1;
+        }
+        if (args.incremental) {
+            return HandleIncrementalExport(resolved->id, resolved->name, args.archivePath);
+        }
+        
+        const bool toStdout = args.archivePath == L"-";
+        HANDLE archive = OpenArchive(args.archivePath);
+        if (archive == INVALID_HANDLE_VALUE) {
+            return 1;
+        }
+        
+        int exitCode = 1;
+        try {
+            GzipOptions options;
+            if (!toStdout) {
+                options.progress = ShowProgress;
+            }
+            HandleSink file(archive);
+            GzipCompressor compressor(file, options);
+            exitCode = StreamRootFilesystem(resolved->id, compressor);
+            if (exitCode == 0) {
+                compressor.Finish();
+            }
+        }
+        catch (...) {
+            CloseArchive(archive, args.archivePath, false);
+            throw;
+        }
+        
+        CloseArchive(archive, args.archivePath, exitCode == 0);
+        return exitCode;
+    }
+    
+    // The store keeps each distinct chunk once, so a nightly snapshot costs
+    // about what changed since the last one.
+    int HandleIncrementalExport(const std::wstring& distributionId, const std::wstring& distributionName,
+                                const std::wstring& storePath) {
+        ChunkStore store{std::filesystem::path(storePath)};
+        const std::string name = SnapshotName(distributionName);
+        SnapshotWriter writer(store, name, {}, ShowProgress);
+        const int exitCode = StreamRootFilesystem(distributionId, writer);
+        std::wcerr << L"\n";
+        if (exitCode != 0) {
+            return exitCode;
+        }
+        
+        writer.Finish();
+        const SnapshotStats& stats = writer.Stats();
+        std::wcout << L"Snapshot " << std::wstring(name.begin(), name.end()) << L": " << stats.bytes / (1024 * 1024)
+                   << L" MB in " << stats.chunks << L" chunks, " << stats.newChunks << L" new ("
+                   << stats.storedBytes / (1024 * 1024) << L" MB stored)\n";
+        return 0;
+    }
+    
+    // Rebuilds the archive a snapshot was taken from, gzip-compressed as
+    // --export writes it.
+    int HandleRestoreCommand(const WSLArguments& args) {
+        const ChunkStore store{std::filesystem::path(args.snapshotStore)};
+        const SnapshotManifest manifest = store.LoadManifest(std::filesystem::path(args.snapshotName).string());
+        
+        HANDLE archive = OpenArchive(args.archivePath);
+        if (archive == INVALID_HANDLE_VALUE) {
+            return 1;
+        }
+        try {
+            GzipOptions options;
+            if (args.archivePath != L"-") {
+                options.progress = ShowProgress;
+            }
+            HandleSink file(archive);
+            GzipCompressor compressor(file, options);
+            store.Restore(manifest, compressor);
+        }
+        catch (...) {
+            CloseArchive(archive, args.archivePath, false);
+            throw;
+        }
+        CloseArchive(archive, args.archivePath, true);
+        return 0;
+    }
+    
+    // Runs tar in the distribution and writes its output to sink, without
+    // Finish()ing it. Returns tar's exit code, except that 1, files that
+    // changed while they were read, counts as success as it does for any
+    // backup of a running system.
+    //
+    // tar runs as the distribution's default user: CreateLxProcess offers
+    // no way to pick another. Files that user cannot read make tar fail
+    // and the export is abandoned; a default user of root, or one with
+    // read access to the whole tree, is needed for a complete archive.
+    static int StreamRootFilesystem(const std::wstring& distributionId, ByteSink& sink) {
+        LaunchRequest request;
+        request.distributionId = distributionId;
+        request.command = L"/bin/tar";
+        request.arguments = {L"tar", L"-C", L"/", L"-cpf", L"-", L"--one-file-system", L"--numeric-owner", L"."};
+        request.environment = CaptureLinuxEnvironment();
+        
+        LaunchResult launch = ServiceSession::Default().Launch(std::move(request)).get();
+        if (!launch.Succeeded()) {
+            std::wcerr << L"Error: Failed to start the export: 0x" << std::hex << launch.status << std::dec << L"\n";
+            return 1;
+        }
+        
+        // tar's warnings go to the console; left unread, they would stall it.
+        std::thread errors([error = std::exchange(launch.error, InvalidNativeHandle)] {
+            HandleSource source(error);
+            HandleSink sink(GetStdHandle(STD_ERROR_HANDLE));
+            std::vector<char> buffer(4096);
+            try {
+                while (const size_t size = source.Read(buffer.data(), buffer.size())) {
+                    sink.Write(buffer.data(), size);
+                }
+            }
+            catch (const std::exception&) {
+            }
+            CloseHandle(error);
+        });
+        
+        DWORD exitCode = 1;
+        try {
+            HandleSource tar(launch.output);
+            std::vector<char> buffer(1024 * 1024);
+            while (const size_t size = tar.Read(buffer.data(), buffer.size())) {
+                sink.Write(buffer.data(), size);
+            }
+            WaitForSingleObject(launch.process, INFINITE);
+            GetExitCodeProcess(launch.process, &exitCode);
+        }
+        catch (...) {
+            // Closing tar's pipes ends it, and with it the error reader.
+            launch.Close();
+            errors.join();
+            throw;
+        }
+        
+        errors.join();
+        if (exitCode == 1) {
+            std::wcerr << L"Warning: some files changed while they were exported\n";
+            return 0;
+        }
+        if (exitCode != 0) {
+            std::wcerr << L"Error: tar exited with " << exitCode << L"\n";
+        }
+        return static_cast<int>(exitCode);
+    }
+    
+    // "-" is stdout. Prints the error and returns INVALID_HANDLE_VALUE if
+    // the file cannot be created.
+    static HANDLE OpenArchive(const std::wstring& path) {
+        if (path == L"-") {
+            return GetStdHandle(STD_OUTPUT_HANDLE);
+        }
+        HANDLE archive = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (archive == INVALID_HANDLE_VALUE) {
+            std::wcerr << L"Error: Failed to create " << path << L": " << GetLastError() << L"\n";
+        }
+        return archive;
+    }
+    
+    // An archive that was not completed is deleted rather than left to be
+    // mistaken for a good one.
+    static void CloseArchive(HANDLE archive, const std::wstring& path, bool complete) {
+        if (path == L"-") {
+            return;
+        }
+        std::wcerr << L"\n";
+        CloseHandle(archive);
+        if (!complete) {
+            DeleteFileW(path.c_str());
+        }
+    }
+    
+    static void ShowProgress(const StreamProgress& progress) {
+        std::wcerr << L"\r" << progress.inputBytes / (1024 * 1024) << L" MB read, "
+                   << progress.outputBytes / (1024 * 1024) << L" MB written" << std::flush;
+    }
+    
+    // <distribution>-<UTC time>, e.g. Ubuntu-20261017T031500Z; names sort
+    // by distribution, then age.
+    static std::string SnapshotName(const std::wstring& distributionName) {
+        std::string name;
+        for (const wchar_t c : distributionName) {
+            const bool safe = (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') || (c >= L'0' && c <= L'9') ||
+                              c == L'-' || c == L'_' || c == L'.';
+            name += safe ? static_cast<char>(c) : '_';
+        }
+        
+        SYSTEMTIME now;
+        GetSystemTime(&now);
+        char stamp[32];
+        snprintf(stamp, sizeof(stamp), "-%04u%02u%02uT%02u%02u%02uZ", now.wYear, now.wMonth, now.wDay, now.wHour,
+                 now.wMinute, now.wSecond);
+        return name + stamp;
+    }
+    
+    // The job list is UTF-8, from a file or stdin ("-").
+    static std::wstring ReadBatchFile(const std::wstring& path) {
+        std::string bytes;
+        if (path == L"-") {
+            std::ostringstream input;
+            input << std::cin.rdbuf();
+            bytes = input.str();
+        }
+        else {
+            std::ifstream file(std::filesystem::path(path), std::ios::binary);
+            if (!file) {
+                throw std::runtime_error("Failed to open batch file: " + std::filesystem::path(path).string());
+            }
+            std::ostringstream input;
+            input << file.rdbuf();
+            bytes = input.str();
+        }
+        
+        if (bytes.empty()) {
+            return {};
+        }
+        const int length = MultiByteToWideChar(CP_UTF8, 0, bytes.data(), static_cast<int>(bytes.size()), nullptr, 0);
+        std::wstring text(length, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, bytes.data(), static_cast<int>(bytes.size()), text.data(), length);
+        return text;
+    }
+    
     int HandleExecuteCommand(const WSLArguments& args) {
-        std::wstring distro = args.distributionName;
-        if (distro.empty()) {
-            distro = GetDefaultDistribution();
-            if (distro.empty()) {
+        // The persistent resolution cache answers this without touching the
+        // distribution store unless it is stale. The launch takes the id from
+        // here rather than resolving the name again.
+        std::optional<ResolvedDistribution> resolved;
+        {
+            WSL_TRACE_SPAN("ResolveDistribution");
+            resolved = ResolveDistribution(args.distributionName);
+        }
+        if (!resolved) {
+            if (args.distributionName.empty()) {
                 std::wcerr << L"Error: No default distribution configured\n";
-                return 1;
+            } else {
+                std::wcerr << L"Error: Distribution not found: " << args.distributionName << L"\n";
             }
+            return 1;
         }
         
         std::wstring command = args.executeCommand;
-        if (command.empty()) {
+        if (command.empty() && args.commandArguments.Empty()) {
             command = L"/bin/bash -l";  // Default shell
         }
         
-        return service_->CreateInstanceAndExecute(distro, command, args);
+        return service_->CreateInstanceAndExecute(*resolved, command, args.commandArguments);
     }
 };
 
@@ -282,77 +548,23 @@ std::wstring GetWSLVersion() {
 }
 
 std::vector<std::wstring> GetAvailableDistributions() {
+    auto catalog = DistributionCatalog::Default().Snapshot();
+
     std::vector<std::wstring> distributions;
-    
-    // Query registry for installed distributions
-    HKEY hKey = nullptr;
-    LONG result = RegOpenKeyExW(HKEY_CURRENT_USER, 
-                               L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss",
-                               0, KEY_READ, &hKey);
-    
-    if (result != ERROR_SUCCESS) {
-        return distributions; // Return empty vector
-    }
-    
-    DWORD index = 0;
-    wchar_t subKeyName[256];
-    DWORD subKeyNameSize = sizeof(subKeyName) / sizeof(subKeyName[0]);
-    
-    while (RegEnumKeyExW(hKey, index++, subKeyName, &subKeyNameSize,
-                        nullptr, nullptr, nullptr, nullptr) == ERROR_SUCCESS) {
-        
-        HKEY hSubKey = nullptr;
-        if (RegOpenKeyExW(hKey, subKeyName, 0, KEY_READ, &hSubKey) == ERROR_SUCCESS) {
-            
-            wchar_t distroName[256];
-            DWORD distroNameSize = sizeof(distroName);
-            
-            if (RegQueryValueExW(hSubKey, L"DistributionName", nullptr, nullptr,
-                               reinterpret_cast<LPBYTE>(distroName), 
-                               &distroNameSize) == ERROR_SUCCESS) {
-                distributions.emplace_back(distroName);
-            }
-            
-            RegCloseKey(hSubKey);
-        }
-        
-        subKeyNameSize = sizeof(subKeyName) / sizeof(subKeyName[0]);
+    distributions.reserve(catalog->All().size());
+    for (const auto& distribution : catalog->All()) {
+        distributions.push_back(distribution.name);
     }
-    
-    RegCloseKey(hKey);
     return distributions;
 }
 
 bool IsDistributionInstalled(const std::wstring& name) {
-    auto distributions = GetAvailableDistributions();
-    return std::find(distributions.begin(), distributions.end(), name) != distributions.end();
+    return DistributionCatalog::Default().Snapshot()->FindByName(name) != nullptr;
 }
 
 std::wstring GetDefaultDistribution() {
-    HKEY hKey = nullptr;
-    LONG result = RegOpenKeyExW(HKEY_CURRENT_USER,
-                               L"SOFTWARE\\Microsoft\\Windows\\CurrentVersion\\Lxss",
-                               0, KEY_READ, &hKey);
-    
-    if (result != ERROR_SUCCESS) {
-        return L"";
-    }
-    
-    wchar_t defaultDistroGuid[256];
-    DWORD size = sizeof(defaultDistroGuid);
-    
-    result = RegQueryValueExW(hKey, L"DefaultDistribution", nullptr, nullptr,
-                             reinterpret_cast<LPBYTE>(defaultDistroGuid), &size);
-    
-    RegCloseKey(hKey);
-    
-    if (result != ERROR_SUCCESS) {
-        return L"";
-    }
-    
-    // Convert GUID to distribution name
-    // This would require additional registry lookup
-    return L"Ubuntu"; // Simplified for example
+    const Distribution* distribution = DistributionCatalog::Default().Snapshot()->Default();
+    return distribution ? distribution->name : L"";
 }
 
 } // namespace WSL
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <windows.h>
+#include "wslargs.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -24,33 +25,6 @@ struct ProcessHandles {
     bool AreValid() const;
 };
 
-enum class WSLCommand {
-    Execute,
-    Help,
-    Version,
-    List,
-    Status,
-    Shutdown,
-    Terminate,
-    SetDefault,
-    Unregister,
-    Import,
-    Export,
-    Update
-};
-
-struct WSLArguments {
-    WSLCommand command = WSLCommand::Execute;
-    std::wstring distributionName;
-    std::wstring executeCommand;
-    std::wstring workingDirectory;
-    std::vector<std::wstring> additionalArgs;
-    bool asUser = false;
-    bool shellExecute = false;
-    std::wstring userName;
-    std::optional<DWORD> exitCode;
-};
-
 class WSLCommandLineParser {
 public:
     explicit WSLCommandLineParser(int argc, wchar_t* argv[]);
@@ -72,12 +46,6 @@ public:
     void ShowVersion() const;
     
 private:
-    void ParseArguments(int argc, wchar_t* argv[]);
-    void ParseDistributionOption(int& index, int argc, wchar_t* argv[]);
-    void ParseExecuteOption(int& index, int argc, wchar_t* argv[]);
-    void ParseUserOption(int& index, int argc, wchar_t* argv[]);
-    void ParseWorkingDirectoryOption(int& index, int argc, wchar_t* argv[]);
-    
     WSLArguments arguments_;
     bool isValid_ = true;
     std::wstring errorMessage_;
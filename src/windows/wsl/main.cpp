@@ -1,86 +1,104 @@
 #include <windows.h>
 #include <iostream>
-#include <vector>
+#include <memory>
 #include <string>
+#include "asynclog.h"
+#include "trace.h"
 #include "wslclient.h"
-#include "svccomm.h"
 
-class WSLCommandLineParser {
-private:
-    std::vector<std::wstring> args;
-    std::wstring distributionName;
-    std::wstring command;
-    bool isHelp = false;
-    bool isVersion = false;
-    bool isShutdown = false;
+namespace {
 
+// WSL_LOG=<path> keeps a log of this invocation. A path ending in .blog
+// gets the binary form, which is cheaper to write; wsllogdecode turns it
+// into text.
+class LogFile {
 public:
-    WSLCommandLineParser(int argc, wchar_t* argv[]) {
-        for (int i = 1; i < argc; ++i) {
-            args.push_back(argv[i]);
+    LogFile() {
+        wchar_t path[MAX_PATH];
+        const DWORD length = GetEnvironmentVariableW(L"WSL_LOG", path, MAX_PATH);
+        if (length == 0 || length >= MAX_PATH) {
+            return;
+        }
+
+        handle_ = CreateFileW(path, FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle_ == INVALID_HANDLE_VALUE) {
+            return;
         }
-        ParseArguments();
+
+        const std::wstring name(path, length);
+        const bool binary = name.size() > 5 && _wcsicmp(name.c_str() + name.size() - 5, L".blog") == 0;
+        sink_ = std::make_unique<WSL::HandleSink>(handle_);
+        logger_ = std::make_unique<WSL::AsyncLogger>(*sink_, binary ? WSL::LogOutput::Binary : WSL::LogOutput::Text);
+        logger_->Install();
     }
 
-    void ParseArguments() {
-        for (size_t i = 0; i < args.size(); ++i) {
-            const auto& arg = args[i];
-
-            if (arg == L"--help" || arg == L"-h") {
-                isHelp = true;
-            }
-            else if (arg == L"--version" || arg == L"-v") {
-                isVersion = true;
-            }
-            else if (arg == L"--shutdown") {
-                isShutdown = true;
-            }
-            else if (arg == L"--distribution" || arg == L"-d") {
-                if (i + 1 < args.size()) {
-                    distributionName = args[++i];
-                }
-            }
-            else if (arg == L"--exec" || arg == L"-e") {
-                if (i + 1 < args.size()) {
-                    command = args[++i];
-                }
-            }
+    ~LogFile() {
+        logger_.reset();
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle_);
         }
     }
 
-    // Getters
-    bool IsHelp() const { return isHelp; }
-    bool IsVersion() const { return isVersion; }
-    bool IsShutdown() const { return isShutdown; }
-    const std::wstring& GetDistributionName() const { return distributionName; }
-    const std::wstring& GetCommand() const { return command; }
-};
+    // Non-copyable, non-movable
+    LogFile(const LogFile&) = delete;
+    LogFile& operator=(const LogFile&) = delete;
+    LogFile(LogFile&&) = delete;
+    LogFile& operator=(LogFile&&) = delete;
 
-int wmain(int argc, wchar_t* argv[]) {
-    WSLCommandLineParser parser(argc, argv);
+private:
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+    std::unique_ptr<WSL::HandleSink> sink_;
+    std::unique_ptr<WSL::AsyncLogger> logger_;
+};
 
-    if (parser.IsHelp()) {
-        ShowHelp();
-        return 0;
+// WSL_TRACE=<path> or --trace <path> traces this invocation. The span
+// covering the whole run, and the one for parsing, are recorded after the
+// fact, since --trace is only known once the arguments are parsed.
+class TraceFile {
+public:
+    TraceFile() : started_(WSL::TraceNow()) {
+        WSL::StartTracingFromEnvironment("wsl");
     }
 
-    if (parser.IsVersion()) {
-        ShowVersion();
-        return 0;
+    ~TraceFile() {
+        WSL::RecordTraceSpan("wsl", started_, WSL::TraceNow());
+        WSL::StopTracing();
     }
 
-    try {
-        WSLServiceCommunicator service;
+    // Non-copyable, non-movable
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+    TraceFile(TraceFile&&) = delete;
+    TraceFile& operator=(TraceFile&&) = delete;
 
-        if (parser.IsShutdown()) {
-            return service.Shutdown();
+    void Parsed(const WSL::WSLArguments& arguments) {
+        if (!WSL::TracingEnabled() && !arguments.tracePath.empty()) {
+            WSL::StartTracing(arguments.tracePath, "wsl");
         }
+        WSL::RecordTraceSpan("ParseArguments", started_, WSL::TraceNow());
+    }
 
-        // Create instance and execute command
-        return service.CreateInstanceAndExecute(
-            parser.GetDistributionName(),
-            parser.GetCommand()
-        );
+private:
+    uint64_t started_;
+};
+
+} // namespace
+
+int wmain(int argc, wchar_t* argv[]) {
+    TraceFile trace;
+    LogFile log;
+
+    // The same parser and dispatch as every other client entry point.
+    WSL::WSLCommandLineParser parser(argc, argv);
+    if (!parser.IsValid()) {
+        std::wcerr << parser.GetErrorMessage() << std::endl;
+        return 1;
+    }
+    trace.Parsed(parser.GetArguments());
+
+    try {
+        WSL::WSLClient client;
+        return client.Execute(parser.GetArguments());
     }
     catch (const std::exception& e) {
         std::wcerr << L"Error: " << e.what() << std::endl;
@@ -0,0 +1,72 @@
+#include "asynclog.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Turns a binary log (WSL_LOG=<path>.blog) into text:
+//     wsllogdecode wsl.blog [output.txt]
+
+namespace {
+
+class StreamSource : public WSL::ByteSource {
+public:
+    explicit StreamSource(std::istream& stream) : stream_(stream) {}
+
+    size_t Read(char* buffer, size_t size) override {
+        stream_.read(buffer, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(stream_.gcount());
+    }
+
+private:
+    std::istream& stream_;
+};
+
+class StreamSink : public WSL::ByteSink {
+public:
+    explicit StreamSink(std::ostream& stream) : stream_(stream) {}
+
+    void Write(const char* data, size_t size) override {
+        if (!stream_.write(data, static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("Failed to write output");
+        }
+    }
+
+private:
+    std::ostream& stream_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: wsllogdecode <log> [output]\n";
+        return 2;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "Error: Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::ofstream file;
+    if (argc == 3) {
+        file.open(argv[2], std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Error: Cannot create " << argv[2] << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        StreamSource source(input);
+        StreamSink sink(argc == 3 ? static_cast<std::ostream&>(file) : std::cout);
+        WSL::DecodeBinaryLog(source, sink);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <windows.h>
+#include <charconv>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "network.h"
+#include "portdiscovery.h"
+#include "portforward.h"
+
+// Forwards localhost ports into the distribution until Ctrl+C:
+//     wslrelay [--threads N] [--discover <proc> <targetHost>] [listenAddress:]listenPort:targetHost:targetPort...
+// --discover also forwards every port the distribution listens on as it
+// appears, watching its /proc (e.g. \\wsl.localhost\Ubuntu\proc) once a
+// second, as a scan reads every socket over the share.
+
+namespace {
+
+std::mutex g_stopLock;
+std::condition_variable g_stopSignal;
+bool g_stop = false;
+
+BOOL WINAPI OnConsoleControl(DWORD) {
+    {
+        std::lock_guard<std::mutex> guard(g_stopLock);
+        g_stop = true;
+    }
+    g_stopSignal.notify_all();
+    return TRUE;
+}
+
+void PrintUsage() {
+    std::cerr << "Usage: wslrelay [--threads N] [--discover <proc> <targetHost>] "
+                 "[listenAddress:]listenPort:targetHost:targetPort...\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    WSL::PortForwardOptions options;
+    std::vector<WSL::Relay::ForwardSpec> forwards;
+    std::string discoverRoot;
+    std::string discoverTarget;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.threads);
+            if (error != std::errc() || end != value.data() + value.size()) {
+                std::cerr << "Error: Invalid thread count '" << value << "'\n";
+                PrintUsage();
+                return 2;
+            }
+            continue;
+        }
+        if (arg == "--discover" && i + 2 < argc) {
+            discoverRoot = argv[++i];
+            discoverTarget = argv[++i];
+            continue;
+        }
+        auto spec = WSL::Relay::ParseForwardSpec(arg);
+        if (!spec) {
+            std::cerr << "Error: Invalid forward '" << arg << "'\n";
+            PrintUsage();
+            return 2;
+        }
+        forwards.push_back(std::move(*spec));
+    }
+    if (forwards.empty() && discoverRoot.empty()) {
+        PrintUsage();
+        return 2;
+    }
+
+    try {
+        WSL::PortForwarder forwarder(options);
+        std::unordered_set<uint16_t> staticPorts;
+        for (const auto& forward : forwards) {
+            const uint16_t port =
+                forwarder.AddForward(forward.listenAddress, forward.listenPort, forward.targetHost, forward.targetPort);
+            staticPorts.insert(port);
+            std::cout << WSL::Relay::FormatEndpoint(forward.listenAddress, port) << " -> "
+                      << WSL::Relay::FormatEndpoint(forward.targetHost, forward.targetPort) << "\n";
+        }
+
+        SetConsoleCtrlHandler(OnConsoleControl, TRUE);
+        forwarder.Start();
+
+        std::unique_ptr<WSL::Relay::DiscoveredForwards> discovered;
+        std::unique_ptr<WSL::PortDiscovery> discovery;
+        if (!discoverRoot.empty()) {
+            discovered = std::make_unique<WSL::Relay::DiscoveredForwards>(forwarder, discoverTarget,
+                                                                          std::move(staticPorts));
+            WSL::PortDiscoveryOptions discoveryOptions;
+            discoveryOptions.procRoot = discoverRoot;
+            discoveryOptions.source = WSL::PortSource::ProcNet; // over the share; polls at ProcNetInterval
+            discovery = std::make_unique<WSL::PortDiscovery>(
+                [&discovered](WSL::PortChange change, const WSL::ListeningPort& port) {
+                    discovered->OnChange(change, port);
+                },
+                discoveryOptions);
+            discovery->Start();
+        }
+
+        {
+            std::unique_lock<std::mutex> guard(g_stopLock);
+            g_stopSignal.wait(guard, [] { return g_stop; });
+        }
+        if (discovery) {
+            discovery->Stop();
+        }
+        forwarder.Stop();
+
+        const WSL::PortForwardStats stats = forwarder.GetStats();
+        std::cout << stats.accepted << " connections, " << stats.connectFailures << " failed, "
+                  << stats.bytesToTarget << " bytes in, " << stats.bytesToClient << " bytes out\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "network.h"
+
+#include <charconv>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace WSL::Relay {
+
+namespace {
+
+std::optional<uint16_t> ParsePort(std::string_view text) {
+    unsigned value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size() || value > UINT16_MAX) {
+        return std::nullopt;
+    }
+    return static_cast<uint16_t>(value);
+}
+
+// Splits on ':' outside brackets and strips the brackets.
+std::optional<std::vector<std::string>> SplitFields(std::string_view spec) {
+    std::vector<std::string> fields(1);
+    bool bracketed = false;
+    for (const char c : spec) {
+        if (c == '[' && !bracketed && fields.back().empty()) {
+            bracketed = true;
+        } else if (c == ']' && bracketed) {
+            bracketed = false;
+        } else if (c == ':' && !bracketed) {
+            fields.emplace_back();
+        } else {
+            fields.back().push_back(c);
+        }
+    }
+    if (bracketed) {
+        return std::nullopt;
+    }
+    return fields;
+}
+
+} // namespace
+
+std::optional<ForwardSpec> ParseForwardSpec(std::string_view spec) {
+    const auto fields = SplitFields(spec);
+    if (!fields || fields->size() < 3 || fields->size() > 4) {
+        return std::nullopt;
+    }
+
+    ForwardSpec result;
+    size_t next = 0;
+    if (fields->size() == 4) {
+        result.listenAddress = (*fields)[next++];
+    }
+    const auto listenPort = ParsePort((*fields)[next++]);
+    result.targetHost = (*fields)[next++];
+    const auto targetPort = ParsePort((*fields)[next++]);
+    if (!listenPort || !targetPort || *targetPort == 0 || result.targetHost.empty()) {
+        return std::nullopt;
+    }
+
+    result.listenPort = *listenPort;
+    result.targetPort = *targetPort;
+    return result;
+}
+
+std::string FormatEndpoint(const std::string& host, uint16_t port) {
+    const bool v6 = host.find(':') != std::string::npos;
+    return (v6 ? "[" + host + "]" : host) + ":" + std::to_string(port);
+}
+
+DiscoveredForwards::DiscoveredForwards(PortForwarder& forwarder, std::string targetHost,
+                                       std::unordered_set<uint16_t> staticPorts)
+    : forwarder_(forwarder), targetHost_(std::move(targetHost)), staticPorts_(std::move(staticPorts)) {}
+
+void DiscoveredForwards::OnChange(PortChange change, const ListeningPort& port) {
+    if ((!port.IsLoopback() && !port.IsWildcard()) || staticPorts_.count(port.port) != 0) {
+        return;
+    }
+
+    if (change == PortChange::Added) {
+        Listeners& listeners = listeners_[port.port];
+        if (listeners.count++ > 0) {
+            return;
+        }
+        try {
+            forwarder_.AddForward("127.0.0.1", port.port, targetHost_, port.port);
+            listeners.owned = true;
+            std::cout << "+ " << FormatEndpoint("127.0.0.1", port.port) << " -> "
+                      << FormatEndpoint(targetHost_, port.port) << "\n";
+        } catch (const std::exception& e) {
+            // Most likely taken by something on this side; the listener is
+            // still counted so its removal stays balanced.
+            std::cerr << "Warning: Cannot forward port " << port.port << ": " << e.what() << "\n";
+        }
+        return;
+    }
+
+    const auto it = listeners_.find(port.port);
+    if (it == listeners_.end() || --it->second.count > 0) {
+        return;
+    }
+    const bool owned = it->second.owned;
+    listeners_.erase(it);
+    if (owned && forwarder_.RemoveForward(port.port)) {
+        std::cout << "- " << FormatEndpoint("127.0.0.1", port.port) << "\n";
+    }
+}
+
+} // namespace WSL::Relay
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include "portdiscovery.h"
+#include "portforward.h"
+
+namespace WSL::Relay {
+
+// One forwarded port, from the command line:
+//     [listenAddress:]listenPort:targetHost:targetPort
+// IPv6 addresses go in brackets, e.g. [::1]:8080:localhost:80.
+struct ForwardSpec {
+    std::string listenAddress = "127.0.0.1";
+    uint16_t listenPort = 0;
+    std::string targetHost;
+    uint16_t targetPort = 0;
+};
+
+// std::nullopt if the spec is malformed.
+std::optional<ForwardSpec> ParseForwardSpec(std::string_view spec);
+
+// "host:port", with IPv6 hosts bracketed.
+std::string FormatEndpoint(const std::string& host, uint16_t port);
+
+// Mirrors the distribution's listeners on localhost: each port listening on
+// a loopback or wildcard address there is forwarded from 127.0.0.1 here to
+// the same port on targetHost. Ports in staticPorts, forwarded from the
+// command line, are left alone. Fed from PortDiscovery's thread.
+class DiscoveredForwards {
+public:
+    DiscoveredForwards(PortForwarder& forwarder, std::string targetHost,
+                       std::unordered_set<uint16_t> staticPorts = {});
+
+    void OnChange(PortChange change, const ListeningPort& port);
+
+private:
+    struct Listeners {
+        // A port is usually listened on over IPv4 and IPv6 both; it is
+        // forwarded while any of them remains.
+        size_t count = 0;
+
+        // Whether AddForward succeeded, so that RemoveForward never takes
+        // down a forward something else made on the port.
+        bool owned = false;
+    };
+
+    PortForwarder& forwarder_;
+    std::string targetHost_;
+    std::unordered_set<uint16_t> staticPorts_;
+    std::unordered_map<uint16_t, Listeners> listeners_;
+};
+
+} // namespace WSL::Relay
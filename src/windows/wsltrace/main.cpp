@@ -0,0 +1,57 @@
+#include "trace.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Per-phase p50/p99 across traces from WSL_TRACE or --trace:
+//     wsltrace <trace.json|directory>...
+// A directory contributes every .json file in it.
+
+namespace {
+
+bool AddFile(WSL::TraceSummary& summary, const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Cannot open " << path.string() << "\n";
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    summary.Add(contents.str());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: wsltrace <trace.json|directory>...\n";
+        return 2;
+    }
+
+    WSL::TraceSummary summary;
+    size_t files = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::filesystem::path path = argv[i];
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+                if (entry.path().extension() == ".json" && AddFile(summary, entry.path())) {
+                    ++files;
+                }
+            }
+        }
+        else if (AddFile(summary, path)) {
+            ++files;
+        }
+    }
+
+    if (summary.Phases().empty()) {
+        std::cerr << "Error: No spans found\n";
+        return 1;
+    }
+    std::cout << files << (files == 1 ? " trace\n\n" : " traces\n\n") << summary.Format();
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <benchmark/benchmark.h>
+#include "asynclog.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace WSL;
+
+namespace {
+
+class NullSink : public ByteSink {
+public:
+    void Write(const char*, size_t) override {}
+};
+
+} // namespace
+
+// What a log call costs the thread making it: encoding the arguments and
+// one push into its own buffer. Formatting happens on the writer thread.
+static void BM_AsyncLogCall(benchmark::State& state) {
+    NullSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.threadBufferSize = 4 * 1024 * 1024});
+    logger.Install();
+
+    // The writer gets to catch up, untimed, before the buffer can fill, so
+    // every call measured is one that is kept.
+    const std::string distribution = "Ubuntu-24.04";
+    int attempt = 0;
+    for (auto _ : state) {
+        WSL_LOG_ERROR("Launch of %s failed on attempt %d: 0x%08x", distribution, ++attempt, 0x80070002u);
+        if (attempt % 16384 == 0) {
+            state.PauseTiming();
+            logger.Flush();
+            state.ResumeTiming();
+        }
+    }
+    logger.Flush();
+    state.counters["dropped"] = static_cast<double>(logger.Dropped());
+}
+BENCHMARK(BM_AsyncLogCall);
+
+// A call below the runtime level: one load and a compare.
+static void BM_AsyncLogFiltered(benchmark::State& state) {
+    NullSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.level = LogLevel::Error});
+    logger.Install();
+
+    int attempt = 0;
+    for (auto _ : state) {
+        WSL_LOG_INFO("attempt %d", ++attempt);
+        benchmark::DoNotOptimize(attempt);
+    }
+}
+BENCHMARK(BM_AsyncLogFiltered);
+
+// The synchronous alternative: format on the calling thread, then write.
+static void BM_SynchronousFormat(benchmark::State& state) {
+    NullSink sink;
+    const std::string distribution = "Ubuntu-24.04";
+    int attempt = 0;
+    char line[512];
+    for (auto _ : state) {
+        const int length = snprintf(line,
+                                    sizeof(line),
+                                    "Launch of %s failed on attempt %d: 0x%08x\n",
+                                    distribution.c_str(),
+                                    ++attempt,
+                                    0x80070002u);
+        sink.Write(line, static_cast<size_t>(length));
+        benchmark::DoNotOptimize(line);
+    }
+}
+BENCHMARK(BM_SynchronousFormat);
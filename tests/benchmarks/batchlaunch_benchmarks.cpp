@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+#include "batchlaunch.h"
+#include "../support/mock_service.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+constexpr auto ConnectTime = std::chrono::microseconds(500);
+constexpr auto ServiceTime = std::chrono::microseconds(100);
+
+MockServiceTransport::Options ServiceOptions() {
+    MockServiceTransport::Options options;
+    options.workers = 8;
+    options.connectTime = ConnectTime;
+    options.serviceTime = ServiceTime;
+    options.createPipes = true;
+    return options;
+}
+
+std::vector<BatchJob> MakeJobs(size_t count) {
+    std::wstring text;
+    for (size_t i = 0; i < count; ++i) {
+        text += L"cc -c file" + std::to_wstring(i) + L".c\n";
+    }
+    return ParseBatchJobs(text);
+}
+
+LaunchRequest Shared() {
+    LaunchRequest shared;
+    shared.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+    std::vector<std::wstring> environment;
+    for (int i = 0; i < 40; ++i) {
+        environment.push_back(L"VARIABLE" + std::to_wstring(i) + L"=some reasonably long value");
+    }
+    shared.environment = std::make_shared<EnvironmentSnapshot>(EnvironmentSnapshot::FromStrings(environment));
+    return shared;
+}
+
+} // namespace
+
+// What a build system does today: one wsl invocation, and so one connection,
+// per command.
+static void BM_CommandPerInvocation(benchmark::State& state) {
+    const auto jobs = MakeJobs(static_cast<size_t>(state.range(0)));
+    const int sink = open("/dev/null", O_WRONLY);
+    for (auto _ : state) {
+        for (const auto& job : jobs) {
+            ServiceSession session(std::make_unique<MockServiceTransport>(ServiceOptions()));
+            BatchLauncher launcher(session, Shared(), {});
+            benchmark::DoNotOptimize(launcher.Run({job}, sink, sink));
+        }
+    }
+    close(sink);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CommandPerInvocation)->Arg(64)->UseRealTime();
+
+// wsl --batch: one connection, shared state resolved once, range(1) in flight.
+static void BM_Batch(benchmark::State& state) {
+    const auto jobs = MakeJobs(static_cast<size_t>(state.range(0)));
+    const int sink = open("/dev/null", O_WRONLY);
+    for (auto _ : state) {
+        ServiceSession session(std::make_unique<MockServiceTransport>(ServiceOptions()));
+        BatchOptions options;
+        options.parallelism = static_cast<size_t>(state.range(1));
+        BatchLauncher launcher(session, Shared(), options);
+        benchmark::DoNotOptimize(launcher.Run(jobs, sink, sink));
+    }
+    close(sink);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Batch)->Args({64, 1})->Args({64, 8})->UseRealTime();
@@ -0,0 +1,192 @@
+#include <benchmark/benchmark.h>
+#include "chunkstore.h"
+#include "tarstream.h"
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace WSL;
+
+namespace {
+
+// A synthetic root filesystem: 2000 files of 1 KiB to 128 KiB, some text
+// and some binary, about 128 MiB once archived.
+struct SyntheticTree {
+    std::vector<std::string> files;
+
+    explicit SyntheticTree(unsigned seed = 11) {
+        static constexpr std::string_view Words[] = {"#include ", "return ", "config=", "/usr/share/", "\n", "if (", "0x"};
+        std::mt19937 random(seed);
+        files.resize(2000);
+        for (auto& file : files) {
+            const size_t size = 1024 + random() % (128 * 1024);
+            const bool text = random() % 2;
+            while (file.size() < size) {
+                if (text) {
+                    file += Words[random() % std::size(Words)];
+                }
+                else {
+                    file += static_cast<char>(random());
+                }
+            }
+            file.resize(size);
+        }
+    }
+
+    // Rewrites part of percent% of the files, growing some of them, as a
+    // day of package updates might.
+    void Modify(int percent, unsigned seed) {
+        std::mt19937 random(seed);
+        for (auto& file : files) {
+            if (static_cast<int>(random() % 100) >= percent) {
+                continue;
+            }
+            const size_t offset = random() % file.size();
+            const size_t length = std::min<size_t>(file.size() - offset, 256 + random() % 4096);
+            for (size_t i = 0; i < length; ++i) {
+                file[offset + i] = static_cast<char>(random());
+            }
+            if (random() % 2) {
+                file.insert(offset, std::string(random() % 2048, 'n'));
+            }
+        }
+    }
+
+    std::string Archive() const {
+        StringSink sink;
+        TarWriter writer(sink);
+        for (size_t i = 0; i < files.size(); ++i) {
+            TarEntry entry;
+            entry.path = "usr/lib/package" + std::to_string(i / 50) + "/file" + std::to_string(i);
+            entry.size = files[i].size();
+            entry.mtime = 1700000000;
+            writer.Add(entry);
+            writer.WriteData(files[i].data(), files[i].size());
+        }
+        writer.Finish();
+        return sink.Data();
+    }
+};
+
+std::filesystem::path StorePath() {
+    return std::filesystem::temp_directory_path() / "wsl_chunkstore_benchmark";
+}
+
+SnapshotStats Snapshot(ChunkStore& store, const std::string& name, const std::string& archive) {
+    SnapshotWriter writer(store, name);
+    for (size_t offset = 0; offset < archive.size(); offset += 1024 * 1024) {
+        writer.Write(archive.data() + offset, std::min<size_t>(1024 * 1024, archive.size() - offset));
+    }
+    writer.Finish();
+    return writer.Stats();
+}
+
+// What the same change costs with fixed 64 KiB blocks, for comparison.
+double FixedBlockDedupRatio(const std::string& before, const std::string& after) {
+    constexpr size_t BlockSize = 64 * 1024;
+    std::unordered_set<ChunkId, ChunkIdHash> known;
+    for (size_t offset = 0; offset < before.size(); offset += BlockSize) {
+        known.insert(ChunkId::Of(before.data() + offset, std::min(BlockSize, before.size() - offset)));
+    }
+    size_t newBytes = 0;
+    for (size_t offset = 0; offset < after.size(); offset += BlockSize) {
+        const size_t size = std::min(BlockSize, after.size() - offset);
+        newBytes += known.count(ChunkId::Of(after.data() + offset, size)) ? 0 : size;
+    }
+    return static_cast<double>(after.size()) / static_cast<double>(std::max<size_t>(newBytes, 1));
+}
+
+} // namespace
+
+// Boundary detection alone.
+static void BM_ContentChunking(benchmark::State& state) {
+    const std::string archive = SyntheticTree().Archive();
+    for (auto _ : state) {
+        size_t chunks = 0;
+        ContentChunker chunker([&](const char*, size_t) { ++chunks; });
+        chunker.Write(archive.data(), archive.size());
+        chunker.Finish();
+        benchmark::DoNotOptimize(chunks);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * archive.size()));
+}
+BENCHMARK(BM_ContentChunking)->Unit(benchmark::kMillisecond);
+
+// A first backup into an empty store: every chunk is hashed, compressed
+// and written.
+static void BM_SnapshotFull(benchmark::State& state) {
+    const std::string archive = SyntheticTree().Archive();
+    SnapshotStats stats;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::filesystem::remove_all(StorePath());
+        ChunkStore store(StorePath());
+        state.ResumeTiming();
+        stats = Snapshot(store, "full", archive);
+    }
+    std::filesystem::remove_all(StorePath());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * archive.size()));
+    state.counters["stored_MiB"] = static_cast<double>(stats.storedBytes) / (1024 * 1024);
+}
+BENCHMARK(BM_SnapshotFull)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The nightly case: range(0)% of files changed since the last snapshot.
+// dedup_ratio is stream bytes over new bytes; fixed_ratio is the same for
+// fixed-size blocks.
+static void BM_SnapshotIncremental(benchmark::State& state) {
+    SyntheticTree tree;
+    const std::string before = tree.Archive();
+    tree.Modify(static_cast<int>(state.range(0)), 5);
+    const std::string after = tree.Archive();
+
+    const auto base = StorePath() / "base";
+    const auto work = StorePath() / "work";
+    std::filesystem::remove_all(StorePath());
+    {
+        ChunkStore store(base);
+        Snapshot(store, "base", before);
+    }
+
+    SnapshotStats stats;
+    for (auto _ : state) {
+        // Each iteration starts from the base snapshot alone.
+        state.PauseTiming();
+        std::filesystem::remove_all(work);
+        std::filesystem::copy(base, work, std::filesystem::copy_options::recursive);
+        ChunkStore store(work);
+        state.ResumeTiming();
+        stats = Snapshot(store, "incremental", after);
+    }
+    std::filesystem::remove_all(StorePath());
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * after.size()));
+    state.counters["dedup_ratio"] =
+        static_cast<double>(stats.bytes) / static_cast<double>(std::max<uint64_t>(stats.newBytes, 1));
+    state.counters["fixed_ratio"] = FixedBlockDedupRatio(before, after);
+    state.counters["new_chunks"] = static_cast<double>(stats.newChunks);
+}
+BENCHMARK(BM_SnapshotIncremental)->Arg(1)->Arg(5)->Arg(20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Reassembling a snapshot: every chunk read, inflated and verified.
+static void BM_SnapshotRestore(benchmark::State& state) {
+    const std::string archive = SyntheticTree().Archive();
+    std::filesystem::remove_all(StorePath());
+    ChunkStore store(StorePath());
+    Snapshot(store, "base", archive);
+    const auto manifest = store.LoadManifest("base");
+
+    class NullSink : public ByteSink {
+    public:
+        void Write(const char*, size_t) override {}
+    };
+    for (auto _ : state) {
+        NullSink sink;
+        store.Restore(manifest, sink);
+    }
+    std::filesystem::remove_all(StorePath());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * archive.size()));
+}
+BENCHMARK(BM_SnapshotRestore)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+#include "cmdline.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+namespace {
+
+// A build invocation: range(0) arguments, a few of them quoted.
+std::wstring MakeCommandLine(size_t arguments, QuotingRules rules) {
+    ArgumentVector argv;
+    argv.Append(L"/usr/bin/clang++");
+    for (size_t i = 1; i < arguments; ++i) {
+        switch (i % 4) {
+        case 0:
+            argv.Append(L"-I/home/developer/src/project/include/module" + std::to_wstring(i));
+            break;
+        case 1:
+            argv.Append(L"-DVERSION=\"1." + std::to_wstring(i) + L"\"");
+            break;
+        case 2:
+            argv.Append(L"/home/developer/My Projects/src/file" + std::to_wstring(i) + L".cpp");
+            break;
+        default:
+            argv.Append(L"-O2");
+            break;
+        }
+    }
+    return argv.Join(rules);
+}
+
+} // namespace
+
+// What ParseCommandLine() did: whitespace splitting, one string per token,
+// with no quoting support at all.
+static void BM_CommandLineStringStream(benchmark::State& state) {
+    const std::wstring commandLine = MakeCommandLine(static_cast<size_t>(state.range(0)), QuotingRules::Posix);
+    for (auto _ : state) {
+        std::vector<std::wstring> arguments;
+        std::wistringstream stream(commandLine);
+        std::wstring argument;
+        while (stream >> argument) {
+            arguments.push_back(argument);
+        }
+        benchmark::DoNotOptimize(arguments.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * commandLine.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_CommandLineStringStream)->Arg(8)->Arg(256);
+
+// Into a reused vector, as a launch loop would.
+static void BM_CommandLinePosix(benchmark::State& state) {
+    const std::wstring commandLine = MakeCommandLine(static_cast<size_t>(state.range(0)), QuotingRules::Posix);
+    ArgumentVector arguments;
+    for (auto _ : state) {
+        TokenizeCommandLine(commandLine, QuotingRules::Posix, arguments);
+        benchmark::DoNotOptimize(arguments.CStr(0));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * commandLine.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_CommandLinePosix)->Arg(8)->Arg(256);
+
+static void BM_CommandLineWindows(benchmark::State& state) {
+    const std::wstring commandLine = MakeCommandLine(static_cast<size_t>(state.range(0)), QuotingRules::Windows);
+    ArgumentVector arguments;
+    for (auto _ : state) {
+        TokenizeCommandLine(commandLine, QuotingRules::Windows, arguments);
+        benchmark::DoNotOptimize(arguments.CStr(0));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * commandLine.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_CommandLineWindows)->Arg(8)->Arg(256);
+
+// The old client path: argv joined with a wostringstream, then split again.
+static void BM_ArgvJoinThenSplit(benchmark::State& state) {
+    const ArgumentVector argv =
+        TokenizeCommandLine(MakeCommandLine(static_cast<size_t>(state.range(0)), QuotingRules::Posix), QuotingRules::Posix);
+    for (auto _ : state) {
+        std::wostringstream joined;
+        for (size_t i = 0; i < argv.Size(); ++i) {
+            if (i > 0) joined << L" ";
+            joined << argv[i];
+        }
+        std::vector<std::wstring> arguments;
+        std::wistringstream stream(joined.str());
+        std::wstring argument;
+        while (stream >> argument) {
+            arguments.push_back(argument);
+        }
+        benchmark::DoNotOptimize(arguments.data());
+    }
+}
+BENCHMARK(BM_ArgvJoinThenSplit)->Arg(8)->Arg(256);
+
+// The new one: argv copied into the flat vector as given.
+static void BM_ArgvPassThrough(benchmark::State& state) {
+    const ArgumentVector argv =
+        TokenizeCommandLine(MakeCommandLine(static_cast<size_t>(state.range(0)), QuotingRules::Posix), QuotingRules::Posix);
+    ArgumentVector arguments;
+    for (auto _ : state) {
+        arguments.Clear();
+        for (std::wstring_view argument : argv) {
+            arguments.Append(argument);
+        }
+        benchmark::DoNotOptimize(arguments.CStr(0));
+    }
+}
+BENCHMARK(BM_ArgvPassThrough)->Arg(8)->Arg(256);
@@ -0,0 +1,67 @@
+#include <benchmark/benchmark.h>
+#include "configcache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace WSL;
+
+namespace {
+
+std::string WriteConfigFile(const char* name) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::ofstream(path, std::ios::binary) << "[wsl2]\n"
+                                             "memory=8GB\n"
+                                             "processors=4\n"
+                                             "swap=2GB\n"
+                                             "networkingMode=mirrored\n"
+                                             "dnsTunneling=true\n"
+                                             "[boot]\n"
+                                             "systemd=true\n"
+                                             "[automount]\n"
+                                             "enabled=true\n"
+                                             "root=/mnt/\n";
+    return path.string();
+}
+
+} // namespace
+
+// What every load paid before: open, map and index the file.
+static void BM_ConfigLoadUncached(benchmark::State& state) {
+    const std::string path = WriteConfigFile("wsl_configcache_bench_uncached.conf");
+    for (auto _ : state) {
+        auto store = ConfigStore::Open(path);
+        benchmark::DoNotOptimize(store);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoadUncached);
+
+// Unwatched: one stat to confirm the identity.
+static void BM_ConfigLoadCachedIdentity(benchmark::State& state) {
+    const std::string path = WriteConfigFile("wsl_configcache_bench_identity.conf");
+    ConfigCache cache;
+    for (auto _ : state) {
+        auto store = cache.Get(path);
+        benchmark::DoNotOptimize(store);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoadCachedIdentity);
+
+// Watched: an atomic load of the current snapshot.
+static void BM_ConfigLoadCachedWatched(benchmark::State& state) {
+    const std::string path = WriteConfigFile("wsl_configcache_bench_watched.conf");
+    ConfigCache cache;
+    if (!cache.Watch(path)) {
+        state.SkipWithError("directory cannot be watched");
+        return;
+    }
+    for (auto _ : state) {
+        auto store = cache.Get(path);
+        benchmark::DoNotOptimize(store);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoadCachedWatched)->ThreadRange(1, 4);
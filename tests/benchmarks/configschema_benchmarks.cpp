@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+#include "configschema.h"
+
+#include <algorithm>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+namespace {
+
+const char* const Config =
+    "[wsl2]\n"
+    "memory=8GB\n"
+    "processors=1\n"
+    "swap=2GB\n"
+    "networkingMode=mirrored\n"
+    "localhostForwarding=true\n"
+    "dnsTunneling=true\n"
+    "firewall=true\n"
+    "autoProxy=true\n"
+    "nestedVirtualization=false\n"
+    "[boot]\n"
+    "systemd=true\n";
+
+// The checks ConfigValidator used to run on every use.
+bool ReferenceValidateMemorySize(const std::string& memoryStr) {
+    std::regex memoryRegex(R"((\d+)(GB|MB|KB|B)?)");
+    return std::regex_match(memoryStr, memoryRegex);
+}
+
+bool ReferenceValidateProcessorCount(const std::string& procStr) {
+    try {
+        int count = std::stoi(procStr);
+        return count > 0 && static_cast<unsigned>(count) <= std::thread::hardware_concurrency();
+    } catch (...) {
+        return false;
+    }
+}
+
+bool ReferenceValidateNetworkingMode(const std::string& mode) {
+    const std::vector<std::string> validModes = {"NAT", "bridged", "mirrored", "none", "virtioproxy"};
+    return std::find(validModes.begin(), validModes.end(), mode) != validModes.end();
+}
+
+} // namespace
+
+// Fetch the three raw strings and validate them, as a consumer had to.
+static void BM_SettingsValidatePerUse(benchmark::State& state) {
+    auto store = ConfigStore::FromText(Config);
+    for (auto _ : state) {
+        bool valid = ReferenceValidateMemorySize(std::string(store->GetValue("wsl2", "memory"))) &&
+                     ReferenceValidateProcessorCount(std::string(store->GetValue("wsl2", "processors"))) &&
+                     ReferenceValidateNetworkingMode(std::string(store->GetValue("wsl2", "networkingMode")));
+        benchmark::DoNotOptimize(valid);
+    }
+}
+BENCHMARK(BM_SettingsValidatePerUse);
+
+// The same three values from the compiled snapshot.
+static void BM_SettingsReadSnapshot(benchmark::State& state) {
+    auto store = ConfigStore::FromText(Config);
+    const CompiledSettings compiled = CompileSettings(*store);
+    const WslSettings& settings = compiled.settings;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(settings.memoryBytes);
+        benchmark::DoNotOptimize(settings.processors);
+        benchmark::DoNotOptimize(settings.networkingMode);
+    }
+}
+BENCHMARK(BM_SettingsReadSnapshot);
+
+// One-time cost paid when .wslconfig is loaded.
+static void BM_SettingsCompile(benchmark::State& state) {
+    auto store = ConfigStore::FromText(Config);
+    for (auto _ : state) {
+        CompiledSettings compiled = CompileSettings(*store);
+        benchmark::DoNotOptimize(compiled);
+    }
+}
+BENCHMARK(BM_SettingsCompile);
@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+#include "configstore.h"
+#include "../support/ini_reference.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+// A realistic .wslconfig: one [wsl2] section plus a few others.
+std::string MakeConfig() {
+    return "[wsl2]\n"
+           "memory=8GB\n"
+           "processors=4\n"
+           "swap=2GB\n"
+           "localhostForwarding=true\n"
+           "networkingMode=mirrored\n"
+           "dnsTunneling=true\n"
+           "firewall=true\n"
+           "autoProxy=true\n"
+           "nestedVirtualization=false\n"
+           "[experimental]\n"
+           "autoMemoryReclaim=gradual\n"
+           "sparseVhd=true\n"
+           "hostAddressLoopback=true\n"
+           "[boot]\n"
+           "systemd=true\n"
+           "[automount]\n"
+           "enabled=true\n"
+           "root=/mnt/\n"
+           "options=metadata,umask=22\n";
+}
+
+std::string WriteConfigFile() {
+    auto path = std::filesystem::temp_directory_path() / "wsl_configstore_bench.conf";
+    std::ofstream(path, std::ios::binary) << MakeConfig();
+    return path.string();
+}
+
+} // namespace
+
+// What every wsl.exe start paid before: ifstream, regex parse, nested maps.
+static void BM_ConfigLoadReference(benchmark::State& state) {
+    const std::string path = WriteConfigFile();
+    for (auto _ : state) {
+        std::ifstream file(path);
+        std::stringstream text;
+        text << file.rdbuf();
+        IniTable table = ReferenceParseIni(text.str());
+        benchmark::DoNotOptimize(table);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoadReference);
+
+static void BM_ConfigLoadMapped(benchmark::State& state) {
+    const std::string path = WriteConfigFile();
+    for (auto _ : state) {
+        auto store = ConfigStore::Open(path);
+        benchmark::DoNotOptimize(store);
+    }
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_ConfigLoadMapped);
+
+// GetValue against the nested std::map<std::string, std::map<...>>.
+static void BM_ConfigLookupNestedMap(benchmark::State& state) {
+    const IniTable table = ReferenceParseIni(MakeConfig());
+    const std::string section = "wsl2";
+    const std::string key = "networkingMode";
+    for (auto _ : state) {
+        auto sectionIt = table.find(section);
+        auto keyIt = sectionIt->second.find(key);
+        benchmark::DoNotOptimize(keyIt->second.data());
+    }
+}
+BENCHMARK(BM_ConfigLookupNestedMap);
+
+static void BM_ConfigLookupFlatIndex(benchmark::State& state) {
+    auto store = ConfigStore::FromText(MakeConfig());
+    for (auto _ : state) {
+        const std::string_view* value = store->Find("wsl2", "networkingMode");
+        benchmark::DoNotOptimize(value);
+    }
+}
+BENCHMARK(BM_ConfigLookupFlatIndex);
@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+#include "distcatalog.h"
+#include "../support/fake_distributions.h"
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+// Every lookup enumerates the store and scans it, as the registry helpers did.
+static void BM_DistributionLookupEnumerate(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    MemoryDistributionBackend backend(MakeDistributions(count));
+    const std::wstring name = L"Distro-" + std::to_wstring(count - 1);
+    for (auto _ : state) {
+        auto found = ReferenceFindByName(backend, name);
+        benchmark::DoNotOptimize(found);
+    }
+}
+BENCHMARK(BM_DistributionLookupEnumerate)->RangeMultiplier(10)->Range(10, 10000);
+
+static void BM_DistributionLookupCatalog(benchmark::State& state) {
+    const size_t count = static_cast<size_t>(state.range(0));
+    DistributionCatalog catalog(std::make_unique<MemoryDistributionBackend>(MakeDistributions(count)));
+    const std::wstring name = L"Distro-" + std::to_wstring(count - 1);
+    for (auto _ : state) {
+        const Distribution* found = catalog.Snapshot()->FindByName(name);
+        benchmark::DoNotOptimize(found);
+    }
+}
+BENCHMARK(BM_DistributionLookupCatalog)->RangeMultiplier(10)->Range(10, 10000);
+
+// One-time cost when the store changes.
+static void BM_DistributionCatalogBuild(benchmark::State& state) {
+    const DistributionList list = MakeDistributions(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        CatalogSnapshot snapshot(list);
+        benchmark::DoNotOptimize(snapshot.Default());
+    }
+}
+BENCHMARK(BM_DistributionCatalogBuild)->RangeMultiplier(10)->Range(10, 10000);
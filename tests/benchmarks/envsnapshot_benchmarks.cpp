@@ -0,0 +1,97 @@
+#include <benchmark/benchmark.h>
+#include "envsnapshot.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+namespace {
+
+// A developer machine: range(0) variables and a PATH of 60 directories,
+// sorted by name as GetEnvironmentStringsW() returns them.
+std::wstring MakeBlock(size_t variables) {
+    std::vector<std::wstring> entries;
+    std::wstring path = L"PATH=";
+    for (int i = 0; i < 60; ++i) {
+        path += L"C:\\Program Files\\Some Vendor\\Tool" + std::to_wstring(i) + L"\\bin;";
+    }
+    entries.push_back(path);
+    for (size_t i = 0; i < variables; ++i) {
+        entries.push_back(L"VARIABLE_" + std::to_wstring(i) + L"=C:\\Users\\developer\\AppData\\Local\\value" +
+                          std::to_wstring(i));
+    }
+    entries.push_back(L"WSLENV=USERPROFILE/p:PATH/l");
+    std::sort(entries.begin(), entries.end(), [](const std::wstring& left, const std::wstring& right) {
+        return left.substr(0, left.find(L'=')) < right.substr(0, right.find(L'='));
+    });
+
+    std::wstring block;
+    for (const auto& entry : entries) {
+        block += entry;
+        block += L'\0';
+    }
+    block += L'\0';
+    return block;
+}
+
+} // namespace
+
+// What GetEnvironmentVariables() did: one std::wstring per variable.
+static void BM_EnvironmentCopyPerVariable(benchmark::State& state) {
+    const std::wstring block = MakeBlock(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<std::wstring> environment;
+        for (const wchar_t* current = block.c_str(); *current; current += wcslen(current) + 1) {
+            environment.emplace_back(current);
+        }
+        benchmark::DoNotOptimize(environment.data());
+    }
+}
+BENCHMARK(BM_EnvironmentCopyPerVariable)->Arg(50)->Arg(300);
+
+static void BM_EnvironmentSnapshot(benchmark::State& state) {
+    const std::wstring block = MakeBlock(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        EnvironmentSnapshot snapshot = EnvironmentSnapshot::FromBlock(block.c_str());
+        benchmark::DoNotOptimize(snapshot.Hash());
+    }
+}
+BENCHMARK(BM_EnvironmentSnapshot)->Arg(50)->Arg(300);
+
+static void BM_EnvironmentFilter(benchmark::State& state) {
+    const std::wstring block = MakeBlock(static_cast<size_t>(state.range(0)));
+    const EnvironmentSnapshot windows = EnvironmentSnapshot::FromBlock(block.c_str());
+    const EnvironmentFilter filter = EnvironmentFilter::FromWslEnv(*windows.Find(L"WSLENV"));
+    for (auto _ : state) {
+        EnvironmentSnapshot translated = filter.Apply(windows);
+        benchmark::DoNotOptimize(translated.Hash());
+    }
+}
+BENCHMARK(BM_EnvironmentFilter)->Arg(50)->Arg(300);
+
+// A later launch in the same session where one variable changed: what the
+// client computes and how many characters cross, against the whole block.
+static void BM_EnvironmentDelta(benchmark::State& state) {
+    const std::wstring block = MakeBlock(static_cast<size_t>(state.range(0)));
+    auto base = std::make_shared<const EnvironmentSnapshot>(EnvironmentSnapshot::FromBlock(block.c_str()));
+
+    std::wstring changedBlock = block;
+    changedBlock.replace(changedBlock.find(L"value7"), 6, L"VALUE7");
+    auto changed = std::make_shared<const EnvironmentSnapshot>(EnvironmentSnapshot::FromBlock(changedBlock.c_str()));
+
+    EnvironmentEncoder client;
+    client.Acknowledge(base);
+    size_t characters = 0;
+    for (auto _ : state) {
+        EnvironmentMessage message = client.Encode(changed);
+        characters = message.Characters();
+        benchmark::DoNotOptimize(message.delta);
+    }
+    state.counters["wire_chars"] = static_cast<double>(characters);
+    state.counters["full_chars"] = static_cast<double>(changed->Characters());
+}
+BENCHMARK(BM_EnvironmentDelta)->Arg(50)->Arg(300);
@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+#include "iniparser.h"
+#include "../support/ini_reference.h"
+
+#include <string>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+// A .wslconfig/wsl.conf-shaped file with the given number of key lines,
+// eight keys per section, a comment every few lines and CRLF endings as
+// Notepad writes them.
+std::string MakeConfig(int keys) {
+    std::string text = "# generated for benchmarking\r\n";
+    for (int i = 0; i < keys; ++i) {
+        if (i % 8 == 0) {
+            text += "\r\n[section" + std::to_string(i / 8) + "]\r\n";
+        }
+        text += "  key" + std::to_string(i) + " = value" + std::to_string(i);
+        text += i % 3 == 0 ? "   # explained\r\n" : "\r\n";
+    }
+    return text;
+}
+
+class NullHandler : public IniHandler {
+public:
+    void OnSection(std::string_view name) override { benchmark::DoNotOptimize(name.data()); }
+    void OnValue(std::string_view, std::string_view key, std::string_view value) override {
+        benchmark::DoNotOptimize(key.data());
+        benchmark::DoNotOptimize(value.data());
+    }
+};
+
+} // namespace
+
+// The previous std::regex implementation, building the nested maps.
+static void BM_IniRegexReference(benchmark::State& state) {
+    const std::string text = MakeConfig(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        IniTable table = ReferenceParseIni(text);
+        benchmark::DoNotOptimize(table);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_IniRegexReference)->Arg(16)->Arg(256)->Arg(4096);
+
+// ParseIni building the same maps, i.e. what WSLConfigManager does now.
+static void BM_IniSinglePassToTable(benchmark::State& state) {
+    const std::string text = MakeConfig(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        IniTable table = ParseIniTable(text);
+        benchmark::DoNotOptimize(table);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_IniSinglePassToTable)->Arg(16)->Arg(256)->Arg(4096);
+
+// The scanner alone, with no storage.
+static void BM_IniSinglePassScan(benchmark::State& state) {
+    const std::string text = MakeConfig(static_cast<int>(state.range(0)));
+    NullHandler handler;
+    for (auto _ : state) {
+        ParseIni(text, handler);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(text.size()));
+}
+BENCHMARK(BM_IniSinglePassScan)->Arg(16)->Arg(256)->Arg(4096);
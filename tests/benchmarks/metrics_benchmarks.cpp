@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+#include "metrics.h"
+
+#include <atomic>
+
+using namespace WSL;
+
+namespace {
+
+MetricsRegistry& Registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+std::atomic<uint64_t> sharedCounter{0};
+
+} // namespace
+
+// A sharded counter update from every thread at once; compare with the
+// single shared atomic below as the thread count grows.
+static void BM_MetricsCounterAdd(benchmark::State& state) {
+    for (auto _ : state) {
+        Registry().Add(Metric::RelayOutputBytes, 4096);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricsCounterAdd)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_SharedAtomicAdd(benchmark::State& state) {
+    for (auto _ : state) {
+        sharedCounter.fetch_add(4096, std::memory_order_relaxed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedAtomicAdd)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MetricsHistogramRecord(benchmark::State& state) {
+    uint64_t value = 1;
+    for (auto _ : state) {
+        Registry().Record(Metric::LaunchLatency, value);
+        value = value * 6364136223846793005ull + 1442695040888963407ull;
+        value >>= 40;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricsHistogramRecord)->ThreadRange(1, 8)->UseRealTime();
+
+// What wsl --status --metrics pays to sum every shard.
+static void BM_MetricsSnapshot(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Registry().Snapshot());
+    }
+}
+BENCHMARK(BM_MetricsSnapshot);
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+#include "parallelgzip.h"
+
+#include <random>
+#include <string>
+
+using namespace WSL;
+
+namespace {
+
+constexpr size_t StreamSize = 64 * 1024 * 1024;
+
+// Roughly what a root filesystem compresses to: about 2.5:1.
+const std::string& Payload() {
+    static const std::string payload = [] {
+        static constexpr std::string_view Words[] = {"/usr/lib/x86_64-linux-gnu/", "libc.so.6", "ELF", "\n",
+                                                     "#include <", "export PATH=", "0000", "deb http://"};
+        std::mt19937 random(7);
+        std::string data;
+        data.reserve(StreamSize + 64);
+        while (data.size() < StreamSize) {
+            if (random() % 3 == 0) {
+                for (int i = 0; i < 8; ++i) {
+                    data += static_cast<char>(random());
+                }
+            }
+            else {
+                data += Words[random() % std::size(Words)];
+            }
+        }
+        data.resize(StreamSize);
+        return data;
+    }();
+    return payload;
+}
+
+// Discards output, so only compression is measured.
+class NullSink : public ByteSink {
+public:
+    void Write(const char*, size_t size) override { written += size; }
+    size_t written = 0;
+};
+
+GzipOptions Options(const benchmark::State& state) {
+    GzipOptions options;
+    options.workers = static_cast<size_t>(state.range(0));
+    return options;
+}
+
+} // namespace
+
+// range(0) workers; Arg(1) is the cost of a single deflate stream.
+static void BM_GzipCompress(benchmark::State& state) {
+    const std::string& payload = Payload();
+    size_t written = 0;
+    for (auto _ : state) {
+        NullSink sink;
+        GzipCompressor compressor(sink, Options(state));
+        for (size_t offset = 0; offset < payload.size(); offset += 1024 * 1024) {
+            compressor.Write(payload.data() + offset, 1024 * 1024);
+        }
+        compressor.Finish();
+        written = sink.written;
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * payload.size()));
+    state.counters["ratio"] = static_cast<double>(payload.size()) / static_cast<double>(written);
+}
+BENCHMARK(BM_GzipCompress)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_GzipDecompress(benchmark::State& state) {
+    const std::string& payload = Payload();
+    StringSink archive;
+    {
+        GzipCompressor compressor(archive);
+        compressor.Write(payload.data(), payload.size());
+        compressor.Finish();
+    }
+
+    for (auto _ : state) {
+        StringSource source(archive.Data());
+        NullSink sink;
+        GzipDecompress(source, sink, Options(state));
+        benchmark::DoNotOptimize(sink.written);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * payload.size()));
+}
+BENCHMARK(BM_GzipDecompress)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
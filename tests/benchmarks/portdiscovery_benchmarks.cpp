@@ -0,0 +1,209 @@
+#include <benchmark/benchmark.h>
+#include "portdiscovery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#ifndef _WIN32
+#include <ctime>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// CPU cost of watching for listeners on a busy system: 10k sockets, most of
+// them established connections, and 100 listeners. A scan is what runs
+// every interval whether or not anything changed, so its CPU time divided
+// by the source's default interval is the steady cost of discovery; it is
+// reported as cpu_pct. Arg 1 scans with sock_diag, 2 reads /proc/net/tcp*.
+// Run with
+//   wsl_benchmarks --benchmark_filter=BM_PortDiscovery --benchmark_format=json
+
+using namespace WSL;
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr size_t Listeners = 100;
+constexpr size_t Connections = 5000; // two sockets each
+
+int ListenOnLoopback() {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 128) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+uint16_t PortOf(int fd) {
+    sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    return ntohs(address.sin_port);
+}
+
+// Held open for the whole run; building it takes a while.
+class Population {
+public:
+    Population() {
+        rlimit limit = {};
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 16384) {
+            limit.rlim_cur = std::min<rlim_t>(16384, limit.rlim_max);
+            setrlimit(RLIMIT_NOFILE, &limit);
+        }
+
+        for (size_t i = 0; i < Listeners; ++i) {
+            const int fd = ListenOnLoopback();
+            if (fd >= 0) {
+                fds_.push_back(fd);
+            }
+        }
+        if (fds_.empty()) {
+            return;
+        }
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(PortOf(fds_.front()));
+        for (size_t i = 0; i < Connections; ++i) {
+            const int client = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (client < 0 || connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                if (client >= 0) {
+                    close(client);
+                }
+                break;
+            }
+            fds_.push_back(client);
+            const int server = accept4(fds_.front(), nullptr, nullptr, SOCK_CLOEXEC);
+            if (server < 0) {
+                break;
+            }
+            fds_.push_back(server);
+        }
+    }
+
+    ~Population() {
+        for (int fd : fds_) {
+            close(fd);
+        }
+    }
+
+    size_t Sockets() const { return fds_.size(); }
+
+private:
+    std::vector<int> fds_;
+};
+
+Population& Sockets() {
+    static Population population;
+    return population;
+}
+
+uint64_t ThreadCpuNs() {
+    timespec now = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + static_cast<uint64_t>(now.tv_nsec);
+}
+
+PortDiscoveryOptions Source(int64_t arg) {
+    PortDiscoveryOptions options;
+    options.source = arg == 1 ? PortSource::SockDiag : PortSource::ProcNet;
+    return options;
+}
+
+} // namespace
+
+// One steady-state scan: nothing changed, so nothing is reported.
+static void BM_PortDiscoveryScan(benchmark::State& state) {
+    const size_t sockets = Sockets().Sockets();
+    std::unique_ptr<PortDiscovery> discovery;
+    try {
+        discovery = std::make_unique<PortDiscovery>([](PortChange, const ListeningPort&) {}, Source(state.range(0)));
+    } catch (const std::system_error&) {
+        state.SkipWithError("sock_diag unavailable");
+        return;
+    }
+    discovery->Poll();
+
+    const uint64_t start = ThreadCpuNs();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(discovery->Poll());
+    }
+    const double cpuPerScan = static_cast<double>(ThreadCpuNs() - start) / static_cast<double>(state.iterations());
+
+    state.counters["sockets"] = static_cast<double>(sockets);
+    state.counters["listeners"] = static_cast<double>(discovery->Ports().size());
+    const auto interval = std::chrono::duration_cast<std::chrono::nanoseconds>(discovery->Interval());
+    state.counters["cpu_pct"] = 100 * cpuPerScan / static_cast<double>(interval.count());
+}
+BENCHMARK(BM_PortDiscoveryScan)->Arg(1)->Arg(2)->Unit(benchmark::kMicrosecond);
+
+// Time from listen() to the Added report with background scans at the
+// default interval. Each listener appears just after the scan that reported
+// the last one, so this is close to the worst case of a whole interval.
+static void BM_PortDiscoveryLatency(benchmark::State& state) {
+    std::mutex lock;
+    std::condition_variable reported;
+    uint16_t waitingFor = 0;
+    bool seen = false;
+
+    std::unique_ptr<PortDiscovery> discovery;
+    try {
+        discovery = std::make_unique<PortDiscovery>(
+            [&](PortChange change, const ListeningPort& port) {
+                std::lock_guard<std::mutex> guard(lock);
+                if (change == PortChange::Added && port.port == waitingFor) {
+                    seen = true;
+                    reported.notify_all();
+                }
+            },
+            Source(state.range(0)));
+    } catch (const std::system_error&) {
+        state.SkipWithError("sock_diag unavailable");
+        return;
+    }
+    discovery->Start();
+
+    for (auto _ : state) {
+        const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            waitingFor = PortOf(fd);
+            seen = false;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        listen(fd, 16);
+        std::unique_lock<std::mutex> guard(lock);
+        if (!reported.wait_for(guard, std::chrono::seconds(5), [&] { return seen; })) {
+            state.SkipWithError("Listener not reported");
+            close(fd);
+            break;
+        }
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        guard.unlock();
+        close(fd);
+    }
+    discovery->Stop();
+}
+BENCHMARK(BM_PortDiscoveryLatency)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseManualTime()->Iterations(20);
+
+#endif
@@ -0,0 +1,325 @@
+#include <benchmark/benchmark.h>
+#include "portforward.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Loopback load test of the port forwarder against a local echo server, the
+// shape of a dev server behind wslrelay: connections/sec for short
+// request-reply connections, bulk throughput copied and spliced, and a
+// thousand connections open at once. Arg 0 of the first two runs straight
+// to the echo server, as the baseline the forwarder's overhead is read
+// against. Run with
+//   wsl_benchmarks --benchmark_filter=BM_PortForward --benchmark_format=json
+
+using namespace WSL;
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr size_t ConcurrentConnections = 1000;
+
+int Connect(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return fd;
+}
+
+bool SendAll(int fd, const char* data, size_t size) {
+    for (size_t sent = 0; sent < size;) {
+        const ssize_t result = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+bool ReceiveExactly(int fd, char* data, size_t size) {
+    for (size_t received = 0; received < size;) {
+        const ssize_t result = recv(fd, data + received, size - received, 0);
+        if (result <= 0) {
+            return false;
+        }
+        received += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+// Single-threaded epoll echo server, so the target costs as little as it
+// can and the forwarder is what the numbers move with.
+class EchoServer {
+public:
+    EchoServer() {
+        listener_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(listener_, 4096);
+        getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length);
+        port_ = ntohs(address.sin_port);
+
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Watch(listener_, EPOLLIN);
+        Watch(wake_, EPOLLIN);
+        thread_ = std::thread(&EchoServer::Run, this);
+    }
+
+    ~EchoServer() {
+        stop_.store(true);
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = write(wake_, &one, sizeof(one));
+        thread_.join();
+        for (auto& [fd, pending] : connections_) {
+            close(fd);
+        }
+        close(listener_);
+        close(wake_);
+        close(epoll_);
+    }
+
+    EchoServer(const EchoServer&) = delete;
+    EchoServer& operator=(const EchoServer&) = delete;
+
+    uint16_t Port() const { return port_; }
+
+private:
+    void Watch(int fd, uint32_t events) {
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void Run() {
+        std::vector<char> buffer(256 * 1024);
+        epoll_event events[256];
+        while (!stop_.load()) {
+            const int count = epoll_wait(epoll_, events, 256, -1);
+            for (int i = 0; i < count; ++i) {
+                const int fd = events[i].data.fd;
+                if (fd == listener_) {
+                    int client;
+                    while ((client = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        connections_[client];
+                        Watch(client, EPOLLIN | EPOLLOUT | EPOLLET);
+                    }
+                } else if (fd != wake_) {
+                    Service(fd, buffer);
+                }
+            }
+        }
+    }
+
+    // Echoes until the socket would block; whatever the peer is not ready
+    // for waits in the connection's backlog.
+    void Service(int fd, std::vector<char>& buffer) {
+        std::string& pending = connections_[fd];
+        for (;;) {
+            while (!pending.empty()) {
+                const ssize_t sent = send(fd, pending.data(), pending.size(), MSG_NOSIGNAL);
+                if (sent <= 0) {
+                    if (sent < 0 && errno == EAGAIN) {
+                        return;
+                    }
+                    Drop(fd);
+                    return;
+                }
+                pending.erase(0, static_cast<size_t>(sent));
+            }
+
+            const ssize_t received = recv(fd, buffer.data(), buffer.size(), 0);
+            if (received > 0) {
+                pending.assign(buffer.data(), static_cast<size_t>(received));
+                continue;
+            }
+            if (received < 0 && errno == EAGAIN) {
+                return;
+            }
+            Drop(fd);
+            return;
+        }
+    }
+
+    void Drop(int fd) {
+        connections_.erase(fd);
+        close(fd);
+    }
+
+    int listener_ = -1;
+    int epoll_ = -1;
+    int wake_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+    std::unordered_map<int, std::string> connections_;
+};
+
+// A thousand connections take four thousand descriptors across the three
+// parties.
+void RaiseDescriptorLimit() {
+    rlimit limit = {};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 8192) {
+        limit.rlim_cur = std::min<rlim_t>(8192, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+struct Fixture {
+    EchoServer server;
+    std::unique_ptr<PortForwarder> forwarder;
+    uint16_t port = 0;
+
+    // Without a forwarder, clients go straight to the echo server.
+    Fixture(bool forward, bool zeroCopy = true) {
+        port = server.Port();
+        if (forward) {
+            PortForwardOptions options;
+            options.zeroCopy = zeroCopy;
+            forwarder = std::make_unique<PortForwarder>(options);
+            port = forwarder->AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+            forwarder->Start();
+        }
+    }
+};
+
+} // namespace
+
+// One short request-reply exchange per connection, the pattern of HTTP
+// clients that do not keep connections alive.
+static void BM_PortForwardConnectionRate(benchmark::State& state) {
+    Fixture fixture(state.range(0) != 0);
+    char request[128] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    char reply[sizeof(request)];
+
+    for (auto _ : state) {
+        const int fd = Connect(fixture.port);
+        if (fd < 0 || !SendAll(fd, request, sizeof(request)) || !ReceiveExactly(fd, reply, sizeof(reply))) {
+            state.SkipWithError("Exchange failed");
+            if (fd >= 0) {
+                close(fd);
+            }
+            break;
+        }
+        close(fd);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel("connections");
+}
+BENCHMARK(BM_PortForwardConnectionRate)->Arg(0)->Arg(1)->UseRealTime();
+
+// Bulk transfer over one connection, written and read back concurrently.
+// Arg 0: direct, 1: forwarded with copying, 2: forwarded with splice.
+static void BM_PortForwardThroughput(benchmark::State& state) {
+    const int64_t mode = state.range(0);
+    Fixture fixture(mode != 0, mode == 2);
+    constexpr size_t Chunk = 64 * 1024;
+    const size_t size = 16 * 1024 * 1024;
+    const std::vector<char> data(Chunk, 'x');
+    std::vector<char> echoed(Chunk);
+
+    const int fd = Connect(fixture.port);
+    if (fd < 0) {
+        state.SkipWithError("Connect failed");
+        return;
+    }
+
+    for (auto _ : state) {
+        std::thread writer([&] {
+            for (size_t sent = 0; sent < size; sent += Chunk) {
+                SendAll(fd, data.data(), Chunk);
+            }
+        });
+        for (size_t received = 0; received < size; received += Chunk) {
+            if (!ReceiveExactly(fd, echoed.data(), Chunk)) {
+                state.SkipWithError("Receive failed");
+                break;
+            }
+        }
+        writer.join();
+    }
+    close(fd);
+
+    // The payload counted once, though it crosses the forwarder both ways.
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(size));
+    if (fixture.forwarder) {
+        state.counters["buffers"] = static_cast<double>(fixture.forwarder->GetStats().buffersAllocated);
+    }
+}
+BENCHMARK(BM_PortForwardThroughput)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A thousand open connections, each making one small exchange per
+// iteration: the cost of carrying many mostly idle connections. Arg 0
+// copies, 1 splices.
+static void BM_PortForwardConcurrent(benchmark::State& state) {
+    RaiseDescriptorLimit();
+    Fixture fixture(true, state.range(0) != 0);
+    std::vector<int> clients;
+    for (size_t i = 0; i < ConcurrentConnections; ++i) {
+        const int fd = Connect(fixture.port);
+        if (fd < 0) {
+            break;
+        }
+        clients.push_back(fd);
+    }
+    if (clients.size() != ConcurrentConnections) {
+        state.SkipWithError("Could not open every connection");
+    }
+
+    char request[64] = "ping";
+    char reply[sizeof(request)];
+    for (auto _ : state) {
+        if (clients.size() != ConcurrentConnections) {
+            break;
+        }
+        for (int fd : clients) {
+            SendAll(fd, request, sizeof(request));
+        }
+        for (int fd : clients) {
+            if (!ReceiveExactly(fd, reply, sizeof(reply))) {
+                state.SkipWithError("Receive failed");
+                break;
+            }
+        }
+    }
+
+    const PortForwardStats stats = fixture.forwarder->GetStats();
+    state.counters["active"] = static_cast<double>(stats.active);
+    state.counters["buffers"] = static_cast<double>(stats.buffersAllocated);
+    for (int fd : clients) {
+        close(fd);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(clients.size()));
+}
+BENCHMARK(BM_PortForwardConcurrent)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+#endif
@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+#include "relayengine.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace WSL;
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr size_t BulkPayloadSize = 64 * 1024 * 1024;
+
+// Drains a pipe into /dev/null without touching the bytes in user space, so
+// the relay under test is the only copy being measured.
+void DiscardPipe(int readEnd) {
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    for (;;) {
+        ssize_t moved = splice(readEnd, nullptr, devNull, nullptr, 1024 * 1024, SPLICE_F_MOVE);
+        if (moved <= 0) {
+            break;
+        }
+    }
+    close(devNull);
+}
+
+int CreatePayloadFile(size_t size) {
+    char path[] = "/tmp/relay_bench_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+
+    std::vector<char> block(1024 * 1024, 'b');
+    for (size_t written = 0; written < size; written += block.size()) {
+        if (write(fd, block.data(), block.size()) <= 0) {
+            break;
+        }
+    }
+    return fd;
+}
+
+} // namespace
+
+// "cat bigfile | ..." : a file feeding the relay whose sink is a pipe.
+// Arg(0) is the buffered copy, Arg(1) the zero-copy path.
+static void BM_RelayFileToPipe(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const bool zeroCopy = state.range(0) != 0;
+    int file = CreatePayloadFile(BulkPayloadSize);
+
+    for (auto _ : state) {
+        lseek(file, 0, SEEK_SET);
+
+        int sink[2];
+        if (pipe(sink) != 0) {
+            state.SkipWithError("pipe() failed");
+            break;
+        }
+        std::thread consumer(DiscardPipe, sink[0]);
+
+        RelayStreamOptions options;
+        options.zeroCopy = zeroCopy;
+        RelayEngine engine;
+        engine.AddStream(file, sink[1], options);
+        engine.Run();
+
+        close(sink[1]);
+        consumer.join();
+        close(sink[0]);
+    }
+
+    close(file);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(BulkPayloadSize));
+    state.SetLabel(zeroCopy ? "zero-copy" : "buffered");
+}
+BENCHMARK(BM_RelayFileToPipe)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Linux process stdout (a pipe) relayed to a pipe consumer.
+static void BM_RelayPipeToPipe(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const bool zeroCopy = state.range(0) != 0;
+    int payloadFile = CreatePayloadFile(BulkPayloadSize);
+
+    for (auto _ : state) {
+        int source[2];
+        int sink[2];
+        if (pipe(source) != 0 || pipe(sink) != 0) {
+            state.SkipWithError("pipe() failed");
+            break;
+        }
+
+        // The producer splices from a file so it does not add a copy of its own.
+        lseek(payloadFile, 0, SEEK_SET);
+        std::thread producer([&] {
+            for (;;) {
+                ssize_t moved = splice(payloadFile, nullptr, source[1], nullptr, 1024 * 1024, SPLICE_F_MOVE);
+                if (moved <= 0) {
+                    break;
+                }
+            }
+            close(source[1]);
+        });
+        std::thread consumer(DiscardPipe, sink[0]);
+
+        RelayStreamOptions options;
+        options.zeroCopy = zeroCopy;
+        RelayEngine engine;
+        engine.AddStream(source[0], sink[1], options);
+        engine.Run();
+
+        close(sink[1]);
+        producer.join();
+        consumer.join();
+        close(source[0]);
+        close(sink[0]);
+    }
+
+    close(payloadFile);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(BulkPayloadSize));
+    state.SetLabel(zeroCopy ? "zero-copy" : "buffered");
+}
+BENCHMARK(BM_RelayPipeToPipe)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Buffered relay of bulk output, reporting syscalls per MiB so the effect of
+// adaptive sizing is visible. Arg(0) pins the old fixed 4 KiB buffer,
+// Arg(1) is Latency mode, Arg(2) Throughput mode.
+static void BM_RelaySyscallsPerMB(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    int payloadFile = CreatePayloadFile(BulkPayloadSize);
+
+    RelayStreamOptions options;
+    options.zeroCopy = false;
+    options.mode = state.range(0) == 2 ? RelayMode::Throughput : RelayMode::Latency;
+    if (state.range(0) == 0) {
+        options.maxBufferSize = options.bufferSize;
+    }
+
+    RelayStreamStats total;
+    for (auto _ : state) {
+        int source[2];
+        int sink[2];
+        if (pipe(source) != 0 || pipe(sink) != 0) {
+            state.SkipWithError("pipe() failed");
+            break;
+        }
+
+        lseek(payloadFile, 0, SEEK_SET);
+        std::thread producer([&] {
+            for (;;) {
+                ssize_t moved = splice(payloadFile, nullptr, source[1], nullptr, 1024 * 1024, SPLICE_F_MOVE);
+                if (moved <= 0) {
+                    break;
+                }
+            }
+            close(source[1]);
+        });
+        std::thread consumer(DiscardPipe, sink[0]);
+
+        RelayEngine engine;
+        size_t stream = engine.AddStream(source[0], sink[1], options);
+        engine.Run();
+
+        RelayStreamStats stats = engine.GetStats(stream);
+        total.bytes += stats.bytes;
+        total.reads += stats.reads;
+        total.writes += stats.writes;
+
+        close(sink[1]);
+        producer.join();
+        consumer.join();
+        close(source[0]);
+        close(sink[0]);
+    }
+
+    close(payloadFile);
+    state.SetBytesProcessed(static_cast<int64_t>(total.bytes));
+    state.counters["syscalls_per_MB"] = total.SyscallsPerMegabyte();
+    state.SetLabel(state.range(0) == 0 ? "fixed-4KiB" : state.range(0) == 1 ? "latency" : "throughput");
+}
+BENCHMARK(BM_RelaySyscallsPerMB)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+#endif
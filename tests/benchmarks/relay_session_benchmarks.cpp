@@ -0,0 +1,383 @@
+#include <benchmark/benchmark.h>
+#include "relaysession.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// End-to-end benchmarks of an interactive session: the same stream wiring
+// RelayIO uses, driven through OS pipes or socketpairs standing in for the
+// console and the service handles. Run with
+//   wsl_benchmarks --benchmark_filter=BM_Session --benchmark_format=json
+// (or the run_benchmarks target) to get results that can be tracked over time.
+
+using namespace WSL;
+
+#ifndef _WIN32
+
+namespace {
+
+enum class Transport {
+    Pipe,
+    SocketPair
+};
+
+struct Channel {
+    int readEnd = -1;
+    int writeEnd = -1;
+
+    explicit Channel(Transport transport = Transport::Pipe) {
+        int fds[2];
+        int result = transport == Transport::Pipe ? pipe2(fds, O_CLOEXEC)
+                                                  : socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+        if (result == 0) {
+            readEnd = fds[0];
+            writeEnd = fds[1];
+        }
+    }
+
+    ~Channel() {
+        CloseRead();
+        CloseWrite();
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    bool Valid() const { return readEnd >= 0 && writeEnd >= 0; }
+
+    void CloseRead() { CloseFd(readEnd); }
+    void CloseWrite() { CloseFd(writeEnd); }
+
+    static void CloseFd(int& fd) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// The relay leaves the descriptors non-blocking, so both helpers wait out
+// EAGAIN instead of treating it as an error.
+bool WriteAll(int fd, const char* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t written = write(fd, data + offset, size - offset);
+        if (written > 0) {
+            offset += static_cast<size_t>(written);
+        } else if (written < 0 && (errno == EAGAIN || errno == EINTR)) {
+            std::this_thread::yield();
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadExactly(int fd, char* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        ssize_t bytesRead = read(fd, data + offset, size - offset);
+        if (bytesRead > 0) {
+            offset += static_cast<size_t>(bytesRead);
+        } else if (bytesRead < 0 && (errno == EAGAIN || errno == EINTR)) {
+            std::this_thread::yield();
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t DrainToEof(int fd) {
+    std::vector<char> buffer(256 * 1024);
+    size_t total = 0;
+    for (;;) {
+        ssize_t bytesRead = read(fd, buffer.data(), buffer.size());
+        if (bytesRead > 0) {
+            total += static_cast<size_t>(bytesRead);
+        } else if (bytesRead < 0 && (errno == EAGAIN || errno == EINTR)) {
+            std::this_thread::yield();
+        } else {
+            return total;
+        }
+    }
+}
+
+// Writes size bytes in chunks of at most 1 MiB and then closes the stream,
+// which is what a Linux process exiting after its output looks like.
+void Produce(Channel& channel, size_t size) {
+    static const std::string chunk(1024 * 1024, 'o');
+    for (size_t sent = 0; sent < size;) {
+        const size_t length = std::min(chunk.size(), size - sent);
+        if (!WriteAll(channel.writeEnd, chunk.data(), length)) {
+            break;
+        }
+        sent += length;
+    }
+    channel.CloseWrite();
+}
+
+double Percentile(std::vector<double>& samples, double fraction) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    const size_t rank = std::min(samples.size() - 1, static_cast<size_t>(fraction * static_cast<double>(samples.size())));
+    std::nth_element(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(rank), samples.end());
+    return samples[rank];
+}
+
+// One short-lived session that relays size bytes of stdout and exits, the
+// shape of a `wsl -e` invocation. Returns false if the output did not arrive.
+bool RunOneShotSession(Transport transport, size_t size, RelayMode mode) {
+    Channel processOut(transport), processErr(transport), console(transport);
+    if (!processOut.Valid() || !processErr.Valid() || !console.Valid()) {
+        return false;
+    }
+
+    RelaySessionHandles handles;
+    handles.processOutput = processOut.readEnd;
+    handles.processError = processErr.readEnd;
+    handles.consoleOutput = console.writeEnd;
+    handles.consoleError = console.writeEnd;
+
+    RelaySession session(handles, mode);
+    std::thread producer([&] { Produce(processOut, size); });
+    processErr.CloseWrite();
+
+    size_t received = 0;
+    std::thread consumer([&] { received = DrainToEof(console.readEnd); });
+
+    session.Run();
+    console.CloseWrite();
+    producer.join();
+    consumer.join();
+    return received == size;
+}
+
+} // namespace
+
+// A whole session relaying one message of 1 B .. 64 MiB from the process to
+// the console. Small sizes are dominated by session setup and teardown, large
+// ones by copy throughput. Second arg: 0 = pipes, 1 = socketpairs.
+static void BM_SessionMessage(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const size_t size = static_cast<size_t>(state.range(0));
+    const Transport transport = state.range(1) == 0 ? Transport::Pipe : Transport::SocketPair;
+
+    for (auto _ : state) {
+        if (!RunOneShotSession(transport, size, RelayMode::Throughput)) {
+            state.SkipWithError("session lost output");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+    state.SetLabel(transport == Transport::Pipe ? "pipe" : "socketpair");
+}
+BENCHMARK(BM_SessionMessage)
+    ->ArgsProduct({{1, 64, 4 << 10, 64 << 10, 1 << 20, 16 << 20, 64 << 20}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// Interactive echo: a keystroke-sized message goes console -> stdin, the
+// "process" echoes it to stdout, and the round trip ends when it is back on
+// the console. Reports p50/p99 in microseconds alongside the mean.
+static void BM_SessionPingPong(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const size_t size = static_cast<size_t>(state.range(0));
+    const RelayMode mode = state.range(1) == 0 ? RelayMode::Latency : RelayMode::Throughput;
+
+    Channel consoleIn, processIn, processOut, processErr, consoleOut;
+    RelaySessionHandles handles;
+    handles.consoleInput = consoleIn.readEnd;
+    handles.processInput = processIn.writeEnd;
+    handles.processOutput = processOut.readEnd;
+    handles.processError = processErr.readEnd;
+    handles.consoleOutput = consoleOut.writeEnd;
+    handles.consoleError = consoleOut.writeEnd;
+
+    RelaySession session(handles, mode);
+    std::thread relay([&] { session.Run(); });
+
+    // The Linux side: echo stdin back on stdout, then exit once told to.
+    std::atomic<bool> exitRequested{false};
+    std::thread echo([&] {
+        std::vector<char> buffer(size);
+        while (ReadExactly(processIn.readEnd, buffer.data(), size) && !exitRequested) {
+            if (!WriteAll(processOut.writeEnd, buffer.data(), size)) {
+                break;
+            }
+        }
+        processOut.CloseWrite();
+        processErr.CloseWrite();
+    });
+
+    const std::string message(size, 'k');
+    std::vector<char> reply(size);
+    std::vector<double> samples;
+
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        if (!WriteAll(consoleIn.writeEnd, message.data(), size) || !ReadExactly(consoleOut.readEnd, reply.data(), size)) {
+            state.SkipWithError("echo failed");
+            break;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    // One more message wakes the echo loop so it can exit and close stdout.
+    exitRequested = true;
+    WriteAll(consoleIn.writeEnd, message.data(), size);
+    echo.join();
+    relay.join();
+
+    state.counters["p50_us"] = Percentile(samples, 0.50);
+    state.counters["p99_us"] = Percentile(samples, 0.99);
+    state.SetLabel(mode == RelayMode::Latency ? "latency" : "throughput");
+}
+BENCHMARK(BM_SessionPingPong)
+    ->ArgsProduct({{1, 64, 4096}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// stdout and stderr writing concurrently into one console, as a build log
+// with interleaved warnings does.
+static void BM_SessionFanIn(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const size_t perStream = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state) {
+        Channel processOut, processErr, console;
+        RelaySessionHandles handles;
+        handles.processOutput = processOut.readEnd;
+        handles.processError = processErr.readEnd;
+        handles.consoleOutput = console.writeEnd;
+        handles.consoleError = console.writeEnd;
+
+        RelaySession session(handles, RelayMode::Throughput);
+        std::thread out([&] { Produce(processOut, perStream); });
+        std::thread err([&] { Produce(processErr, perStream); });
+
+        size_t received = 0;
+        std::thread consumer([&] { received = DrainToEof(console.readEnd); });
+
+        session.Run();
+        console.CloseWrite();
+        out.join();
+        err.join();
+        consumer.join();
+
+        if (received != 2 * perStream) {
+            state.SkipWithError("session lost output");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(2 * perStream));
+}
+BENCHMARK(BM_SessionFanIn)->Arg(64 << 10)->Arg(16 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Many sessions at once, each on its own thread as RelayIO runs them, each
+// relaying 1 MiB. Shows how the per-session cost scales with contention.
+static void BM_SessionConcurrent(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const int sessions = static_cast<int>(state.range(0));
+    constexpr size_t PerSession = 1 << 20;
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        std::vector<char> ok(static_cast<size_t>(sessions), 0);
+        threads.reserve(static_cast<size_t>(sessions));
+        for (int i = 0; i < sessions; ++i) {
+            threads.emplace_back([&ok, i] {
+                ok[static_cast<size_t>(i)] = RunOneShotSession(Transport::Pipe, PerSession, RelayMode::Throughput);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (std::count(ok.begin(), ok.end(), 0) != 0) {
+            state.SkipWithError("session lost output");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * sessions * static_cast<int64_t>(PerSession));
+    state.counters["sessions_per_s"] =
+        benchmark::Counter(static_cast<double>(state.iterations()) * sessions, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SessionConcurrent)->RangeMultiplier(4)->Range(1, 64)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A `wsl -e` job end to end: fork a child that writes size bytes and exits
+// with a status, relay it with the pidfd in the wait set, and check the status
+// arrives. teardown_us is the time from the exit being observed to Run()
+// returning with all output drained.
+static void BM_SessionExitTeardown(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    const size_t size = static_cast<size_t>(state.range(0));
+    constexpr int ExitStatus = 7;
+    double teardownTotal = 0.0;
+
+    for (auto _ : state) {
+        Channel processOut, processErr, console;
+        pid_t pid = fork();
+        if (pid == 0) {
+            processOut.CloseRead();
+            processErr.CloseRead();
+            std::string output(size, 'e');
+            WriteAll(processOut.writeEnd, output.data(), output.size());
+            _exit(ExitStatus);
+        }
+
+        int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (pidfd < 0) {
+            waitpid(pid, nullptr, 0);
+            state.SkipWithError("pidfd_open is not available");
+            break;
+        }
+        processOut.CloseWrite();
+        processErr.CloseWrite();
+
+        RelaySessionHandles handles;
+        handles.processOutput = processOut.readEnd;
+        handles.processError = processErr.readEnd;
+        handles.consoleOutput = console.writeEnd;
+        handles.consoleError = console.writeEnd;
+        handles.process = pidfd;
+
+        size_t received = 0;
+        std::thread consumer([&] { received = DrainToEof(console.readEnd); });
+
+        RelaySession session(handles, RelayMode::Throughput);
+        session.Run();
+        console.CloseWrite();
+        consumer.join();
+        close(pidfd);
+
+        if (session.GetExitCode() != ExitStatus || received != size) {
+            state.SkipWithError("wrong exit status or lost output");
+            break;
+        }
+        teardownTotal += std::chrono::duration<double, std::micro>(session.GetTeardownLatency()).count();
+    }
+
+    state.counters["teardown_us"] = state.iterations() == 0 ? 0.0 : teardownTotal / static_cast<double>(state.iterations());
+    state.counters["jobs_per_s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SessionExitTeardown)->Arg(0)->Arg(64 << 10)->Arg(4 << 20)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+#endif
@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+#include "resolvecache.h"
+#include "../support/fake_distributions.h"
+
+#include <filesystem>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+// The distribution store lives in a file, so the cold path pays real I/O
+// for every enumeration, as the registry scan does.
+struct StartupFixture {
+    std::filesystem::path directory;
+    std::string store;
+    std::string cache;
+
+    explicit StartupFixture(size_t count) {
+        directory = std::filesystem::temp_directory_path() / "wsl_resolvecache_bench";
+        std::filesystem::create_directories(directory);
+        store = (directory / "lxss.txt").string();
+        cache = (directory / "resolve.cache").string();
+        FileDistributionBackend::Write(store, MakeDistributions(count, count / 2));
+        std::filesystem::remove(cache);
+    }
+
+    ~StartupFixture() { std::filesystem::remove_all(directory); }
+};
+
+} // namespace
+
+// Each iteration is one client start: a new catalog, then resolve.
+static void BM_StartupResolveCold(benchmark::State& state) {
+    StartupFixture fixture(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        DistributionCatalog catalog(std::make_unique<FileDistributionBackend>(fixture.store));
+        auto resolved = ResolveDistribution("", L"", catalog);
+        benchmark::DoNotOptimize(resolved);
+    }
+}
+BENCHMARK(BM_StartupResolveCold)->Arg(4)->Arg(64)->Arg(1024);
+
+static void BM_StartupResolveCached(benchmark::State& state) {
+    StartupFixture fixture(static_cast<size_t>(state.range(0)));
+    {
+        DistributionCatalog catalog(std::make_unique<FileDistributionBackend>(fixture.store));
+        ResolveDistribution(fixture.cache, L"", catalog);
+    }
+
+    for (auto _ : state) {
+        DistributionCatalog catalog(std::make_unique<FileDistributionBackend>(fixture.store));
+        auto resolved = ResolveDistribution(fixture.cache, L"", catalog);
+        if (!resolved || !resolved->cached) {
+            state.SkipWithError("cache miss");
+            break;
+        }
+        benchmark::DoNotOptimize(resolved);
+    }
+}
+BENCHMARK(BM_StartupResolveCached)->Arg(4)->Arg(64)->Arg(1024);
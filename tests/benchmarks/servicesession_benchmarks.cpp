@@ -0,0 +1,95 @@
+#include <benchmark/benchmark.h>
+#include "servicesession.h"
+#include "../support/mock_service.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+constexpr auto ConnectTime = std::chrono::microseconds(500);
+constexpr auto ServiceTime = std::chrono::microseconds(100);
+
+LaunchRequest MakeRequest() {
+    LaunchRequest request;
+    request.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+    request.command = L"/bin/true";
+    return request;
+}
+
+MockServiceTransport::Options ServiceOptions(size_t workers) {
+    MockServiceTransport::Options options;
+    options.workers = workers;
+    options.connectTime = ConnectTime;
+    options.serviceTime = ServiceTime;
+    options.createPipes = true;
+    return options;
+}
+
+void ReportLatency(benchmark::State& state, std::vector<double>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    state.counters["p50_us"] = samples[samples.size() / 2];
+    state.counters["p99_us"] = samples[samples.size() * 99 / 100];
+}
+
+} // namespace
+
+// The old shape: connect, launch one process, disconnect.
+static void BM_LaunchConnectPerProcess(benchmark::State& state) {
+    for (auto _ : state) {
+        ServiceSession session(std::make_unique<MockServiceTransport>(ServiceOptions(1)));
+        LaunchResult result = session.Launch(MakeRequest()).get();
+        benchmark::DoNotOptimize(result.status);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LaunchConnectPerProcess)->UseRealTime();
+
+// One session, launches back to back.
+static void BM_LaunchSequential(benchmark::State& state) {
+    ServiceSession session(std::make_unique<MockServiceTransport>(ServiceOptions(1)));
+    std::vector<double> samples;
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        LaunchResult result = session.Launch(MakeRequest()).get();
+        samples.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        benchmark::DoNotOptimize(result.status);
+    }
+    state.SetItemsProcessed(state.iterations());
+    ReportLatency(state, samples);
+}
+BENCHMARK(BM_LaunchSequential)->UseRealTime();
+
+// range(0) launches in flight over one session with range(1) service workers.
+static void BM_LaunchMultiplexed(benchmark::State& state) {
+    const size_t inFlight = static_cast<size_t>(state.range(0));
+    ServiceSession session(std::make_unique<MockServiceTransport>(ServiceOptions(static_cast<size_t>(state.range(1)))));
+
+    std::vector<double> samples;
+    for (auto _ : state) {
+        std::vector<std::chrono::steady_clock::time_point> starts(inFlight);
+        std::vector<std::future<LaunchResult>> launches;
+        launches.reserve(inFlight);
+        for (size_t i = 0; i < inFlight; ++i) {
+            starts[i] = std::chrono::steady_clock::now();
+            launches.push_back(session.Launch(MakeRequest()));
+        }
+        for (size_t i = 0; i < inFlight; ++i) {
+            LaunchResult result = launches[i].get();
+            samples.push_back(
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - starts[i]).count());
+            benchmark::DoNotOptimize(result.status);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(inFlight));
+    ReportLatency(state, samples);
+}
+BENCHMARK(BM_LaunchMultiplexed)->Args({16, 1})->Args({16, 4})->Args({64, 4})->UseRealTime();
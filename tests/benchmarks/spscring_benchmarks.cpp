@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+#include "spscring.h"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+// Element-at-a-time handoff between two threads; reports items/s. Both
+// sides yield on empty/full so the numbers stay meaningful on small hosts.
+static void BM_SpscRingElements(benchmark::State& state) {
+    constexpr uint64_t Count = 1 << 22;
+    SpscRing<uint64_t> ring(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        std::thread consumer([&] {
+            uint64_t value = 0;
+            for (uint64_t received = 0; received < Count;) {
+                if (ring.TryPop(value)) {
+                    ++received;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            benchmark::DoNotOptimize(value);
+        });
+
+        for (uint64_t i = 0; i < Count;) {
+            if (ring.TryPush(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        consumer.join();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * Count));
+}
+BENCHMARK(BM_SpscRingElements)->Arg(1024)->Arg(64 * 1024)->UseRealTime();
+
+// Byte spans the way the relay uses the ring: the producer fills writable
+// spans in place, the consumer drains readable spans. Arg is the chunk size.
+static void BM_SpscRingByteSpans(benchmark::State& state) {
+    constexpr size_t Total = 64 * 1024 * 1024;
+    const size_t chunkSize = static_cast<size_t>(state.range(0));
+    SpscRing<char> ring(1024 * 1024);
+    std::vector<char> source(chunkSize, 'r');
+
+    for (auto _ : state) {
+        std::thread consumer([&] {
+            std::vector<char> sink(chunkSize);
+            for (size_t received = 0; received < Total;) {
+                auto span = ring.ReadableSpan();
+                size_t chunk = std::min(span.size(), chunkSize);
+                if (chunk == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::memcpy(sink.data(), span.data(), chunk);
+                ring.Consume(chunk);
+                received += chunk;
+            }
+            benchmark::DoNotOptimize(sink.data());
+        });
+
+        for (size_t sent = 0; sent < Total;) {
+            auto span = ring.WritableSpan();
+            size_t chunk = std::min({span.size(), chunkSize, Total - sent});
+            if (chunk == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::memcpy(span.data(), source.data(), chunk);
+            ring.Commit(chunk);
+            sent += chunk;
+        }
+        consumer.join();
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * Total));
+}
+BENCHMARK(BM_SpscRingByteSpans)->Arg(64)->Arg(4096)->Arg(65536)->Unit(benchmark::kMillisecond)->UseRealTime();
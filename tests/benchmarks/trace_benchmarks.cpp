@@ -0,0 +1,30 @@
+#include <benchmark/benchmark.h>
+#include "trace.h"
+
+#include <filesystem>
+
+using namespace WSL;
+
+// The cost in every build: a span when tracing is off.
+static void BM_TraceSpanDisabled(benchmark::State& state) {
+    for (auto _ : state) {
+        WSL_TRACE_SPAN("Disabled");
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_TraceSpanDisabled);
+
+// A span while tracing: two clock reads and an append to the thread's
+// events, plus its share of writing them out.
+static void BM_TraceSpanEnabled(benchmark::State& state) {
+    const auto path = std::filesystem::temp_directory_path() / "wsl_trace_benchmark.json";
+    std::filesystem::remove(path);
+    StartTracing(path, "benchmark");
+    for (auto _ : state) {
+        WSL_TRACE_SPAN("Enabled");
+        benchmark::ClobberMemory();
+    }
+    StopTracing();
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_TraceSpanEnabled);
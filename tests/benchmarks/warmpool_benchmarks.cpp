@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+#include "warmpool.h"
+#include "../support/mock_service.h"
+
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+namespace {
+
+// Roughly what sourcing a distribution's login profile costs.
+constexpr auto LoginTime = std::chrono::milliseconds(20);
+
+std::unique_ptr<ServiceSession> SpawningSession() {
+    MockServiceTransport::Options options;
+    options.workers = 4;
+    options.spawn = true;
+    options.startupTime = LoginTime;
+    return std::make_unique<ServiceSession>(std::make_unique<MockServiceTransport>(options));
+}
+
+LaunchRequest MakeRequest() {
+    LaunchRequest request;
+    request.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+    request.command = L"echo ready";
+    request.workingDirectory = L"/tmp";
+    request.environment = std::make_shared<EnvironmentSnapshot>(
+        EnvironmentSnapshot::FromStrings({L"TERM=xterm-256color", L"LANG=C.UTF-8", L"WSLENV=USERPROFILE/p"}));
+    return request;
+}
+
+// Until the command's first output byte, which is what the user waits for.
+void WaitForOutput(LaunchResult& result) {
+    char byte;
+    benchmark::DoNotOptimize(read(result.output, &byte, 1));
+}
+
+} // namespace
+
+static void BM_ColdLaunch(benchmark::State& state) {
+    auto session = SpawningSession();
+    LaunchRequest request = MakeRequest();
+    request.command = L"/bin/sh";
+    request.arguments = {L"/bin/sh", L"-c", L"echo ready"};
+
+    for (auto _ : state) {
+        LaunchResult result = session->Launch(request).get();
+        WaitForOutput(result);
+    }
+}
+BENCHMARK(BM_ColdLaunch)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_WarmLaunch(benchmark::State& state) {
+    signal(SIGPIPE, SIG_IGN);
+    auto session = SpawningSession();
+
+    WarmPoolOptions options;
+    options.size = 2;
+    options.shell = L"/bin/sh";
+    options.shellArguments = {};
+    WarmPool pool(*session, options);
+
+    const LaunchRequest request = MakeRequest();
+    pool.Prewarm(request);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        while (pool.GetStats().idle < options.size) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        // And past their login; a pool sized for the load is always ahead.
+        std::this_thread::sleep_for(LoginTime * 2);
+        state.ResumeTiming();
+
+        LaunchResult result = pool.Launch(request);
+        WaitForOutput(result);
+    }
+    state.counters["hit_rate"] = static_cast<double>(pool.GetStats().hits) /
+                                 static_cast<double>(pool.GetStats().hits + pool.GetStats().misses);
+}
+BENCHMARK(BM_WarmLaunch)->UseRealTime()->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+#include "optiontable.h"
+#include "wslargs.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+namespace {
+
+const std::vector<const wchar_t*> Typical = {L"wsl.exe", L"--distribution", L"Ubuntu-22.04", L"--user", L"root",
+                                             L"--cd", L"/home/root", L"--shell-type", L"ls", L"-la"};
+
+// What WSLCommandLineParser::ParseArguments() did per argument: lowercase a
+// copy, then walk the comparisons until one matches.
+int LegacyMatch(const wchar_t* argument) {
+    std::wstring arg = argument;
+    std::transform(arg.begin(), arg.end(), arg.begin(), ::towlower);
+    static const wchar_t* const Chain[] = {L"--help", L"-h", L"--version", L"-v", L"--list", L"-l", L"--status",
+                                           L"--shutdown", L"--terminate", L"-t", L"--distribution", L"-d",
+                                           L"--exec", L"-e", L"--user", L"-u", L"--cd", L"--batch", L"--parallel",
+                                           L"--output-dir", L"--shell-type"};
+    for (int i = 0; i < static_cast<int>(std::size(Chain)); ++i) {
+        if (arg == Chain[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
+static void BM_LegacyOptionChain(benchmark::State& state) {
+    for (auto _ : state) {
+        int matched = 0;
+        for (size_t i = 1; i + 2 < Typical.size(); ++i) {
+            matched += LegacyMatch(Typical[i]);
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+}
+BENCHMARK(BM_LegacyOptionChain);
+
+static void BM_ParseWSLArguments(benchmark::State& state) {
+    for (auto _ : state) {
+        WSLArguments arguments = ParseWSLArguments(static_cast<int>(Typical.size()), Typical.data());
+        benchmark::DoNotOptimize(arguments.command);
+    }
+}
+BENCHMARK(BM_ParseWSLArguments);
+
+// Lookup alone, the part the table replaces.
+static void BM_OptionTableLookup(benchmark::State& state) {
+    struct Target {};
+    static constexpr Option<Target> Options[] = {
+        {L"--help", L"-h", 0, "", nullptr},          {L"--version", L"-v", 0, "", nullptr},
+        {L"--list", L"-l", 0, "", nullptr},          {L"--status", L"", 0, "", nullptr},
+        {L"--shutdown", L"", 0, "", nullptr},        {L"--terminate", L"-t", 1, "", nullptr},
+        {L"--distribution", L"-d", 1, "", nullptr},  {L"--exec", L"-e", 1, "", nullptr},
+        {L"--user", L"-u", 1, "", nullptr},          {L"--cd", L"", 1, "", nullptr},
+        {L"--batch", L"", 1, "", nullptr},           {L"--parallel", L"", 1, "", nullptr},
+        {L"--output-dir", L"", 1, "", nullptr},      {L"--shell-type", L"", 0, "", nullptr},
+    };
+    static constexpr OptionTable<Target, std::size(Options)> Table(Options);
+    for (auto _ : state) {
+        int matched = 0;
+        for (size_t i = 1; i + 2 < Typical.size(); ++i) {
+            matched += Table.Find(Typical[i]) != nullptr;
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+}
+BENCHMARK(BM_OptionTableLookup);
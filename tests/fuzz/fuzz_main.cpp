@@ -0,0 +1,59 @@
+// Stand-in for libFuzzer on toolchains without -fsanitize=fuzzer: replays
+// every file named on the command line (directories are walked), or runs a
+// fixed number of pseudo-random inputs when given none, so fuzz targets still
+// build and run as regression tests under GCC/MSVC.
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+void RunFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            std::filesystem::path path(argv[i]);
+            if (std::filesystem::is_directory(path)) {
+                for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                    if (entry.is_regular_file()) {
+                        RunFile(entry.path());
+                    }
+                }
+            } else {
+                RunFile(path);
+            }
+        }
+        return 0;
+    }
+
+    constexpr int Iterations = 5000;
+    std::mt19937 random(0x5eed);
+    std::uniform_int_distribution<size_t> length(0, 512);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    std::vector<uint8_t> data;
+    for (int i = 0; i < Iterations; ++i) {
+        data.resize(length(random));
+        for (auto& value : data) {
+            value = static_cast<uint8_t>(byte(random));
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    std::printf("Ran %d random inputs\n", Iterations);
+    return 0;
+}
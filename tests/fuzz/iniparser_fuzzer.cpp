@@ -0,0 +1,65 @@
+// libFuzzer harness for WSL::ParseIni. Every input is also run through the
+// old std::regex parser and the two must agree; any divergence or an error
+// position outside the input aborts.
+//
+//   clang++ -std=c++20 -fsanitize=fuzzer,address,undefined ...
+//   ./iniparser_fuzzer -max_len=4096 corpus/
+
+#include "iniparser.h"
+#include "../support/ini_reference.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// std::regex recurses per character, so very long lines would only fuzz the
+// reference's stack depth.
+constexpr size_t MaxDifferentialInput = 4096;
+
+class BoundsChecker : public WSL::IniHandler {
+public:
+    explicit BoundsChecker(std::string_view text) : text(text) {}
+
+    void OnSection(std::string_view name) override { CheckInside(name); }
+
+    void OnValue(std::string_view section, std::string_view key, std::string_view value) override {
+        CheckInside(section);
+        CheckInside(key);
+        CheckInside(value);
+        if (key.empty()) {
+            std::abort();
+        }
+    }
+
+    void OnError(const WSL::IniError& error) override {
+        if (error.line == 0 || error.column == 0 || error.column > text.size() + 1) {
+            std::abort();
+        }
+    }
+
+private:
+    void CheckInside(std::string_view view) const {
+        if (view.data() < text.data() || view.data() + view.size() > text.data() + text.size()) {
+            std::abort();
+        }
+    }
+
+    std::string_view text;
+};
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    const std::string text(reinterpret_cast<const char*>(data), size);
+
+    BoundsChecker checker(text);
+    WSL::ParseIni(text, checker);
+
+    if (size <= MaxDifferentialInput &&
+        WSL::Testing::ParseIniTable(text) != WSL::Testing::ReferenceParseIni(text)) {
+        std::abort();
+    }
+    return 0;
+}
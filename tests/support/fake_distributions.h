@@ -0,0 +1,142 @@
+#pragma once
+
+// Stand-ins for the Lxss registry key so DistributionCatalog can be tested
+// and benchmarked off Windows.
+
+#include "configcache.h"
+#include "distcatalog.h"
+
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace WSL::Testing {
+
+// "{xxxxxxxx-0000-4000-8000-xxxxxxxxxxxx}" from an index, upper-case like
+// registry key names.
+inline std::wstring MakeDistributionId(size_t index) {
+    wchar_t text[40];
+    std::swprintf(text, 40, L"{%08X-0000-4000-8000-%012zX}", static_cast<unsigned>(index * 2654435761u), index);
+    return text;
+}
+
+inline DistributionList MakeDistributions(size_t count, size_t defaultIndex = 0) {
+    DistributionList list;
+    for (size_t i = 0; i < count; ++i) {
+        list.distributions.push_back(
+            {MakeDistributionId(i), L"Distro-" + std::to_wstring(i), L"C:\\WSL\\Distro-" + std::to_wstring(i), 2});
+    }
+    if (defaultIndex < count) {
+        list.defaultId = list.distributions[defaultIndex].id;
+    }
+    return list;
+}
+
+// Holds the list in memory; Set() plays the part of a registry write.
+class MemoryDistributionBackend : public DistributionBackend {
+public:
+    explicit MemoryDistributionBackend(DistributionList list = {}) : list_(std::move(list)) {}
+
+    bool Enumerate(DistributionList& list) override {
+        ++enumerations;
+        changed_ = false;
+        if (!available) {
+            return false;
+        }
+        list = list_;
+        return true;
+    }
+
+    bool Changed() override { return changed_; }
+
+    std::optional<uint64_t> Stamp() override { return generation_; }
+
+    void Set(DistributionList list) {
+        list_ = std::move(list);
+        changed_ = true;
+        ++generation_;
+    }
+
+    bool available = true;
+    size_t enumerations = 0;
+
+private:
+    DistributionList list_;
+    bool changed_ = true;
+    uint64_t generation_ = 1;
+};
+
+// One distribution per line, "id|name|basePath|version", with an optional
+// "default|id" line. Changes are noticed through the file's identity.
+class FileDistributionBackend : public DistributionBackend {
+public:
+    explicit FileDistributionBackend(std::string path) : path_(std::move(path)) {}
+
+    static void Write(const std::string& path, const DistributionList& list) {
+        std::wofstream file(path);
+        if (!list.defaultId.empty()) {
+            file << L"default|" << list.defaultId << L"\n";
+        }
+        for (const Distribution& distribution : list.distributions) {
+            file << distribution.id << L"|" << distribution.name << L"|" << distribution.basePath << L"|"
+                 << distribution.version << L"\n";
+        }
+    }
+
+    bool Enumerate(DistributionList& list) override {
+        identity_ = FileIdentity::Query(path_);
+        std::wifstream file(path_);
+        if (!identity_ || !file) {
+            return false;
+        }
+
+        std::wstring line;
+        while (std::getline(file, line)) {
+            std::vector<std::wstring> fields;
+            std::wstringstream stream(line);
+            for (std::wstring field; std::getline(stream, field, L'|');) {
+                fields.push_back(field);
+            }
+
+            if (fields.size() == 2 && fields[0] == L"default") {
+                list.defaultId = fields[1];
+            } else if (fields.size() == 4) {
+                list.distributions.push_back(
+                    {fields[0], fields[1], fields[2], static_cast<uint32_t>(std::stoul(fields[3]))});
+            }
+        }
+        return true;
+    }
+
+    bool Changed() override { return FileIdentity::Query(path_) != identity_; }
+
+    std::optional<uint64_t> Stamp() override {
+        auto identity = FileIdentity::Query(path_);
+        if (!identity) {
+            return std::nullopt;
+        }
+        return identity->modified ^ (identity->size << 1) ^ (identity->file << 7);
+    }
+
+private:
+    std::string path_;
+    std::optional<FileIdentity> identity_;
+};
+
+// What GetDistributionId() and IsDistributionInstalled() did on every call:
+// enumerate the whole store, then scan it.
+inline std::optional<Distribution> ReferenceFindByName(DistributionBackend& backend, const std::wstring& name) {
+    DistributionList list;
+    backend.Enumerate(list);
+    for (const Distribution& distribution : list.distributions) {
+        if (distribution.name == name) {
+            return distribution;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace WSL::Testing
@@ -0,0 +1,86 @@
+#pragma once
+
+// The std::regex parser WSLConfigManager used before WSL::ParseIni, kept
+// verbatim (minus the file I/O) as the oracle for differential tests, the
+// fuzzer and the benchmarks.
+
+#include "iniparser.h"
+
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace WSL::Testing {
+
+using IniTable = std::map<std::string, std::map<std::string, std::string>>;
+
+inline std::string ReferenceTrim(const std::string& str) {
+    size_t start = str.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return "";
+
+    size_t end = str.find_last_not_of(" \t\r\n");
+    return str.substr(start, end - start + 1);
+}
+
+inline IniTable ReferenceParseIni(const std::string& text) {
+    IniTable config;
+    std::istringstream file(text);
+
+    std::string line;
+    std::string currentSection;
+    std::regex sectionRegex(R"(\[([^\]]+)\])");
+    std::regex keyValueRegex(R"(([^=]+)=([^=]*))");
+    std::smatch matches;
+
+    while (std::getline(file, line)) {
+        size_t commentPos = line.find('#');
+        if (commentPos != std::string::npos) {
+            line = line.substr(0, commentPos);
+        }
+
+        line = ReferenceTrim(line);
+        if (line.empty()) continue;
+
+        if (std::regex_match(line, matches, sectionRegex)) {
+            currentSection = matches[1].str();
+            config[currentSection] = std::map<std::string, std::string>();
+        }
+        else if (std::regex_match(line, matches, keyValueRegex)) {
+            if (!currentSection.empty()) {
+                std::string key = ReferenceTrim(matches[1].str());
+                std::string value = ReferenceTrim(matches[2].str());
+                config[currentSection][key] = value;
+            }
+        }
+    }
+
+    return config;
+}
+
+// WSL::ParseIni into the same shape as the reference.
+class IniTableBuilder : public IniHandler {
+public:
+    void OnSection(std::string_view name) override {
+        current = &table[std::string(name)];
+        current->clear();
+    }
+
+    void OnValue(std::string_view, std::string_view key, std::string_view value) override {
+        (*current)[std::string(key)] = std::string(value);
+    }
+
+    IniTable table;
+
+private:
+    std::map<std::string, std::string>* current = nullptr;
+};
+
+inline IniTable ParseIniTable(std::string_view text) {
+    IniTableBuilder builder;
+    ParseIni(text, builder);
+    return std::move(builder.table);
+}
+
+} // namespace WSL::Testing
@@ -0,0 +1,222 @@
+#pragma once
+
+// An in-process stand-in for the LxssUserSession COM server: a pool of
+// worker threads that "create" processes and complete requests out of order,
+// so ServiceSession can be tested and benchmarked off Windows.
+
+#include "servicesession.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace WSL::Testing {
+
+class MockServiceTransport : public ServiceTransport {
+public:
+    struct Options {
+        size_t workers = 2;
+
+        // Paid once when the transport is created, as CoCreateInstance is.
+        std::chrono::nanoseconds connectTime{0};
+
+        // Round trip per CreateLxProcess. The client only waits on it, so
+        // it is slept rather than spun.
+        std::chrono::nanoseconds serviceTime{0};
+
+        // Hand back a real pipe per stdio stream, as the service does.
+        bool createPipes = false;
+
+        // Actually run request.command with request.arguments as argv and
+        // hand back its stdio pipes and a pidfd as the process handle.
+        bool spawn = false;
+
+        // Spawned processes only reach their command after this long, as a
+        // login shell does after sourcing its profile.
+        std::chrono::nanoseconds startupTime{0};
+
+        // Decides each request's status; success when unset.
+        std::function<int32_t(const LaunchRequest&)> handler;
+    };
+
+    explicit MockServiceTransport(Options options) : options_(std::move(options)) {
+        if (options_.connectTime.count() > 0) {
+            std::this_thread::sleep_for(options_.connectTime);
+        }
+        for (size_t i = 0; i < options_.workers; ++i) {
+            workers_.emplace_back(&MockServiceTransport::Work, this);
+        }
+    }
+
+    ~MockServiceTransport() override { Close(); }
+
+    void SetCompletion(Completion completion) override { completion_ = std::move(completion); }
+
+    bool Send(uint64_t id, LaunchRequest request) override {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_ || disconnected) {
+                return false;
+            }
+            queue_.emplace_back(id, std::move(request));
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+    void Close() override {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_) {
+                return;
+            }
+            closed_ = true;
+            queue_.clear();
+        }
+        ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    // Completes an id the session never issued, or one a second time.
+    void CompleteSpurious(uint64_t id) { completion_(id, LaunchResult()); }
+
+    // Holds every worker before it completes anything until Release().
+    void Hold() {
+        std::lock_guard<std::mutex> guard(lock_);
+        held_ = true;
+    }
+
+    void Release() {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            held_ = false;
+        }
+        ready_.notify_all();
+    }
+
+    bool disconnected = false;
+
+private:
+    void Work() {
+        for (;;) {
+            std::pair<uint64_t, LaunchRequest> request;
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+                ready_.wait(guard, [this] { return closed_ || (!held_ && !queue_.empty()); });
+                if (closed_) {
+                    return;
+                }
+                request = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            if (options_.serviceTime.count() > 0) {
+                std::this_thread::sleep_for(options_.serviceTime);
+            }
+
+            LaunchResult result;
+            if (options_.spawn) {
+                completion_(request.first, Spawn(request.second, options_.startupTime));
+                continue;
+            }
+            if (options_.handler) {
+                result.status = options_.handler(request.second);
+            }
+            if (result.Succeeded() && options_.createPipes) {
+                int fds[2];
+                for (NativeHandle* handle : {&result.input, &result.output, &result.error}) {
+                    if (pipe(fds) == 0) {
+                        close(fds[1]);
+                        *handle = fds[0];
+                    }
+                }
+            }
+            completion_(request.first, std::move(result));
+        }
+    }
+
+    static std::string Narrow(std::wstring_view text) { return std::string(text.begin(), text.end()); }
+
+    static LaunchResult Spawn(const LaunchRequest& request, std::chrono::nanoseconds startupTime) {
+        int input[2], output[2], error[2];
+        if (pipe2(input, O_CLOEXEC) != 0 || pipe2(output, O_CLOEXEC) != 0 || pipe2(error, O_CLOEXEC) != 0) {
+            return LaunchResult(static_cast<int32_t>(0x80004005)); // E_FAIL
+        }
+
+        std::vector<std::string> arguments;
+        for (std::wstring_view argument : request.arguments) {
+            arguments.push_back(Narrow(argument));
+        }
+        if (arguments.empty()) {
+            arguments.push_back(Narrow(request.command));
+        }
+        std::string program = Narrow(request.command);
+        if (startupTime.count() > 0) {
+            const double seconds = std::chrono::duration<double>(startupTime).count();
+            arguments[0] = program;
+            arguments.insert(arguments.begin(), {"/bin/sh", "-c", "sleep " + std::to_string(seconds) + "; exec \"$0\" \"$@\""});
+            program = "/bin/sh";
+        }
+        std::vector<char*> argv;
+        for (auto& argument : arguments) {
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, input[0], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, error[1], STDERR_FILENO);
+
+        pid_t pid = 0;
+        const int spawned = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        for (int fd : {input[0], output[1], error[1]}) {
+            close(fd);
+        }
+
+        LaunchResult result;
+        result.input = input[1];
+        result.output = output[0];
+        result.error = error[0];
+        if (spawned != 0) {
+            result.status = static_cast<int32_t>(0x80070000 | (spawned & 0xFFFF)); // HRESULT_FROM_WIN32-style
+            return result;
+        }
+
+        result.process = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (result.process < 0) {
+            waitpid(pid, nullptr, 0);
+            result.process = InvalidNativeHandle;
+        }
+        return result;
+    }
+
+    Options options_;
+    Completion completion_;
+    std::mutex lock_;
+    std::condition_variable ready_;
+    std::deque<std::pair<uint64_t, LaunchRequest>> queue_;
+    std::vector<std::thread> workers_;
+    bool closed_ = false;
+    bool held_ = false;
+};
+
+} // namespace WSL::Testing
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include "asynclog.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+class AsyncLogTest : public ::testing::Test {
+protected:
+    // Lines without the timestamp, thread and file, which vary.
+    static std::vector<std::string> Messages(const std::string& text) {
+        std::vector<std::string> messages;
+        size_t start = 0;
+        while (start < text.size()) {
+            const size_t end = text.find('\n', start);
+            const std::string line = text.substr(start, end - start);
+            const size_t level = line.find(' ') + 1;
+            const size_t site = line.find(".cpp:");
+            const size_t message = line.find(' ', site) + 1;
+            messages.push_back(line.substr(level, line.find(' ', level) - level) + " " + line.substr(message));
+            start = end + 1;
+        }
+        return messages;
+    }
+};
+
+TEST_F(AsyncLogTest, FormatsArgumentsOnTheWriterThread) {
+    StringSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.level = LogLevel::Trace});
+    logger.Install();
+
+    const std::string owned = "owned";
+    const std::wstring wide = L"wide é中";
+    WSL_LOG_INFO("plain");
+    WSL_LOG_INFO("%d %u %x %5.2f %s %ls %c 100%%", -3, 7u, 255, 3.14159, owned, wide, 'z');
+    WSL_LOG_WARNING("[%-6s] [%.3s] [%08x]", "left", "truncated", 0xBEEFu);
+    WSL_LOG_ERROR("failed: %s", static_cast<const char*>(nullptr));
+    logger.Flush();
+
+    EXPECT_EQ(Messages(sink.Data()),
+              (std::vector<std::string>{
+                  "INFO plain",
+                  "INFO -3 7 ff  3.14 owned wide é中 z 100%",
+                  "WARN [left  ] [tru] [0000beef]",
+                  "ERROR failed: (null)",
+              }));
+    EXPECT_EQ(logger.Written(), 4u);
+    EXPECT_EQ(logger.Dropped(), 0u);
+}
+
+TEST_F(AsyncLogTest, NegativeValuesKeepTheirWidth) {
+    StringSink text;
+    StringSink binary;
+    const auto log = [] {
+        WSL_LOG_ERROR("0x%08x %d %u %o", static_cast<int32_t>(0x80004005), static_cast<int32_t>(0x80004005),
+                      static_cast<int16_t>(-1), static_cast<int8_t>(-1));
+        WSL_LOG_ERROR("%llx %x", static_cast<int64_t>(-1), static_cast<int>(-2));
+    };
+    {
+        AsyncLogger logger(text, LogOutput::Text);
+        logger.Install();
+        log();
+    }
+    {
+        AsyncLogger logger(binary, LogOutput::Binary);
+        logger.Install();
+        log();
+    }
+
+    // As printf prints them.
+    const std::vector<std::string> expected = {
+        "ERROR 0x80004005 -2147467259 65535 377",
+        "ERROR ffffffffffffffff fffffffe",
+    };
+    EXPECT_EQ(Messages(text.Data()), expected);
+
+    StringSource source(binary.Data());
+    StringSink decoded;
+    DecodeBinaryLog(source, decoded);
+    EXPECT_EQ(Messages(decoded.Data()), expected);
+}
+
+TEST_F(AsyncLogTest, RespectsTheRuntimeLevel) {
+    StringSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.level = LogLevel::Warning});
+    logger.Install();
+
+    WSL_LOG_INFO("hidden");
+    WSL_LOG_WARNING("shown");
+    logger.SetLevel(LogLevel::Trace);
+    WSL_LOG_DEBUG("shown too");
+    logger.Flush();
+
+    EXPECT_EQ(Messages(sink.Data()), (std::vector<std::string>{"WARN shown", "DEBUG shown too"}));
+}
+
+TEST_F(AsyncLogTest, NothingIsRecordedWithoutALogger) {
+    WSL_LOG_ERROR("nobody is listening: %d", 1);
+
+    StringSink sink;
+    {
+        AsyncLogger logger(sink, LogOutput::Text);
+        logger.Install();
+        logger.Uninstall();
+        WSL_LOG_ERROR("uninstalled: %d", 2);
+    }
+    EXPECT_TRUE(sink.Data().empty());
+
+    // A thread that logged to an earlier logger moves on to the next one.
+    AsyncLogger logger(sink, LogOutput::Text);
+    logger.Install();
+    WSL_LOG_ERROR("second logger: %d", 3);
+    logger.Flush();
+    EXPECT_EQ(Messages(sink.Data()), (std::vector<std::string>{"ERROR second logger: 3"}));
+}
+
+TEST_F(AsyncLogTest, MergesThreadsInTimeOrder) {
+    StringSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.threadBufferSize = 1024 * 1024});
+    logger.Install();
+
+    constexpr int Threads = 4;
+    constexpr int PerThread = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < PerThread; ++i) {
+                WSL_LOG_INFO("thread %d record %d", t, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    logger.Flush();
+
+    EXPECT_EQ(logger.Written(), static_cast<uint64_t>(Threads * PerThread));
+
+    // Every thread's records arrive complete and in order.
+    std::vector<int> next(Threads, 0);
+    for (const auto& message : Messages(sink.Data())) {
+        int thread = -1;
+        int record = -1;
+        ASSERT_EQ(sscanf(message.c_str(), "INFO thread %d record %d", &thread, &record), 2) << message;
+        EXPECT_EQ(record, next[thread]++);
+    }
+    EXPECT_EQ(next, std::vector<int>(Threads, PerThread));
+}
+
+TEST_F(AsyncLogTest, DropsRatherThanBlocksWhenABufferIsFull) {
+    StringSink sink;
+    AsyncLogger logger(sink, LogOutput::Text, {.threadBufferSize = 4096, .flushInterval = std::chrono::hours(1)});
+    logger.Install();
+
+    for (int i = 0; i < 1000; ++i) {
+        WSL_LOG_INFO("record %d with some padding to fill the buffer", i);
+    }
+    logger.Flush();
+
+    EXPECT_GT(logger.Dropped(), 0u);
+    EXPECT_EQ(logger.Written() + logger.Dropped(), 1000u);
+}
+
+TEST_F(AsyncLogTest, BinaryLogDecodesToTheSameText) {
+    StringSink text;
+    StringSink binary;
+    {
+        AsyncLogger textLogger(text, LogOutput::Text);
+        textLogger.Install();
+        for (int i = 0; i < 3; ++i) {
+            WSL_LOG_ERROR("attempt %d of %s: 0x%08x", i, "launch", 0x80070002u);
+        }
+        WSL_LOG_INFO("%p %g", static_cast<void*>(nullptr), 0.5);
+    }
+    {
+        AsyncLogger binaryLogger(binary, LogOutput::Binary);
+        binaryLogger.Install();
+        for (int i = 0; i < 3; ++i) {
+            WSL_LOG_ERROR("attempt %d of %s: 0x%08x", i, "launch", 0x80070002u);
+        }
+        WSL_LOG_INFO("%p %g", static_cast<void*>(nullptr), 0.5);
+    }
+
+    // Each site's format is written once, however often it logs.
+    EXPECT_LT(binary.Data().size(), text.Data().size());
+
+    StringSource source(binary.Data());
+    StringSink decoded;
+    DecodeBinaryLog(source, decoded);
+    EXPECT_EQ(Messages(decoded.Data()), Messages(text.Data()));
+    EXPECT_EQ(Messages(decoded.Data()).back(), "INFO 0x0000000000000000 0.5");
+
+    // The line, level and file survive too.
+    EXPECT_NE(decoded.Data().find(" ERROR "), std::string::npos);
+    EXPECT_NE(decoded.Data().find("asynclog_tests.cpp:"), std::string::npos);
+
+    // Sessions appended to the same file decode one after another.
+    const std::string twice = binary.Data() + binary.Data();
+    StringSource appended(twice);
+    StringSink both;
+    DecodeBinaryLog(appended, both);
+    EXPECT_EQ(both.Data().size(), 2 * decoded.Data().size());
+
+    StringSource truncated(std::string_view(binary.Data()).substr(0, binary.Data().size() - 3));
+    EXPECT_THROW(DecodeBinaryLog(truncated, decoded), std::runtime_error);
+    StringSource garbage("not a log");
+    EXPECT_THROW(DecodeBinaryLog(garbage, decoded), std::runtime_error);
+}
+
+TEST_F(AsyncLogTest, FormatsAreCheckedAtCompileTime) {
+    // Each of these would fail to compile as a log call:
+    //     WSL_LOG_INFO("%d");              fewer arguments than conversions
+    //     WSL_LOG_INFO("%d", 1, 2);        more
+    //     WSL_LOG_INFO("%s", 1);           integer for a string
+    //     WSL_LOG_INFO("%s", L"wide");     wide string without %ls
+    //     WSL_LOG_INFO("%n", &count);      unsupported conversion
+    static_assert(LogDetail::NextConversion("a %-08.3lld b", 0).type == 'd');
+    static_assert(LogDetail::NextConversion("100%% %ls", 0).length == 'l');
+    static_assert(LogDetail::NextConversion("no conversions", 0).type == 0);
+    static_assert(std::is_constructible_v<LogFormat<int, const wchar_t*>, const char (&)[8]>);
+    SUCCEED();
+}
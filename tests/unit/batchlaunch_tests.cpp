@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include "batchlaunch.h"
+#include "../support/mock_service.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class BatchLaunchTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+    int output = -1;
+    int error = -1;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    ("wsl-batch-test-" + std::to_string(getpid()) + "-" +
+                     ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::create_directories(directory);
+        output = open((directory / "stdout").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        error = open((directory / "stderr").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    void TearDown() override {
+        close(output);
+        close(error);
+        std::filesystem::remove_all(directory);
+    }
+
+    static std::string ReadFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::ostringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+
+    static std::unique_ptr<ServiceSession> SpawningSession() {
+        MockServiceTransport::Options options;
+        options.workers = 4;
+        options.spawn = true;
+        return std::make_unique<ServiceSession>(std::make_unique<MockServiceTransport>(options));
+    }
+
+    static LaunchRequest Shared() {
+        LaunchRequest shared;
+        shared.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+        return shared;
+    }
+};
+
+TEST_F(BatchLaunchTest, ParsesTagsCommentsAndLineNumbers) {
+    auto jobs = ParseBatchJobs(L"# build everything\r\n"
+                               L"make -C lib\r\n"
+                               L"\n"
+                               L"  [tests]   ctest --output-on-failure  \n"
+                               L"echo [not a tag]");
+
+    ASSERT_EQ(jobs.size(), 3u);
+    EXPECT_EQ(jobs[0].tag, L"2");
+    EXPECT_EQ(jobs[0].command, L"make -C lib");
+    EXPECT_EQ(jobs[1].tag, L"tests");
+    EXPECT_EQ(jobs[1].command, L"ctest --output-on-failure");
+    EXPECT_EQ(jobs[2].tag, L"5");
+    EXPECT_EQ(jobs[2].command, L"echo [not a tag]");
+}
+
+TEST_F(BatchLaunchTest, RejectsMalformedJobs) {
+    EXPECT_THROW(ParseBatchJobs(L"[open echo"), std::invalid_argument);
+    EXPECT_THROW(ParseBatchJobs(L"[] echo"), std::invalid_argument);
+    EXPECT_THROW(ParseBatchJobs(L"[../escape] echo"), std::invalid_argument);
+    EXPECT_THROW(ParseBatchJobs(L"[only-a-tag]"), std::invalid_argument);
+    EXPECT_THROW(ParseBatchJobs(L"[a] echo 1\n[a] echo 2"), std::invalid_argument);
+
+    // An explicit tag can collide with another line's number.
+    EXPECT_THROW(ParseBatchJobs(L"[2] echo 1\necho 2"), std::invalid_argument);
+}
+
+TEST_F(BatchLaunchTest, ReportsPerJobExitCodes) {
+    auto session = SpawningSession();
+    BatchLauncher launcher(*session, Shared(), {});
+
+    auto results = launcher.Run(ParseBatchJobs(L"[ok] true\n[three] exit 3\n[missing] exec /nonexistent"), output, error);
+
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(results[0].tag, L"ok");
+    EXPECT_TRUE(results[0].Succeeded());
+    EXPECT_EQ(results[1].exitCode, 3);
+    EXPECT_EQ(results[2].exitCode, 127);
+    EXPECT_EQ(BatchExitCode(results), 3);
+}
+
+TEST_F(BatchLaunchTest, TaggedOutputKeepsEachJobTogether) {
+    auto session = SpawningSession();
+    BatchOptions options;
+    options.parallelism = 4;
+    BatchLauncher launcher(*session, Shared(), options);
+
+    std::wstring text;
+    for (int i = 0; i < 8; ++i) {
+        text += L"[job" + std::to_wstring(i) + L"] for n in 1 2 3; do echo line$n; done; echo oops >&2\n";
+    }
+    auto results = launcher.Run(ParseBatchJobs(text), output, error);
+    EXPECT_EQ(BatchExitCode(results), 0);
+
+    // Jobs finish in any order, but each one's lines arrive as a block.
+    std::istringstream lines(ReadFile(directory / "stdout"));
+    std::string line;
+    int count = 0;
+    std::string tag;
+    while (std::getline(lines, line)) {
+        const std::string prefix = line.substr(0, line.find(' '));
+        const int within = count++ % 3;
+        if (within == 0) {
+            tag = prefix;
+        }
+        EXPECT_EQ(prefix, tag);
+        EXPECT_EQ(line.substr(line.find(' ') + 1), "line" + std::to_string(within + 1));
+    }
+    EXPECT_EQ(count, 24);
+
+    const std::string errors = ReadFile(directory / "stderr");
+    EXPECT_NE(errors.find("[job0] oops\n"), std::string::npos);
+    EXPECT_NE(errors.find("[job7] oops\n"), std::string::npos);
+}
+
+TEST_F(BatchLaunchTest, FileOutputWritesOneFilePerStream) {
+    auto session = SpawningSession();
+    BatchOptions options;
+    options.output = BatchOutputMode::Files;
+    options.outputDirectory = (directory / "logs").string();
+    BatchLauncher launcher(*session, Shared(), options);
+
+    auto results = launcher.Run(ParseBatchJobs(L"[a] printf alpha\n[b] printf beta >&2; exit 1"), output, error);
+
+    EXPECT_EQ(ReadFile(directory / "logs" / "a.out"), "alpha");
+    EXPECT_EQ(ReadFile(directory / "logs" / "a.err"), "");
+    EXPECT_EQ(ReadFile(directory / "logs" / "b.err"), "beta");
+    EXPECT_EQ(ReadFile(directory / "stdout"), "");
+    EXPECT_EQ(BatchExitCode(results), 1);
+}
+
+TEST_F(BatchLaunchTest, RespectsParallelismLimit) {
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+
+    MockServiceTransport::Options service;
+    service.workers = 8;
+    service.createPipes = true;
+    service.handler = [&](const LaunchRequest&) {
+        const int now = ++running;
+        int seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        --running;
+        return 0;
+    };
+    ServiceSession session(std::make_unique<MockServiceTransport>(service));
+
+    BatchOptions options;
+    options.parallelism = 3;
+    BatchLauncher launcher(session, Shared(), options);
+
+    std::wstring text;
+    for (int i = 0; i < 30; ++i) {
+        text += L"true\n";
+    }
+    auto results = launcher.Run(ParseBatchJobs(text), output, error);
+
+    EXPECT_EQ(results.size(), 30u);
+    EXPECT_EQ(peak.load(), 3);
+    EXPECT_EQ(session.GetStats().launched, 30u);
+}
+
+TEST_F(BatchLaunchTest, LaunchFailuresAreReportedPerJob) {
+    MockServiceTransport::Options service;
+    service.createPipes = true;
+    service.handler = [](const LaunchRequest& request) {
+        return request.arguments.Back() == L"bad" ? static_cast<int32_t>(0x80070490) : 0;
+    };
+    ServiceSession session(std::make_unique<MockServiceTransport>(service));
+    BatchLauncher launcher(session, Shared(), {});
+
+    auto results = launcher.Run(ParseBatchJobs(L"[good] good\n[bad] bad"), output, error);
+
+    EXPECT_GE(results[0].status, 0);
+    EXPECT_EQ(results[1].status, static_cast<int32_t>(0x80070490));
+    EXPECT_FALSE(results[1].exitCode.has_value());
+    EXPECT_EQ(BatchExitCode(results), 1);
+}
+
+TEST_F(BatchLaunchTest, SharedStateComesFromTheTemplate) {
+    std::mutex lock;
+    std::vector<LaunchRequest> seen;
+
+    MockServiceTransport::Options service;
+    service.createPipes = true;
+    service.handler = [&](const LaunchRequest& request) {
+        std::lock_guard<std::mutex> guard(lock);
+        seen.push_back(request);
+        return 0;
+    };
+    ServiceSession session(std::make_unique<MockServiceTransport>(service));
+
+    LaunchRequest shared = Shared();
+    shared.environment = std::make_shared<EnvironmentSnapshot>(EnvironmentSnapshot::FromStrings({L"A=1", L"B=2"}));
+    shared.workingDirectory = L"/src";
+    shared.userName = L"builder";
+    BatchLauncher launcher(session, shared, {});
+    launcher.Run(ParseBatchJobs(L"echo one\necho two"), output, error);
+
+    ASSERT_EQ(seen.size(), 2u);
+    for (const auto& request : seen) {
+        EXPECT_EQ(request.distributionId, shared.distributionId);
+        EXPECT_EQ(request.environment, shared.environment);
+        EXPECT_EQ(request.workingDirectory, L"/src");
+        EXPECT_EQ(request.userName, L"builder");
+        EXPECT_EQ(request.command, L"/bin/sh");
+        ASSERT_EQ(request.arguments.Size(), 3u);
+        EXPECT_EQ(request.arguments[1], L"-c");
+    }
+}
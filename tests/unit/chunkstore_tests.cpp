@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "chunkstore.h"
+
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class ChunkStoreTest : public ::testing::Test {
+protected:
+    static constexpr ChunkerOptions Options{4 * 1024, 16 * 1024, 64 * 1024};
+
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_chunkstore_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    // Half random, half repetitive, like a filesystem image.
+    static std::string MakeImage(size_t size, unsigned seed = 1) {
+        std::mt19937 random(seed);
+        std::string data;
+        data.reserve(size);
+        while (data.size() < size) {
+            if (random() % 2) {
+                for (int i = 0; i < 512; ++i) {
+                    data += static_cast<char>(random());
+                }
+            }
+            else {
+                data += std::string(512, static_cast<char>('a' + random() % 26));
+            }
+        }
+        data.resize(size);
+        return data;
+    }
+
+    static SnapshotStats Snapshot(ChunkStore& store, const std::string& name, std::string_view data) {
+        SnapshotWriter writer(store, name, Options);
+        for (size_t offset = 0; offset < data.size(); offset += 50000) {
+            const auto piece = data.substr(offset, 50000);
+            writer.Write(piece.data(), piece.size());
+        }
+        writer.Finish();
+        return writer.Stats();
+    }
+
+    static std::string Restore(const ChunkStore& store, const std::string& name) {
+        StringSink sink;
+        store.Restore(store.LoadManifest(name), sink);
+        return sink.Data();
+    }
+};
+
+TEST_F(ChunkStoreTest, IdsAreSha256) {
+    const auto id = ChunkId::Of("abc", 3);
+    EXPECT_EQ(id.Hex(), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(ChunkId::FromHex(id.Hex()), id);
+    EXPECT_FALSE(ChunkId::FromHex("ba78"));
+    EXPECT_FALSE(ChunkId::FromHex(std::string(64, 'G')));
+}
+
+TEST_F(ChunkStoreTest, IncrementalSnapshotsStoreOnlyChanges) {
+    const std::string monday = MakeImage(3 * 1024 * 1024);
+    std::string tuesday = monday;
+    tuesday.replace(1024 * 1024, 5000, std::string(5000, '#'));
+    tuesday.insert(2 * 1024 * 1024, "new file contents");
+
+    ChunkStore store(directory);
+    const auto first = Snapshot(store, "monday", monday);
+    EXPECT_EQ(first.bytes, monday.size());
+    EXPECT_EQ(first.newBytes, first.bytes);
+    EXPECT_LT(first.storedBytes, first.newBytes); // the repetitive half compresses
+
+    const auto second = Snapshot(store, "tuesday", tuesday);
+    EXPECT_EQ(second.bytes, tuesday.size());
+    EXPECT_LE(second.newChunks, 6u);
+    EXPECT_LT(second.newBytes, tuesday.size() / 10);
+
+    // Nothing changed, nothing stored.
+    const auto third = Snapshot(store, "wednesday", tuesday);
+    EXPECT_EQ(third.newChunks, 0u);
+
+    EXPECT_EQ(store.Snapshots(), (std::vector<std::string>{"monday", "tuesday", "wednesday"}));
+    EXPECT_EQ(Restore(store, "monday"), monday);
+    EXPECT_EQ(Restore(store, "tuesday"), tuesday);
+}
+
+TEST_F(ChunkStoreTest, ReopenedStoreKnowsItsChunks) {
+    const std::string image = MakeImage(512 * 1024, 2);
+    size_t chunks = 0;
+    {
+        ChunkStore store(directory);
+        Snapshot(store, "first", image);
+        chunks = store.ChunkCount();
+    }
+
+    ChunkStore reopened(directory);
+    EXPECT_EQ(reopened.ChunkCount(), chunks);
+    EXPECT_EQ(Snapshot(reopened, "second", image).newChunks, 0u);
+    EXPECT_EQ(Restore(reopened, "first"), image);
+    EXPECT_EQ(reopened.LoadManifest("second").size, image.size());
+}
+
+TEST_F(ChunkStoreTest, DetectsDamage) {
+    const std::string image = MakeImage(256 * 1024, 3);
+    ChunkStore store(directory);
+    Snapshot(store, "snapshot", image);
+    const auto manifest = store.LoadManifest("snapshot");
+    ASSERT_GE(manifest.chunks.size(), 2u);
+
+    // A flipped bit in a stored chunk.
+    const std::string hex = manifest.chunks[1].id.Hex();
+    const auto path = directory / "chunks" / hex.substr(0, 2) / hex;
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(20);
+        file.put('\x7F');
+    }
+    EXPECT_THROW(Restore(store, "snapshot"), std::runtime_error);
+
+    // A missing one.
+    std::filesystem::remove(path);
+    EXPECT_THROW(Restore(store, "snapshot"), std::runtime_error);
+
+    // A truncated manifest.
+    std::filesystem::resize_file(directory / "snapshots" / "snapshot", 100);
+    EXPECT_THROW(store.LoadManifest("snapshot"), std::runtime_error);
+}
+
+TEST_F(ChunkStoreTest, RejectsUnsafeSnapshotNames) {
+    ChunkStore store(directory);
+    for (const char* name : {"", "../escape", "a/b", "a\\b", ".hidden", "c:name", "x.tmp"}) {
+        SnapshotWriter writer(store, name, Options);
+        writer.Write("data", 4);
+        EXPECT_THROW(writer.Finish(), std::invalid_argument) << name;
+    }
+    EXPECT_THROW(store.LoadManifest("../snapshots"), std::invalid_argument);
+}
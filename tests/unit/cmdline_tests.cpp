@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include "cmdline.h"
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class CommandLineTest : public ::testing::Test {
+protected:
+    static std::vector<std::wstring> Split(std::wstring_view commandLine, QuotingRules rules) {
+        std::vector<std::wstring> arguments;
+        for (std::wstring_view argument : TokenizeCommandLine(commandLine, rules)) {
+            arguments.emplace_back(argument);
+        }
+        return arguments;
+    }
+
+    // Arguments drawn mostly from the characters the rules treat specially.
+    static ArgumentVector RandomArguments(std::mt19937& random, bool windowsProgram) {
+        static constexpr std::wstring_view Alphabet = L"ab \t\n\"'\\$`#*;\x00e9";
+        ArgumentVector arguments;
+        if (windowsProgram) {
+            arguments.Append(random() % 2 ? L"C:\\Program Files\\tool.exe" : L"tool");
+        }
+        const size_t count = random() % 5;
+        for (size_t i = 0; i < count; ++i) {
+            std::wstring argument(random() % 8, L'\0');
+            for (wchar_t& c : argument) {
+                c = Alphabet[random() % Alphabet.size()];
+            }
+            arguments.Append(argument);
+        }
+        return arguments;
+    }
+};
+
+TEST_F(CommandLineTest, SplitsPosixWords) {
+    using Words = std::vector<std::wstring>;
+    EXPECT_EQ(Split(L"  ls   -la\t/tmp\n", QuotingRules::Posix), (Words{L"ls", L"-la", L"/tmp"}));
+    EXPECT_EQ(Split(L"echo 'a  b' \"c  d\"", QuotingRules::Posix), (Words{L"echo", L"a  b", L"c  d"}));
+    EXPECT_EQ(Split(L"echo '' \"\" x''y", QuotingRules::Posix), (Words{L"echo", L"", L"", L"xy"}));
+    EXPECT_EQ(Split(L"echo 'it'\\''s' \"say \\\"hi\\\"\"", QuotingRules::Posix), (Words{L"echo", L"it's", L"say \"hi\""}));
+    EXPECT_EQ(Split(L"echo \"\\$HOME \\n\" \\$HOME a\\ b", QuotingRules::Posix), (Words{L"echo", L"$HOME \\n", L"$HOME", L"a b"}));
+    EXPECT_EQ(Split(L"echo one\\\ntwo \\\n three", QuotingRules::Posix), (Words{L"echo", L"onetwo", L"three"}));
+    EXPECT_EQ(Split(L"echo $HOME *.txt # not a comment", QuotingRules::Posix),
+              (Words{L"echo", L"$HOME", L"*.txt", L"#", L"not", L"a", L"comment"}));
+    EXPECT_EQ(Split(L"trailing\\", QuotingRules::Posix), (Words{L"trailing\\"}));
+    EXPECT_TRUE(Split(L" \t\n", QuotingRules::Posix).empty());
+
+    EXPECT_THROW(TokenizeCommandLine(L"echo 'open", QuotingRules::Posix), std::invalid_argument);
+    EXPECT_THROW(TokenizeCommandLine(L"echo \"open\\\"", QuotingRules::Posix), std::invalid_argument);
+}
+
+// The examples from Microsoft's "Parsing C++ command-line arguments", with
+// CommandLineToArgvW's reading of "" inside quotes.
+TEST_F(CommandLineTest, SplitsLikeCommandLineToArgvW) {
+    using Words = std::vector<std::wstring>;
+    EXPECT_EQ(Split(L"prog \"abc\" d e", QuotingRules::Windows), (Words{L"prog", L"abc", L"d", L"e"}));
+    EXPECT_EQ(Split(L"prog a\\\\\\b d\"e f\"g h", QuotingRules::Windows), (Words{L"prog", L"a\\\\\\b", L"de fg", L"h"}));
+    EXPECT_EQ(Split(L"prog a\\\\\\\"b c d", QuotingRules::Windows), (Words{L"prog", L"a\\\"b", L"c", L"d"}));
+    EXPECT_EQ(Split(L"prog a\\\\\\\\\"b c\" d e", QuotingRules::Windows), (Words{L"prog", L"a\\\\b c", L"d", L"e"}));
+    EXPECT_EQ(Split(L"prog a\"b\"\" c d", QuotingRules::Windows), (Words{L"prog", L"ab\"", L"c", L"d"}));
+    EXPECT_EQ(Split(L"prog \"\" \"\"\" x \"\"\"\" y", QuotingRules::Windows),
+              (Words{L"prog", L"", L"\"", L"x", L"\" y"}));
+    EXPECT_EQ(Split(L"prog 'single quotes' are\nplain", QuotingRules::Windows),
+              (Words{L"prog", L"'single", L"quotes'", L"are\nplain"}));
+
+    // The program name takes backslashes literally and quotes only group.
+    EXPECT_EQ(Split(L"\"C:\\Program Files\\a\\\"b c", QuotingRules::Windows), (Words{L"C:\\Program Files\\a\\b", L"c"}));
+    EXPECT_EQ(Split(L"C:\\dir\\\"x y\"z w", QuotingRules::Windows), (Words{L"C:\\dir\\x yz", L"w"}));
+    EXPECT_EQ(Split(L"prog \"unterminated arg", QuotingRules::Windows), (Words{L"prog", L"unterminated arg"}));
+}
+
+TEST_F(CommandLineTest, ArgumentVectorIsOneTerminatedBuffer) {
+    ArgumentVector arguments{L"/bin/bash", L"-c", L"", L"echo hi"};
+    ASSERT_EQ(arguments.Size(), 4u);
+    EXPECT_EQ(arguments[0], L"/bin/bash");
+    EXPECT_EQ(arguments[2], L"");
+    EXPECT_EQ(arguments.Back(), L"echo hi");
+    EXPECT_EQ(std::wstring(arguments.CStr(1)), L"-c");
+    EXPECT_EQ(arguments.CStr(1), arguments.CStr(0) + 10);
+    EXPECT_EQ(arguments.Characters(), 10u + 3u + 1u + 8u);
+
+    std::vector<std::wstring_view> iterated(arguments.begin(), arguments.end());
+    EXPECT_EQ(iterated.size(), 4u);
+    EXPECT_EQ(iterated[3], L"echo hi");
+
+    EXPECT_EQ(arguments.Join(QuotingRules::Posix), L"/bin/bash -c '' 'echo hi'");
+    EXPECT_EQ(arguments.Join(QuotingRules::Windows), L"/bin/bash -c \"\" \"echo hi\"");
+}
+
+TEST_F(CommandLineTest, ReusesStorageOnceGrown) {
+    ArgumentVector arguments;
+    TokenizeCommandLine(L"a much longer command line with many words in it", QuotingRules::Posix, arguments);
+    const wchar_t* storage = arguments.CStr(0);
+
+    TokenizeCommandLine(L"short 'one'", QuotingRules::Posix, arguments);
+    ASSERT_EQ(arguments.Size(), 2u);
+    EXPECT_EQ(arguments.CStr(0), storage);
+    EXPECT_EQ(arguments[1], L"one");
+
+    TokenizeCommandLine(L"", QuotingRules::Windows, arguments);
+    EXPECT_TRUE(arguments.Empty());
+}
+
+TEST_F(CommandLineTest, QuotesForEitherRules) {
+    EXPECT_EQ(QuoteArgument(L"plain-word_1.txt", QuotingRules::Posix), L"plain-word_1.txt");
+    EXPECT_EQ(QuoteArgument(L"it's $HOME", QuotingRules::Posix), L"'it'\\''s $HOME'");
+    EXPECT_EQ(QuoteArgument(L"", QuotingRules::Posix), L"''");
+
+    EXPECT_EQ(QuoteArgument(L"C:\\dir\\", QuotingRules::Windows), L"C:\\dir\\");
+    EXPECT_EQ(QuoteArgument(L"C:\\my dir\\", QuotingRules::Windows), L"\"C:\\my dir\\\\\"");
+    EXPECT_EQ(QuoteArgument(L"say \\\"hi\"", QuotingRules::Windows), L"\"say \\\\\\\"hi\\\"\"");
+
+    EXPECT_THROW((ArgumentVector{L"a\"b"}.Join(QuotingRules::Windows)), std::invalid_argument);
+}
+
+// Random argvs survive Join() then TokenizeCommandLine() under both rules.
+TEST_F(CommandLineTest, RoundTripsRandomArguments) {
+    std::mt19937 random(20240611);
+    for (int i = 0; i < 20000; ++i) {
+        const bool windows = i % 2 == 1;
+        const QuotingRules rules = windows ? QuotingRules::Windows : QuotingRules::Posix;
+        const ArgumentVector arguments = RandomArguments(random, windows);
+        const std::wstring commandLine = arguments.Join(rules);
+        ASSERT_EQ(TokenizeCommandLine(commandLine, rules), arguments) << "command line: " << testing::PrintToString(commandLine);
+    }
+}
+
+// Arbitrary input either tokenizes to something that re-joins to the same
+// argv, or, under Posix rules only, is rejected as an unterminated quote.
+TEST_F(CommandLineTest, FuzzedInputIsStable) {
+    static constexpr std::wstring_view Alphabet = L"a \t\n\"'\\$";
+    std::mt19937 random(7);
+    ArgumentVector reused;
+    for (int i = 0; i < 20000; ++i) {
+        std::wstring commandLine(random() % 24, L'\0');
+        for (wchar_t& c : commandLine) {
+            c = Alphabet[random() % Alphabet.size()];
+        }
+
+        const QuotingRules rules = i % 2 ? QuotingRules::Windows : QuotingRules::Posix;
+        try {
+            TokenizeCommandLine(commandLine, rules, reused);
+        }
+        catch (const std::invalid_argument&) {
+            ASSERT_EQ(rules, QuotingRules::Posix);
+            continue;
+        }
+        ASSERT_LE(reused.Characters(), commandLine.size() + 1);
+
+        // A program name with a quote in it cannot be re-joined.
+        if (rules == QuotingRules::Windows && !reused.Empty() && reused[0].find(L'"') != std::wstring_view::npos) {
+            continue;
+        }
+        ASSERT_EQ(TokenizeCommandLine(reused.Join(rules), rules), reused)
+            << "command line: " << testing::PrintToString(commandLine);
+    }
+}
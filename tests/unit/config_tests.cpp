@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include "config.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+std::filesystem::path MakeTempDirectory() {
+    auto path = std::filesystem::temp_directory_path() /
+                ("wsl_config_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+} // namespace
+
+class WSLConfigManagerTest : public ::testing::Test {
+protected:
+    std::filesystem::path distribution;
+
+    void SetUp() override {
+        distribution = MakeTempDirectory();
+        std::filesystem::create_directories(distribution / "etc");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(distribution);
+    }
+
+    void WriteWslConf(const std::string& text) {
+        std::ofstream file(distribution / "etc" / "wsl.conf", std::ios::binary);
+        file << text;
+    }
+};
+
+TEST_F(WSLConfigManagerTest, LoadsWslConf) {
+    WriteWslConf(
+        "[boot]\r\n"
+        "systemd=true\r\n"
+        "[automount]\r\n"
+        "enabled = true   # mount fixed drives\r\n"
+        "root=/mnt\r\n");
+
+    WSLConfigManager config;
+    ASSERT_TRUE(config.LoadWslConfig(distribution.string()));
+
+    EXPECT_EQ(config.GetValue("boot", "systemd"), "true");
+    EXPECT_EQ(config.GetValue("automount", "enabled"), "true");
+    EXPECT_EQ(config.GetValue("automount", "root"), "/mnt");
+    EXPECT_EQ(config.GetValue("automount", "missing"), "");
+    EXPECT_TRUE(config.GetParseErrors().empty());
+}
+
+TEST_F(WSLConfigManagerTest, MissingFileFailsToLoad) {
+    WSLConfigManager config;
+    EXPECT_FALSE(config.LoadWslConfig((distribution / "nowhere").string()));
+}
+
+TEST_F(WSLConfigManagerTest, ReportsSkippedLines) {
+    WriteWslConf(
+        "[boot]\n"
+        "systemd\n"
+        "[network\n");
+
+    WSLConfigManager config;
+    ASSERT_TRUE(config.LoadWslConfig(distribution.string()));
+
+    const auto& errors = config.GetParseErrors();
+    ASSERT_EQ(errors.size(), 2u);
+    EXPECT_EQ(errors[0].line, 2u);
+    EXPECT_EQ(errors[1].line, 3u);
+    EXPECT_EQ(errors[1].message, "malformed section header");
+}
+
+TEST_F(WSLConfigManagerTest, CompilesGlobalSettingsOnLoad) {
+    // LoadGlobalConfig appends "\.wslconfig" to the profile path.
+    const std::string profile = (distribution / "profile").string();
+    {
+        std::ofstream file(profile + "\\.wslconfig", std::ios::binary);
+        file << "[wsl2]\nmemory=4GB\nnetworkingMode=bridged\nfirewall=nope\n";
+    }
+
+    WSLConfigManager config;
+    EXPECT_EQ(config.GetSettings().memoryBytes, 0u);
+    ASSERT_TRUE(config.LoadGlobalConfig(profile));
+
+    EXPECT_EQ(config.GetSettings().memoryBytes, 4ull << 30);
+    EXPECT_EQ(config.GetSettings().networkingMode, WSL::NetworkingMode::Bridged);
+    EXPECT_TRUE(config.GetSettings().firewall);
+    ASSERT_EQ(config.GetSettingIssues().size(), 1u);
+    EXPECT_EQ(config.GetSettingIssues()[0].key, "firewall");
+}
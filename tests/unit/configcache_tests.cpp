@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "configcache.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+class ConfigCacheTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+    std::string path;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::pair<std::string, ConfigCache::Snapshot>> notifications;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_configcache_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+        path = (directory / ".wslconfig").string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    void WriteInPlace(const std::string& text) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    // How most editors save: write a sibling, then rename it over the file.
+    void WriteAndRename(const std::string& text) {
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            file << text;
+        }
+        std::filesystem::rename(temporary, path);
+    }
+
+    ConfigCache::SectionCallback Record(const std::string& section) {
+        return [this, section](const ConfigCache::Snapshot& snapshot) {
+            std::lock_guard<std::mutex> guard(lock);
+            notifications.emplace_back(section, snapshot);
+            changed.notify_all();
+        };
+    }
+
+    bool WaitForNotifications(size_t count) {
+        std::unique_lock<std::mutex> guard(lock);
+        return changed.wait_for(guard, std::chrono::seconds(5), [&] { return notifications.size() >= count; });
+    }
+};
+
+TEST_F(ConfigCacheTest, IdentityTracksContent) {
+    EXPECT_FALSE(FileIdentity::Query(path));
+
+    WriteInPlace("[wsl2]\nmemory=4GB\n");
+    auto first = FileIdentity::Query(path);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first, FileIdentity::Query(path));
+
+    WriteInPlace("[wsl2]\nmemory=16GB\n");
+    auto second = FileIdentity::Query(path);
+    ASSERT_TRUE(second);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first->file, second->file);
+
+    WriteAndRename("[wsl2]\nmemory=16GB\n");
+    auto replaced = FileIdentity::Query(path);
+    ASSERT_TRUE(replaced);
+    EXPECT_NE(second->file, replaced->file);
+}
+
+TEST_F(ConfigCacheTest, UnchangedFileReturnsSameSnapshot) {
+    WriteInPlace("[wsl2]\nmemory=4GB\n");
+
+    ConfigCache cache;
+    auto first = cache.Get(path);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first->GetValue("wsl2", "memory"), "4GB");
+
+    auto second = cache.Get(path);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.GetStats().reloads, 1u);
+    EXPECT_EQ(cache.GetStats().hits, 1u);
+}
+
+TEST_F(ConfigCacheTest, ChangedFileIsReparsed) {
+    WriteInPlace("[wsl2]\nmemory=4GB\n");
+
+    ConfigCache cache;
+    auto first = cache.Get(path);
+    WriteInPlace("[wsl2]\nmemory=16GB\n");
+    auto second = cache.Get(path);
+
+    ASSERT_TRUE(second);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(second->GetValue("wsl2", "memory"), "16GB");
+
+    // The old snapshot owns its text and is unaffected.
+    EXPECT_EQ(first->GetValue("wsl2", "memory"), "4GB");
+}
+
+TEST_F(ConfigCacheTest, MissingFileComesAndGoes) {
+    ConfigCache cache;
+    EXPECT_EQ(cache.Get(path), nullptr);
+
+    WriteInPlace("[boot]\nsystemd=true\n");
+    auto snapshot = cache.Get(path);
+    ASSERT_TRUE(snapshot);
+    EXPECT_EQ(snapshot->GetValue("boot", "systemd"), "true");
+
+    std::filesystem::remove(path);
+    EXPECT_EQ(cache.Get(path), nullptr);
+}
+
+TEST_F(ConfigCacheTest, ChangedSections) {
+    auto before = ConfigStore::FromText("[a]\nx=1\n[b]\ny=2\n[c]\nz=3\n");
+    auto after = ConfigStore::FromText("[a]\nx=1\n[b]\ny=20\n[d]\nw=4\n");
+
+    EXPECT_EQ(ConfigCache::ChangedSections(before.get(), after.get()), (std::vector<std::string>{"b", "c", "d"}));
+    EXPECT_TRUE(ConfigCache::ChangedSections(before.get(), before.get()).empty());
+    EXPECT_EQ(ConfigCache::ChangedSections(nullptr, before.get()), (std::vector<std::string>{"a", "b", "c"}));
+    EXPECT_EQ(ConfigCache::ChangedSections(after.get(), nullptr), (std::vector<std::string>{"a", "b", "d"}));
+}
+
+TEST_F(ConfigCacheTest, WatchedFileReloadsInBackground) {
+    WriteInPlace("[wsl2]\nmemory=4GB\n[boot]\nsystemd=true\n");
+
+    ConfigCache cache;
+    ASSERT_TRUE(cache.Watch(path));
+    cache.Subscribe(path, "wsl2", Record("wsl2"));
+    cache.Subscribe(path, "boot", Record("boot"));
+
+    auto first = cache.Get(path);
+    ASSERT_TRUE(first);
+    const uint64_t reloads = cache.GetStats().reloads;
+
+    WriteAndRename("[wsl2]\nmemory=16GB\n[boot]\nsystemd=true\n");
+    ASSERT_TRUE(WaitForNotifications(1));
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ASSERT_EQ(notifications.size(), 1u);
+        EXPECT_EQ(notifications[0].first, "wsl2");
+        ASSERT_TRUE(notifications[0].second);
+        EXPECT_EQ(notifications[0].second->GetValue("wsl2", "memory"), "16GB");
+    }
+
+    // Served from the swapped snapshot without another reload.
+    auto second = cache.Get(path);
+    EXPECT_EQ(second->GetValue("wsl2", "memory"), "16GB");
+    EXPECT_EQ(cache.GetStats().reloads, reloads + 1);
+}
+
+TEST_F(ConfigCacheTest, WatchedInPlaceWriteAndDelete) {
+    WriteInPlace("[boot]\nsystemd=true\n");
+
+    ConfigCache cache;
+    ASSERT_TRUE(cache.Watch(path));
+    const uint64_t id = cache.Subscribe(path, "boot", Record("boot"));
+
+    WriteInPlace("[boot]\nsystemd=false\n");
+    ASSERT_TRUE(WaitForNotifications(1));
+    EXPECT_EQ(cache.Get(path)->GetValue("boot", "systemd"), "false");
+
+    std::filesystem::remove(path);
+    ASSERT_TRUE(WaitForNotifications(2));
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        EXPECT_EQ(notifications[1].second, nullptr);
+    }
+    EXPECT_EQ(cache.Get(path), nullptr);
+
+    cache.Unsubscribe(id);
+    WriteInPlace("[boot]\nsystemd=true\n");
+    for (int i = 0; i < 500 && !cache.Get(path); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(cache.Get(path));
+
+    std::lock_guard<std::mutex> guard(lock);
+    EXPECT_EQ(notifications.size(), 2u);
+}
+
+TEST_F(ConfigCacheTest, LostDirectoryFallsBackToIdentity) {
+    const std::filesystem::path nested = directory / "profile";
+    std::filesystem::create_directories(nested);
+    path = (nested / ".wslconfig").string();
+    WriteInPlace("[boot]\nsystemd=true\n");
+
+    ConfigCache cache;
+    ASSERT_TRUE(cache.Watch(path));
+    ASSERT_TRUE(cache.Get(path));
+
+    // The new directory is not watched, so only an identity check sees the
+    // file in it.
+    std::filesystem::remove_all(nested);
+    std::filesystem::create_directories(nested);
+    WriteInPlace("[boot]\nsystemd=false\n");
+    for (int i = 0; i < 500 && !cache.Get(path); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(cache.Get(path));
+    EXPECT_EQ(cache.Get(path)->GetValue("boot", "systemd"), "false");
+
+    // Watching again picks up where the lost watch left off.
+    ASSERT_TRUE(cache.Watch(path));
+    WriteInPlace("[boot]\nsystemd=true\n");
+    for (int i = 0; i < 500 && cache.Get(path)->GetValue("boot", "systemd") != "true"; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(cache.Get(path)->GetValue("boot", "systemd"), "true");
+}
+
+TEST_F(ConfigCacheTest, UnwatchableDirectoryFallsBackToIdentity) {
+    ConfigCache cache;
+    const std::string nowhere = (directory / "missing" / ".wslconfig").string();
+    EXPECT_FALSE(cache.Watch(nowhere));
+    EXPECT_EQ(cache.Get(nowhere), nullptr);
+}
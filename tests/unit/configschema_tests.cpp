@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "configschema.h"
+
+using namespace WSL;
+
+class ConfigSchemaTest : public ::testing::Test {
+protected:
+    static CompiledSettings Compile(const std::string& text, uint32_t hostProcessors = 8) {
+        auto store = ConfigStore::FromText(text);
+        return CompileSettings(*store, SettingsLimits{hostProcessors});
+    }
+};
+
+TEST_F(ConfigSchemaTest, ParsesMemorySizes) {
+    EXPECT_EQ(ParseMemorySize("4096"), 4096u);
+    EXPECT_EQ(ParseMemorySize("512B"), 512u);
+    EXPECT_EQ(ParseMemorySize("64KB"), 64u << 10);
+    EXPECT_EQ(ParseMemorySize("512MB"), 512u << 20);
+    EXPECT_EQ(ParseMemorySize("8GB"), 8ull << 30);
+
+    EXPECT_FALSE(ParseMemorySize(""));
+    EXPECT_FALSE(ParseMemorySize("GB"));
+    EXPECT_FALSE(ParseMemorySize("8 GB"));
+    EXPECT_FALSE(ParseMemorySize("8gb"));
+    EXPECT_FALSE(ParseMemorySize("8TB"));
+    EXPECT_FALSE(ParseMemorySize("-1GB"));
+    EXPECT_FALSE(ParseMemorySize("99999999999999999999"));
+    EXPECT_FALSE(ParseMemorySize("17179869184GB"));
+}
+
+TEST_F(ConfigSchemaTest, MapsNetworkingModes) {
+    for (const NetworkingModeName& entry : NetworkingModeNames) {
+        EXPECT_EQ(ParseNetworkingMode(entry.name), entry.mode);
+        EXPECT_EQ(NetworkingModeToString(entry.mode), entry.name);
+    }
+    EXPECT_FALSE(ParseNetworkingMode("nat"));
+    EXPECT_FALSE(ParseNetworkingMode("vpn"));
+}
+
+TEST_F(ConfigSchemaTest, CompilesTypedSettings) {
+    auto compiled = Compile(
+        "[wsl2]\n"
+        "memory=8GB\n"
+        "swap=0\n"
+        "processors=4\n"
+        "networkingMode=mirrored\n"
+        "localhostForwarding=false\n"
+        "dnsTunneling=true\n"
+        "[boot]\n"
+        "systemd=true\n");
+
+    EXPECT_TRUE(compiled.issues.empty());
+    const WslSettings& settings = compiled.settings;
+    EXPECT_EQ(settings.memoryBytes, 8ull << 30);
+    EXPECT_EQ(settings.swapBytes, 0u);
+    EXPECT_EQ(settings.processors, 4u);
+    EXPECT_EQ(settings.networkingMode, NetworkingMode::Mirrored);
+    EXPECT_FALSE(settings.localhostForwarding);
+    EXPECT_TRUE(settings.dnsTunneling);
+    EXPECT_TRUE(settings.firewall);
+}
+
+TEST_F(ConfigSchemaTest, MissingFileKeepsDefaults) {
+    auto compiled = Compile("");
+    const WslSettings defaults;
+    EXPECT_EQ(compiled.settings.memoryBytes, defaults.memoryBytes);
+    EXPECT_EQ(compiled.settings.networkingMode, defaults.networkingMode);
+    EXPECT_EQ(compiled.settings.guiApplications, defaults.guiApplications);
+    EXPECT_TRUE(compiled.issues.empty());
+}
+
+TEST_F(ConfigSchemaTest, ReportsInvalidValuesWithLocation) {
+    auto compiled = Compile(
+        "[wsl2]\n"
+        "memory=lots\n"
+        "processors = 64\n"
+        "networkingMode=vpn\n"
+        "firewall=maybe\n");
+
+    ASSERT_EQ(compiled.issues.size(), 4u);
+
+    // Issues come out in schema order.
+    EXPECT_EQ(compiled.issues[0].key, "memory");
+    EXPECT_EQ(compiled.issues[0].value, "lots");
+    EXPECT_EQ(compiled.issues[0].line, 2u);
+    EXPECT_EQ(compiled.issues[0].column, 8u);
+
+    EXPECT_EQ(compiled.issues[1].key, "processors");
+    EXPECT_EQ(compiled.issues[1].line, 3u);
+    EXPECT_EQ(compiled.issues[1].column, 14u);
+    EXPECT_NE(compiled.issues[1].message.find("8 logical processors"), std::string::npos);
+
+    EXPECT_EQ(compiled.issues[2].key, "networkingMode");
+    EXPECT_EQ(compiled.issues[3].key, "firewall");
+
+    // Rejected values fall back to the defaults.
+    const WslSettings defaults;
+    EXPECT_EQ(compiled.settings.memoryBytes, defaults.memoryBytes);
+    EXPECT_EQ(compiled.settings.processors, defaults.processors);
+    EXPECT_EQ(compiled.settings.networkingMode, defaults.networkingMode);
+    EXPECT_EQ(compiled.settings.firewall, defaults.firewall);
+}
+
+TEST_F(ConfigSchemaTest, ProcessorLimits) {
+    EXPECT_EQ(Compile("[wsl2]\nprocessors=0\n").issues.size(), 1u);
+    EXPECT_EQ(Compile("[wsl2]\nprocessors=8\n").settings.processors, 8u);
+    EXPECT_EQ(Compile("[wsl2]\nprocessors=9\n").issues.size(), 1u);
+
+    // No host limit known.
+    EXPECT_EQ(Compile("[wsl2]\nprocessors=512\n", 0).settings.processors, 512u);
+}
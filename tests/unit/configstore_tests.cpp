@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include "configstore.h"
+#include "../support/ini_reference.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class ConfigStoreTest : public ::testing::Test {
+protected:
+    std::filesystem::path path;
+
+    void SetUp() override {
+        path = std::filesystem::temp_directory_path() /
+               (std::string("wsl_configstore_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    void WriteFile(const std::string& text) {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    // The flat index must hold exactly what the old nested maps held.
+    static void ExpectMatchesReference(const std::string& text) {
+        auto store = ConfigStore::FromText(text);
+
+        IniTable flattened;
+        for (const ConfigEntry& entry : store->Entries()) {
+            flattened[std::string(entry.section)][std::string(entry.key)] = std::string(entry.value);
+        }
+
+        IniTable reference = ReferenceParseIni(text);
+        std::erase_if(reference, [](const auto& section) { return section.second.empty(); });
+        EXPECT_EQ(flattened, reference) << "input: " << text;
+    }
+};
+
+TEST_F(ConfigStoreTest, MapsFileAndLooksUpValues) {
+    WriteFile(
+        "[wsl2]\n"
+        "memory=8GB\n"
+        "processors = 4\n"
+        "[boot]\n"
+        "systemd=true\n");
+
+    auto store = ConfigStore::Open(path.string());
+    ASSERT_TRUE(store);
+
+    EXPECT_EQ(store->GetValue("wsl2", "memory"), "8GB");
+    EXPECT_EQ(store->GetValue("wsl2", "processors"), "4");
+    EXPECT_EQ(store->GetValue("boot", "systemd"), "true");
+    EXPECT_EQ(store->Find("boot", "memory"), nullptr);
+    EXPECT_EQ(store->Find("network", "memory"), nullptr);
+
+    // Values are views into the mapping, not copies.
+    const std::string_view text = store->Text();
+    const std::string_view* memory = store->Find("wsl2", "memory");
+    ASSERT_NE(memory, nullptr);
+    EXPECT_GE(memory->data(), text.data());
+    EXPECT_LE(memory->data() + memory->size(), text.data() + text.size());
+}
+
+TEST_F(ConfigStoreTest, MissingAndEmptyFiles) {
+    EXPECT_FALSE(ConfigStore::Open(path.string()));
+
+    WriteFile("");
+    auto store = ConfigStore::Open(path.string());
+    ASSERT_TRUE(store);
+    EXPECT_TRUE(store->Entries().empty());
+}
+
+TEST_F(ConfigStoreTest, LastDeclarationWins) {
+    auto store = ConfigStore::FromText(
+        "[wsl2]\n"
+        "memory=1GB\n"
+        "swap=0\n"
+        "[boot]\n"
+        "systemd=false\n"
+        "systemd=true\n"
+        "[wsl2]\n"
+        "memory=2GB\n");
+
+    EXPECT_EQ(store->GetValue("wsl2", "memory"), "2GB");
+    EXPECT_EQ(store->Find("wsl2", "swap"), nullptr);
+    EXPECT_EQ(store->GetValue("boot", "systemd"), "true");
+    EXPECT_EQ(store->Entries().size(), 2u);
+}
+
+TEST_F(ConfigStoreTest, SectionReturnsSortedKeys) {
+    auto store = ConfigStore::FromText(
+        "[b]\n"
+        "z=1\n"
+        "[a]\n"
+        "y=2\n"
+        "[b]\n"
+        "k=3\n"
+        "m=4\n");
+
+    auto section = store->Section("b");
+    ASSERT_EQ(section.size(), 2u);
+    EXPECT_EQ(section[0].key, "k");
+    EXPECT_EQ(section[1].key, "m");
+    EXPECT_TRUE(store->Section("c").empty());
+}
+
+TEST_F(ConfigStoreTest, MatchesReferenceOnRandomInput) {
+    const std::string alphabet = "[]=#abc \n";
+    std::mt19937 random(99);
+    std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+    std::uniform_int_distribution<size_t> length(0, 96);
+
+    for (int i = 0; i < 3000 && !HasFailure(); ++i) {
+        std::string text(length(random), ' ');
+        for (char& c : text) {
+            c = alphabet[pick(random)];
+        }
+        ExpectMatchesReference(text);
+    }
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include "contentchunker.h"
+
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class ContentChunkerTest : public ::testing::Test {
+protected:
+    static constexpr ChunkerOptions Options{4 * 1024, 16 * 1024, 64 * 1024};
+
+    static std::string RandomData(size_t size, unsigned seed = 1) {
+        std::mt19937 random(seed);
+        std::string data(size, '\0');
+        for (char& c : data) {
+            c = static_cast<char>(random());
+        }
+        return data;
+    }
+
+    static std::vector<std::string> Chunk(std::string_view data, size_t writeSize, ChunkerOptions options = Options) {
+        std::vector<std::string> chunks;
+        ContentChunker chunker([&](const char* chunk, size_t size) { chunks.emplace_back(chunk, size); }, options);
+        for (size_t offset = 0; offset < data.size(); offset += writeSize) {
+            const auto piece = data.substr(offset, writeSize);
+            chunker.Write(piece.data(), piece.size());
+        }
+        chunker.Finish();
+        return chunks;
+    }
+};
+
+TEST_F(ContentChunkerTest, ChunksCoverTheStreamWithinBounds) {
+    const std::string data = RandomData(2 * 1024 * 1024);
+    const auto chunks = Chunk(data, 100000);
+
+    std::string joined;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        joined += chunks[i];
+        EXPECT_LE(chunks[i].size(), Options.maxSize);
+        if (i + 1 < chunks.size()) {
+            EXPECT_GE(chunks[i].size(), Options.minSize);
+        }
+    }
+    EXPECT_EQ(joined, data);
+
+    // Normalized chunking keeps the mean near the target.
+    const double mean = static_cast<double>(data.size()) / static_cast<double>(chunks.size());
+    EXPECT_GT(mean, Options.averageSize * 0.5);
+    EXPECT_LT(mean, Options.averageSize * 2.0);
+}
+
+TEST_F(ContentChunkerTest, BoundariesDoNotDependOnWriteSizes) {
+    const std::string data = RandomData(512 * 1024, 2);
+    const auto expected = Chunk(data, data.size());
+    EXPECT_EQ(Chunk(data, 1), expected);
+    EXPECT_EQ(Chunk(data, 4095), expected);
+    EXPECT_EQ(Chunk(data, 65537), expected);
+}
+
+TEST_F(ContentChunkerTest, EditsOnlyDisturbNearbyChunks) {
+    const std::string original = RandomData(4 * 1024 * 1024, 3);
+    std::string edited = original;
+    edited.insert(100 * 1024, "a few inserted bytes");
+    edited.erase(3 * 1024 * 1024, 777);
+
+    const auto before = Chunk(original, 1 << 20);
+    const auto after = Chunk(edited, 1 << 20);
+    const std::set<std::string> known(before.begin(), before.end());
+    size_t shared = 0;
+    for (const auto& chunk : after) {
+        shared += known.count(chunk);
+    }
+    // Each edit costs a chunk or two; fixed-size blocks would lose all of
+    // them after the insertion.
+    EXPECT_GE(shared + 6, after.size());
+}
+
+TEST_F(ContentChunkerTest, HandlesShortAndEmptyStreams) {
+    EXPECT_TRUE(Chunk("", 1).empty());
+    const auto chunks = Chunk("short", 2);
+    ASSERT_EQ(chunks.size(), 1u);
+    EXPECT_EQ(chunks[0], "short");
+
+    // Data with no boundary in it is cut at the maximum.
+    const std::string zeros(3 * Options.maxSize + 10, '\0');
+    const auto forced = Chunk(zeros, 1000);
+    ASSERT_EQ(forced.size(), 4u);
+    EXPECT_EQ(forced[0].size(), Options.maxSize);
+    EXPECT_EQ(forced[3].size(), 10u);
+}
+
+TEST_F(ContentChunkerTest, RejectsBadOptions) {
+    const auto callback = [](const char*, size_t) {};
+    EXPECT_THROW(ContentChunker(callback, ChunkerOptions{1024, 3000, 8192}), std::invalid_argument);
+    EXPECT_THROW(ContentChunker(callback, ChunkerOptions{8192, 4096, 16384}), std::invalid_argument);
+    EXPECT_THROW(ContentChunker(callback, ChunkerOptions{1024, 4096, 2048}), std::invalid_argument);
+}
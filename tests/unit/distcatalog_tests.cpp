@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+#include "distcatalog.h"
+#include "../support/fake_distributions.h"
+
+#include <filesystem>
+#include <thread>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class DistributionCatalogTest : public ::testing::Test {
+protected:
+    MemoryDistributionBackend* backend = nullptr;
+
+    std::unique_ptr<DistributionCatalog> MakeCatalog(DistributionList list) {
+        auto owned = std::make_unique<MemoryDistributionBackend>(std::move(list));
+        backend = owned.get();
+        return std::make_unique<DistributionCatalog>(std::move(owned));
+    }
+};
+
+TEST_F(DistributionCatalogTest, IndexesByNameAndId) {
+    DistributionList list;
+    list.distributions = {
+        {L"{0283592D-BE56-40D4-B935-3FC18C3AA007}", L"Ubuntu", L"C:\\WSL\\Ubuntu", 2},
+        {L"{8B1B4D54-CB37-4C6E-8D44-42B0F4C9E0A1}", L"Debian", L"C:\\WSL\\Debian", 1},
+    };
+    list.defaultId = L"{8b1b4d54-cb37-4c6e-8d44-42b0f4c9e0a1}";
+    auto catalog = MakeCatalog(std::move(list));
+
+    auto snapshot = catalog->Snapshot();
+    ASSERT_EQ(snapshot->All().size(), 2u);
+
+    const Distribution* ubuntu = snapshot->FindByName(L"Ubuntu");
+    ASSERT_NE(ubuntu, nullptr);
+    EXPECT_EQ(ubuntu->basePath, L"C:\\WSL\\Ubuntu");
+    EXPECT_EQ(snapshot->FindByName(L"ubuntu"), nullptr);
+
+    EXPECT_EQ(snapshot->FindById(L"{0283592d-be56-40d4-b935-3fc18c3aa007}"), ubuntu);
+    EXPECT_EQ(snapshot->FindById(L"0283592D-BE56-40D4-B935-3FC18C3AA007"), ubuntu);
+    EXPECT_EQ(snapshot->FindById(L"{00000000-0000-0000-0000-000000000000}"), nullptr);
+
+    // The default GUID resolves to its real name.
+    ASSERT_NE(snapshot->Default(), nullptr);
+    EXPECT_EQ(snapshot->Default()->name, L"Debian");
+    EXPECT_EQ(snapshot->Default()->version, 1u);
+}
+
+TEST_F(DistributionCatalogTest, DanglingOrMissingDefault) {
+    DistributionList list = MakeDistributions(3, 3);
+    EXPECT_EQ(MakeCatalog(list)->Snapshot()->Default(), nullptr);
+
+    list.defaultId = L"{FFFFFFFF-0000-4000-8000-000000000000}";
+    EXPECT_EQ(MakeCatalog(list)->Snapshot()->Default(), nullptr);
+}
+
+TEST_F(DistributionCatalogTest, EnumeratesOnceUntilChanged) {
+    auto catalog = MakeCatalog(MakeDistributions(4));
+
+    auto first = catalog->Snapshot();
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(catalog->Snapshot(), first);
+    }
+    EXPECT_EQ(backend->enumerations, 1u);
+
+    backend->Set(MakeDistributions(5, 4));
+    auto second = catalog->Snapshot();
+    EXPECT_NE(second, first);
+    EXPECT_EQ(second->All().size(), 5u);
+    EXPECT_EQ(second->Default()->name, L"Distro-4");
+    EXPECT_EQ(backend->enumerations, 2u);
+
+    // Old snapshots stay valid for whoever holds them.
+    EXPECT_EQ(first->All().size(), 4u);
+
+    catalog->Invalidate();
+    catalog->Snapshot();
+    EXPECT_EQ(catalog->GetEnumerationCount(), 3u);
+}
+
+TEST_F(DistributionCatalogTest, UnavailableStoreIsEmpty) {
+    auto catalog = MakeCatalog(MakeDistributions(2));
+    backend->available = false;
+
+    auto snapshot = catalog->Snapshot();
+    EXPECT_TRUE(snapshot->All().empty());
+    EXPECT_EQ(snapshot->Default(), nullptr);
+}
+
+TEST_F(DistributionCatalogTest, ThousandsOfDistributions) {
+    const size_t count = 5000;
+    auto catalog = MakeCatalog(MakeDistributions(count, count - 1));
+    auto snapshot = catalog->Snapshot();
+
+    for (size_t i = 0; i < count; i += 97) {
+        const Distribution* byName = snapshot->FindByName(L"Distro-" + std::to_wstring(i));
+        ASSERT_NE(byName, nullptr);
+        EXPECT_EQ(snapshot->FindById(MakeDistributionId(i)), byName);
+    }
+    EXPECT_EQ(snapshot->Default()->name, L"Distro-4999");
+    EXPECT_EQ(snapshot->FindByName(L"Distro-5000"), nullptr);
+}
+
+TEST_F(DistributionCatalogTest, DuplicateNamesResolveToFirst) {
+    DistributionList list = MakeDistributions(3);
+    list.distributions[2].name = list.distributions[1].name;
+    auto snapshot = MakeCatalog(list)->Snapshot();
+
+    EXPECT_EQ(snapshot->FindByName(L"Distro-1")->id, list.distributions[1].id);
+}
+
+TEST_F(DistributionCatalogTest, FileBackedStore) {
+    const std::string path = (std::filesystem::temp_directory_path() / "wsl_distcatalog_store.txt").string();
+    FileDistributionBackend::Write(path, MakeDistributions(1000, 10));
+
+    DistributionCatalog catalog(std::make_unique<FileDistributionBackend>(path));
+    auto first = catalog.Snapshot();
+    ASSERT_EQ(first->All().size(), 1000u);
+    EXPECT_EQ(first->Default()->name, L"Distro-10");
+    EXPECT_EQ(catalog.Snapshot(), first);
+
+    FileDistributionBackend::Write(path, MakeDistributions(1001, 20));
+    auto second = catalog.Snapshot();
+    EXPECT_EQ(second->All().size(), 1001u);
+    EXPECT_EQ(second->Default()->name, L"Distro-20");
+    EXPECT_EQ(catalog.GetEnumerationCount(), 2u);
+
+    std::filesystem::remove(path);
+}
+
+TEST_F(DistributionCatalogTest, ConcurrentReaders) {
+    auto catalog = MakeCatalog(MakeDistributions(100, 50));
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&catalog] {
+            for (int i = 0; i < 1000; ++i) {
+                auto snapshot = catalog->Snapshot();
+                ASSERT_NE(snapshot->Default(), nullptr);
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(backend->enumerations, 1u);
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "envsnapshot.h"
+
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class EnvironmentSnapshotTest : public ::testing::Test {
+protected:
+    static std::shared_ptr<const EnvironmentSnapshot> Share(EnvironmentSnapshot snapshot) {
+        return std::make_shared<const EnvironmentSnapshot>(std::move(snapshot));
+    }
+
+    static std::vector<std::wstring> Entries(const EnvironmentSnapshot& snapshot) {
+        std::vector<std::wstring> entries;
+        for (size_t i = 0; i < snapshot.Size(); ++i) {
+            entries.emplace_back(snapshot.Entry(i));
+        }
+        return entries;
+    }
+};
+
+TEST_F(EnvironmentSnapshotTest, ParsesAnEnvironmentBlock) {
+    const wchar_t block[] = L"=C:=C:\\Windows\0PATH=C:\\bin;C:\\tools\0HOME=\0A=b=c\0\0";
+    EnvironmentSnapshot snapshot = EnvironmentSnapshot::FromBlock(block);
+
+    ASSERT_EQ(snapshot.Size(), 3u);
+    EXPECT_EQ(snapshot[0].name, L"A");
+    EXPECT_EQ(snapshot[0].value, L"b=c");
+    EXPECT_EQ(snapshot[1].name, L"HOME");
+    EXPECT_EQ(snapshot[1].value, L"");
+    EXPECT_EQ(std::wstring(snapshot.Entry(2)), L"PATH=C:\\bin;C:\\tools");
+
+    EXPECT_EQ(snapshot.Find(L"PATH"), L"C:\\bin;C:\\tools");
+    EXPECT_FALSE(snapshot.Find(L"path").has_value());
+    EXPECT_FALSE(snapshot.Find(L"=C:").has_value());
+    EXPECT_TRUE(EnvironmentSnapshot::FromBlock(L"\0").Empty());
+}
+
+TEST_F(EnvironmentSnapshotTest, HashIgnoresOrderButNotContent) {
+    auto first = EnvironmentSnapshot::FromStrings({L"A=1", L"B=2"});
+    auto reordered = EnvironmentSnapshot::FromStrings({L"B=2", L"A=1"});
+    auto changed = EnvironmentSnapshot::FromStrings({L"A=1", L"B=3"});
+    auto moved = EnvironmentSnapshot::FromStrings({L"A=1B", L"=2"});
+
+    EXPECT_EQ(first.Hash(), reordered.Hash());
+    EXPECT_NE(first.Hash(), changed.Hash());
+    EXPECT_NE(first.Hash(), moved.Hash());
+
+    // First of duplicate names wins.
+    EXPECT_EQ(EnvironmentSnapshot::FromStrings({L"A=1", L"A=2"}).Find(L"A"), L"1");
+}
+
+TEST_F(EnvironmentSnapshotTest, TranslatesWindowsPaths) {
+    EXPECT_EQ(TranslateWindowsPath(L"C:\\Users\\me"), L"/mnt/c/Users/me");
+    EXPECT_EQ(TranslateWindowsPath(L"d:/src/"), L"/mnt/d/src");
+    EXPECT_EQ(TranslateWindowsPath(L"C:\\"), L"/mnt/c");
+    EXPECT_EQ(TranslateWindowsPath(L"relative\\dir"), L"relative/dir");
+}
+
+TEST_F(EnvironmentSnapshotTest, AppliesWslEnvFlags) {
+    auto windows = EnvironmentSnapshot::FromStrings({
+        L"USERPROFILE=C:\\Users\\me",
+        L"TOOLS=C:\\bin;D:\\tools",
+        L"LINUXONLY=x",
+        L"WINDOWSONLY=y",
+        L"OTHER=z",
+        L"WSLENV=USERPROFILE/p:tools/l:LINUXONLY/u:WINDOWSONLY/w",
+    });
+    auto filter = EnvironmentFilter::FromWslEnv(*windows.Find(L"WSLENV"));
+    auto translated = filter.Apply(windows);
+
+    EXPECT_EQ(translated.Find(L"USERPROFILE"), L"/mnt/c/Users/me");
+    EXPECT_EQ(translated.Find(L"TOOLS"), L"/mnt/c/bin:/mnt/d/tools");
+    EXPECT_EQ(translated.Find(L"LINUXONLY"), L"x");
+    EXPECT_FALSE(translated.Find(L"WINDOWSONLY").has_value());
+    EXPECT_EQ(translated.Find(L"OTHER"), L"z");
+
+    filter.SetStrict(true);
+    filter.Allow(L"OTH*");
+    filter.Deny(L"linuxonly");
+    translated = filter.Apply(windows);
+    EXPECT_EQ(Entries(translated),
+              (std::vector<std::wstring>{L"OTHER=z", L"TOOLS=/mnt/c/bin:/mnt/d/tools", L"USERPROFILE=/mnt/c/Users/me",
+                                         L"WSLENV=USERPROFILE/p:tools/l:LINUXONLY/u:WINDOWSONLY/w"}));
+}
+
+TEST_F(EnvironmentSnapshotTest, DeltaRoundTrips) {
+    auto base = EnvironmentSnapshot::FromStrings({L"A=1", L"B=2", L"C=3", L"E=5"});
+    auto target = EnvironmentSnapshot::FromStrings({L"0=new", L"B=2", L"C=changed", L"D=4", L"F=6"});
+
+    EnvironmentDelta delta = DiffEnvironment(base, target);
+    EXPECT_EQ(delta.set, (std::vector<std::wstring>{L"0=new", L"C=changed", L"D=4", L"F=6"}));
+    EXPECT_EQ(delta.removed, (std::vector<std::wstring>{L"A", L"E"}));
+
+    auto applied = ApplyEnvironmentDelta(base, delta);
+    ASSERT_TRUE(applied.has_value());
+    EXPECT_EQ(Entries(*applied), Entries(target));
+    EXPECT_EQ(applied->Hash(), target.Hash());
+
+    // Against the wrong base it refuses rather than guessing.
+    EXPECT_FALSE(ApplyEnvironmentDelta(target, delta).has_value());
+}
+
+TEST_F(EnvironmentSnapshotTest, UnchangedEnvironmentSendsOnlyAHash) {
+    auto base = EnvironmentSnapshot::FromStrings({L"A=1"});
+    EnvironmentDelta delta = DiffEnvironment(base, EnvironmentSnapshot::FromStrings({L"A=1"}));
+    EXPECT_TRUE(delta.set.empty());
+    EXPECT_TRUE(delta.removed.empty());
+    EXPECT_EQ(delta.Characters(), 0u);
+}
+
+TEST_F(EnvironmentSnapshotTest, SessionBaselineProtocol) {
+    std::vector<std::wstring> entries;
+    for (int i = 0; i < 100; ++i) {
+        entries.push_back(L"VARIABLE" + std::to_wstring(i) + L"=" + std::wstring(50, L'x'));
+    }
+    auto first = Share(EnvironmentSnapshot::FromStrings(entries));
+    entries[10] = L"VARIABLE10=changed";
+    auto second = Share(EnvironmentSnapshot::FromStrings(entries));
+
+    EnvironmentEncoder client;
+    EnvironmentBaseline service;
+
+    // First launch: the whole block.
+    EnvironmentMessage message = client.Encode(first);
+    ASSERT_TRUE(message.full);
+    EXPECT_EQ(service.Receive(message)->Hash(), first->Hash());
+    client.Acknowledge(message.full);
+
+    // Same environment: nothing but the hash.
+    message = client.Encode(first);
+    ASSERT_FALSE(message.full);
+    EXPECT_EQ(message.Characters(), 0u);
+    EXPECT_EQ(service.Receive(message)->Hash(), first->Hash());
+
+    // One variable changed: only that crosses.
+    message = client.Encode(second);
+    ASSERT_TRUE(message.delta);
+    EXPECT_EQ(message.delta->set, (std::vector<std::wstring>{L"VARIABLE10=changed"}));
+    EXPECT_LT(message.Characters() * 50, second->Characters());
+    EXPECT_EQ(service.Receive(message)->Hash(), second->Hash());
+
+    // A service that lost its baseline refuses the delta; the client resends.
+    EnvironmentBaseline restarted;
+    EXPECT_EQ(restarted.Receive(message), nullptr);
+    client.Reset();
+    message = client.Encode(second);
+    ASSERT_TRUE(message.full);
+    EXPECT_EQ(restarted.Receive(message)->Hash(), second->Hash());
+}
+
+TEST_F(EnvironmentSnapshotTest, LargeChangesResendInFull) {
+    auto first = Share(EnvironmentSnapshot::FromStrings({L"A=1", L"B=2"}));
+    auto second = Share(EnvironmentSnapshot::FromStrings({L"C=3", L"D=4"}));
+
+    EnvironmentEncoder client;
+    client.Acknowledge(first);
+    EXPECT_TRUE(client.Encode(second).full);
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "iniparser.h"
+#include "../support/ini_reference.h"
+
+#include <random>
+#include <string>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class IniParserTest : public ::testing::Test {
+protected:
+    static void ExpectMatchesReference(const std::string& text) {
+        EXPECT_EQ(ParseIniTable(text), ReferenceParseIni(text)) << "input: " << text;
+    }
+};
+
+TEST_F(IniParserTest, ParsesSectionsKeysAndComments) {
+    const std::string text =
+        "# leading comment\n"
+        "[boot]\n"
+        "systemd = true   # trailing comment\n"
+        "\n"
+        "[automount]\r\n"
+        "  enabled=true\r\n"
+        "root=/mnt\n";
+
+    IniTable table = ParseIniTable(text);
+    EXPECT_EQ(table["boot"]["systemd"], "true");
+    EXPECT_EQ(table["automount"]["enabled"], "true");
+    EXPECT_EQ(table["automount"]["root"], "/mnt");
+    ExpectMatchesReference(text);
+}
+
+TEST_F(IniParserTest, KeepsRegexParserQuirks) {
+    // Redeclared sections start over, header names are not trimmed, lines
+    // with two '=' and keys before any section are dropped, and '#' cuts a
+    // value short.
+    const std::string text =
+        "orphan=1\n"
+        "[wsl2]\n"
+        "memory=4GB\n"
+        "[ wsl2 ]\n"
+        "swap=0\n"
+        "[wsl2]\n"
+        "processors=2\n"
+        "kernelCommandLine=a=b\n"
+        "empty=\n"
+        "color=#fff\n"
+        "[a=b]\n"
+        "[x]=y\n";
+
+    IniTable table = ParseIniTable(text);
+    EXPECT_EQ(table["wsl2"].size(), 3u);
+    EXPECT_EQ(table["wsl2"]["processors"], "2");
+    EXPECT_EQ(table["wsl2"]["empty"], "");
+    EXPECT_EQ(table["wsl2"]["color"], "");
+    EXPECT_EQ(table[" wsl2 "]["swap"], "0");
+    EXPECT_EQ(table["a=b"]["[x]"], "y");
+    ExpectMatchesReference(text);
+}
+
+TEST_F(IniParserTest, ReportsSkippedLinesWithPosition) {
+    const std::string text =
+        "stray=1\n"
+        "[boot\n"
+        "[boot]\n"
+        "  justakey\n"
+        "a=b=c\n"
+        "  = value\n";
+
+    std::vector<IniError> errors = ValidateIni(text);
+    ASSERT_EQ(errors.size(), 5u);
+
+    EXPECT_EQ(errors[0].line, 1u);
+    EXPECT_EQ(errors[0].column, 1u);
+    EXPECT_EQ(errors[0].message, "key outside of any section");
+
+    EXPECT_EQ(errors[1].line, 2u);
+    EXPECT_EQ(errors[1].message, "malformed section header");
+
+    EXPECT_EQ(errors[2].line, 4u);
+    EXPECT_EQ(errors[2].column, 3u);
+
+    EXPECT_EQ(errors[3].line, 5u);
+    EXPECT_EQ(errors[3].column, 4u);
+    EXPECT_EQ(errors[3].message, "unexpected second '='");
+
+    EXPECT_EQ(errors[4].line, 6u);
+    EXPECT_EQ(errors[4].column, 3u);
+}
+
+TEST_F(IniParserTest, HandlesEdgesOfInput) {
+    for (const char* text : {"", "\n", "[s]", "[s]\nk=v", "[s]\nk=v\n\n", "[]\n", "[s]\n=\n", "[s]\nk\t=\tv\t\r"}) {
+        ExpectMatchesReference(text);
+    }
+}
+
+TEST_F(IniParserTest, MatchesReferenceOnRandomInput) {
+    // Small alphabet so the interesting characters collide often.
+    const std::string alphabet = "[]=#ab \t\r\n";
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+    std::uniform_int_distribution<size_t> length(0, 64);
+
+    for (int i = 0; i < 5000; ++i) {
+        std::string text(length(random), ' ');
+        for (char& c : text) {
+            c = alphabet[pick(random)];
+        }
+        ExpectMatchesReference(text);
+        if (HasFailure()) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "metrics.h"
+#include "relaysession.h"
+#include "servicesession.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace WSL;
+
+class MetricsTest : public ::testing::Test {
+protected:
+    std::string segment;
+
+    void SetUp() override {
+        segment = std::string("WSLMetricsTest-") + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        MetricsRegistry::Unlink(segment);
+    }
+
+    void TearDown() override {
+        MetricsRegistry::Unlink(segment);
+    }
+};
+
+TEST_F(MetricsTest, CountersSumAcrossThreads) {
+    MetricsRegistry registry;
+    EXPECT_FALSE(registry.IsShared());
+
+    constexpr int Threads = 8;
+    constexpr int PerThread = 10000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&registry] {
+            for (int j = 0; j < PerThread; ++j) {
+                registry.Add(Metric::Launches);
+                registry.Add(Metric::RelayOutputBytes, 3);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const MetricsSnapshot snapshot = registry.Snapshot();
+    EXPECT_EQ(snapshot.Get(Metric::Launches).value, Threads * PerThread);
+    EXPECT_EQ(snapshot.Get(Metric::RelayOutputBytes).value, 3 * Threads * PerThread);
+    EXPECT_EQ(snapshot.Get(Metric::LaunchFailures).value, 0);
+}
+
+TEST_F(MetricsTest, HistogramPercentilesStayWithinABucket) {
+    MetricsRegistry registry;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        registry.Record(Metric::LaunchLatency, value * 1000);
+    }
+
+    const HistogramSummary histogram = registry.Snapshot().Get(Metric::LaunchLatency).histogram;
+    EXPECT_EQ(histogram.count, 1000u);
+    EXPECT_EQ(histogram.sum, 500500u * 1000);
+    EXPECT_EQ(histogram.max, 1000000u);
+
+    // Reported as the bucket's upper bound: never below, at most 1/8 above.
+    auto near = [](uint64_t reported, uint64_t exact) {
+        EXPECT_GE(reported, exact);
+        EXPECT_LE(reported, exact + exact / 8);
+    };
+    near(histogram.p50, 500000);
+    near(histogram.p90, 900000);
+    near(histogram.p99, 990000);
+
+    // Small values are exact, and huge ones are clamped rather than lost.
+    MetricsRegistry small;
+    small.Record(Metric::LaunchLatency, 0);
+    small.Record(Metric::LaunchLatency, 5);
+    small.Record(Metric::LaunchLatency, UINT64_MAX / 2);
+    const HistogramSummary edges = small.Snapshot().Get(Metric::LaunchLatency).histogram;
+    EXPECT_EQ(edges.count, 3u);
+    EXPECT_EQ(edges.p50, 5u);
+    EXPECT_EQ(edges.p99, UINT64_MAX / 2);
+}
+
+TEST_F(MetricsTest, ReadersSeeEveryPublisherThroughTheSegment) {
+    EXPECT_FALSE(MetricsRegistry::Read(segment).has_value());
+
+    // Two registries on one segment stand in for two processes.
+    MetricsRegistry first(segment);
+    MetricsRegistry second(segment);
+    ASSERT_TRUE(first.IsShared());
+    ASSERT_TRUE(second.IsShared());
+
+    first.Add(Metric::ConfigReloads, 2);
+    second.Add(Metric::ConfigReloads, 5);
+    second.Record(Metric::LaunchLatency, 2000000);
+
+    auto snapshot = MetricsRegistry::Read(segment);
+    ASSERT_TRUE(snapshot.has_value());
+    EXPECT_EQ(snapshot->Get(Metric::ConfigReloads).value, 7);
+    EXPECT_EQ(snapshot->Get(Metric::LaunchLatency).histogram.count, 1u);
+    EXPECT_EQ(first.Snapshot().Get(Metric::ConfigReloads).value, 7);
+}
+
+TEST_F(MetricsTest, FormatsTextAndJson) {
+    MetricsRegistry registry;
+    registry.Add(Metric::Launches, 4);
+    registry.Record(Metric::LaunchLatency, 1500000);
+
+    const MetricsSnapshot snapshot = registry.Snapshot();
+    const std::string text = snapshot.Format();
+    EXPECT_NE(text.find("launches"), std::string::npos);
+    EXPECT_NE(text.find("relay_stalls"), std::string::npos);
+    EXPECT_NE(text.find("max 1.500 ms"), std::string::npos);
+
+    const std::string json = snapshot.FormatJson();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(), '}');
+    EXPECT_NE(json.find("\"launches\":4,"), std::string::npos);
+    EXPECT_NE(json.find("\"launch_latency\":{\"count\":1,\"sum_ns\":1500000,"), std::string::npos);
+    EXPECT_NE(json.find("\"max_ns\":1500000}"), std::string::npos);
+}
+
+namespace {
+
+class ImmediateTransport : public ServiceTransport {
+public:
+    void SetCompletion(Completion completion) override { completion_ = std::move(completion); }
+
+    bool Send(uint64_t id, LaunchRequest request) override {
+        completion_(id, LaunchResult(request.command == L"fail" ? LaunchAborted : 0));
+        return true;
+    }
+
+    void Close() override {}
+
+private:
+    Completion completion_;
+};
+
+} // namespace
+
+TEST_F(MetricsTest, ServiceSessionPublishesLaunches) {
+    MetricsRegistry registry;
+    {
+        ServiceSession session(std::make_unique<ImmediateTransport>(), &registry);
+        LaunchRequest request;
+        request.command = L"true";
+        session.Launch(std::move(request)).get();
+        request.command = L"fail";
+        session.Launch(std::move(request)).get();
+    }
+
+    const MetricsSnapshot snapshot = registry.Snapshot();
+    EXPECT_EQ(snapshot.Get(Metric::Launches).value, 2);
+    EXPECT_EQ(snapshot.Get(Metric::LaunchFailures).value, 1);
+    EXPECT_EQ(snapshot.Get(Metric::LaunchLatency).histogram.count, 2u);
+}
+
+#ifndef _WIN32
+
+TEST_F(MetricsTest, RelaySessionPublishesBytesPerStream) {
+    // Pipes stand in for the process' output and the console.
+    int processOutput[2], processError[2], consoleOutput[2], consoleError[2];
+    ASSERT_EQ(pipe(processOutput), 0);
+    ASSERT_EQ(pipe(processError), 0);
+    ASSERT_EQ(pipe(consoleOutput), 0);
+    ASSERT_EQ(pipe(consoleError), 0);
+
+    ASSERT_EQ(write(processOutput[1], "hello", 5), 5);
+    ASSERT_EQ(write(processError[1], "oops!!", 6), 6);
+    close(processOutput[1]);
+    close(processError[1]);
+
+    RelaySessionHandles handles;
+    handles.processOutput = processOutput[0];
+    handles.processError = processError[0];
+    handles.consoleOutput = consoleOutput[1];
+    handles.consoleError = consoleError[1];
+
+    MetricsRegistry registry;
+    {
+        RelaySession session(handles, RelayMode::Latency, &registry);
+        EXPECT_EQ(session.Run(), RelayResult::Completed);
+    }
+
+    const MetricsSnapshot snapshot = registry.Snapshot();
+    EXPECT_EQ(snapshot.Get(Metric::RelayOutputBytes).value, 5);
+    EXPECT_EQ(snapshot.Get(Metric::RelayErrorBytes).value, 6);
+    EXPECT_EQ(snapshot.Get(Metric::RelayInputBytes).value, 0);
+
+    for (int fd : {processOutput[0], processError[0], consoleOutput[0], consoleOutput[1], consoleError[0],
+                   consoleError[1]}) {
+        close(fd);
+    }
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "parallelgzip.h"
+
+#include <zlib.h>
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class ParallelGzipTest : public ::testing::Test {
+protected:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    // Text-like data, so chunks compress but not to nothing.
+    static std::string MakeData(size_t size, unsigned seed = 1) {
+        static constexpr std::string_view Words[] = {"usr ", "bin ", "lib ", "etc/", "wsl ", "\n", "0x", "conf "};
+        std::mt19937 random(seed);
+        std::string data;
+        data.reserve(size + 8);
+        while (data.size() < size) {
+            if (random() % 4 == 0) {
+                data += static_cast<char>(random());
+            }
+            else {
+                data += Words[random() % std::size(Words)];
+            }
+        }
+        data.resize(size);
+        return data;
+    }
+
+    static std::string Compress(std::string_view data, GzipOptions options = {}, size_t writeSize = 10000) {
+        StringSink sink;
+        GzipCompressor compressor(sink, std::move(options));
+        for (size_t offset = 0; offset < data.size(); offset += writeSize) {
+            const auto piece = data.substr(offset, writeSize);
+            compressor.Write(piece.data(), piece.size());
+        }
+        compressor.Finish();
+        return sink.Data();
+    }
+
+    static std::string Decompress(std::string_view archive, GzipOptions options = {}) {
+        StringSource source(archive);
+        StringSink sink;
+        GzipDecompress(source, sink, std::move(options));
+        return sink.Data();
+    }
+
+    // What a stock gzip reader makes of the stream.
+    static std::string ZlibInflate(std::string_view archive) {
+        z_stream stream{};
+        EXPECT_EQ(inflateInit2(&stream, 16 + MAX_WBITS), Z_OK);
+        std::string result;
+        std::vector<char> buffer(64 * 1024);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(archive.data()));
+        stream.avail_in = static_cast<uInt>(archive.size());
+        for (;;) {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            stream.avail_out = static_cast<uInt>(buffer.size());
+            const int status = inflate(&stream, Z_NO_FLUSH);
+            result.append(buffer.data(), buffer.size() - stream.avail_out);
+            if (status == Z_STREAM_END) {
+                if (stream.avail_in == 0) {
+                    break;
+                }
+                inflateReset(&stream);
+                continue;
+            }
+            if (status != Z_OK) {
+                ADD_FAILURE() << "inflate failed: " << status;
+                break;
+            }
+        }
+        inflateEnd(&stream);
+        return result;
+    }
+
+    static GzipOptions Options(size_t workers) {
+        GzipOptions options;
+        options.chunkSize = ChunkSize;
+        options.workers = workers;
+        return options;
+    }
+};
+
+TEST_F(ParallelGzipTest, RoundTripsAcrossChunkBoundaries) {
+    for (const size_t size : {size_t{0}, size_t{1}, ChunkSize - 1, ChunkSize, ChunkSize + 1, 10 * ChunkSize + 123}) {
+        const std::string data = MakeData(size);
+        for (const size_t workers : {1, 4}) {
+            const std::string archive = Compress(data, Options(workers));
+            EXPECT_EQ(Decompress(archive, Options(workers)), data) << size << " bytes, " << workers << " workers";
+        }
+    }
+}
+
+TEST_F(ParallelGzipTest, OutputIsOrdinaryGzip) {
+    const std::string data = MakeData(5 * ChunkSize + 17);
+    const std::string archive = Compress(data, Options(3));
+    ASSERT_GE(archive.size(), 2u);
+    EXPECT_EQ(static_cast<unsigned char>(archive[0]), 0x1F);
+    EXPECT_EQ(static_cast<unsigned char>(archive[1]), 0x8B);
+    EXPECT_LT(archive.size(), data.size());
+    EXPECT_EQ(ZlibInflate(archive), data);
+}
+
+TEST_F(ParallelGzipTest, OutputDoesNotDependOnWorkersOrWriteSizes) {
+    const std::string data = MakeData(7 * ChunkSize + 5);
+    const std::string expected = Compress(data, Options(1), 1 << 20);
+    EXPECT_EQ(Compress(data, Options(4), 1), expected);
+    EXPECT_EQ(Compress(data, Options(2), ChunkSize), expected);
+}
+
+TEST_F(ParallelGzipTest, ReadsPlainGzipAndUncompressedInput) {
+    const std::string data = MakeData(3 * ChunkSize);
+
+    // Two members, as gzip writes when files are concatenated.
+    std::string plain;
+    for (const std::string_view half : {std::string_view(data).substr(0, ChunkSize), std::string_view(data).substr(ChunkSize)}) {
+        z_stream stream{};
+        ASSERT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+        std::string member(deflateBound(&stream, static_cast<uLong>(half.size())), '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(half.data()));
+        stream.avail_in = static_cast<uInt>(half.size());
+        stream.next_out = reinterpret_cast<Bytef*>(member.data());
+        stream.avail_out = static_cast<uInt>(member.size());
+        ASSERT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        member.resize(stream.total_out);
+        deflateEnd(&stream);
+        plain += member;
+    }
+    EXPECT_EQ(Decompress(plain), data);
+
+    EXPECT_EQ(Decompress(data), data);
+    EXPECT_EQ(Decompress(""), "");
+}
+
+TEST_F(ParallelGzipTest, NamesTheCorruptChunk) {
+    const std::string data = MakeData(6 * ChunkSize);
+    const std::string archive = Compress(data, Options(2));
+
+    // Find the fourth member through the lengths the header records.
+    size_t offset = 0;
+    for (int member = 0; member < 3; ++member) {
+        uint32_t length = 0;
+        for (int i = 0; i < 4; ++i) {
+            length |= static_cast<uint32_t>(static_cast<unsigned char>(archive[offset + 16 + i])) << (8 * i);
+        }
+        offset += length;
+    }
+
+    std::string corrupt = archive;
+    corrupt[offset + 40] ^= 0x55;
+    try {
+        Decompress(corrupt, Options(2));
+        FAIL() << "corruption was not detected";
+    }
+    catch (const std::runtime_error& error) {
+        EXPECT_NE(std::string(error.what()).find("chunk 3"), std::string::npos) << error.what();
+    }
+
+    EXPECT_THROW(Decompress(std::string_view(archive).substr(0, archive.size() - 100), Options(2)),
+                 std::runtime_error);
+}
+
+TEST_F(ParallelGzipTest, ReportsProgressPerChunk) {
+    const std::string data = MakeData(8 * ChunkSize + 1);
+    std::vector<StreamProgress> reports;
+    GzipOptions options = Options(2);
+    options.progress = [&](const StreamProgress& progress) { reports.push_back(progress); };
+
+    const std::string archive = Compress(data, options);
+    ASSERT_EQ(reports.size(), 9u);
+    for (size_t i = 1; i < reports.size(); ++i) {
+        EXPECT_EQ(reports[i].chunks, i + 1);
+        EXPECT_GT(reports[i].inputBytes, reports[i - 1].inputBytes);
+    }
+    EXPECT_EQ(reports.back().inputBytes, data.size());
+    EXPECT_EQ(reports.back().outputBytes, archive.size());
+
+    reports.clear();
+    EXPECT_EQ(Decompress(archive, options), data);
+    ASSERT_EQ(reports.size(), 9u);
+    EXPECT_EQ(reports.back().inputBytes, archive.size());
+    EXPECT_EQ(reports.back().outputBytes, data.size());
+}
+
+TEST_F(ParallelGzipTest, RejectsBadOptions) {
+    StringSink sink;
+    GzipOptions options;
+    options.chunkSize = 1024;
+    EXPECT_THROW(GzipCompressor(sink, options), std::invalid_argument);
+    options = {};
+    options.level = 0;
+    EXPECT_THROW(GzipCompressor(sink, options), std::invalid_argument);
+}
@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include "portdiscovery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace WSL;
+
+namespace {
+
+constexpr const char* TcpHeader =
+    "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode\n";
+constexpr const char* Tcp6Header =
+    "  sl  local_address                         remote_address                        st tx_queue rx_queue tr "
+    "tm->when retrnsmt   uid  timeout inode\n";
+
+// 127.0.0.1:8080 and 0.0.0.0:5432 listening, plus an established
+// connection on 8080 that is not.
+constexpr const char* TcpListing =
+    "   0: 0100007F:1F90 00000000:0000 0A 00000000:00000000 00:00000000 00000000  1000        0 1001 1 0 100 0 0 10 0\n"
+    "   1: 00000000:1538 00000000:0000 0A 00000000:00000000 00:00000000 00000000   999        0 1002 1 0 100 0 0 10 0\n"
+    "   2: 0100007F:1F90 0100007F:D2F0 01 00000000:00000000 00:00000000 00000000  1000        0 1003 1 0 20 4 30 10 -1\n";
+
+// [::1]:3000 listening.
+constexpr const char* Tcp6Listing =
+    "   0: 00000000000000000000000001000000:0BB8 00000000000000000000000000000000:0000 0A 00000000:00000000 "
+    "00:00000000 00000000  1000        0 2001 1 0 100 0 0 10 0\n";
+
+struct Event {
+    PortChange change;
+    std::string address;
+    uint16_t port;
+
+    bool operator==(const Event&) const = default;
+};
+
+} // namespace
+
+class PortDiscoveryTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+    std::vector<Event> events;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_portdiscovery_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory / "net");
+    }
+
+    void TearDown() override {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    void WriteListing(const char* name, const std::string& contents) {
+        std::ofstream(directory / "net" / name, std::ios::binary) << contents;
+    }
+
+    PortCallback Record() {
+        return [this](PortChange change, const ListeningPort& port) {
+            events.push_back({change, port.Address(), port.port});
+        };
+    }
+
+    PortDiscoveryOptions ProcNet() const {
+        PortDiscoveryOptions options;
+        options.source = PortSource::ProcNet;
+        options.procRoot = directory.string();
+        return options;
+    }
+};
+
+TEST_F(PortDiscoveryTest, ReportsListenersFromProcNet) {
+    WriteListing("tcp", std::string(TcpHeader) + TcpListing);
+    WriteListing("tcp6", std::string(Tcp6Header) + Tcp6Listing);
+
+    PortDiscovery discovery(Record(), ProcNet());
+    EXPECT_EQ(discovery.Source(), PortSource::ProcNet);
+    EXPECT_EQ(discovery.Poll(), 3u);
+
+    const std::vector<Event> expected = {
+        {PortChange::Added, "0.0.0.0", 5432},
+        {PortChange::Added, "127.0.0.1", 8080},
+        {PortChange::Added, "::1", 3000},
+    };
+    EXPECT_EQ(events, expected);
+
+    const std::vector<ListeningPort> ports = discovery.Ports();
+    ASSERT_EQ(ports.size(), 3u);
+    EXPECT_TRUE(ports[0].IsWildcard());
+    EXPECT_TRUE(ports[1].IsLoopback());
+    EXPECT_TRUE(ports[2].IsLoopback());
+    EXPECT_FALSE(ports[2].IsWildcard());
+}
+
+TEST_F(PortDiscoveryTest, ProcNetPollsLessOftenByDefault) {
+    PortDiscovery procNet([](PortChange, const ListeningPort&) {}, ProcNet());
+    EXPECT_EQ(procNet.Interval(), ProcNetInterval);
+
+    PortDiscoveryOptions options = ProcNet();
+    options.interval = std::chrono::milliseconds(10);
+    PortDiscovery chosen([](PortChange, const ListeningPort&) {}, options);
+    EXPECT_EQ(chosen.Interval(), std::chrono::milliseconds(10));
+}
+
+TEST_F(PortDiscoveryTest, ReportsOnlyWhatChanged) {
+    WriteListing("tcp", std::string(TcpHeader) + TcpListing);
+    PortDiscovery discovery(Record(), ProcNet());
+    EXPECT_EQ(discovery.Poll(), 2u);
+    EXPECT_EQ(discovery.Poll(), 0u);
+
+    // 8080 goes away and 9000 on every address appears.
+    events.clear();
+    WriteListing("tcp", std::string(TcpHeader) +
+                            "   0: 00000000:1538 00000000:0000 0A 00000000:00000000 00:00000000 00000000 0 0 1 1\n"
+                            "   1: 00000000:2328 00000000:0000 0A 00000000:00000000 00:00000000 00000000 0 0 2 1\n");
+    EXPECT_EQ(discovery.Poll(), 2u);
+
+    const std::vector<Event> expected = {
+        {PortChange::Added, "0.0.0.0", 9000},
+        {PortChange::Removed, "127.0.0.1", 8080},
+    };
+    EXPECT_EQ(events, expected);
+}
+
+TEST_F(PortDiscoveryTest, KeepsTheLastSetWhenAScanFails) {
+    WriteListing("tcp", std::string(TcpHeader) + TcpListing);
+    PortDiscovery discovery(Record(), ProcNet());
+    EXPECT_EQ(discovery.Poll(), 2u);
+
+    // Unreadable is not the same as empty; nothing is reported gone.
+    std::filesystem::remove(directory / "net" / "tcp");
+    events.clear();
+    EXPECT_EQ(discovery.Poll(), 0u);
+    EXPECT_TRUE(events.empty());
+    EXPECT_EQ(discovery.Ports().size(), 2u);
+}
+
+TEST_F(PortDiscoveryTest, FormatsAddresses) {
+    ListeningPort port;
+    port.family = AF_INET6;
+    port.address = {0xfe, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0, 0x02};
+    EXPECT_EQ(port.Address(), "fe80::1:2");
+
+    port.address = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1};
+    EXPECT_EQ(port.Address(), "2001:db8:0:1::1");
+
+    port.address = {};
+    EXPECT_EQ(port.Address(), "::");
+    EXPECT_TRUE(port.IsWildcard());
+
+    port.address = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 127, 0, 0, 1};
+    EXPECT_TRUE(port.IsLoopback());
+
+    port.family = AF_INET;
+    port.address = {10, 0, 0, 1};
+    EXPECT_EQ(port.Address(), "10.0.0.1");
+    EXPECT_FALSE(port.IsLoopback());
+}
+
+#ifndef _WIN32
+
+namespace {
+
+int ListenOnLoopback(uint16_t& port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    listen(fd, 16);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+    return fd;
+}
+
+bool Contains(const std::vector<ListeningPort>& ports, uint16_t port) {
+    for (const auto& listening : ports) {
+        if (listening.port == port && listening.Address() == "127.0.0.1") {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+TEST_F(PortDiscoveryTest, SourcesAgreeOnTheSystemsListeners) {
+    uint16_t port = 0;
+    const int fd = ListenOnLoopback(port);
+    ASSERT_GE(fd, 0);
+
+    PortDiscovery automatic([](PortChange, const ListeningPort&) {});
+    PortDiscoveryOptions options;
+    options.source = PortSource::ProcNet;
+    PortDiscovery procNet([](PortChange, const ListeningPort&) {}, options);
+    automatic.Poll();
+    procNet.Poll();
+
+    EXPECT_TRUE(Contains(automatic.Ports(), port));
+    EXPECT_TRUE(Contains(procNet.Ports(), port));
+    if (automatic.Source() == PortSource::SockDiag) {
+        EXPECT_EQ(automatic.Ports(), procNet.Ports());
+    }
+
+    close(fd);
+    automatic.Poll();
+    EXPECT_FALSE(Contains(automatic.Ports(), port));
+}
+
+TEST_F(PortDiscoveryTest, BackgroundScansReportNewListeners) {
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<std::pair<PortChange, uint16_t>> seen;
+
+    PortDiscoveryOptions options;
+    options.interval = std::chrono::milliseconds(10);
+    PortDiscovery discovery(
+        [&](PortChange change, const ListeningPort& port) {
+            std::lock_guard<std::mutex> guard(lock);
+            seen.emplace_back(change, port.port);
+            changed.notify_all();
+        },
+        options);
+    discovery.Start();
+
+    uint16_t port = 0;
+    const int fd = ListenOnLoopback(port);
+    auto reported = [&](PortChange change) {
+        std::unique_lock<std::mutex> guard(lock);
+        return changed.wait_for(guard, std::chrono::seconds(5), [&] {
+            return std::find(seen.begin(), seen.end(), std::make_pair(change, port)) != seen.end();
+        });
+    };
+    EXPECT_TRUE(reported(PortChange::Added));
+    close(fd);
+    EXPECT_TRUE(reported(PortChange::Removed));
+
+    discovery.Stop();
+    discovery.Stop();
+}
+
+#endif
@@ -0,0 +1,333 @@
+#include <gtest/gtest.h>
+#include "portforward.h"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace WSL;
+
+#ifndef _WIN32
+
+namespace {
+
+int Listen(uint16_t& port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 256) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    port = ntohs(address.sin_port);
+    return fd;
+}
+
+int Connect(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool SendAll(int fd, const std::string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        const ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+// Reads until EOF, or a reset.
+std::string ReceiveAll(int fd) {
+    std::string data;
+    char buffer[16384];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        data.append(buffer, static_cast<size_t>(received));
+    }
+    return data;
+}
+
+std::string Pattern(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<char>('a' + (i * 7) % 26);
+    }
+    return data;
+}
+
+// Target that runs a handler per accepted connection, each on its own
+// thread, until destroyed.
+class TestServer {
+public:
+    explicit TestServer(std::function<void(int)> handler) : handler_(std::move(handler)) {
+        fd_ = Listen(port_);
+        thread_ = std::thread([this] {
+            int client;
+            while ((client = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+                handlers_.emplace_back([this, client] {
+                    handler_(client);
+                    close(client);
+                });
+            }
+        });
+    }
+
+    ~TestServer() {
+        shutdown(fd_, SHUT_RDWR);
+        thread_.join();
+        for (auto& handler : handlers_) {
+            handler.join();
+        }
+        close(fd_);
+    }
+
+    uint16_t Port() const { return port_; }
+
+private:
+    std::function<void(int)> handler_;
+    int fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::vector<std::thread> handlers_;
+};
+
+void Echo(int fd) {
+    char buffer[16384];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        if (!SendAll(fd, std::string(buffer, static_cast<size_t>(received)))) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+class PortForwardTest : public ::testing::Test {
+protected:
+    static PortForwardOptions Options(bool zeroCopy = true) {
+        PortForwardOptions options;
+        options.threads = 2;
+        options.zeroCopy = zeroCopy;
+        return options;
+    }
+
+    // Stats are updated by the loops; give them a moment to catch up.
+    template <typename Predicate>
+    static bool Eventually(Predicate predicate) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    // Larger than a pipe and a pooled buffer, sent whole before reading, so
+    // both directions fill up and have to wait for the other side.
+    static void ExpectEcho(bool zeroCopy) {
+        TestServer server(Echo);
+        PortForwarder forwarder(Options(zeroCopy));
+        const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+        ASSERT_NE(port, 0);
+        forwarder.Start();
+
+        const std::string data = Pattern(4 * 1024 * 1024);
+        const int client = Connect(port);
+        ASSERT_GE(client, 0);
+        std::thread writer([&] {
+            EXPECT_TRUE(SendAll(client, data));
+            shutdown(client, SHUT_WR);
+        });
+        const std::string echoed = ReceiveAll(client);
+        writer.join();
+        close(client);
+
+        EXPECT_EQ(echoed.size(), data.size());
+        EXPECT_TRUE(echoed == data);
+
+        ASSERT_TRUE(Eventually([&] { return forwarder.GetStats().active == 0; }));
+        const PortForwardStats stats = forwarder.GetStats();
+        EXPECT_EQ(stats.accepted, 1u);
+        EXPECT_EQ(stats.connectFailures, 0u);
+        EXPECT_EQ(stats.bytesToTarget, data.size());
+        EXPECT_EQ(stats.bytesToClient, data.size());
+    }
+};
+
+TEST_F(PortForwardTest, EchoesThroughTheForwarder) {
+    ExpectEcho(true);
+}
+
+TEST_F(PortForwardTest, EchoesWithoutZeroCopy) {
+    ExpectEcho(false);
+}
+
+TEST_F(PortForwardTest, ClientHalfCloseReachesTheTarget) {
+    // Replies only once the request is complete, which it learns from EOF.
+    TestServer server([](int fd) {
+        const std::string request = ReceiveAll(fd);
+        SendAll(fd, "received " + std::to_string(request.size()));
+    });
+    PortForwarder forwarder(Options());
+    const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+    forwarder.Start();
+
+    const int client = Connect(port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(SendAll(client, Pattern(100000)));
+    ASSERT_EQ(shutdown(client, SHUT_WR), 0);
+    EXPECT_EQ(ReceiveAll(client), "received 100000");
+    close(client);
+}
+
+TEST_F(PortForwardTest, TargetHalfCloseReachesTheClient) {
+    std::promise<std::string> afterEof;
+    TestServer server([&afterEof](int fd) {
+        SendAll(fd, "banner");
+        shutdown(fd, SHUT_WR);
+        afterEof.set_value(ReceiveAll(fd));
+    });
+    PortForwarder forwarder(Options());
+    const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+    forwarder.Start();
+
+    // The client sees EOF after the banner and can still talk.
+    const int client = Connect(port);
+    ASSERT_GE(client, 0);
+    EXPECT_EQ(ReceiveAll(client), "banner");
+    ASSERT_TRUE(SendAll(client, "still here"));
+    shutdown(client, SHUT_WR);
+    EXPECT_EQ(afterEof.get_future().get(), "still here");
+    close(client);
+
+    EXPECT_TRUE(Eventually([&] { return forwarder.GetStats().active == 0; }));
+}
+
+TEST_F(PortForwardTest, UnreachableTargetClosesTheClient) {
+    uint16_t closedPort = 0;
+    close(Listen(closedPort));
+
+    PortForwarder forwarder(Options());
+    const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", closedPort);
+    forwarder.Start();
+
+    const int client = Connect(port);
+    ASSERT_GE(client, 0);
+    EXPECT_EQ(ReceiveAll(client), "");
+    close(client);
+
+    EXPECT_TRUE(Eventually([&] {
+        const PortForwardStats stats = forwarder.GetStats();
+        return stats.connectFailures == 1 && stats.active == 0;
+    }));
+}
+
+TEST_F(PortForwardTest, CarriesManyConnectionsAtOnce) {
+    TestServer server(Echo);
+    PortForwarder forwarder(Options());
+    const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+    forwarder.Start();
+
+    // All open before any finishes.
+    constexpr int Connections = 64;
+    std::vector<int> clients;
+    for (int i = 0; i < Connections; ++i) {
+        clients.push_back(Connect(port));
+        ASSERT_GE(clients.back(), 0);
+    }
+    ASSERT_TRUE(Eventually([&] { return forwarder.GetStats().active == Connections; }));
+
+    for (int i = 0; i < Connections; ++i) {
+        ASSERT_TRUE(SendAll(clients[i], "connection " + std::to_string(i)));
+        shutdown(clients[i], SHUT_WR);
+    }
+    for (int i = 0; i < Connections; ++i) {
+        EXPECT_EQ(ReceiveAll(clients[i]), "connection " + std::to_string(i));
+        close(clients[i]);
+    }
+
+    EXPECT_TRUE(Eventually([&] { return forwarder.GetStats().active == 0; }));
+    EXPECT_EQ(forwarder.GetStats().accepted, static_cast<uint64_t>(Connections));
+
+    // Idle between requests, so buffers went back to the pool and were
+    // shared rather than one allocated per connection.
+    EXPECT_LT(forwarder.GetStats().buffersAllocated, static_cast<uint64_t>(2 * Connections));
+}
+
+TEST_F(PortForwardTest, ForwardsComeAndGoWhileRunning) {
+    TestServer server(Echo);
+    PortForwarder forwarder(Options());
+    forwarder.Start();
+
+    const uint16_t port = forwarder.AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+    const int open = Connect(port);
+    ASSERT_GE(open, 0);
+    ASSERT_TRUE(SendAll(open, "before"));
+    char reply[6];
+    ASSERT_EQ(recv(open, reply, sizeof(reply), MSG_WAITALL), 6);
+
+    // New connections are refused once the listeners are gone, but the
+    // one already accepted keeps working.
+    EXPECT_TRUE(forwarder.RemoveForward(port));
+    EXPECT_FALSE(forwarder.RemoveForward(port));
+    EXPECT_TRUE(Eventually([&] {
+        const int fd = Connect(port);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return fd < 0;
+    }));
+    ASSERT_TRUE(SendAll(open, "after"));
+    shutdown(open, SHUT_WR);
+    EXPECT_EQ(ReceiveAll(open), "after");
+    close(open);
+}
+
+TEST_F(PortForwardTest, StopClosesOpenConnections) {
+    TestServer server(Echo);
+    auto forwarder = std::make_unique<PortForwarder>(Options());
+    const uint16_t port = forwarder->AddForward("127.0.0.1", 0, "127.0.0.1", server.Port());
+    forwarder->Start();
+
+    const int client = Connect(port);
+    ASSERT_GE(client, 0);
+    ASSERT_TRUE(SendAll(client, "ping"));
+    char reply[4];
+    ASSERT_EQ(recv(client, reply, sizeof(reply), MSG_WAITALL), 4);
+
+    forwarder->Stop();
+    forwarder->Stop();
+    EXPECT_EQ(ReceiveAll(client), "");
+    close(client);
+    forwarder.reset();
+}
+
+#endif
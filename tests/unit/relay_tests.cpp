@@ -0,0 +1,597 @@
+#include <gtest/gtest.h>
+#include "relayengine.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace WSL;
+
+namespace {
+
+// Anonymous pipe standing in for the handles the service hands back.
+struct TestPipe {
+    NativeHandle readEnd = InvalidNativeHandle;
+    NativeHandle writeEnd = InvalidNativeHandle;
+
+    TestPipe() {
+#ifdef _WIN32
+        CreatePipe(&readEnd, &writeEnd, nullptr, 0);
+#else
+        int fds[2];
+        if (pipe(fds) == 0) {
+            readEnd = fds[0];
+            writeEnd = fds[1];
+        }
+#endif
+    }
+
+    ~TestPipe() {
+        CloseRead();
+        CloseWrite();
+    }
+
+    void CloseRead() { CloseNative(readEnd); }
+    void CloseWrite() { CloseNative(writeEnd); }
+
+    static void CloseNative(NativeHandle& handle) {
+        if (handle != InvalidNativeHandle) {
+#ifdef _WIN32
+            CloseHandle(handle);
+#else
+            close(handle);
+#endif
+            handle = InvalidNativeHandle;
+        }
+    }
+};
+
+bool WriteAll(NativeHandle handle, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+#ifdef _WIN32
+        DWORD written = 0;
+        if (!WriteFile(handle, data.data() + offset, static_cast<DWORD>(data.size() - offset), &written, nullptr)) {
+            return false;
+        }
+#else
+        ssize_t written = write(handle, data.data() + offset, data.size() - offset);
+        if (written <= 0) {
+            return false;
+        }
+#endif
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+std::string ReadToEnd(NativeHandle handle) {
+    std::string result;
+    char buffer[8192];
+    for (;;) {
+#ifdef _WIN32
+        DWORD bytesRead = 0;
+        if (!ReadFile(handle, buffer, sizeof(buffer), &bytesRead, nullptr) || bytesRead == 0) {
+            break;
+        }
+#else
+        ssize_t bytesRead = read(handle, buffer, sizeof(buffer));
+        if (bytesRead < 0 && errno == EAGAIN) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (bytesRead <= 0) {
+            break;
+        }
+#endif
+        result.append(buffer, static_cast<size_t>(bytesRead));
+    }
+    return result;
+}
+
+} // namespace
+
+class RelayEngineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+#ifndef _WIN32
+        // A closed consumer must surface as EPIPE, not kill the test binary.
+        signal(SIGPIPE, SIG_IGN);
+#endif
+    }
+};
+
+TEST_F(RelayEngineTest, RelaysStdoutAndStderrToEof) {
+    TestPipe linuxStdout, consoleStdout;
+    TestPipe linuxStderr, consoleStderr;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    size_t err = engine.AddStream(linuxStderr.readEnd, consoleStderr.writeEnd);
+
+    std::thread producer([&] {
+        WriteAll(linuxStdout.writeEnd, "hello stdout");
+        WriteAll(linuxStderr.writeEnd, "hello stderr");
+        linuxStdout.CloseWrite();
+        linuxStderr.CloseWrite();
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    producer.join();
+
+    consoleStdout.CloseWrite();
+    consoleStderr.CloseWrite();
+    EXPECT_EQ(ReadToEnd(consoleStdout.readEnd), "hello stdout");
+    EXPECT_EQ(ReadToEnd(consoleStderr.readEnd), "hello stderr");
+    EXPECT_EQ(engine.GetBytesRelayed(out), 12u);
+    EXPECT_EQ(engine.GetBytesRelayed(err), 12u);
+}
+
+TEST_F(RelayEngineTest, OpenStdinDoesNotBlockCompletion) {
+    TestPipe consoleStdin, linuxStdin;
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayStreamOptions stdinOptions;
+    stdinOptions.required = false;
+
+    RelayEngine engine;
+    engine.AddStream(consoleStdin.readEnd, linuxStdin.writeEnd, stdinOptions);
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+
+    // Stdin stays open for the whole test, which used to hang the join.
+    linuxStdout.CloseWrite();
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST_F(RelayEngineTest, CancelStopsRunningLoop) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        engine.Cancel();
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Cancelled);
+    canceller.join();
+}
+
+TEST_F(RelayEngineTest, CloseSinkOnEofPropagatesEof) {
+    TestPipe consoleStdin, linuxStdin;
+
+    RelayStreamOptions options;
+    options.closeSinkOnEof = true;
+
+    RelayEngine engine;
+    engine.AddStream(consoleStdin.readEnd, linuxStdin.writeEnd, options);
+
+    WriteAll(consoleStdin.writeEnd, "input");
+    consoleStdin.CloseWrite();
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+
+    // The engine owns and closed the write end, so the reader sees EOF.
+    linuxStdin.writeEnd = InvalidNativeHandle;
+    EXPECT_EQ(ReadToEnd(linuxStdin.readEnd), "input");
+}
+
+TEST_F(RelayEngineTest, SlowConsumerReceivesEveryByte) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+
+    const std::string payload(4 * 1024 * 1024, 'x');
+    std::thread producer([&] {
+        WriteAll(linuxStdout.writeEnd, payload);
+        linuxStdout.CloseWrite();
+    });
+
+    std::string received;
+    std::thread consumer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        received = ReadToEnd(consoleStdout.readEnd);
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    consoleStdout.CloseWrite();
+
+    producer.join();
+    consumer.join();
+    EXPECT_EQ(received.size(), payload.size());
+    EXPECT_EQ(engine.GetBytesRelayed(out), payload.size());
+}
+
+TEST_F(RelayEngineTest, StagedWriterAbsorbsSlowSink) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayStreamOptions options;
+    options.writerRingSize = 1024 * 1024;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+
+    // Several times what the sink pipe holds, but within the ring: the
+    // producer must be able to finish while nobody reads the sink.
+    const std::string payload(512 * 1024, 's');
+    std::thread producer([&] {
+        WriteAll(linuxStdout.writeEnd, payload);
+        linuxStdout.CloseWrite();
+    });
+
+    std::string received;
+    std::thread consumer([&] {
+        producer.join();
+        received = ReadToEnd(consoleStdout.readEnd);
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    consoleStdout.CloseWrite();
+
+    consumer.join();
+    EXPECT_EQ(received, payload);
+    EXPECT_EQ(engine.GetBytesRelayed(out), payload.size());
+}
+
+TEST_F(RelayEngineTest, FullRingAppliesBackpressure) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayStreamOptions options;
+    options.writerRingSize = 16 * 1024;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+
+    std::string payload(4 * 1024 * 1024, '\0');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>('a' + (i * 7) % 26);
+    }
+
+    std::thread producer([&] {
+        WriteAll(linuxStdout.writeEnd, payload);
+        linuxStdout.CloseWrite();
+    });
+
+    std::string received;
+    std::thread consumer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        received = ReadToEnd(consoleStdout.readEnd);
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    consoleStdout.CloseWrite();
+
+    producer.join();
+    consumer.join();
+    EXPECT_EQ(received, payload);
+    EXPECT_GT(engine.GetStats(out).readerStalls, 0u);
+}
+
+TEST_F(RelayEngineTest, CancelStopsBlockedWriterStage) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayStreamOptions options;
+    options.writerRingSize = 64 * 1024;
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+
+    // Fill the sink so the writer thread is parked on it.
+    std::thread producer([&] { WriteAll(linuxStdout.writeEnd, std::string(1024 * 1024, 'c')); });
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        engine.Cancel();
+    });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Cancelled);
+    canceller.join();
+
+    linuxStdout.CloseRead();
+    producer.join();
+}
+
+#ifndef _WIN32
+
+TEST_F(RelayEngineTest, PipeToPipeUsesSplice) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    EXPECT_EQ(engine.GetTransfer(out), RelayTransfer::Splice);
+
+    const std::string payload(1024 * 1024, 's');
+    std::thread producer([&] {
+        WriteAll(linuxStdout.writeEnd, payload);
+        linuxStdout.CloseWrite();
+    });
+
+    std::string received;
+    std::thread consumer([&] { received = ReadToEnd(consoleStdout.readEnd); });
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    consoleStdout.CloseWrite();
+    producer.join();
+    consumer.join();
+
+    EXPECT_EQ(received, payload);
+    EXPECT_EQ(engine.GetTransfer(out), RelayTransfer::Splice);
+}
+
+TEST_F(RelayEngineTest, ZeroCopyCanBeDisabled) {
+    TestPipe linuxStdout, consoleStdout;
+
+    RelayStreamOptions options;
+    options.zeroCopy = false;
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+    EXPECT_EQ(engine.GetTransfer(out), RelayTransfer::Buffered);
+}
+
+TEST_F(RelayEngineTest, UnspliceableSinkFallsBackToBuffered) {
+    TestPipe linuxStdout;
+
+    // splice() rejects O_APPEND targets with EINVAL.
+    char path[] = "/tmp/relay_fallback_XXXXXX";
+    int file = mkstemp(path);
+    ASSERT_GE(file, 0);
+    int sink = open(path, O_WRONLY | O_APPEND);
+    ASSERT_GE(sink, 0);
+
+    RelayEngine engine;
+    size_t out = engine.AddStream(linuxStdout.readEnd, sink);
+    EXPECT_EQ(engine.GetTransfer(out), RelayTransfer::Splice);
+
+    WriteAll(linuxStdout.writeEnd, "fallback");
+    linuxStdout.CloseWrite();
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_EQ(engine.GetTransfer(out), RelayTransfer::Buffered);
+    EXPECT_EQ(ReadToEnd(file), "fallback");
+
+    close(sink);
+    close(file);
+    unlink(path);
+}
+
+// A forked child stands in for the Linux process; its pidfd is the process
+// handle the service would hand back.
+class RelayProcessTest : public RelayEngineTest {
+protected:
+    template <typename Body>
+    int Spawn(Body body) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(body());
+        }
+
+        int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (pidfd < 0) {
+            waitpid(pid, nullptr, 0);
+        }
+        return pidfd;
+    }
+};
+
+TEST_F(RelayProcessTest, ReturnsExitCodeFromProcessHandle) {
+    TestPipe linuxStdout, linuxStderr, consoleStdout;
+
+    int process = Spawn([&] {
+        WriteAll(linuxStdout.writeEnd, "done");
+        return 42;
+    });
+    if (process < 0) {
+        GTEST_SKIP() << "pidfd_open is not available";
+    }
+    linuxStdout.CloseWrite();
+    linuxStderr.CloseWrite();
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    engine.AddStream(linuxStderr.readEnd, consoleStdout.writeEnd);
+    engine.WatchProcess(process);
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_EQ(engine.GetExitCode(), 42);
+
+    consoleStdout.CloseWrite();
+    EXPECT_EQ(ReadToEnd(consoleStdout.readEnd), "done");
+    close(process);
+}
+
+TEST_F(RelayProcessTest, SignalledProcessReportsShellStyleStatus) {
+    TestPipe linuxStdout, consoleStdout;
+
+    int process = Spawn([] {
+        raise(SIGKILL);
+        return 0;
+    });
+    if (process < 0) {
+        GTEST_SKIP() << "pidfd_open is not available";
+    }
+    linuxStdout.CloseWrite();
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    engine.WatchProcess(process);
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_EQ(engine.GetExitCode(), 128 + SIGKILL);
+    close(process);
+}
+
+TEST_F(RelayProcessTest, OutputDrainsToEofAfterExit) {
+    TestPipe linuxStdout, consoleStdout;
+
+    int process = Spawn([] { return 3; });
+    if (process < 0) {
+        GTEST_SKIP() << "pidfd_open is not available";
+    }
+
+    // Something outliving the process (a daemonised grandchild) still holds
+    // stdout; the tail of its output must not be lost.
+    std::thread straggler([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        WriteAll(linuxStdout.writeEnd, "tail");
+        linuxStdout.CloseWrite();
+    });
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    engine.WatchProcess(process);
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    straggler.join();
+
+    EXPECT_EQ(engine.GetExitCode(), 3);
+    EXPECT_GE(engine.GetTeardownLatency(), std::chrono::milliseconds(20));
+
+    consoleStdout.CloseWrite();
+    EXPECT_EQ(ReadToEnd(consoleStdout.readEnd), "tail");
+    close(process);
+}
+
+TEST_F(RelayProcessTest, ExitAbandonsOpenStdin) {
+    TestPipe consoleStdin, linuxStdin, linuxStdout, consoleStdout;
+
+    int process = Spawn([] { return 0; });
+    if (process < 0) {
+        GTEST_SKIP() << "pidfd_open is not available";
+    }
+    linuxStdout.CloseWrite();
+
+    RelayStreamOptions stdinOptions;
+    stdinOptions.required = false;
+
+    RelayEngine engine;
+    engine.AddStream(consoleStdin.readEnd, linuxStdin.writeEnd, stdinOptions);
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    engine.WatchProcess(process);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(engine.GetExitCode(), 0);
+    close(process);
+}
+
+TEST_F(RelayProcessTest, ControlHangupEndsSessionWithoutStatus) {
+    TestPipe linuxStdout, consoleStdout, control;
+    linuxStdout.CloseWrite();
+
+    RelayEngine engine;
+    engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd);
+    engine.WatchProcess(InvalidNativeHandle, control.readEnd);
+
+    control.CloseWrite();
+
+    EXPECT_EQ(engine.Run(), RelayResult::Completed);
+    EXPECT_FALSE(engine.GetExitCode().has_value());
+}
+
+#endif
+
+class RelayModeTest : public RelayEngineTest {
+protected:
+    // Trickles small writes into the relay the way an interactive program
+    // or a line-buffered logger would.
+    RelayStreamStats RelayTrickle(RelayMode mode, std::string& received) {
+        TestPipe linuxStdout, consoleStdout;
+
+        RelayStreamOptions options;
+        options.mode = mode;
+        options.zeroCopy = false;
+        options.coalesceWindow = std::chrono::milliseconds(50);
+
+        RelayEngine engine;
+        size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+
+        std::thread producer([&] {
+            for (int i = 0; i < 40; ++i) {
+                WriteAll(linuxStdout.writeEnd, "line " + std::to_string(i) + "\n");
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            linuxStdout.CloseWrite();
+        });
+        std::thread consumer([&] { received = ReadToEnd(consoleStdout.readEnd); });
+
+        EXPECT_EQ(engine.Run(), RelayResult::Completed);
+        consoleStdout.CloseWrite();
+        producer.join();
+        consumer.join();
+        return engine.GetStats(out);
+    }
+
+    RelayStreamStats RelayBulk(RelayMode mode) {
+        TestPipe linuxStdout, consoleStdout;
+
+        RelayStreamOptions options;
+        options.mode = mode;
+        options.zeroCopy = false;
+
+        RelayEngine engine;
+        size_t out = engine.AddStream(linuxStdout.readEnd, consoleStdout.writeEnd, options);
+
+        const std::string payload(8 * 1024 * 1024, 'b');
+        std::thread producer([&] {
+            WriteAll(linuxStdout.writeEnd, payload);
+            linuxStdout.CloseWrite();
+        });
+        std::string received;
+        std::thread consumer([&] { received = ReadToEnd(consoleStdout.readEnd); });
+
+        EXPECT_EQ(engine.Run(), RelayResult::Completed);
+        consoleStdout.CloseWrite();
+        producer.join();
+        consumer.join();
+        EXPECT_EQ(received.size(), payload.size());
+        return engine.GetStats(out);
+    }
+
+    static std::string ExpectedTrickle() {
+        std::string expected;
+        for (int i = 0; i < 40; ++i) {
+            expected += "line " + std::to_string(i) + "\n";
+        }
+        return expected;
+    }
+};
+
+TEST_F(RelayModeTest, ThroughputModeCoalescesSmallWrites) {
+    std::string latencyOutput;
+    std::string throughputOutput;
+    RelayStreamStats latency = RelayTrickle(RelayMode::Latency, latencyOutput);
+    RelayStreamStats throughput = RelayTrickle(RelayMode::Throughput, throughputOutput);
+
+    EXPECT_EQ(latencyOutput, ExpectedTrickle());
+    EXPECT_EQ(throughputOutput, ExpectedTrickle());
+    EXPECT_LT(throughput.writes, latency.writes);
+    EXPECT_LE(throughput.writes, 5u);
+}
+
+TEST_F(RelayModeTest, BulkOutputGrowsBufferWithinModeCap) {
+    RelayStreamStats latency = RelayBulk(RelayMode::Latency);
+    RelayStreamStats throughput = RelayBulk(RelayMode::Throughput);
+
+    EXPECT_GT(latency.bufferSize, 4096u);
+    EXPECT_LE(latency.bufferSize, 64u * 1024u);
+    EXPECT_GE(throughput.bufferSize, latency.bufferSize);
+
+    // A fixed 4 KiB buffer costs at least one read and one write per 4 KiB.
+    EXPECT_LT(latency.SyscallsPerMegabyte(), 256.0);
+    EXPECT_LT(throughput.SyscallsPerMegabyte(), 256.0);
+}
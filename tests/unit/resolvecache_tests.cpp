@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include "resolvecache.h"
+#include "../support/fake_distributions.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class ResolutionCacheTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+    std::string path;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_resolvecache_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+        path = (directory / "wsl" / "resolve.cache").string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    // A fresh catalog per call, as each wsl.exe process starts with one.
+    static std::optional<ResolvedDistribution> Resolve(const std::string& path, std::wstring_view name,
+                                                       const DistributionList& list, size_t* enumerations = nullptr,
+                                                       uint64_t generation = 0) {
+        auto owned = std::make_unique<MemoryDistributionBackend>(list);
+        MemoryDistributionBackend* backend = owned.get();
+        for (uint64_t i = 0; i < generation; ++i) {
+            backend->Set(list);
+        }
+
+        DistributionCatalog catalog(std::move(owned));
+        auto resolved = ResolveDistribution(path, name, catalog);
+        if (enumerations) {
+            *enumerations = backend->enumerations;
+        }
+        return resolved;
+    }
+};
+
+TEST_F(ResolutionCacheTest, WritesAndReadsBack) {
+    DistributionCatalog catalog(std::make_unique<MemoryDistributionBackend>(MakeDistributions(50, 7)));
+    ASSERT_TRUE(ResolutionCache::Write(path, *catalog.Snapshot(), 42, L"endpoint"));
+
+    ResolutionCache cache;
+    ASSERT_TRUE(cache.Open(path));
+    EXPECT_EQ(cache.Stamp(), 42u);
+    EXPECT_EQ(cache.Endpoint(), L"endpoint");
+
+    for (size_t i = 0; i < 50; ++i) {
+        auto found = cache.Find(L"Distro-" + std::to_wstring(i));
+        ASSERT_TRUE(found);
+        EXPECT_EQ(found->id, MakeDistributionId(i));
+        EXPECT_TRUE(found->cached);
+    }
+    EXPECT_FALSE(cache.Find(L"Distro-50"));
+    EXPECT_FALSE(cache.Find(L""));
+
+    auto fallback = cache.Default();
+    ASSERT_TRUE(fallback);
+    EXPECT_EQ(fallback->name, L"Distro-7");
+}
+
+TEST_F(ResolutionCacheTest, EmptyCatalog) {
+    DistributionCatalog catalog(std::make_unique<MemoryDistributionBackend>());
+    ASSERT_TRUE(ResolutionCache::Write(path, *catalog.Snapshot(), 1, L""));
+
+    ResolutionCache cache;
+    ASSERT_TRUE(cache.Open(path));
+    EXPECT_FALSE(cache.Find(L"Ubuntu"));
+    EXPECT_FALSE(cache.Default());
+}
+
+TEST_F(ResolutionCacheTest, SecondRunSkipsEnumeration) {
+    const DistributionList list = MakeDistributions(20, 3);
+
+    size_t enumerations = 0;
+    auto cold = Resolve(path, L"Distro-12", list, &enumerations);
+    ASSERT_TRUE(cold);
+    EXPECT_FALSE(cold->cached);
+    EXPECT_EQ(enumerations, 1u);
+
+    auto warm = Resolve(path, L"Distro-12", list, &enumerations);
+    ASSERT_TRUE(warm);
+    EXPECT_TRUE(warm->cached);
+    EXPECT_EQ(warm->id, cold->id);
+    EXPECT_EQ(warm->endpoint, DefaultServiceEndpoint);
+    EXPECT_EQ(enumerations, 0u);
+
+    auto fallback = Resolve(path, L"", list, &enumerations);
+    ASSERT_TRUE(fallback);
+    EXPECT_TRUE(fallback->cached);
+    EXPECT_EQ(fallback->name, L"Distro-3");
+}
+
+TEST_F(ResolutionCacheTest, StaleStampFallsBackAndRewrites) {
+    const DistributionList before = MakeDistributions(5, 0);
+    ASSERT_TRUE(Resolve(path, L"Distro-1", before));
+
+    // A registration moves the store's stamp.
+    const DistributionList after = MakeDistributions(6, 5);
+    size_t enumerations = 0;
+    auto resolved = Resolve(path, L"", after, &enumerations, 1);
+    ASSERT_TRUE(resolved);
+    EXPECT_FALSE(resolved->cached);
+    EXPECT_EQ(resolved->name, L"Distro-5");
+    EXPECT_EQ(enumerations, 1u);
+
+    resolved = Resolve(path, L"", after, &enumerations, 1);
+    ASSERT_TRUE(resolved);
+    EXPECT_TRUE(resolved->cached);
+    EXPECT_EQ(enumerations, 0u);
+}
+
+TEST_F(ResolutionCacheTest, UnknownNameMissesWithoutRewriting) {
+    const DistributionList list = MakeDistributions(5);
+    ASSERT_TRUE(Resolve(path, L"Distro-1", list));
+    const auto written = std::filesystem::last_write_time(path);
+
+    size_t enumerations = 0;
+    EXPECT_FALSE(Resolve(path, L"Nope", list, &enumerations));
+    EXPECT_EQ(enumerations, 1u);
+    EXPECT_EQ(std::filesystem::last_write_time(path), written);
+}
+
+TEST_F(ResolutionCacheTest, RejectsDamagedFiles) {
+    const DistributionList list = MakeDistributions(10, 2);
+    ASSERT_TRUE(Resolve(path, L"Distro-1", list));
+    const auto size = std::filesystem::file_size(path);
+
+    // Flip one byte in the string pool.
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(size - 3));
+        file.put('\x7f');
+    }
+    ResolutionCache cache;
+    EXPECT_FALSE(cache.Open(path));
+
+    // The next resolve repairs it.
+    size_t enumerations = 0;
+    auto resolved = Resolve(path, L"Distro-1", list, &enumerations);
+    ASSERT_TRUE(resolved);
+    EXPECT_FALSE(resolved->cached);
+    EXPECT_TRUE(cache.Open(path));
+    cache.Close();
+
+    std::filesystem::resize_file(path, size - 1);
+    EXPECT_FALSE(cache.Open(path));
+
+    std::filesystem::resize_file(path, 8);
+    EXPECT_FALSE(cache.Open(path));
+}
+
+TEST_F(ResolutionCacheTest, RejectsOtherVersions) {
+    DistributionCatalog catalog(std::make_unique<MemoryDistributionBackend>(MakeDistributions(2)));
+    ASSERT_TRUE(ResolutionCache::Write(path, *catalog.Snapshot(), 1, L""));
+
+    // The version follows the 4-byte magic.
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(4);
+        const uint16_t version = ResolutionCache::FormatVersion + 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+
+    ResolutionCache cache;
+    EXPECT_FALSE(cache.Open(path));
+}
+
+TEST_F(ResolutionCacheTest, NoStampNoCache) {
+    class UnstampedBackend : public MemoryDistributionBackend {
+    public:
+        using MemoryDistributionBackend::MemoryDistributionBackend;
+        std::optional<uint64_t> Stamp() override { return std::nullopt; }
+    };
+
+    DistributionCatalog catalog(std::make_unique<UnstampedBackend>(MakeDistributions(3)));
+    auto resolved = ResolveDistribution(path, L"Distro-2", catalog);
+    ASSERT_TRUE(resolved);
+    EXPECT_FALSE(resolved->cached);
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
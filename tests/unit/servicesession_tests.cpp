@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include "servicesession.h"
+#include "wslargs.h"
+#include "../support/mock_service.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class ServiceSessionTest : public ::testing::Test {
+protected:
+    MockServiceTransport* transport = nullptr;
+
+    std::unique_ptr<ServiceSession> MakeSession(MockServiceTransport::Options options = {}) {
+        auto owned = std::make_unique<MockServiceTransport>(std::move(options));
+        transport = owned.get();
+        return std::make_unique<ServiceSession>(std::move(owned));
+    }
+
+    static LaunchRequest Request(const std::wstring& command) {
+        LaunchRequest request;
+        request.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+        request.command = command;
+        return request;
+    }
+
+    // The mock's status is the command's number, so every result can be
+    // matched to its request.
+    static int32_t EchoStatus(const LaunchRequest& request) { return std::stoi(request.command); }
+};
+
+TEST_F(ServiceSessionTest, EachLaunchGetsItsOwnResult) {
+    MockServiceTransport::Options options;
+    options.workers = 4;
+    options.handler = EchoStatus;
+    auto session = MakeSession(options);
+
+    std::vector<std::future<LaunchResult>> launches;
+    for (int i = 0; i < 500; ++i) {
+        launches.push_back(session->Launch(Request(std::to_wstring(i))));
+    }
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_EQ(launches[i].get().status, i);
+    }
+
+    auto stats = session->GetStats();
+    EXPECT_EQ(stats.launched, 500u);
+    EXPECT_EQ(stats.completed, 500u);
+    EXPECT_EQ(stats.failed, 0u);
+    EXPECT_EQ(stats.pending, 0u);
+}
+
+TEST_F(ServiceSessionTest, CompletesOutOfOrder) {
+    // Even requests take much longer than odd ones.
+    MockServiceTransport::Options options;
+    options.workers = 4;
+    options.handler = [](const LaunchRequest& request) {
+        const int value = std::stoi(request.command);
+        if (value % 2 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return value;
+    };
+    auto session = MakeSession(options);
+
+    std::mutex lock;
+    std::vector<int> order;
+    std::vector<std::future<LaunchResult>> launches;
+    for (int i = 0; i < 8; ++i) {
+        auto promise = std::make_shared<std::promise<LaunchResult>>();
+        launches.push_back(promise->get_future());
+        session->Launch(Request(std::to_wstring(i)), [&, i, promise](LaunchResult result) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                order.push_back(i);
+            }
+            EXPECT_EQ(result.status, i);
+            promise->set_value(std::move(result));
+        });
+    }
+    for (auto& launch : launches) {
+        launch.wait();
+    }
+
+    ASSERT_EQ(order.size(), 8u);
+    EXPECT_NE(order.front() % 2, 0) << "an odd request should finish first";
+}
+
+TEST_F(ServiceSessionTest, FailuresAreCounted) {
+    MockServiceTransport::Options options;
+    options.handler = [](const LaunchRequest& request) {
+        return request.command == L"bad" ? static_cast<int32_t>(0x80070490) : 0;
+    };
+    auto session = MakeSession(options);
+
+    EXPECT_TRUE(session->Launch(Request(L"good")).get().Succeeded());
+    EXPECT_EQ(session->Launch(Request(L"bad")).get().status, static_cast<int32_t>(0x80070490));
+    EXPECT_EQ(session->GetStats().failed, 1u);
+}
+
+TEST_F(ServiceSessionTest, LostConnectionFailsImmediately) {
+    auto session = MakeSession();
+    transport->disconnected = true;
+
+    auto launch = session->Launch(Request(L"0"));
+    ASSERT_EQ(launch.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(launch.get().status, LaunchServiceUnavailable);
+}
+
+TEST_F(ServiceSessionTest, DestructionAbortsPendingLaunches) {
+    auto session = MakeSession();
+    transport->Hold();
+
+    std::vector<std::future<LaunchResult>> launches;
+    for (int i = 0; i < 10; ++i) {
+        launches.push_back(session->Launch(Request(L"0")));
+    }
+    EXPECT_EQ(session->GetStats().pending, 10u);
+
+    session.reset();
+    for (auto& launch : launches) {
+        EXPECT_EQ(launch.get().status, LaunchAborted);
+    }
+}
+
+TEST_F(ServiceSessionTest, SpuriousCompletionsAreIgnored) {
+    MockServiceTransport::Options options;
+    options.createPipes = true;
+    auto session = MakeSession(options);
+
+    // Never issued; its handles are closed on the way out.
+    transport->CompleteSpurious(999999);
+
+    LaunchResult result = session->Launch(Request(L"0")).get();
+    ASSERT_TRUE(result.Succeeded());
+    ASSERT_NE(result.output, InvalidNativeHandle);
+    EXPECT_EQ(session->GetStats().completed, 1u);
+
+    // Handles are owned by the result and closed with it.
+    const int output = result.output;
+    result.Close();
+    EXPECT_EQ(fcntl(output, F_GETFD), -1);
+}
+
+TEST_F(ServiceSessionTest, ConcurrentLaunchers) {
+    MockServiceTransport::Options options;
+    options.workers = 3;
+    options.handler = EchoStatus;
+    auto session = MakeSession(options);
+
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> launchers;
+    for (int t = 0; t < 4; ++t) {
+        launchers.emplace_back([&, t] {
+            for (int i = 0; i < 200; ++i) {
+                const int value = t * 1000 + i;
+                if (session->Launch(Request(std::to_wstring(value))).get().status != value) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& launcher : launchers) {
+        launcher.join();
+    }
+
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_EQ(session->GetStats().completed, 800u);
+}
+
+TEST_F(ServiceSessionTest, TrailingArgvReachesTheServiceAsGiven) {
+    std::mutex lock;
+    std::vector<LaunchRequest> received;
+    MockServiceTransport::Options options;
+    options.handler = [&](const LaunchRequest& request) {
+        std::lock_guard<std::mutex> guard(lock);
+        received.push_back(request);
+        return 0;
+    };
+    auto session = MakeSession(options);
+
+    // wsl ls -la "two words": no -e, so nothing is tokenized.
+    const wchar_t* argv[] = {L"wsl", L"ls", L"-la", L"two words"};
+    const WSLArguments args = ParseWSLArguments(4, argv);
+    ASSERT_TRUE(args.executeCommand.empty());
+    LaunchRequest request = Request(L"");
+    ASSERT_TRUE(SetLaunchCommand(request, args.executeCommand, args.commandArguments));
+    ASSERT_TRUE(session->Launch(std::move(request)).get().Succeeded());
+
+    // wsl -e 'ls "two words"' is split under POSIX rules.
+    const wchar_t* execute[] = {L"wsl", L"-e", L"ls \"two words\""};
+    const WSLArguments commandLine = ParseWSLArguments(3, execute);
+    request = Request(L"");
+    ASSERT_TRUE(SetLaunchCommand(request, commandLine.executeCommand, commandLine.commandArguments));
+    ASSERT_TRUE(session->Launch(std::move(request)).get().Succeeded());
+
+    ASSERT_EQ(received.size(), 2u);
+    EXPECT_EQ(received[0].command, L"ls");
+    EXPECT_EQ(received[0].arguments, (ArgumentVector{L"ls", L"-la", L"two words"}));
+    EXPECT_EQ(received[1].command, L"ls");
+    EXPECT_EQ(received[1].arguments, (ArgumentVector{L"ls", L"two words"}));
+
+    // Neither leaves nothing to run.
+    request = Request(L"");
+    EXPECT_FALSE(SetLaunchCommand(request, L"  ", ArgumentVector()));
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "spscring.h"
+
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+class SpscRingTest : public ::testing::Test {
+};
+
+TEST_F(SpscRingTest, CapacityRoundsUpToPowerOfTwo) {
+    SpscRing<int> ring(1000);
+    EXPECT_EQ(ring.Capacity(), 1024u);
+
+    EXPECT_THROW(SpscRing<int>(0), std::invalid_argument);
+}
+
+TEST_F(SpscRingTest, FullRingRejectsPushUntilConsumed) {
+    SpscRing<int> ring(4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(ring.TryPush(i));
+    }
+
+    EXPECT_FALSE(ring.TryPush(99));
+    EXPECT_TRUE(ring.WritableSpan().empty());
+
+    int value = -1;
+    EXPECT_TRUE(ring.TryPop(value));
+    EXPECT_EQ(value, 0);
+    EXPECT_TRUE(ring.TryPush(4));
+
+    for (int expected = 1; expected <= 4; ++expected) {
+        EXPECT_TRUE(ring.TryPop(value));
+        EXPECT_EQ(value, expected);
+    }
+    EXPECT_FALSE(ring.TryPop(value));
+    EXPECT_TRUE(ring.EmptyApprox());
+}
+
+TEST_F(SpscRingTest, SpansStopAtWrapPoint) {
+    SpscRing<char> ring(8);
+    EXPECT_EQ(ring.Push("abcdef", 6), 6u);
+
+    char out[8] = {};
+    EXPECT_EQ(ring.Pop(out, 4), 4u);
+
+    // Tail sits at offset 6: two contiguous bytes before the wrap, six free.
+    auto writable = ring.WritableSpan();
+    EXPECT_EQ(writable.size(), 2u);
+
+    EXPECT_EQ(ring.Push("ghijkl", 6), 6u);
+    EXPECT_EQ(ring.SizeApprox(), 8u);
+
+    auto readable = ring.ReadableSpan();
+    EXPECT_EQ(std::string(readable.data(), readable.size()), "efgh");
+
+    EXPECT_EQ(ring.Pop(out, 8), 8u);
+    EXPECT_EQ(std::string(out, 8), "efghijkl");
+}
+
+TEST_F(SpscRingTest, PushReportsBackpressure) {
+    SpscRing<char> ring(16);
+    std::string payload(40, 'p');
+
+    EXPECT_EQ(ring.Push(payload.data(), payload.size()), 16u);
+    EXPECT_EQ(ring.Push(payload.data(), payload.size()), 0u);
+}
+
+TEST_F(SpscRingTest, ConcurrentTransferPreservesOrder) {
+    constexpr uint64_t Count = 2'000'000;
+    SpscRing<uint64_t> ring(1024);
+
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < Count;) {
+            if (ring.TryPush(i)) {
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    bool ordered = true;
+    while (expected < Count) {
+        uint64_t value = 0;
+        if (!ring.TryPop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && value == expected;
+        ++expected;
+    }
+
+    producer.join();
+    EXPECT_TRUE(ordered);
+    EXPECT_TRUE(ring.EmptyApprox());
+}
+
+TEST_F(SpscRingTest, ConcurrentSpanTransferPreservesBytes) {
+    constexpr size_t Total = 8 * 1024 * 1024;
+    SpscRing<unsigned char> ring(64 * 1024);
+
+    std::thread producer([&] {
+        size_t sent = 0;
+        while (sent < Total) {
+            auto span = ring.WritableSpan();
+            if (span.empty()) {
+                std::this_thread::yield();
+                continue;
+            }
+            size_t chunk = std::min(span.size(), Total - sent);
+            for (size_t i = 0; i < chunk; ++i) {
+                span[i] = static_cast<unsigned char>((sent + i) * 31);
+            }
+            ring.Commit(chunk);
+            sent += chunk;
+        }
+    });
+
+    size_t received = 0;
+    bool intact = true;
+    while (received < Total) {
+        auto span = ring.ReadableSpan();
+        if (span.empty()) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < span.size(); ++i) {
+            intact = intact && span[i] == static_cast<unsigned char>((received + i) * 31);
+        }
+        received += span.size();
+        ring.Consume(span.size());
+    }
+
+    producer.join();
+    EXPECT_TRUE(intact);
+}
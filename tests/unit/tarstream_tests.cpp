@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "parallelgzip.h"
+#include "tarstream.h"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class TarStreamTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_tarstream_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    // Records what the reader hands over.
+    struct Recorder : TarVisitor {
+        std::vector<TarEntry> entries;
+        std::map<std::string, std::string> contents;
+
+        void BeginEntry(const TarEntry& entry) override {
+            entries.push_back(entry);
+            contents[entry.path];
+        }
+        void EntryData(const char* data, size_t size) override { contents[entries.back().path].append(data, size); }
+        void EndEntry() override {}
+    };
+
+    static TarEntry File(std::string path, size_t size) {
+        TarEntry entry;
+        entry.path = std::move(path);
+        entry.size = size;
+        entry.mtime = 1700000000;
+        return entry;
+    }
+
+    // Feeds the archive through in small, uneven writes.
+    static void Feed(TarReader& reader, std::string_view archive) {
+        size_t step = 1;
+        for (size_t offset = 0; offset < archive.size(); offset += step, step = step % 700 + 37) {
+            const auto piece = archive.substr(offset, step);
+            reader.Write(piece.data(), piece.size());
+        }
+        reader.Finish();
+    }
+
+    static void WriteFile(const std::filesystem::path& path, const std::string& text) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+
+    static std::string ReadFile(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+};
+
+TEST_F(TarStreamTest, RoundTripsEntries) {
+    const std::string longDirectory(180, 'd');
+    const std::string longName = longDirectory + "/" + std::string(120, 'n');
+    const std::string splitName = std::string(90, 'p') + "/" + std::string(90, 'q');
+    const std::string payload(1500, 'x');
+
+    StringSink sink;
+    TarWriter writer(sink);
+    writer.Add(File("a.txt", 5));
+    writer.WriteData("hello", 5);
+    TarEntry directoryEntry = File("etc", 0);
+    directoryEntry.type = TarEntry::Type::Directory;
+    directoryEntry.mode = 0755;
+    writer.Add(directoryEntry);
+    writer.Add(File(splitName, payload.size()));
+    writer.WriteData(payload.data(), 1000);
+    writer.WriteData(payload.data() + 1000, 500);
+    writer.Add(File(longName, 3));
+    writer.WriteData("abc", 3);
+    TarEntry link = File("etc/link", 0);
+    link.type = TarEntry::Type::Symlink;
+    link.linkTarget = "/" + std::string(150, 't');
+    writer.Add(link);
+    writer.Finish();
+    EXPECT_EQ(sink.Data().size() % 512, 0u);
+
+    Recorder recorder;
+    TarReader reader(recorder);
+    Feed(reader, sink.Data());
+    EXPECT_EQ(reader.Entries(), 5u);
+    ASSERT_EQ(recorder.entries.size(), 5u);
+    EXPECT_EQ(recorder.entries[0].path, "a.txt");
+    EXPECT_EQ(recorder.entries[0].mtime, 1700000000);
+    EXPECT_EQ(recorder.contents["a.txt"], "hello");
+    EXPECT_EQ(recorder.entries[1].type, TarEntry::Type::Directory);
+    EXPECT_EQ(recorder.entries[1].path, "etc");
+    EXPECT_EQ(recorder.entries[1].mode, 0755u);
+    EXPECT_EQ(recorder.entries[2].path, splitName);
+    EXPECT_EQ(recorder.contents[splitName], payload);
+    EXPECT_EQ(recorder.entries[3].path, longName);
+    EXPECT_EQ(recorder.contents[longName], "abc");
+    EXPECT_EQ(recorder.entries[4].type, TarEntry::Type::Symlink);
+    EXPECT_EQ(recorder.entries[4].linkTarget, link.linkTarget);
+}
+
+TEST_F(TarStreamTest, DetectsDamage) {
+    StringSink sink;
+    TarWriter writer(sink);
+    writer.Add(File("a", 600));
+    writer.WriteData(std::string(600, 'a').data(), 600);
+    writer.Finish();
+
+    std::string corrupt = sink.Data();
+    corrupt[3] ^= 1;
+    Recorder recorder;
+    TarReader reader(recorder);
+    EXPECT_THROW(Feed(reader, corrupt), std::runtime_error);
+
+    Recorder truncated;
+    TarReader truncatedReader(truncated);
+    EXPECT_THROW(Feed(truncatedReader, std::string_view(sink.Data()).substr(0, 700)), std::runtime_error);
+
+    StringSink unused;
+    TarWriter incomplete(unused);
+    incomplete.Add(File("b", 10));
+    EXPECT_THROW(incomplete.WriteData("01234567890", 11), std::logic_error);
+    EXPECT_THROW(incomplete.Finish(), std::logic_error);
+}
+
+TEST_F(TarStreamTest, ExtractsTreeThroughCompression) {
+    const auto source = directory / "source";
+    std::filesystem::create_directories(source / "etc" / "deep");
+    std::filesystem::create_directories(source / "empty");
+    WriteFile(source / "etc" / "hosts", "127.0.0.1 localhost\n");
+    WriteFile(source / "etc" / "deep" / "big", std::string(300 * 1024, 'z') + "end");
+    std::filesystem::create_symlink("etc/hosts", source / "hosts");
+    std::filesystem::permissions(source / "etc" / "hosts", std::filesystem::perms(0600));
+
+    StringSink archive;
+    {
+        GzipOptions options;
+        options.chunkSize = 64 * 1024;
+        options.workers = 2;
+        GzipCompressor compressor(archive, options);
+        TarWriter writer(compressor);
+        writer.AddTree(source);
+        writer.Finish();
+    }
+
+    const auto target = directory / "target";
+    TarExtractor extractor(target);
+    TarReader reader(extractor);
+    StringSource input(archive.Data());
+    GzipDecompress(input, reader);
+
+    EXPECT_EQ(ReadFile(target / "etc" / "hosts"), "127.0.0.1 localhost\n");
+    EXPECT_EQ(ReadFile(target / "etc" / "deep" / "big"), ReadFile(source / "etc" / "deep" / "big"));
+    EXPECT_TRUE(std::filesystem::is_directory(target / "empty"));
+    ASSERT_TRUE(std::filesystem::is_symlink(target / "hosts"));
+    EXPECT_EQ(std::filesystem::read_symlink(target / "hosts"), "etc/hosts");
+    EXPECT_EQ(std::filesystem::status(target / "etc" / "hosts").permissions() & std::filesystem::perms::all,
+              std::filesystem::perms(0600));
+    // Archives keep whole seconds.
+    const auto seconds = [](const std::filesystem::path& path) {
+        return std::chrono::floor<std::chrono::seconds>(
+            std::chrono::file_clock::to_sys(std::filesystem::last_write_time(path)));
+    };
+    EXPECT_EQ(seconds(target / "etc" / "hosts"), seconds(source / "etc" / "hosts"));
+}
+
+TEST_F(TarStreamTest, RefusesPathsOutsideTheTarget) {
+    const auto target = directory / "target";
+    const auto outside = directory / "outside";
+    std::filesystem::create_directories(outside);
+
+    const auto extract = [&](const std::vector<TarEntry>& entries) {
+        StringSink sink;
+        TarWriter writer(sink);
+        for (const auto& entry : entries) {
+            writer.Add(entry);
+            writer.WriteData(std::string(entry.size, 'x').data(), entry.size);
+        }
+        writer.Finish();
+        TarExtractor extractor(target);
+        TarReader reader(extractor);
+        Feed(reader, sink.Data());
+    };
+
+    EXPECT_THROW(extract({File("../escape", 1)}), std::runtime_error);
+    EXPECT_THROW(extract({File("a/../../escape", 1)}), std::runtime_error);
+    EXPECT_THROW(extract({File("/etc/escape", 1)}), std::runtime_error);
+
+    // A symlink to outside, then a file through it.
+    TarEntry link = File("out", 0);
+    link.type = TarEntry::Type::Symlink;
+    link.linkTarget = outside.string();
+    EXPECT_THROW(extract({link, File("out/escape", 1)}), std::runtime_error);
+
+    // A symlink to outside, then a directory of the same name: the link is
+    // replaced, and neither the mode nor the time reaches outside.
+    const auto outsideTime = std::filesystem::last_write_time(outside);
+    const auto outsidePerms = std::filesystem::status(outside).permissions();
+    TarEntry directoryLink = link;
+    directoryLink.path = "x";
+    TarEntry replacement = File("x", 0);
+    replacement.type = TarEntry::Type::Directory;
+    replacement.mode = 0777;
+    replacement.mtime = 1000;
+    extract({directoryLink, replacement});
+    EXPECT_FALSE(std::filesystem::is_symlink(target / "x"));
+    EXPECT_TRUE(std::filesystem::is_directory(target / "x"));
+    EXPECT_EQ(std::filesystem::last_write_time(outside), outsideTime);
+    EXPECT_EQ(std::filesystem::status(outside).permissions(), outsidePerms);
+
+    EXPECT_TRUE(std::filesystem::is_empty(outside));
+}
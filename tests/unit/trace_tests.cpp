@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "trace.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace WSL;
+
+class TraceTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() /
+                    (std::string("wsl_trace_") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        StopTracing();
+        std::filesystem::remove_all(directory);
+    }
+
+    static std::string Read(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    static size_t Count(const std::string& text, std::string_view pattern) {
+        size_t count = 0;
+        for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) {
+            ++count;
+        }
+        return count;
+    }
+};
+
+TEST_F(TraceTest, SpansCostNothingUntilStarted) {
+    EXPECT_FALSE(TracingEnabled());
+    {
+        WSL_TRACE_SPAN("Ignored");
+    }
+
+    const auto path = directory / "trace.json";
+    ASSERT_TRUE(StartTracing(path, "wsl"));
+    EXPECT_TRUE(TracingEnabled());
+    StopTracing();
+    EXPECT_FALSE(TracingEnabled());
+
+    EXPECT_EQ(Read(path).find("Ignored"), std::string::npos);
+}
+
+TEST_F(TraceTest, WritesCompleteEvents) {
+    const auto path = directory / "trace.json";
+    ASSERT_TRUE(StartTracing(path, "wsl"));
+    {
+        WSL_TRACE_SPAN("Launch");
+        {
+            WSL_TRACE_SPAN("Parse \"arguments\"");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    const uint64_t now = TraceNow();
+    RecordTraceSpan("Earlier", now - 5000000, now);
+    StopTracing();
+
+    const std::string trace = Read(path);
+    EXPECT_EQ(trace.rfind("[\n{\"name\":\"process_name\",\"ph\":\"M\"", 0), 0u) << trace;
+    EXPECT_NE(trace.find("\"args\":{\"name\":\"wsl\"}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"Parse \\\"arguments\\\"\",\"cat\":\"wsl\",\"ph\":\"X\",\"ts\":"), std::string::npos);
+    EXPECT_EQ(Count(trace, "\"ph\":\"X\""), 3u);
+
+    // The inner span closes first; the outer one covers the sleep.
+    EXPECT_LT(trace.find("Parse"), trace.find("Launch"));
+    TraceSummary summary;
+    summary.Add(trace);
+    const auto phases = summary.Phases();
+    ASSERT_EQ(phases.size(), 3u);
+    EXPECT_EQ(phases[0].name, "Parse \"arguments\"");
+    EXPECT_EQ(phases[1].name, "Launch");
+    EXPECT_GE(phases[1].max, 2000.0);
+    EXPECT_EQ(phases[2].name, "Earlier");
+    EXPECT_DOUBLE_EQ(phases[2].max, 5000.0);
+}
+
+TEST_F(TraceTest, ADirectoryGetsAFilePerProcess) {
+    ASSERT_TRUE(StartTracing(directory, "wslservice"));
+    {
+        WSL_TRACE_SPAN("CreateLxProcess");
+    }
+    StopTracing();
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        files.push_back(entry.path());
+    }
+    ASSERT_EQ(files.size(), 1u);
+    EXPECT_EQ(files[0].filename().string().rfind("wslservice-", 0), 0u);
+    EXPECT_NE(Read(files[0]).find("CreateLxProcess"), std::string::npos);
+}
+
+TEST_F(TraceTest, RunsAppendToOneFile) {
+    const auto path = directory / "batch.json";
+    for (int run = 0; run < 3; ++run) {
+        ASSERT_TRUE(StartTracing(path, "wsl"));
+        {
+            WSL_TRACE_SPAN("Launch");
+            RecordTraceSpan("Parse", TraceNow() - 1000, TraceNow());
+        }
+        StopTracing();
+    }
+
+    // One opening bracket; every later run's header and every span follow
+    // a comma.
+    const std::string trace = Read(path);
+    EXPECT_EQ(Count(trace, "["), 1u);
+    EXPECT_EQ(Count(trace, "process_name"), 3u);
+    EXPECT_EQ(Count(trace, ",\n{"), 2u + 3u * 2u);
+    EXPECT_EQ(trace.find(",,"), std::string::npos);
+}
+
+TEST_F(TraceTest, CollectsEveryThread) {
+    const auto path = directory / "threads.json";
+    ASSERT_TRUE(StartTracing(path, "wsl"));
+
+    constexpr int Threads = 4;
+    constexpr int Spans = 3000; // past the per-thread flush threshold
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < Spans; ++i) {
+                WSL_TRACE_SPAN("Work");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    StopTracing();
+
+    TraceSummary summary;
+    summary.Add(Read(path));
+    const auto phases = summary.Phases();
+    ASSERT_EQ(phases.size(), 1u);
+    EXPECT_EQ(phases[0].count, static_cast<size_t>(Threads * Spans));
+}
+
+TEST_F(TraceTest, SummarizesPercentilesAcrossRuns) {
+    std::string trace = "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"wsl\"}}";
+    for (int i = 1; i <= 100; ++i) {
+        trace += ",\n{\"name\":\"Launch\",\"cat\":\"wsl\",\"ph\":\"X\",\"ts\":1.000,\"dur\":" + std::to_string(i * 1000) +
+                 ".000,\"pid\":1,\"tid\":1}";
+    }
+    trace += ",\n{\"name\":\"Relay\",\"cat\":\"wsl\",\"ph\":\"X\",\"ts\":1.000,\"dur\":250.500,\"pid\":1,\"tid\":1}";
+
+    TraceSummary summary;
+    summary.Add(trace);
+    summary.Add("not a trace\n{\"name\":\"Half\"");
+    const auto phases = summary.Phases();
+    ASSERT_EQ(phases.size(), 2u);
+    EXPECT_EQ(phases[0].name, "Launch");
+    EXPECT_EQ(phases[0].count, 100u);
+    EXPECT_DOUBLE_EQ(phases[0].p50, 50000.0);
+    EXPECT_DOUBLE_EQ(phases[0].p99, 99000.0);
+    EXPECT_DOUBLE_EQ(phases[0].max, 100000.0);
+    EXPECT_DOUBLE_EQ(phases[1].p50, 250.5);
+
+    const std::string table = summary.Format();
+    EXPECT_NE(table.find("Launch      100       50.000       99.000      100.000"), std::string::npos) << table;
+}
+
+TEST_F(TraceTest, FailsQuietlyWhenTheFileCannotBeOpened) {
+    EXPECT_FALSE(StartTracing(directory / "missing" / "trace.json", "wsl"));
+    EXPECT_FALSE(TracingEnabled());
+}
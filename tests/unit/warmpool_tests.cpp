@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include "warmpool.h"
+#include "../support/mock_service.h"
+
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace WSL;
+using namespace WSL::Testing;
+
+class WarmPoolTest : public ::testing::Test {
+protected:
+    std::unique_ptr<ServiceSession> session;
+
+    void SetUp() override {
+        signal(SIGPIPE, SIG_IGN);
+
+        MockServiceTransport::Options options;
+        options.workers = 4;
+        options.spawn = true;
+        session = std::make_unique<ServiceSession>(std::make_unique<MockServiceTransport>(options));
+    }
+
+    static WarmPoolOptions Options(size_t size) {
+        WarmPoolOptions options;
+        options.size = size;
+        options.shell = L"/bin/sh";
+        options.shellArguments = {};
+        return options;
+    }
+
+    static LaunchRequest Request(const std::wstring& script) {
+        LaunchRequest request;
+        request.distributionId = L"{0283592D-BE56-40D4-B935-3FC18C3AA007}";
+        request.command = L"/bin/sh";
+        request.arguments = {L"/bin/sh", L"-c", script};
+        return request;
+    }
+
+    template <typename Predicate>
+    static bool WaitFor(Predicate predicate) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!predicate()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    static std::string ReadOutput(LaunchResult& result) {
+        std::string text;
+        char buffer[256];
+        ssize_t bytes;
+        while ((bytes = read(result.output, buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, static_cast<size_t>(bytes));
+        }
+        return text;
+    }
+};
+
+TEST_F(WarmPoolTest, EncodesJobsOnOneLine) {
+    LaunchRequest request;
+    request.workingDirectory = L"/home/user";
+    request.environment = std::make_shared<EnvironmentSnapshot>(
+        EnvironmentSnapshot::FromStrings({L"B=it's\nhere", L"ProgramFiles(x86)=C:\\x", L"A=1", L"__wsl_warm_nl=x"}));
+    request.command = L"echo hi";
+
+    EXPECT_EQ(EncodeWarmJob(request),
+              "cd -- '/home/user' || exit 1; export 'A=1' 'B=it'\\''s'\"$__wsl_warm_nl\"'here'; eval 'echo hi'\n");
+
+    request = {};
+    request.arguments = {L"/bin/ls", L"-l"};
+    EXPECT_EQ(EncodeWarmJob(request), "exec '/bin/ls' '-l'\n");
+}
+
+TEST_F(WarmPoolTest, RunsTheJobOnAWarmWorker) {
+    WarmPool pool(*session, Options(1));
+
+    LaunchRequest request = Request(L"printf '%s|%s' \"$VALUE\" \"$(pwd)\"");
+    request.workingDirectory = L"/tmp";
+    // nl is an ordinary variable, not the one newlines are spliced from.
+    request.environment = std::make_shared<EnvironmentSnapshot>(
+        EnvironmentSnapshot::FromStrings({L"VALUE=it's a\nvalue", L"nl=not a newline"}));
+
+    pool.Prewarm(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+
+    LaunchResult result = pool.Launch(request);
+    ASSERT_TRUE(result.Succeeded());
+    EXPECT_EQ(ReadOutput(result), "it's a\nvalue|/tmp");
+
+    auto stats = pool.GetStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+}
+
+TEST_F(WarmPoolTest, LoginOutputDoesNotSpoilTheWorker) {
+    // A login that prints a banner before running the bootstrap, as
+    // /etc/profile.d scripts do.
+    WarmPoolOptions options = Options(1);
+    options.shellArguments = {L"-c", L"echo 'Welcome to Ubuntu'; exec /bin/sh \"$0\" \"$@\""};
+    WarmPool pool(*session, options);
+
+    const LaunchRequest request = Request(L"echo warm");
+    pool.Prewarm(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+
+    LaunchResult result = pool.Launch(request);
+    ASSERT_TRUE(result.Succeeded());
+    EXPECT_EQ(ReadOutput(result), "warm\n");
+
+    auto stats = pool.GetStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+    EXPECT_EQ(stats.evicted, 0u);
+}
+
+TEST_F(WarmPoolTest, EachWorkerRunsOneCommand) {
+    WarmPool pool(*session, Options(1));
+    // A bare command line runs in the worker's own shell.
+    LaunchRequest request = Request(L"");
+    request.command = L"echo $$";
+    request.arguments.Clear();
+
+    pool.Prewarm(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+    LaunchResult first = pool.Launch(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+    LaunchResult second = pool.Launch(request);
+
+    // Output reaches EOF because the worker exits after its one command.
+    const std::string firstPid = ReadOutput(first);
+    const std::string secondPid = ReadOutput(second);
+    EXPECT_FALSE(firstPid.empty());
+    EXPECT_NE(firstPid, secondPid);
+    EXPECT_EQ(pool.GetStats().hits, 2u);
+}
+
+TEST_F(WarmPoolTest, ColdLaunchWhenNoWorkerIsReady) {
+    WarmPool pool(*session, Options(0));
+
+    LaunchResult result = pool.Launch(Request(L"echo cold"));
+    ASSERT_TRUE(result.Succeeded());
+    EXPECT_EQ(ReadOutput(result), "cold\n");
+
+    auto stats = pool.GetStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.started, 0u);
+}
+
+TEST_F(WarmPoolTest, RefillsAfterEachClaim) {
+    WarmPool pool(*session, Options(2));
+    const LaunchRequest request = Request(L"true");
+
+    // A miss still starts the pool for next time.
+    pool.Launch(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 2; }));
+
+    pool.Launch(request);
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 2; }));
+
+    auto stats = pool.GetStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.started, 3u);
+}
+
+TEST_F(WarmPoolTest, KeysByDistributionAndUser) {
+    WarmPool pool(*session, Options(1));
+    LaunchRequest root = Request(L"true");
+    root.userName = L"root";
+
+    pool.Prewarm(Request(L"true"));
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+
+    pool.Launch(root);
+    EXPECT_EQ(pool.GetStats().misses, 1u);
+}
+
+TEST_F(WarmPoolTest, EvictsIdleWorkers) {
+    WarmPoolOptions options = Options(1);
+    options.idleTimeout = std::chrono::milliseconds(40);
+    WarmPool pool(*session, options);
+
+    pool.Prewarm(Request(L"true"));
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().started == 1 && pool.GetStats().evicted == 1; }));
+    EXPECT_EQ(pool.GetStats().idle, 0u);
+}
+
+TEST_F(WarmPoolTest, SkipsWorkersThatDied) {
+    // The "shell" exits straight away instead of waiting for a job.
+    WarmPoolOptions options = Options(1);
+    options.shellArguments = {L"-c", L"exit 0"};
+    WarmPool pool(*session, options);
+
+    pool.Prewarm(Request(L"true"));
+    ASSERT_TRUE(WaitFor([&] { return pool.GetStats().idle == 1; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    LaunchResult result = pool.Launch(Request(L"echo fallback"));
+    EXPECT_EQ(ReadOutput(result), "fallback\n");
+
+    auto stats = pool.GetStats();
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_GE(stats.evicted, 1u);
+}
+
+TEST_F(WarmPoolTest, WorkersStartingWhenThePoolGoesAway) {
+    {
+        WarmPool pool(*session, Options(4));
+        pool.Prewarm(Request(L"true"));
+    }
+    // Their completions land after the pool is gone and are dropped.
+    session.reset();
+}
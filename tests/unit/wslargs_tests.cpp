@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "optiontable.h"
+#include "wslargs.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace WSL;
+
+class WSLArgumentsTest : public ::testing::Test {
+protected:
+    static WSLArguments Parse(std::vector<const wchar_t*> arguments) {
+        arguments.insert(arguments.begin(), L"wsl.exe");
+        return ParseWSLArguments(static_cast<int>(arguments.size()), arguments.data());
+    }
+};
+
+TEST_F(WSLArgumentsTest, ParsesOptionsAndTheirValues) {
+    WSLArguments arguments = Parse({L"-d", L"Ubuntu", L"--USER", L"root", L"--cd", L"/tmp", L"--shell-type"});
+    EXPECT_EQ(arguments.command, WSLCommand::Execute);
+    EXPECT_EQ(arguments.distributionName, L"Ubuntu");
+    EXPECT_EQ(arguments.userName, L"root");
+    EXPECT_TRUE(arguments.asUser);
+    EXPECT_EQ(arguments.workingDirectory, L"/tmp");
+    EXPECT_TRUE(arguments.shellExecute);
+    EXPECT_TRUE(arguments.commandArguments.Empty());
+
+    arguments = Parse({L"--batch", L"jobs.txt", L"--Parallel", L"8", L"--output-dir", L"out"});
+    EXPECT_EQ(arguments.command, WSLCommand::Batch);
+    EXPECT_EQ(arguments.batchFile, L"jobs.txt");
+    EXPECT_EQ(arguments.batchParallelism, 8u);
+    EXPECT_EQ(arguments.batchOutputDirectory, L"out");
+
+    arguments = Parse({L"--trace", L"C:\\traces", L"-e", L"true"});
+    EXPECT_EQ(arguments.tracePath, L"C:\\traces");
+    EXPECT_EQ(arguments.executeCommand, L"true");
+}
+
+TEST_F(WSLArgumentsTest, ParsesEveryVerb) {
+    EXPECT_EQ(Parse({L"-l"}).command, WSLCommand::List);
+    EXPECT_EQ(Parse({L"--status"}).command, WSLCommand::Status);
+
+    WSLArguments status = Parse({L"--status", L"--metrics", L"--json"});
+    EXPECT_EQ(status.command, WSLCommand::Status);
+    EXPECT_TRUE(status.showMetrics);
+    EXPECT_TRUE(status.json);
+    EXPECT_EQ(Parse({L"--shutdown"}).command, WSLCommand::Shutdown);
+    EXPECT_EQ(Parse({L"--version"}).command, WSLCommand::Version);
+    EXPECT_EQ(Parse({L"--update"}).command, WSLCommand::Update);
+
+    WSLArguments arguments = Parse({L"-t", L"Debian"});
+    EXPECT_EQ(arguments.command, WSLCommand::Terminate);
+    EXPECT_EQ(arguments.distributionName, L"Debian");
+
+    arguments = Parse({L"-s", L"Debian"});
+    EXPECT_EQ(arguments.command, WSLCommand::SetDefault);
+    EXPECT_EQ(arguments.distributionName, L"Debian");
+
+    arguments = Parse({L"--unregister", L"Old"});
+    EXPECT_EQ(arguments.command, WSLCommand::Unregister);
+    EXPECT_EQ(arguments.distributionName, L"Old");
+
+    arguments = Parse({L"--import", L"New", L"D:\\wsl\\new", L"new.tar"});
+    EXPECT_EQ(arguments.command, WSLCommand::Import);
+    EXPECT_EQ(arguments.distributionName, L"New");
+    EXPECT_EQ(arguments.installLocation, L"D:\\wsl\\new");
+    EXPECT_EQ(arguments.archivePath, L"new.tar");
+
+    arguments = Parse({L"--export", L"Ubuntu", L"backup.tar"});
+    EXPECT_EQ(arguments.command, WSLCommand::Export);
+    EXPECT_EQ(arguments.distributionName, L"Ubuntu");
+    EXPECT_EQ(arguments.archivePath, L"backup.tar");
+    EXPECT_FALSE(arguments.incremental);
+
+    arguments = Parse({L"--export", L"Ubuntu", L"D:\\backups", L"--incremental"});
+    EXPECT_EQ(arguments.command, WSLCommand::Export);
+    EXPECT_TRUE(arguments.incremental);
+
+    arguments = Parse({L"--restore", L"D:\\backups", L"Ubuntu-20261017T000000Z", L"restored.tar.gz"});
+    EXPECT_EQ(arguments.command, WSLCommand::Restore);
+    EXPECT_EQ(arguments.snapshotStore, L"D:\\backups");
+    EXPECT_EQ(arguments.snapshotName, L"Ubuntu-20261017T000000Z");
+    EXPECT_EQ(arguments.archivePath, L"restored.tar.gz");
+}
+
+TEST_F(WSLArgumentsTest, HelpOverridesEverythingElse) {
+    EXPECT_EQ(Parse({L"--list", L"-H", L"--no-such-option"}).command, WSLCommand::Help);
+}
+
+TEST_F(WSLArgumentsTest, TrailingCommandIsKeptAsGiven) {
+    WSLArguments arguments = Parse({L"-d", L"Ubuntu", L"ls", L"-la", L"my file", L"--list"});
+    EXPECT_EQ(arguments.command, WSLCommand::Execute);
+    ASSERT_EQ(arguments.commandArguments.Size(), 4u);
+    EXPECT_EQ(arguments.commandArguments[2], L"my file");
+    EXPECT_EQ(arguments.commandArguments[3], L"--list");
+
+    arguments = Parse({L"--", L"-weird-program", L""});
+    ASSERT_EQ(arguments.commandArguments.Size(), 2u);
+    EXPECT_EQ(arguments.commandArguments[0], L"-weird-program");
+    EXPECT_EQ(arguments.commandArguments[1], L"");
+}
+
+TEST_F(WSLArgumentsTest, RejectsUnknownOptionsAndMissingValues) {
+    EXPECT_THROW(Parse({L"--no-such-option"}), std::invalid_argument);
+    EXPECT_THROW(Parse({L"--distribution"}), std::invalid_argument);
+    EXPECT_THROW(Parse({L"--import", L"New", L"D:\\wsl\\new"}), std::invalid_argument);
+    EXPECT_THROW(Parse({L"--parallel", L"0"}), std::invalid_argument);
+    EXPECT_THROW(Parse({L"--parallel", L"-4"}), std::invalid_argument);
+    EXPECT_THROW(Parse({L"--parallel", L"4x"}), std::invalid_argument);
+    EXPECT_THROW(ParseWSLArguments(0, nullptr), std::invalid_argument);
+
+    try {
+        Parse({L"--export", L"Ubuntu"});
+        FAIL() << "expected std::invalid_argument";
+    }
+    catch (const std::invalid_argument& e) {
+        EXPECT_STREQ(e.what(), "--export requires a distribution name and archive");
+    }
+}
+
+struct Counter {
+    int value = 0;
+};
+
+// The table itself is usable in constant expressions.
+TEST_F(WSLArgumentsTest, OptionTableLooksUpAtCompileTime) {
+    static constexpr Option<Counter> Options[] = {
+        {L"--one", L"-1", 0, "", [](Counter& counter, const wchar_t* const*) { counter.value += 1; }},
+        {L"--two", L"", 0, "", [](Counter& counter, const wchar_t* const*) { counter.value += 2; }},
+        {L"--three", L"-3", 0, "", [](Counter& counter, const wchar_t* const*) { counter.value += 3; }},
+    };
+    static constexpr OptionTable<Counter, 3> Table(Options);
+    static_assert(Table.Find(L"--TWO") == Table.Find(L"--two"));
+    static_assert(Table.Find(L"-3")->name == L"--three");
+    static_assert(Table.Find(L"--four") == nullptr);
+    static_assert(Table.Find(L"") == nullptr);
+
+    Counter counter;
+    Table.Find(L"-1")->handler(counter, nullptr);
+    Table.Find(L"--Three")->handler(counter, nullptr);
+    EXPECT_EQ(counter.value, 4);
+}
@@ -83,31 +83,6 @@ TEST_F(WSLServiceTest, COMInterfaceCreation) {
     EXPECT_NO_THROW(service.Initialize());
 }
 
-// Performance tests
-class WSLPerformanceTest : public ::testing::Test {
-protected:
-    void SetUp() override {
-        // Setup performance monitoring
-    }
-};
-
-TEST_F(WSLPerformanceTest, IORelayPerformance) {
-    // Test I/O relay performance with large data transfers
-    const size_t testDataSize = 1024 * 1024; // 1MB
-    std::vector<char> testData(testDataSize, 'A');
-
-    auto start = std::chrono::high_resolution_clock::now();
-
-    // Simulate I/O relay
-    // This would relay the test data through the actual relay mechanism
-
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-
-    // Performance should be under reasonable threshold
-    EXPECT_LT(duration.count(), 1000); // Under 1 second for 1MB
-}
-
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();